@@ -0,0 +1,212 @@
+#include "PCH.h"
+#include "../Core/BVH/BVHBuilder.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../Core/Shapes/MeshShape.h"
+#include "../Core/Shapes/Mesh/MeshCache.h"
+#include "../Core/Shapes/Mesh/TriangleSoup.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Rendering/RendererContext.h"
+#include "../Core/Traversal/TraversalContext.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+using namespace math;
+
+
+// generate bounding boxes of a random triangle soup
+static DynArray<Box> GenerateTriangleSoup(uint32 numTriangles)
+{
+    const float sceneSize = 100.0f;
+    const float triangleSize = 0.5f;
+
+    Random random;
+
+    DynArray<Box> boxes;
+    boxes.Reserve(numTriangles);
+    for (uint32 i = 0; i < numTriangles; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * sceneSize;
+        const Vector4 v0 = center + random.GetVector4Bipolar() * triangleSize;
+        const Vector4 v1 = center + random.GetVector4Bipolar() * triangleSize;
+        const Vector4 v2 = center + random.GetVector4Bipolar() * triangleSize;
+        boxes.PushBack(Box(v0, v1, v2));
+    }
+
+    return boxes;
+}
+
+static void BuildBVH(benchmark::State& state, const BvhBuildingParams& params)
+{
+    const uint32 numTriangles = static_cast<uint32>(state.range(0));
+    const DynArray<Box> boxes = GenerateTriangleSoup(numTriangles);
+
+    for (auto _ : state)
+    {
+        BVH bvh;
+        BVHBuilder::Indices leavesOrder;
+        BVHBuilder builder(bvh);
+        builder.Build(boxes.Data(), numTriangles, params, leavesOrder);
+        benchmark::DoNotOptimize(bvh.GetNumNodes());
+    }
+
+    state.SetItemsProcessed(state.iterations() * numTriangles);
+}
+
+
+static void Benchmark_BVH_Build_FullSweep(benchmark::State& state)
+{
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::FullSweep;
+    BuildBVH(state, params);
+}
+BENCHMARK(Benchmark_BVH_Build_FullSweep)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void Benchmark_BVH_Build_Binned_SingleThreaded(benchmark::State& state)
+{
+    ThreadPool threadPool;
+    threadPool.SetNumThreads(1);
+
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::Binned;
+    params.threadPool = &threadPool;
+    BuildBVH(state, params);
+}
+BENCHMARK(Benchmark_BVH_Build_Binned_SingleThreaded)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void Benchmark_BVH_Build_Binned(benchmark::State& state)
+{
+    ThreadPool threadPool;
+
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::Binned;
+    params.threadPool = &threadPool;
+    BuildBVH(state, params);
+}
+BENCHMARK(Benchmark_BVH_Build_Binned)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+// incoherent rays vs. random triangle soup, for each BVH node format
+static void Benchmark_BVH_Traverse(benchmark::State& state)
+{
+    const BvhFormat bvhFormat = static_cast<BvhFormat>(state.range(0));
+    const uint32 numTriangles = static_cast<uint32>(state.range(1));
+    const uint32 numRays = 4096;
+    const float sceneSize = 100.0f;
+
+    Random random;
+
+    TriangleSoup triangleSoup;
+    if (!triangleSoup.Generate(random, numTriangles, sceneSize))
+    {
+        state.SkipWithError("Failed to generate triangles");
+        return;
+    }
+
+    MeshDesc meshDesc;
+    meshDesc.bvhFormat = bvhFormat;
+    meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+    MeshShape mesh;
+    if (!mesh.Initialize(meshDesc))
+    {
+        state.SkipWithError("Failed to create mesh");
+        return;
+    }
+
+    DynArray<Ray> rays;
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        rays.PushBack(Ray(random.GetVector4Bipolar() * sceneSize, random.GetVector4Bipolar()));
+    }
+
+    RenderingContext context;
+    uint32 rayIndex = 0;
+
+    for (auto _ : state)
+    {
+        HitPoint hitPoint;
+        mesh.Traverse({ rays[rayIndex], hitPoint, context }, 0);
+        benchmark::DoNotOptimize(hitPoint);
+        rayIndex = (rayIndex + 1) % numRays;
+    }
+
+    state.counters["bvh_bytes"] = static_cast<double>(mesh.GetBvhMemorySize());
+    state.SetItemsProcessed(state.iterations());
+}
+static void Benchmark_BVH_Traverse_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const BvhFormat format : { BvhFormat::Binary, BvhFormat::Wide4, BvhFormat::Wide8, BvhFormat::Quantized })
+    {
+        for (const int64_t numTriangles : { 1000, 100000, 1000000 })
+        {
+            benchmark->Args({ static_cast<int64_t>(format), numTriangles });
+        }
+    }
+}
+BENCHMARK(Benchmark_BVH_Traverse)->ArgNames({ "format", "triangles" })->Apply(Benchmark_BVH_Traverse_Arguments);
+
+
+// mesh initialization: BVH build and triangles preprocessing vs. loading them from the mesh cache file
+static void Benchmark_MeshShape_Initialize(benchmark::State& state)
+{
+    const bool useCache = state.range(0) != 0;
+    const uint32 numTriangles = static_cast<uint32>(state.range(1));
+    const float sceneSize = 100.0f;
+
+    Random random;
+
+    TriangleSoup triangleSoup;
+    if (!triangleSoup.Generate(random, numTriangles, sceneSize))
+    {
+        state.SkipWithError("Failed to generate triangles");
+        return;
+    }
+
+    MeshDesc meshDesc;
+    meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+    if (useCache)
+    {
+        meshDesc.cacheDirectory = ".";
+
+        // write the cache file
+        MeshShape mesh;
+        if (!mesh.Initialize(meshDesc))
+        {
+            state.SkipWithError("Failed to create mesh");
+            return;
+        }
+    }
+
+    for (auto _ : state)
+    {
+        MeshShape mesh;
+        if (!mesh.Initialize(meshDesc))
+        {
+            state.SkipWithError("Failed to create mesh");
+            break;
+        }
+    }
+
+    if (useCache)
+    {
+        remove(MeshCache::GetFilePath(meshDesc.cacheDirectory, MeshCache::CalculateHash(meshDesc.vertexBufferDesc, MeshShape::GetBvhBuildingParams(meshDesc))).c_str());
+    }
+
+    state.SetItemsProcessed(state.iterations() * numTriangles);
+}
+static void Benchmark_MeshShape_Initialize_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t cached : { 0, 1 })
+    {
+        for (const int64_t numTriangles : { 10000, 100000, 1000000 })
+        {
+            benchmark->Args({ cached, numTriangles });
+        }
+    }
+}
+BENCHMARK(Benchmark_MeshShape_Initialize)->ArgNames({ "cached", "triangles" })->Apply(Benchmark_MeshShape_Initialize_Arguments)->Unit(benchmark::kMillisecond)->UseRealTime();
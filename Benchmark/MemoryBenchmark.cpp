@@ -1,10 +1,17 @@
 #include "PCH.h"
 #include "../Core/Utils/Memory.h"
 #include "../Core/Utils/MemoryHelpers.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Shapes/MeshShape.h"
+#include "../Core/Shapes/Mesh/TriangleSoup.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Rendering/RendererContext.h"
+#include "../Core/Traversal/TraversalContext.h"
 
 #include <benchmark/benchmark.h>
 
 using namespace rt;
+using namespace math;
 
 
 static void Benchmark_LargeMemCopy_Aligned64(benchmark::State& state)
@@ -39,3 +46,68 @@ static void Benchmark_Memcpy_Std(benchmark::State& state)
     DefaultAllocator::Free(src);
 }
 BENCHMARK(Benchmark_Memcpy_Std)->RangeMultiplier(2)->Range(1, 128);
+
+
+// BVH traversal with nodes and triangles allocated with/without large pages
+// Incoherent rays over a big mesh touch a lot of pages, so the TLB misses become visible.
+static void Benchmark_BVH_Traverse_LargePages(benchmark::State& state)
+{
+    const bool useLargePages = state.range(0) != 0;
+    const uint32 numTriangles = static_cast<uint32>(state.range(1));
+    const uint32 numRays = 64 * 1024;
+    const float sceneSize = 100.0f;
+
+    Random random;
+
+    TriangleSoup triangleSoup;
+    if (!triangleSoup.Generate(random, numTriangles, sceneSize))
+    {
+        state.SkipWithError("Failed to generate triangles");
+        return;
+    }
+
+    MeshDesc meshDesc;
+    meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+    SystemAllocator::SetLargePagesEnabled(useLargePages);
+    MeshShape mesh;
+    const bool meshCreated = mesh.Initialize(meshDesc);
+    SystemAllocator::SetLargePagesEnabled(true);
+
+    if (!meshCreated)
+    {
+        state.SkipWithError("Failed to create mesh");
+        return;
+    }
+
+    DynArray<Ray> rays;
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        rays.PushBack(Ray(random.GetVector4Bipolar() * sceneSize, random.GetVector4Bipolar()));
+    }
+
+    RenderingContext context;
+    uint32 rayIndex = 0;
+
+    for (auto _ : state)
+    {
+        HitPoint hitPoint;
+        mesh.Traverse({ rays[rayIndex], hitPoint, context }, 0);
+        benchmark::DoNotOptimize(hitPoint);
+        rayIndex = (rayIndex + 1) % numRays;
+    }
+
+    state.counters["bvh_bytes"] = static_cast<double>(mesh.GetBvhMemorySize());
+    state.SetItemsProcessed(state.iterations());
+}
+static void Benchmark_BVH_Traverse_LargePages_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t largePages : { 0, 1 })
+    {
+        for (const int64_t numTriangles : { 100000, 1000000, 4000000 })
+        {
+            benchmark->Args({ largePages, numTriangles });
+        }
+    }
+}
+BENCHMARK(Benchmark_BVH_Traverse_LargePages)->ArgNames({ "large_pages", "triangles" })->Apply(Benchmark_BVH_Traverse_LargePages_Arguments);
@@ -0,0 +1,61 @@
+#include "PCH.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Camera.h"
+#include "../Core/Scene/Light/BackgroundLight.h"
+#include "../Core/Scene/Object/SceneObject_Light.h"
+#include "../Core/Rendering/Renderer.h"
+#include "../Core/Rendering/Viewport.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+using namespace math;
+
+
+// post processing of a whole image (sum buffer filled with a single rendering pass of a background light)
+static void Benchmark_Viewport_PostProcess(benchmark::State& state)
+{
+    const uint32 width = static_cast<uint32>(state.range(0));
+    const uint32 height = static_cast<uint32>(state.range(1));
+
+    Scene scene;
+    scene.AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(Vector4(0.5f, 1.0f, 2.0f))));
+    scene.BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    Viewport viewport;
+    if (!viewport.Resize(width, height))
+    {
+        state.SkipWithError("Failed to resize viewport");
+        return;
+    }
+    viewport.SetRenderer(CreateRenderer("Path Tracer", scene));
+    viewport.Reset();
+    viewport.Render(camera);
+
+    PostprocessParams params;
+    params.useSimd = state.range(2) != 0;
+    params.bloomFactor = state.range(3) != 0 ? 0.1f : 0.0f;
+    viewport.SetPostprocessParams(params);
+
+    for (auto _ : state)
+    {
+        viewport.UpdateFrontBuffer();
+    }
+
+    state.SetItemsProcessed(state.iterations() * width * height);
+}
+static void Benchmark_Viewport_PostProcess_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t bloom : { 0, 1 })
+    {
+        for (const int64_t simd : { 0, 1 })
+        {
+            benchmark->Args({ 1920, 1080, simd, bloom });
+            benchmark->Args({ 3840, 2160, simd, bloom });
+        }
+    }
+}
+BENCHMARK(Benchmark_Viewport_PostProcess)->ArgNames({ "width", "height", "simd", "bloom" })->Apply(Benchmark_Viewport_PostProcess_Arguments)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,207 @@
+#include "PCH.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Shapes/MeshShape.h"
+#include "../Core/Shapes/Mesh/TriangleSoup.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Object/SceneObject_Shape.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Rendering/RendererContext.h"
+#include "../Core/Traversal/RayStream.h"
+#include "../Core/Traversal/TraversalContext.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+using namespace math;
+
+
+// random triangle soup with secondary rays spawned from the primary rays hit points
+class RayStreamFixture : public benchmark::Fixture
+{
+public:
+    static constexpr uint32 NumTriangles = 100000;
+    static constexpr uint32 NumRays = 64 * 1024;
+
+    void SetUp(const benchmark::State&) override
+    {
+        if (mScene)
+        {
+            return;
+        }
+
+        const float sceneSize = 100.0f;
+
+        Random random;
+
+        TriangleSoup triangleSoup;
+        if (!triangleSoup.Generate(random, NumTriangles, sceneSize))
+        {
+            return;
+        }
+
+        MeshDesc meshDesc;
+        meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+        MeshShapePtr mesh = std::make_shared<MeshShape>();
+        if (!mesh->Initialize(meshDesc))
+        {
+            return;
+        }
+
+        mScene = std::make_unique<Scene>();
+        mScene->AddObject(std::make_unique<ShapeSceneObject>(mesh));
+        mScene->BuildBVH();
+
+        RenderingContext context;
+
+        // shoot primary rays from a single point and bounce them in random directions
+        const Vector4 cameraPosition(0.0f, 0.0f, -2.0f * sceneSize);
+        while (mSecondaryRays.Size() < NumRays)
+        {
+            const Vector4 target = random.GetVector4Bipolar() * sceneSize;
+            const Ray primaryRay(cameraPosition, target - cameraPosition);
+
+            HitPoint hitPoint;
+            mScene->Traverse({ primaryRay, hitPoint, context });
+            if (hitPoint.objectId == RT_INVALID_OBJECT)
+            {
+                continue;
+            }
+
+            const Vector4 hitPosition = primaryRay.GetAtDistance(hitPoint.distance);
+            mSecondaryRays.PushBack(Ray(hitPosition, random.GetVector4Bipolar()));
+        }
+    }
+
+    void TraceSecondaryRays(benchmark::State& state, bool sort, const RenderingParams& params = RenderingParams())
+    {
+        if (!mScene)
+        {
+            state.SkipWithError("Failed to create scene");
+            return;
+        }
+
+        RenderingContext context;
+        context.params = &params;
+        RayStream rayStream;
+
+        const auto traceRays = [&]()
+        {
+            for (uint32 i = 0; i < mSecondaryRays.Size(); ++i)
+            {
+                rayStream.PushRay(mSecondaryRays[i], Vector4(1.0f), ImageLocationInfo(i % 1024, i / 1024));
+            }
+
+            if (sort)
+            {
+                rayStream.Sort();
+            }
+
+            while (rayStream.PopPacket(context.rayPacket))
+            {
+                mScene->Traverse({ context.rayPacket, context });
+            }
+        };
+
+        for (auto _ : state)
+        {
+            traceRays();
+        }
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        // collect the counters in an extra pass, so they don't affect the measured time
+        context.localCounters.enabled = true;
+        context.counters.Reset();
+        traceRays();
+
+        // fraction of ray-box tests that hit, i.e. how many SIMD lanes were doing useful work
+        state.counters["utilization"] = static_cast<double>(context.counters.numPassedRayBoxTests) / static_cast<double>(context.counters.numRayBoxTests);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        state.SetItemsProcessed(state.iterations() * mSecondaryRays.Size());
+    }
+
+protected:
+    std::unique_ptr<Scene> mScene;
+    DynArray<Ray> mSecondaryRays;
+};
+
+BENCHMARK_DEFINE_F(RayStreamFixture, Benchmark_RayStream_Unsorted)(benchmark::State& state)
+{
+    TraceSecondaryRays(state, false);
+}
+BENCHMARK_REGISTER_F(RayStreamFixture, Benchmark_RayStream_Unsorted)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(RayStreamFixture, Benchmark_RayStream_Sorted)(benchmark::State& state)
+{
+    TraceSecondaryRays(state, true);
+}
+BENCHMARK_REGISTER_F(RayStreamFixture, Benchmark_RayStream_Sorted)->Unit(benchmark::kMillisecond);
+
+// packet traversal with different ray reordering thresholds (in percents of active SIMD lanes, 0 = disabled)
+BENCHMARK_DEFINE_F(RayStreamFixture, Benchmark_RayStream_Reordering)(benchmark::State& state)
+{
+    RenderingParams params;
+    params.packetReorderingThreshold = static_cast<float>(state.range(1)) / 100.0f;
+    TraceSecondaryRays(state, state.range(0) != 0, params);
+}
+static void Benchmark_RayStream_Reordering_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t sorted : { 0, 1 })
+    {
+        for (const int64_t threshold : { 0, 25, 50, 75, 100 })
+        {
+            benchmark->Args({ sorted, threshold });
+        }
+    }
+}
+BENCHMARK_REGISTER_F(RayStreamFixture, Benchmark_RayStream_Reordering)->ArgNames({ "sorted", "threshold" })->Apply(Benchmark_RayStream_Reordering_Arguments)->Unit(benchmark::kMillisecond);
+
+// packet traversal with different SIMD-8 (active groups) and single-ray (active rays) fallback thresholds
+BENCHMARK_DEFINE_F(RayStreamFixture, Benchmark_RayStream_Fallback)(benchmark::State& state)
+{
+    RenderingParams params;
+    params.simdTraversalThreshold = static_cast<uint32>(state.range(0));
+    params.singleRayTraversalThreshold = static_cast<uint32>(state.range(1));
+    TraceSecondaryRays(state, true, params);
+}
+static void Benchmark_RayStream_Fallback_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t simdThreshold : { 0, 1, 2, 4 })
+    {
+        for (const int64_t singleRayThreshold : { 0, 1, 2, 4 })
+        {
+            benchmark->Args({ simdThreshold, singleRayThreshold });
+        }
+    }
+}
+BENCHMARK_REGISTER_F(RayStreamFixture, Benchmark_RayStream_Fallback)->ArgNames({ "simd", "single" })->Apply(Benchmark_RayStream_Fallback_Arguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_RayStream_Sort(benchmark::State& state)
+{
+    const uint32 numRays = static_cast<uint32>(state.range(0));
+
+    Random random;
+    DynArray<Ray> rays;
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        rays.PushBack(Ray(random.GetVector4Bipolar() * 100.0f, random.GetVector4Bipolar()));
+    }
+
+    RayStream rayStream;
+
+    for (auto _ : state)
+    {
+        for (uint32 i = 0; i < numRays; ++i)
+        {
+            rayStream.PushRay(rays[i], Vector4(1.0f), ImageLocationInfo(0, 0));
+        }
+
+        rayStream.Sort();
+        benchmark::DoNotOptimize(rayStream.GetNumRays());
+        rayStream.Clear();
+    }
+
+    state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(Benchmark_RayStream_Sort)->RangeMultiplier(8)->Range(4096, 1024 * 1024)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,705 @@
+#include "PCH.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Math/SamplingHelpers.h"
+#include "../Core/Math/Transform.h"
+#include "../Core/Shapes/MeshShape.h"
+#include "../Core/Material/Material.h"
+#include "../Core/Textures/CheckerboardTexture.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Camera.h"
+#include "../Core/Scene/Object/SceneObject_Shape.h"
+#include "../Core/Scene/Object/SceneObject_Light.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Rendering/RendererContext.h"
+#include "../Core/Rendering/Renderer.h"
+#include "../Core/Rendering/Viewport.h"
+#include "../Core/Traversal/TraversalContext.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../Demo/SceneLoader.h"
+
+#include <benchmark/benchmark.h>
+
+// Scene-level ray throughput benchmarks.
+// Note: all the benchmarks report rays per second as "items_per_second". Use the Google Benchmark
+// '--benchmark_out=results.json --benchmark_out_format=json' options to export the results.
+// Note: test scenes are loaded from the directory given by RT_DATA_PATH environment variable (defaults to "../../../Data/")
+
+using namespace rt;
+using namespace math;
+
+
+namespace {
+
+template <typename T, size_t N>
+constexpr int64_t NumElements(const T(&)[N])
+{
+    return static_cast<int64_t>(N);
+}
+
+// number of primary rays (and shadow and incoherent rays derived from them) traced per iteration
+static constexpr uint32 RaysGridSize = 256;
+
+struct BenchmarkScene : public Aligned<64>
+{
+    Scene scene;
+    Camera camera;
+    Vector4 lightPosition;
+
+    DynArray<Ray> primaryRays;
+    DynArray<Ray> shadowRays;
+    DynArray<float> shadowRayDistances;
+    DynArray<Ray> incoherentRays;
+
+    bool Initialize()
+    {
+        if (!scene.BuildBVH())
+        {
+            return false;
+        }
+
+        Random random;
+        RenderingContext context;
+
+        for (uint32 y = 0; y < RaysGridSize; ++y)
+        {
+            for (uint32 x = 0; x < RaysGridSize; ++x)
+            {
+                const Vector4 coords((static_cast<float>(x) + 0.5f) / RaysGridSize, (static_cast<float>(y) + 0.5f) / RaysGridSize, 0.0f, 0.0f);
+                const Ray primaryRay = camera.GenerateRay(coords, context);
+                primaryRays.PushBack(primaryRay);
+
+                HitPoint hitPoint;
+                scene.Traverse({ primaryRay, hitPoint, context });
+                if (hitPoint.objectId == RT_INVALID_OBJECT)
+                {
+                    continue;
+                }
+
+                const Vector4 hitPosition = primaryRay.GetAtDistance(hitPoint.distance * 0.999f);
+
+                const Vector4 toLight = lightPosition - hitPosition;
+                shadowRays.PushBack(Ray(hitPosition, toLight));
+                // don't hit the light geometry itself
+                shadowRayDistances.PushBack(toLight.Length3() * 0.999f);
+
+                incoherentRays.PushBack(Ray(hitPosition, SamplingHelpers::GetSphere(random.GetFloat2())));
+            }
+        }
+
+        return !shadowRays.Empty();
+    }
+};
+
+// keep only the most recently used scene, large meshes take a lot of memory
+static std::unique_ptr<BenchmarkScene> gCachedScene;
+static std::string gCachedSceneName;
+
+// used for meshes BVH building
+static ThreadPool gThreadPool;
+
+// bumpy sphere made of approximately given number of triangles
+// alpha masked sphere has checkerboard pattern of holes (half of the surface is cut out)
+MeshShapePtr CreateBumpySphere(uint32 numTriangles, uint32 maxLeafSize = 2, bool useTriangleBlocks = false, bool alphaMasked = false)
+{
+    const uint32 numRings = Max(2u, static_cast<uint32>(sqrtf(static_cast<float>(numTriangles) / 4.0f)));
+    const uint32 numSegments = 2 * numRings;
+
+    DynArray<Float3> positions, normals, tangents;
+    DynArray<Float2> texCoords;
+    for (uint32 i = 0; i <= numRings; ++i)
+    {
+        const float theta = RT_PI * static_cast<float>(i) / static_cast<float>(numRings);
+        for (uint32 j = 0; j <= numSegments; ++j)
+        {
+            const float phi = 2.0f * RT_PI * static_cast<float>(j) / static_cast<float>(numSegments);
+            const Vector4 normal(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            const float radius = 1.0f + 0.05f * sinf(13.0f * theta) * sinf(17.0f * phi);
+
+            positions.PushBack((normal * radius).ToFloat3());
+            normals.PushBack(normal.ToFloat3());
+            tangents.PushBack(Float3(-sinf(phi), 0.0f, cosf(phi)));
+            texCoords.PushBack(Float2(16.0f * static_cast<float>(j) / static_cast<float>(numSegments), 8.0f * static_cast<float>(i) / static_cast<float>(numRings)));
+        }
+    }
+
+    DynArray<uint32> indices;
+    for (uint32 i = 0; i < numRings; ++i)
+    {
+        for (uint32 j = 0; j < numSegments; ++j)
+        {
+            const uint32 v00 = i * (numSegments + 1) + j;
+            const uint32 v01 = v00 + 1;
+            const uint32 v10 = v00 + numSegments + 1;
+            const uint32 v11 = v10 + 1;
+
+            // skip degenerate triangles at the poles
+            if (i > 0)
+            {
+                indices.PushBack(v00);
+                indices.PushBack(v10);
+                indices.PushBack(v01);
+            }
+
+            if (i + 1 < numRings)
+            {
+                indices.PushBack(v01);
+                indices.PushBack(v10);
+                indices.PushBack(v11);
+            }
+        }
+    }
+
+    const uint32 numMeshTriangles = indices.Size() / 3;
+    DynArray<uint32> materialIndices(numMeshTriangles, alphaMasked ? 0u : UINT32_MAX);
+
+    MaterialPtr material = std::make_shared<Material>();
+    Vector4 holeColor = Vector4::Zero();
+    material->maskMap = std::make_shared<CheckerboardTexture>(Vector4(1.0f), holeColor);
+
+    MeshDesc meshDesc;
+    meshDesc.vertexBufferDesc.numTriangles = numMeshTriangles;
+    meshDesc.vertexBufferDesc.numVertices = positions.Size();
+    meshDesc.vertexBufferDesc.positions = positions.Data();
+    meshDesc.vertexBufferDesc.normals = normals.Data();
+    meshDesc.vertexBufferDesc.tangents = tangents.Data();
+    meshDesc.vertexBufferDesc.texCoords = texCoords.Data();
+    meshDesc.vertexBufferDesc.vertexIndexBuffer = indices.Data();
+    meshDesc.vertexBufferDesc.materialIndexBuffer = materialIndices.Data();
+    meshDesc.vertexBufferDesc.materials = &material;
+    meshDesc.vertexBufferDesc.numMaterials = alphaMasked ? 1u : 0u;
+    meshDesc.maxLeafSize = maxLeafSize;
+    meshDesc.useTriangleBlocks = useTriangleBlocks;
+    meshDesc.threadPool = &gThreadPool;
+
+    MeshShapePtr mesh = std::make_shared<MeshShape>();
+    if (!mesh->Initialize(meshDesc))
+    {
+        return nullptr;
+    }
+
+    return mesh;
+}
+
+void SetupCamera(BenchmarkScene& benchmarkScene, const Vector4& position)
+{
+    benchmarkScene.camera.SetTransform(Transform(position));
+    benchmarkScene.camera.SetPerspective(1.0f, DegToRad(60.0f));
+}
+
+// single procedural mesh
+const BenchmarkScene* GetMeshScene(uint32 numTriangles, uint32 maxLeafSize = 2, bool useTriangleBlocks = false, bool alphaMasked = false)
+{
+    const std::string name = "mesh_" + std::to_string(numTriangles) + "_" + std::to_string(maxLeafSize) + (useTriangleBlocks ? "_blocks" : "") + (alphaMasked ? "_masked" : "");
+    if (gCachedSceneName == name)
+    {
+        return gCachedScene.get();
+    }
+
+    gCachedScene.reset();
+    gCachedSceneName = name;
+
+    MeshShapePtr mesh = CreateBumpySphere(numTriangles, maxLeafSize, useTriangleBlocks, alphaMasked);
+    if (!mesh)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<BenchmarkScene> benchmarkScene(new BenchmarkScene);
+    benchmarkScene->scene.AddObject(std::make_unique<ShapeSceneObject>(mesh));
+    benchmarkScene->lightPosition = Vector4(2.0f, 3.0f, -4.0f);
+    SetupCamera(*benchmarkScene, Vector4(0.0f, 0.0f, -2.5f));
+
+    if (benchmarkScene->Initialize())
+    {
+        gCachedScene = std::move(benchmarkScene);
+    }
+
+    return gCachedScene.get();
+}
+
+// many randomly placed instances of the same mesh (10K triangles)
+const BenchmarkScene* GetInstancesScene(uint32 numInstances)
+{
+    const std::string name = "instances_" + std::to_string(numInstances);
+    if (gCachedSceneName == name)
+    {
+        return gCachedScene.get();
+    }
+
+    gCachedScene.reset();
+    gCachedSceneName = name;
+
+    MeshShapePtr mesh = CreateBumpySphere(10000);
+    if (!mesh)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<BenchmarkScene> benchmarkScene(new BenchmarkScene);
+
+    // keep the instances density constant
+    const float sceneSize = 2.0f * cbrtf(static_cast<float>(numInstances));
+
+    Random random;
+    for (uint32 i = 0; i < numInstances; ++i)
+    {
+        const Vector4 position = random.GetVector4Bipolar() * sceneSize;
+        const Quaternion rotation = Quaternion::FromEulerAngles((random.GetVector4() * (2.0f * RT_PI)).ToFloat3());
+
+        SceneObjectPtr object = std::make_unique<ShapeSceneObject>(mesh);
+        object->SetTransform(Transform(position, rotation).ToMatrix4());
+        benchmarkScene->scene.AddObject(std::move(object));
+    }
+
+    benchmarkScene->lightPosition = Vector4(0.0f, 2.0f * sceneSize, 0.0f);
+    SetupCamera(*benchmarkScene, Vector4(0.0f, 0.0f, -2.0f * sceneSize));
+
+    if (benchmarkScene->Initialize())
+    {
+        gCachedScene = std::move(benchmarkScene);
+    }
+
+    return gCachedScene.get();
+}
+
+std::string GetDataPath()
+{
+    const char* dataPath = getenv("RT_DATA_PATH");
+    return dataPath ? dataPath : "../../../Data/";
+}
+
+// scene loaded from Data/TestScenes
+const BenchmarkScene* GetTestScene(const char* sceneName)
+{
+    const std::string name = std::string("test_") + sceneName;
+    if (gCachedSceneName == name)
+    {
+        return gCachedScene.get();
+    }
+
+    gCachedScene.reset();
+    gCachedSceneName = name;
+
+    std::unique_ptr<BenchmarkScene> benchmarkScene(new BenchmarkScene);
+
+    const std::string dataPath = GetDataPath();
+    const std::string scenePath = dataPath + "TestScenes/" + sceneName;
+    if (!helpers::LoadScene(scenePath, dataPath, benchmarkScene->scene, benchmarkScene->camera))
+    {
+        return nullptr;
+    }
+
+    // shadow rays are cast towards the first light (or the camera if there are only global lights)
+    const auto& lights = benchmarkScene->scene.GetLights();
+    benchmarkScene->lightPosition = lights.Empty() ?
+        benchmarkScene->camera.GetTransform().GetTranslation() :
+        lights[0]->GetBaseTransform().GetTranslation();
+
+    if (benchmarkScene->Initialize())
+    {
+        gCachedScene = std::move(benchmarkScene);
+    }
+
+    return gCachedScene.get();
+}
+
+void TraceRays_Single(benchmark::State& state, const BenchmarkScene* benchmarkScene)
+{
+    if (!benchmarkScene)
+    {
+        state.SkipWithError("Failed to create scene");
+        return;
+    }
+
+    RenderingContext context;
+    const DynArray<Ray>& rays = state.range(1) == 0 ? benchmarkScene->primaryRays : benchmarkScene->incoherentRays;
+
+    for (auto _ : state)
+    {
+        for (const Ray& ray : rays)
+        {
+            HitPoint hitPoint;
+            benchmarkScene->scene.Traverse({ ray, hitPoint, context });
+            benchmark::DoNotOptimize(hitPoint.distance);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.Size());
+}
+
+void TraceRays_Shadow(benchmark::State& state, const BenchmarkScene* benchmarkScene)
+{
+    if (!benchmarkScene)
+    {
+        state.SkipWithError("Failed to create scene");
+        return;
+    }
+
+    RenderingContext context;
+    const DynArray<Ray>& rays = benchmarkScene->shadowRays;
+
+    uint32 numOccluded = 0;
+    for (auto _ : state)
+    {
+        numOccluded = 0;
+        for (uint32 i = 0; i < rays.Size(); ++i)
+        {
+            HitPoint hitPoint;
+            hitPoint.distance = benchmarkScene->shadowRayDistances[i];
+            if (benchmarkScene->scene.Traverse_Shadow({ rays[i], hitPoint, context }))
+            {
+                numOccluded++;
+            }
+        }
+    }
+
+    state.counters["occluded"] = static_cast<double>(numOccluded) / static_cast<double>(rays.Size());
+    state.SetItemsProcessed(state.iterations() * rays.Size());
+}
+
+// shadow rays traced in groups of 8 consecutive rays
+void TraceRays_Shadow_Simd8(benchmark::State& state, const BenchmarkScene* benchmarkScene)
+{
+    if (!benchmarkScene)
+    {
+        state.SkipWithError("Failed to create scene");
+        return;
+    }
+
+    RenderingContext context;
+    const DynArray<Ray>& rays = benchmarkScene->shadowRays;
+
+    uint32 numOccluded = 0;
+    for (auto _ : state)
+    {
+        numOccluded = 0;
+        for (uint32 i = 0; i < rays.Size(); i += 8)
+        {
+            // unused lanes of the last group are inactive (zero max distance)
+            const Ray* groupRays[8];
+            HitPoint_Simd8 hitPoint;
+            for (uint32 lane = 0; lane < 8; ++lane)
+            {
+                const uint32 rayIndex = Min(i + lane, rays.Size() - 1);
+                groupRays[lane] = &rays[rayIndex];
+                hitPoint.distance[lane] = i + lane < rays.Size() ? benchmarkScene->shadowRayDistances[rayIndex] : 0.0f;
+            }
+
+            const Ray_Simd8 simdRay(*groupRays[0], *groupRays[1], *groupRays[2], *groupRays[3], *groupRays[4], *groupRays[5], *groupRays[6], *groupRays[7]);
+            numOccluded += PopCount(benchmarkScene->scene.Traverse_Shadow(SimdTraversalContext{ simdRay, hitPoint, context }));
+        }
+    }
+
+    state.counters["occluded"] = static_cast<double>(numOccluded) / static_cast<double>(rays.Size());
+    state.SetItemsProcessed(state.iterations() * rays.Size());
+}
+
+void TraceRays_Shadow_Packet(benchmark::State& state, const BenchmarkScene* benchmarkScene)
+{
+    if (!benchmarkScene)
+    {
+        state.SkipWithError("Failed to create scene");
+        return;
+    }
+
+    RenderingContext context;
+    const DynArray<Ray>& rays = benchmarkScene->shadowRays;
+
+    uint32 numOccluded = 0;
+    for (auto _ : state)
+    {
+        numOccluded = 0;
+        for (uint32 i = 0; i < rays.Size(); ++i)
+        {
+            context.rayPacket.PushRay(rays[i], Vector4(1.0f), ImageLocationInfo(0, 0), benchmarkScene->shadowRayDistances[i]);
+
+            if (context.rayPacket.numRays == MaxRayPacketSize || i + 1 == rays.Size())
+            {
+                benchmarkScene->scene.Traverse_Shadow(PacketTraversalContext{ context.rayPacket, context });
+                for (uint32 j = 0; j < context.rayPacket.GetNumGroups(); ++j)
+                {
+                    numOccluded += PopCount(context.occludedRays[j]);
+                }
+                context.rayPacket.Clear();
+            }
+        }
+    }
+
+    state.counters["occluded"] = static_cast<double>(numOccluded) / static_cast<double>(rays.Size());
+    state.SetItemsProcessed(state.iterations() * rays.Size());
+}
+
+void TraceRays_Packet(benchmark::State& state, const BenchmarkScene* benchmarkScene)
+{
+    if (!benchmarkScene)
+    {
+        state.SkipWithError("Failed to create scene");
+        return;
+    }
+
+    RenderingContext context;
+    const DynArray<Ray>& rays = state.range(1) == 0 ? benchmarkScene->primaryRays : benchmarkScene->incoherentRays;
+
+    for (auto _ : state)
+    {
+        for (uint32 i = 0; i < rays.Size(); ++i)
+        {
+            context.rayPacket.PushRay(rays[i], Vector4(1.0f), ImageLocationInfo(i % RaysGridSize, i / RaysGridSize));
+
+            if (context.rayPacket.numRays == MaxRayPacketSize || i + 1 == rays.Size())
+            {
+                benchmarkScene->scene.Traverse({ context.rayPacket, context });
+                context.rayPacket.Clear();
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * rays.Size());
+}
+
+// second argument selects rays set: 0 - primary (coherent), 1 - random directions from primary hit points (incoherent)
+void MeshArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t numTriangles : { 10000, 100000, 1000000, 10000000 })
+    {
+        for (const int64_t incoherent : { 0, 1 })
+        {
+            benchmark->Args({ numTriangles, incoherent });
+        }
+    }
+}
+
+// BVH leaf size, incoherent rays and triangle blocks
+void LeafSizeArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t leafSize : { 1, 2, 3, 4, 6, 8, 12, 16 })
+    {
+        for (const int64_t incoherent : { 0, 1 })
+        {
+            for (const int64_t useTriangleBlocks : { 0, 1 })
+            {
+                benchmark->Args({ leafSize, incoherent, useTriangleBlocks });
+            }
+        }
+    }
+}
+
+void LeafSizeShadowArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t leafSize : { 1, 2, 3, 4, 6, 8, 12, 16 })
+    {
+        for (const int64_t useTriangleBlocks : { 0, 1 })
+        {
+            benchmark->Args({ leafSize, useTriangleBlocks });
+        }
+    }
+}
+
+// BVH leaf size, triangle blocks and alpha mask
+void AlphaMaskShadowArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t leafSize : { 2, 8 })
+    {
+        for (const int64_t useTriangleBlocks : { 0, 1 })
+        {
+            for (const int64_t alphaMasked : { 0, 1 })
+            {
+                benchmark->Args({ leafSize, useTriangleBlocks, alphaMasked });
+            }
+        }
+    }
+}
+
+void InstancesArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (const int64_t numInstances : { 16, 128, 1024, 8192 })
+    {
+        for (const int64_t incoherent : { 0, 1 })
+        {
+            benchmark->Args({ numInstances, incoherent });
+        }
+    }
+}
+
+// test scenes that don't reference external assets
+static const char* const TestScenes[] =
+{
+    "cornell_box.json",
+    "cornell_box_obstructed.json",
+    "mis_test.json",
+};
+
+void TestSceneArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int64_t sceneIndex = 0; sceneIndex < NumElements(TestScenes); ++sceneIndex)
+    {
+        for (const int64_t incoherent : { 0, 1 })
+        {
+            benchmark->Args({ sceneIndex, incoherent });
+        }
+    }
+}
+
+} // namespace
+
+
+static void Benchmark_Scene_Mesh_Single(benchmark::State& state)
+{
+    TraceRays_Single(state, GetMeshScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Mesh_Single)->ArgNames({ "triangles", "incoherent" })->Apply(MeshArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_Packet(benchmark::State& state)
+{
+    TraceRays_Packet(state, GetMeshScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Mesh_Packet)->ArgNames({ "triangles", "incoherent" })->Apply(MeshArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_Shadow(benchmark::State& state)
+{
+    TraceRays_Shadow(state, GetMeshScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Mesh_Shadow)->ArgNames({ "triangles" })->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_Shadow_Simd8(benchmark::State& state)
+{
+    TraceRays_Shadow_Simd8(state, GetMeshScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Mesh_Shadow_Simd8)->ArgNames({ "triangles" })->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_Shadow_Packet(benchmark::State& state)
+{
+    TraceRays_Shadow_Packet(state, GetMeshScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Mesh_Shadow_Packet)->ArgNames({ "triangles" })->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+// 1M triangles mesh with different leaf sizes, triangles intersected one by one or in SIMD blocks of 8
+// Note: the data directory doesn't contain any big meshes, so the procedural one is used
+static void Benchmark_Scene_Mesh_LeafSize_Single(benchmark::State& state)
+{
+    TraceRays_Single(state, GetMeshScene(1000000, static_cast<uint32>(state.range(0)), state.range(2) != 0));
+}
+BENCHMARK(Benchmark_Scene_Mesh_LeafSize_Single)->ArgNames({ "leaf", "incoherent", "blocks" })->Apply(LeafSizeArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_LeafSize_Shadow(benchmark::State& state)
+{
+    TraceRays_Shadow(state, GetMeshScene(1000000, static_cast<uint32>(state.range(0)), state.range(1) != 0));
+}
+BENCHMARK(Benchmark_Scene_Mesh_LeafSize_Shadow)->ArgNames({ "leaf", "blocks" })->Apply(LeafSizeShadowArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Mesh_AlphaMask_Shadow(benchmark::State& state)
+{
+    TraceRays_Shadow(state, GetMeshScene(1000000, static_cast<uint32>(state.range(0)), state.range(1) != 0, state.range(2) != 0));
+}
+BENCHMARK(Benchmark_Scene_Mesh_AlphaMask_Shadow)->ArgNames({ "leaf", "blocks", "masked" })->Apply(AlphaMaskShadowArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Instances_Single(benchmark::State& state)
+{
+    TraceRays_Single(state, GetInstancesScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Instances_Single)->ArgNames({ "instances", "incoherent" })->Apply(InstancesArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Instances_Packet(benchmark::State& state)
+{
+    TraceRays_Packet(state, GetInstancesScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Instances_Packet)->ArgNames({ "instances", "incoherent" })->Apply(InstancesArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Instances_Shadow(benchmark::State& state)
+{
+    TraceRays_Shadow(state, GetInstancesScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Instances_Shadow)->ArgNames({ "instances" })->RangeMultiplier(8)->Range(16, 8192)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Instances_Shadow_Simd8(benchmark::State& state)
+{
+    TraceRays_Shadow_Simd8(state, GetInstancesScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Instances_Shadow_Simd8)->ArgNames({ "instances" })->RangeMultiplier(8)->Range(16, 8192)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_Instances_Shadow_Packet(benchmark::State& state)
+{
+    TraceRays_Shadow_Packet(state, GetInstancesScene(static_cast<uint32>(state.range(0))));
+}
+BENCHMARK(Benchmark_Scene_Instances_Shadow_Packet)->ArgNames({ "instances" })->RangeMultiplier(8)->Range(16, 8192)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_TestScene_Single(benchmark::State& state)
+{
+    TraceRays_Single(state, GetTestScene(TestScenes[state.range(0)]));
+}
+BENCHMARK(Benchmark_Scene_TestScene_Single)->ArgNames({ "scene", "incoherent" })->Apply(TestSceneArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_TestScene_Packet(benchmark::State& state)
+{
+    TraceRays_Packet(state, GetTestScene(TestScenes[state.range(0)]));
+}
+BENCHMARK(Benchmark_Scene_TestScene_Packet)->ArgNames({ "scene", "incoherent" })->Apply(TestSceneArguments)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_TestScene_Shadow(benchmark::State& state)
+{
+    TraceRays_Shadow(state, GetTestScene(TestScenes[state.range(0)]));
+}
+BENCHMARK(Benchmark_Scene_TestScene_Shadow)->ArgNames({ "scene" })->DenseRange(0, static_cast<int>(NumElements(TestScenes)) - 1)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_TestScene_Shadow_Simd8(benchmark::State& state)
+{
+    TraceRays_Shadow_Simd8(state, GetTestScene(TestScenes[state.range(0)]));
+}
+BENCHMARK(Benchmark_Scene_TestScene_Shadow_Simd8)->ArgNames({ "scene" })->DenseRange(0, static_cast<int>(NumElements(TestScenes)) - 1)->Unit(benchmark::kMillisecond);
+
+static void Benchmark_Scene_TestScene_Shadow_Packet(benchmark::State& state)
+{
+    TraceRays_Shadow_Packet(state, GetTestScene(TestScenes[state.range(0)]));
+}
+BENCHMARK(Benchmark_Scene_TestScene_Shadow_Packet)->ArgNames({ "scene" })->DenseRange(0, static_cast<int>(NumElements(TestScenes)) - 1)->Unit(benchmark::kMillisecond);
+
+static const char* const RendererNames[] = { "Path Tracer", "Path Tracer MIS", "Light Tracer", "VCM" };
+
+static void Benchmark_Viewport_Render_Arguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int64_t rendererIndex = 0; rendererIndex < NumElements(RendererNames); ++rendererIndex)
+    {
+        benchmark->Args({ rendererIndex, 0 });
+    }
+
+    // only the path tracer implements packet tracing
+    benchmark->Args({ 0, 1 });
+}
+
+// full rendering passes of the Cornell box scene (256x256, all threads) with each of the renderers
+static void Benchmark_Viewport_Render(benchmark::State& state)
+{
+    const std::string dataPath = GetDataPath();
+
+    Scene scene;
+    Camera camera;
+    if (!helpers::LoadScene(dataPath + "TestScenes/cornell_box.json", dataPath, scene, camera) || !scene.BuildBVH())
+    {
+        state.SkipWithError("Failed to load scene");
+        return;
+    }
+
+    RenderingParams params;
+    params.traversalMode = state.range(1) ? TraversalMode::Packet : TraversalMode::Single;
+
+    const RendererPtr renderer = CreateRenderer(RendererNames[state.range(0)], scene);
+
+    std::unique_ptr<Viewport> viewport(new Viewport);
+    if (!renderer || !viewport->Resize(RaysGridSize, RaysGridSize) || !viewport->SetRenderingParams(params) || !viewport->SetRenderer(renderer))
+    {
+        state.SkipWithError("Failed to initialize viewport");
+        return;
+    }
+
+    uint64 numRays = 0;
+    for (auto _ : state)
+    {
+        viewport->Render(camera);
+        numRays += viewport->GetCounters().numRays;
+    }
+
+    state.SetLabel(RendererNames[state.range(0)]);
+    state.counters["rays"] = benchmark::Counter(static_cast<double>(numRays), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations() * RaysGridSize * RaysGridSize);
+}
+BENCHMARK(Benchmark_Viewport_Render)->ArgNames({ "renderer", "packet" })->Apply(Benchmark_Viewport_Render_Arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,78 @@
+#include "PCH.h"
+#include "../Core/Utils/ThreadPool.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace rt;
+
+
+// measures pure dispatch overhead: empty tasks, variable number of worker threads
+static void Benchmark_ThreadPool_Dispatch(benchmark::State& state)
+{
+    const uint32 numTasks = 4096;
+
+    ThreadPool pool;
+    pool.SetNumThreads(static_cast<uint32>(state.range(0)));
+
+    const ParallelTask task = [](uint32 taskID, uint32 threadID)
+    {
+        benchmark::DoNotOptimize(taskID);
+        benchmark::DoNotOptimize(threadID);
+    };
+
+    for (auto _ : state)
+    {
+        pool.RunParallelTask(task, numTasks);
+    }
+
+    state.SetItemsProcessed(state.iterations() * numTasks);
+}
+BENCHMARK(Benchmark_ThreadPool_Dispatch)->RangeMultiplier(2)->Range(1, 256)->UseRealTime();
+
+
+// single task per call - latency of waking up the pool and waiting for completion
+static void Benchmark_ThreadPool_SingleTask(benchmark::State& state)
+{
+    ThreadPool pool;
+    pool.SetNumThreads(static_cast<uint32>(state.range(0)));
+
+    const ParallelTask task = [](uint32 taskID, uint32)
+    {
+        benchmark::DoNotOptimize(taskID);
+    };
+
+    for (auto _ : state)
+    {
+        pool.RunParallelTask(task, 1);
+    }
+}
+BENCHMARK(Benchmark_ThreadPool_SingleTask)->RangeMultiplier(2)->Range(1, 256)->UseRealTime();
+
+
+// nested parallelism - every outer task spawns inner tasks
+static void Benchmark_ThreadPool_Nested(benchmark::State& state)
+{
+    const uint32 numOuterTasks = 64;
+    const uint32 numInnerTasks = 64;
+
+    ThreadPool pool;
+    pool.SetNumThreads(static_cast<uint32>(state.range(0)));
+
+    const ParallelTask innerTask = [](uint32 taskID, uint32)
+    {
+        benchmark::DoNotOptimize(taskID);
+    };
+
+    const ParallelTask outerTask = [&pool, &innerTask](uint32, uint32)
+    {
+        pool.RunParallelTask(innerTask, numInnerTasks);
+    };
+
+    for (auto _ : state)
+    {
+        pool.RunParallelTask(outerTask, numOuterTasks);
+    }
+
+    state.SetItemsProcessed(state.iterations() * numOuterTasks * numInnerTasks);
+}
+BENCHMARK(Benchmark_ThreadPool_Nested)->RangeMultiplier(2)->Range(1, 256)->UseRealTime();
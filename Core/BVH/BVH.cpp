@@ -19,16 +19,25 @@ struct BVHFileHeader
 static_assert(sizeof(BVH::Node) == 32, "Invalid node size");
 
 BVH::BVH()
-    : mNumNodes(0)
+    : mExternalNodes(nullptr)
+    , mNumNodes(0)
 { }
 
 bool BVH::AllocateNodes(uint32 numNodes)
 {
+    mExternalNodes = nullptr;
     mNodes.Resize(numNodes);
     mNumNodes = numNodes;
     return true;
 }
 
+void BVH::InitializeExternal(const Node* nodes, uint32 numNodes)
+{
+    mNodes.Clear(true);
+    mExternalNodes = nodes;
+    mNumNodes = numNodes;
+}
+
 bool BVH::SaveToFile(const std::string& filePath) const
 {
     FILE* file = fopen(filePath.c_str(), "wb");
@@ -50,7 +59,7 @@ bool BVH::SaveToFile(const std::string& filePath) const
         return false;
     }
 
-    if (fwrite(mNodes.Data(), sizeof(Node), mNumNodes, file) != mNumNodes)
+    if (fwrite(GetNodes(), sizeof(Node), mNumNodes, file) != mNumNodes)
     {
         fclose(file);
         RT_LOG_ERROR("Failed to write BVH nodes");
@@ -122,7 +131,7 @@ void BVH::CalculateStats(Stats& outStats) const
 
 void BVH::CalculateStatsForNode(uint32 nodeIndex, Stats& outStats, uint32 depth) const
 {
-    const Node& node = mNodes[nodeIndex];
+    const Node& node = GetNodes()[nodeIndex];
     const math::Box box = node.GetBox();
 
     outStats.totalNodesArea += box.SurfaceArea();
@@ -14,7 +14,7 @@
 namespace rt {
 
 // binary Bounding Volume Hierarchy
-class BVH
+class RAYLIB_API BVH
 {
 public:
     static constexpr uint32 MaxDepth = 128;
@@ -87,7 +87,11 @@ public:
     bool SaveToFile(const std::string& filePath) const;
     bool LoadFromFile(const std::string& filePath);
 
-    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.Data(); }
+    // use nodes stored in an external memory (e.g. memory mapped file) without copying them
+    // Note: the memory must outlive the BVH object
+    void InitializeExternal(const Node* nodes, uint32 numNodes);
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mExternalNodes ? mExternalNodes : mNodes.Data(); }
     RT_FORCE_INLINE uint32 GetNumNodes() const { return mNumNodes; }
 
 private:
@@ -95,6 +99,7 @@ private:
     bool AllocateNodes(uint32 numNodes);
 
     DynArray<Node, SystemAllocator> mNodes;
+    const Node* mExternalNodes;
     uint32 mNumNodes;
 
     friend class BVHBuilder;
@@ -2,6 +2,8 @@
 #include "BVHBuilder.h"
 #include "Utils/Logger.h"
 #include "Utils/Timer.h"
+#include "Utils/Profiler.h"
+#include "Utils/ThreadPool.h"
 
 
 namespace rt {
@@ -21,9 +23,41 @@ BVHBuilder::Context::Context(uint32 numLeaves)
 
 //////////////////////////////////////////////////////////////////////////
 
+void BVHBuilder::BinSet::Clear(uint32 numBins)
+{
+    for (uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        for (uint32 i = 0; i < numBins; ++i)
+        {
+            Bin& bin = bins[axis][i];
+            bin.box = Box::Empty();
+            bin.centroidBox = Box::Empty();
+            bin.count = 0;
+        }
+    }
+}
+
+void BVHBuilder::BinSet::Merge(const BinSet& other, uint32 numBins)
+{
+    for (uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        for (uint32 i = 0; i < numBins; ++i)
+        {
+            Bin& bin = bins[axis][i];
+            const Bin& otherBin = other.bins[axis][i];
+            bin.box = Box(bin.box, otherBin.box);
+            bin.centroidBox = Box(bin.centroidBox, otherBin.centroidBox);
+            bin.count += otherBin.count;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 BVHBuilder::BVHBuilder(BVH& targetBVH)
     : mLeafBoxes(nullptr)
     , mNumLeaves(0)
+    , mThreadPool(nullptr)
     , mNumGeneratedNodes(0)
     , mTarget(targetBVH)
 {
@@ -38,10 +72,12 @@ bool BVHBuilder::Build(const Box* data, const uint32 numLeaves,
                        const BvhBuildingParams& params,
                        DynArray<uint32>& outLeavesOrder)
 {
+    RT_SCOPED_TRACE(BVHBuilder_Build);
+
     mLeafBoxes = data;
     mNumLeaves = numLeaves;
     mParams = params;
-    mTarget.AllocateNodes(2 * mNumLeaves); // TODO this is too big, reallocate at the end
+    mTarget.AllocateNodes(2 * mNumLeaves); // upper bound, shrunk at the end
 
     mNumGeneratedNodes = 0;
     mNumGeneratedLeaves = 0;
@@ -66,41 +102,72 @@ bool BVHBuilder::Build(const Box* data, const uint32 numLeaves,
                 overallBox.min.f[0], overallBox.min.f[1], overallBox.min.f[2],
                 overallBox.max.f[0], overallBox.max.f[1], overallBox.max.f[2]);
 
-    WorkSet rootWorkSet;
-    rootWorkSet.box = overallBox;
-    rootWorkSet.numLeaves = mNumLeaves;
-    rootWorkSet.leafIndices.Reserve(mNumLeaves);
-    for (uint32 i = 0; i < mNumLeaves; ++i)
-    {
-        rootWorkSet.leafIndices.PushBack(i);
-    }
-
     Timer timer;
     timer.Start();
 
+    if (mParams.algorithm == BvhBuildingParams::Algorithm::FullSweep)
     {
+        WorkSet rootWorkSet;
+        rootWorkSet.box = overallBox;
+        rootWorkSet.numLeaves = mNumLeaves;
+        rootWorkSet.leafIndices.Reserve(mNumLeaves);
+        for (uint32 i = 0; i < mNumLeaves; ++i)
+        {
+            rootWorkSet.leafIndices.PushBack(i);
+        }
+
         Context context(mNumLeaves);
 
         BVH::Node& rootNode = mTarget.mNodes.Front();
         mNumGeneratedNodes += 2;
         BuildNode(rootWorkSet, context, rootNode);
     }
+    else if (mParams.algorithm == BvhBuildingParams::Algorithm::Binned)
+    {
+        BuildBinned(overallBox);
+        mLeavesOrder = std::move(mIndexArena);
+        mNumGeneratedLeaves = mNumLeaves;
+    }
+    else
+    {
+        RT_FATAL();
+    }
+
+    const uint32 numGeneratedNodes = mNumGeneratedNodes;
 
     RT_ASSERT(mNumGeneratedLeaves == mNumLeaves); // Number of generated leaves is invalid
-    RT_ASSERT(mNumGeneratedNodes <= 2 * mNumLeaves); // Number of generated nodes is invalid
+    RT_ASSERT(numGeneratedNodes <= 2 * mNumLeaves); // Number of generated nodes is invalid
 
     // shrink BVH nodes array
-    mTarget.mNumNodes = mNumGeneratedNodes;
-    mTarget.mNodes.Resize(mNumGeneratedNodes);
-    // mTarget.mNodes.shrink_to_fit(); // TODO
+    mTarget.mNumNodes = numGeneratedNodes;
+    mTarget.mNodes.Resize(numGeneratedNodes);
+    if (!mTarget.mNodes.ShrinkToFit())
+    {
+        RT_LOG_WARNING("Failed to shrink BVH nodes array");
+    }
 
     const float millisecondsElapsed = (float)(1000.0 * timer.Stop());
-    RT_LOG_INFO("Finished BVH generation in %.9g ms (num nodes = %u)", millisecondsElapsed, mNumGeneratedNodes);
+    RT_LOG_INFO("Finished BVH generation in %.9g ms (num nodes = %u)", millisecondsElapsed, numGeneratedNodes);
 
-    outLeavesOrder = mLeavesOrder;
+    outLeavesOrder = std::move(mLeavesOrder);
     return true;
 }
 
+float BVHBuilder::EvaluateCost(const Box& box) const
+{
+    if (mParams.heuristics == BvhBuildingParams::Heuristics::SurfaceArea)
+    {
+        return box.SurfaceArea();
+    }
+    else if (mParams.heuristics == BvhBuildingParams::Heuristics::Volume)
+    {
+        return box.Volume();
+    }
+
+    RT_FATAL();
+    return 0.0f;
+}
+
 void BVHBuilder::GenerateLeaf(const WorkSet& workSet, BVH::Node& targetNode)
 {
     targetNode.numLeaves = workSet.numLeaves;
@@ -168,21 +235,8 @@ void BVHBuilder::BuildNode(const WorkSet& workSet, Context& context, BVH::Node&
             const Box& leftBox = context.mLeftBoxesCache[splitPos];
             const Box& rightBox = context.mRightBoxesCache[splitPos + 1];
 
-            float leftCost = 0.0f, rightCost = 0.0f;
-            if (mParams.heuristics == BvhBuildingParams::Heuristics::SurfaceArea)
-            {
-                leftCost = leftBox.SurfaceArea();
-                rightCost = rightBox.SurfaceArea();
-            }
-            else if (mParams.heuristics == BvhBuildingParams::Heuristics::Volume)
-            {
-                leftCost = leftBox.Volume();
-                rightCost = rightBox.Volume();
-            }
-            else
-            {
-                RT_FATAL();
-            }
+            const float leftCost = EvaluateCost(leftBox);
+            const float rightCost = EvaluateCost(rightBox);
 
             const uint32 leftCount = splitPos + 1;
             const uint32 rightCount = workSet.numLeaves - leftCount;
@@ -202,8 +256,7 @@ void BVHBuilder::BuildNode(const WorkSet& workSet, Context& context, BVH::Node&
     const uint32 leftCount = bestSplitPos + 1;
     const uint32 rightCount = workSet.numLeaves - leftCount;
 
-    const uint32 leftNodeIndex = mNumGeneratedNodes;
-    mNumGeneratedNodes += 2;
+    const uint32 leftNodeIndex = mNumGeneratedNodes.fetch_add(2);
 
     targetNode.childIndex = leftNodeIndex;
     targetNode.numLeaves = 0;
@@ -276,4 +329,274 @@ void BVHBuilder::SortLeaves(const WorkSet& workSet, Context& context) const
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+
+void BVHBuilder::BuildBinned(const Box& overallBox)
+{
+    mParams.numBins = Clamp(mParams.numBins, 2u, MaxBins);
+
+    // precompute leaf centroids (doubled, like in the full-sweep algorithm)
+    Box centroidBox = Box::Empty();
+    mCentroids.Resize_SkipConstructor(mNumLeaves);
+    mIndexArena.Resize_SkipConstructor(mNumLeaves);
+    for (uint32 i = 0; i < mNumLeaves; ++i)
+    {
+        const Vector4 centroid = mLeafBoxes[i].min + mLeafBoxes[i].max;
+        mCentroids[i] = centroid;
+        centroidBox.AddPoint(centroid);
+        mIndexArena[i] = i;
+    }
+
+    mThreadPool = mParams.threadPool;
+
+    BinnedWorkSet rootWorkSet;
+    rootWorkSet.box = overallBox;
+    rootWorkSet.centroidBox = centroidBox;
+    rootWorkSet.begin = 0;
+    rootWorkSet.end = mNumLeaves;
+    rootWorkSet.depth = 0;
+    rootWorkSet.nodeIndex = 0;
+    mNumGeneratedNodes += 2;
+
+    if (mThreadPool && mNumLeaves >= ParallelSubtreeThreshold)
+    {
+        // run the root node on a worker thread, so the nested tasks are picked up by the whole pool
+        const ParallelTask rootTask = [this, &rootWorkSet](uint32, uint32)
+        {
+            BuildNode_Binned(rootWorkSet);
+        };
+        mThreadPool->RunParallelTask(rootTask, 1);
+    }
+    else
+    {
+        BuildNode_Binned(rootWorkSet);
+    }
+
+    mThreadPool = nullptr;
+    mCentroids.Clear(true);
+}
+
+void BVHBuilder::ComputeBins(const BinnedWorkSet& workSet, uint32 begin, uint32 end, uint32 numBins, BinSet& outBins) const
+{
+    const Vector4 extent = workSet.centroidBox.max - workSet.centroidBox.min;
+
+    outBins.Clear(numBins);
+
+    for (uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+
+        const float binScale = static_cast<float>(numBins) * 0.9999f / extent[axis];
+        const float binOffset = workSet.centroidBox.min[axis];
+
+        for (uint32 i = begin; i < end; ++i)
+        {
+            const uint32 leafIndex = mIndexArena[i];
+            const Vector4& centroid = mCentroids[leafIndex];
+            const int32 binIndex = static_cast<int32>((centroid[axis] - binOffset) * binScale);
+
+            Bin& bin = outBins.bins[axis][Clamp<int32>(binIndex, 0, numBins - 1)];
+            bin.box = Box(bin.box, mLeafBoxes[leafIndex]);
+            bin.centroidBox.AddPoint(centroid);
+            bin.count++;
+        }
+    }
+}
+
+void BVHBuilder::ComputeBins_Parallel(const BinnedWorkSet& workSet, uint32 numBins, BinSet& outBins) const
+{
+    const uint32 numLeaves = workSet.end - workSet.begin;
+    const uint32 numChunks = (numLeaves + BinningChunkSize - 1) / BinningChunkSize;
+
+    DynArray<BinSet> chunkBins;
+    chunkBins.Resize_SkipConstructor(numChunks);
+
+    const ParallelTask binningTask = [&](uint32 chunkIndex, uint32)
+    {
+        const uint32 begin = workSet.begin + chunkIndex * BinningChunkSize;
+        const uint32 end = Min(begin + BinningChunkSize, workSet.end);
+        ComputeBins(workSet, begin, end, numBins, chunkBins[chunkIndex]);
+    };
+    mThreadPool->RunParallelTask(binningTask, numChunks);
+
+    outBins.Clear(numBins);
+    for (const BinSet& bins : chunkBins)
+    {
+        outBins.Merge(bins, numBins);
+    }
+}
+
+void BVHBuilder::SplitInHalf(const BinnedWorkSet& workSet, BinnedWorkSet& outLeft, BinnedWorkSet& outRight)
+{
+    const uint32 mid = workSet.begin + (workSet.end - workSet.begin) / 2;
+
+    outLeft.begin = workSet.begin;
+    outLeft.end = mid;
+    outRight.begin = mid;
+    outRight.end = workSet.end;
+
+    for (BinnedWorkSet* child : { &outLeft, &outRight })
+    {
+        child->box = Box::Empty();
+        child->centroidBox = Box::Empty();
+        for (uint32 i = child->begin; i < child->end; ++i)
+        {
+            const uint32 leafIndex = mIndexArena[i];
+            child->box = Box(child->box, mLeafBoxes[leafIndex]);
+            child->centroidBox.AddPoint(mCentroids[leafIndex]);
+        }
+    }
+}
+
+void BVHBuilder::BuildNode_Binned(const BinnedWorkSet& workSet)
+{
+    const uint32 numLeaves = workSet.end - workSet.begin;
+
+    RT_ASSERT(numLeaves > 0);
+    RT_ASSERT(workSet.end <= mNumLeaves);
+    RT_ASSERT(workSet.depth <= BVH::MaxDepth);
+
+    BVH::Node& targetNode = mTarget.mNodes[workSet.nodeIndex];
+    targetNode.min = workSet.box.min.ToFloat3();
+    targetNode.max = workSet.box.max.ToFloat3();
+
+    if (numLeaves <= mParams.maxLeafNodeSize)
+    {
+        // leaves are already in place in the index arena
+        targetNode.numLeaves = numLeaves;
+        targetNode.childIndex = workSet.begin;
+        return;
+    }
+
+    // there is no point in having more bins than leaves
+    const uint32 numBins = Min(mParams.numBins, numLeaves);
+
+    BinSet binSet;
+    if (mThreadPool && numLeaves >= ParallelBinningThreshold)
+    {
+        ComputeBins_Parallel(workSet, numBins, binSet);
+    }
+    else
+    {
+        ComputeBins(workSet, workSet.begin, workSet.end, numBins, binSet);
+    }
+
+    uint32 bestAxis = 0;
+    uint32 bestSplitBin = 0;
+    float bestCost = FLT_MAX;
+
+    for (uint32 axis = 0; axis < NumAxes; ++axis)
+    {
+        const Bin* bins = binSet.bins[axis];
+
+        // calculate right child node cost for each possible split position
+        float rightCosts[MaxBins];
+        {
+            Box accumulatedBox = Box::Empty();
+            uint32 accumulatedCount = 0;
+            for (uint32 i = numBins; i-- > 1; )
+            {
+                accumulatedBox = Box(accumulatedBox, bins[i].box);
+                accumulatedCount += bins[i].count;
+                rightCosts[i] = accumulatedCount > 0 ? EvaluateCost(accumulatedBox) * static_cast<float>(accumulatedCount) : 0.0f;
+            }
+        }
+
+        // sweep from the left, split is placed after 'splitBin'
+        Box accumulatedBox = Box::Empty();
+        uint32 leftCount = 0;
+        for (uint32 splitBin = 0; splitBin < numBins - 1; ++splitBin)
+        {
+            accumulatedBox = Box(accumulatedBox, bins[splitBin].box);
+            leftCount += bins[splitBin].count;
+
+            if (leftCount == 0 || leftCount == numLeaves)
+            {
+                continue;
+            }
+
+            const float totalCost = EvaluateCost(accumulatedBox) * static_cast<float>(leftCount) + rightCosts[splitBin + 1];
+            if (totalCost < bestCost)
+            {
+                bestCost = totalCost;
+                bestAxis = axis;
+                bestSplitBin = splitBin;
+            }
+        }
+    }
+
+    BinnedWorkSet children[2];
+
+    if (bestCost < FLT_MAX)
+    {
+        const Bin* bins = binSet.bins[bestAxis];
+        const float binScale = static_cast<float>(numBins) * 0.9999f / (workSet.centroidBox.max[bestAxis] - workSet.centroidBox.min[bestAxis]);
+        const float binOffset = workSet.centroidBox.min[bestAxis];
+
+        // partition the index arena in place
+        const auto predicate = [&](const uint32 leafIndex)
+        {
+            const int32 binIndex = static_cast<int32>((mCentroids[leafIndex][bestAxis] - binOffset) * binScale);
+            return Clamp<int32>(binIndex, 0, numBins - 1) <= static_cast<int32>(bestSplitBin);
+        };
+        uint32* splitPtr = std::partition(mIndexArena.Data() + workSet.begin, mIndexArena.Data() + workSet.end, predicate);
+        const uint32 mid = static_cast<uint32>(splitPtr - mIndexArena.Data());
+
+        children[0].begin = workSet.begin;
+        children[0].end = mid;
+        children[1].begin = mid;
+        children[1].end = workSet.end;
+
+        for (uint32 i = 0; i < 2; ++i)
+        {
+            children[i].box = Box::Empty();
+            children[i].centroidBox = Box::Empty();
+        }
+
+        for (uint32 i = 0; i < numBins; ++i)
+        {
+            BinnedWorkSet& child = children[i <= bestSplitBin ? 0 : 1];
+            child.box = Box(child.box, bins[i].box);
+            child.centroidBox = Box(child.centroidBox, bins[i].centroidBox);
+        }
+
+        RT_ASSERT(children[0].end > children[0].begin);
+        RT_ASSERT(children[1].end > children[1].begin);
+    }
+    else
+    {
+        // all the centroids fall into single bin - fallback to median split
+        SplitInHalf(workSet, children[0], children[1]);
+    }
+
+    const uint32 leftNodeIndex = mNumGeneratedNodes.fetch_add(2);
+
+    targetNode.childIndex = leftNodeIndex;
+    targetNode.numLeaves = 0;
+    targetNode.splitAxis = bestAxis;
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        children[i].depth = workSet.depth + 1;
+        children[i].nodeIndex = leftNodeIndex + i;
+    }
+
+    if (mThreadPool && numLeaves >= ParallelSubtreeThreshold)
+    {
+        const ParallelTask childTask = [this, &children](uint32 taskID, uint32)
+        {
+            BuildNode_Binned(children[taskID]);
+        };
+        mThreadPool->RunParallelTask(childTask, 2);
+    }
+    else
+    {
+        BuildNode_Binned(children[0]);
+        BuildNode_Binned(children[1]);
+    }
+}
+
 } // namespace rt
@@ -1,10 +1,15 @@
 #pragma once
 
-#include "RayLib.h"
+#include "../RayLib.h"
 #include "BVH.h"
 
+#include <atomic>
+#include <memory>
+
 namespace rt {
 
+class ThreadPool;
+
 struct BvhBuildingParams
 {
     enum class Heuristics
@@ -13,12 +18,24 @@ struct BvhBuildingParams
         Volume
     };
 
+    enum class Algorithm
+    {
+        Binned,     // fast, parallel, centroid-binned SAH
+        FullSweep,  // high quality, evaluates every possible split position (single threaded)
+    };
+
     uint32 maxLeafNodeSize = 2; // max number of objects in leaf nodes
     Heuristics heuristics = Heuristics::SurfaceArea;
+    Algorithm algorithm = Algorithm::Binned;
+    uint32 numBins = 32; // number of bins per axis (binned algorithm only)
+
+    // optional thread pool used by the binned algorithm
+    // if not provided, the BVH is built on the calling thread
+    ThreadPool* threadPool = nullptr;
 };
 
 // helper class for constructing BVH using SAH algorithm
-class BVHBuilder
+class RAYLIB_API BVHBuilder
 {
 public:
 
@@ -35,6 +52,14 @@ public:
 private:
 
     constexpr static uint32 NumAxes = 3;
+    constexpr static uint32 MaxBins = 32;
+
+    // nodes with at least this many leaves will have their subtrees built in parallel
+    constexpr static uint32 ParallelSubtreeThreshold = 4096;
+
+    // nodes with at least this many leaves will be binned in parallel
+    constexpr static uint32 ParallelBinningThreshold = 64 * 1024;
+    constexpr static uint32 BinningChunkSize = 16 * 1024;
 
     struct Context
     {
@@ -60,17 +85,58 @@ private:
         { }
     };
 
+    // range of leaves in the index arena, processed by the binned builder
+    struct RT_ALIGN(16) BinnedWorkSet
+    {
+        math::Box box;
+        math::Box centroidBox;
+        uint32 begin;
+        uint32 end;
+        uint32 depth;
+        uint32 nodeIndex;
+    };
+
+    struct RT_ALIGN(16) Bin
+    {
+        math::Box box;
+        math::Box centroidBox;
+        uint32 count;
+    };
+
+    struct BinSet
+    {
+        Bin bins[NumAxes][MaxBins];
+
+        void Clear(uint32 numBins);
+        void Merge(const BinSet& other, uint32 numBins);
+    };
+
+    float EvaluateCost(const math::Box& box) const;
+
+    // full-sweep algorithm
     // sort leaf indices in each axis
     void SortLeaves(const WorkSet& workSet, Context& context) const;
     void BuildNode(const WorkSet& workSet, Context& context, BVH::Node& targetNode);
     void GenerateLeaf(const WorkSet& workSet, BVH::Node& targetNode);
 
+    // binned algorithm
+    void BuildBinned(const math::Box& overallBox);
+    void BuildNode_Binned(const BinnedWorkSet& workSet);
+    void ComputeBins(const BinnedWorkSet& workSet, uint32 begin, uint32 end, uint32 numBins, BinSet& outBins) const;
+    void ComputeBins_Parallel(const BinnedWorkSet& workSet, uint32 numBins, BinSet& outBins) const;
+    void SplitInHalf(const BinnedWorkSet& workSet, BinnedWorkSet& outLeft, BinnedWorkSet& outRight);
+
     // input data
     BvhBuildingParams mParams;
     const math::Box* mLeafBoxes;
     uint32 mNumLeaves;
 
-    uint32 mNumGeneratedNodes;
+    // binned algorithm state
+    DynArray<math::Vector4> mCentroids;
+    Indices mIndexArena;
+    ThreadPool* mThreadPool;
+
+    std::atomic<uint32> mNumGeneratedNodes;
     uint32 mNumGeneratedLeaves;
     Indices mLeavesOrder;
 
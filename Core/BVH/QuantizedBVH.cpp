@@ -0,0 +1,201 @@
+#include "PCH.h"
+#include "QuantizedBVH.h"
+#include "Utils/Logger.h"
+
+
+namespace rt {
+
+using namespace math;
+
+static_assert(sizeof(QuantizedBVH::Node) == 32, "Invalid quantized BVH node size");
+
+namespace {
+
+// grid cell size exponent limits (keeps the scale a normalized float)
+static constexpr int32 MinScaleExponent = -120;
+static constexpr int32 MaxScaleExponent = 120;
+static constexpr int32 ScaleExponentBias = 127;
+
+// must match QuantizedBVH::Node::GetChildBox() (the product is exact, so the result does not depend on FMA)
+RT_FORCE_INLINE float DecodeValue(float origin, int32 quantized, float scale)
+{
+    return origin + static_cast<float>(quantized) * scale;
+}
+
+// find the smallest power-of-two grid cell size covering [origin, max] range with MaxQuantizedValue cells
+int32 CalculateScaleExponent(float origin, float max)
+{
+    int32 exponent = 0;
+    std::frexp((max - origin) / static_cast<float>(QuantizedBVH::MaxQuantizedValue), &exponent);
+    exponent = Clamp(exponent, MinScaleExponent, MaxScaleExponent);
+
+    // rounding may lead to slightly too small grid
+    while (exponent < MaxScaleExponent && DecodeValue(origin, QuantizedBVH::MaxQuantizedValue, std::ldexp(1.0f, exponent)) < max)
+    {
+        exponent++;
+    }
+
+    return exponent;
+}
+
+// quantize lower bound (rounding down)
+uint8 QuantizeMin(float value, float origin, float scale)
+{
+    const int32 maxValue = static_cast<int32>(QuantizedBVH::MaxQuantizedValue);
+    int32 quantized = Clamp(static_cast<int32>(std::floor((value - origin) / scale)), 0, maxValue);
+    while (quantized > 0 && DecodeValue(origin, quantized, scale) > value)
+    {
+        quantized--;
+    }
+    return static_cast<uint8>(quantized);
+}
+
+// quantize upper bound (rounding up)
+uint8 QuantizeMax(float value, float origin, float scale)
+{
+    const int32 maxValue = static_cast<int32>(QuantizedBVH::MaxQuantizedValue);
+    int32 quantized = Clamp(static_cast<int32>(std::ceil((value - origin) / scale)), 0, maxValue);
+    while (quantized < maxValue && DecodeValue(origin, quantized, scale) < value)
+    {
+        quantized++;
+    }
+    return static_cast<uint8>(quantized);
+}
+
+RT_FORCE_INLINE bool BoxContains(const Box& outer, const Box& inner)
+{
+    return (outer.min <= inner.min).All() && (outer.max >= inner.max).All();
+}
+
+} // namespace
+
+QuantizedBVH::QuantizedBVH()
+    : mRootBox(Box::Empty())
+    , mRootChildIndex(0)
+    , mRootNumLeaves(0)
+{
+}
+
+void QuantizedBVH::Clear()
+{
+    mNodes.Clear(true);
+    mRootBox = Box::Empty();
+    mRootChildIndex = 0;
+    mRootNumLeaves = 0;
+}
+
+bool QuantizedBVH::Build(const BVH& source)
+{
+    Clear();
+
+    if (source.GetNumNodes() == 0)
+    {
+        return true;
+    }
+
+    const BVH::Node& sourceRoot = source.GetNodes()[0];
+    mRootBox = sourceRoot.GetBox();
+
+    if (sourceRoot.IsLeaf())
+    {
+        // the whole tree is a single leaf - no nodes needed
+        mRootChildIndex = sourceRoot.childIndex;
+        mRootNumLeaves = sourceRoot.numLeaves;
+        return true;
+    }
+
+    // only inner nodes of the source BVH are stored (leaves are embedded in parents)
+    if (!mNodes.Reserve(source.GetNumNodes() / 2))
+    {
+        RT_LOG_ERROR("Failed to allocate memory for quantized BVH nodes");
+        return false;
+    }
+
+    mNodes.Resize(1);
+    QuantizeNode(source, 0, 0, mRootBox);
+
+    RT_LOG_INFO("Quantized BVH: %u nodes (%zu bytes) -> %u nodes (%zu bytes)",
+                source.GetNumNodes(), source.GetNumNodes() * sizeof(BVH::Node), mNodes.Size(), GetMemorySize());
+    return true;
+}
+
+void QuantizedBVH::QuantizeNode(const BVH& source, uint32 sourceNodeIndex, uint32 targetNodeIndex, const Box& decodedBox)
+{
+    const BVH::Node* sourceNodes = source.GetNodes();
+    const BVH::Node& sourceNode = sourceNodes[sourceNodeIndex];
+    RT_ASSERT(!sourceNode.IsLeaf());
+
+    const uint32 children[2] = { sourceNode.childIndex, sourceNode.childIndex + 1 };
+
+    // allocate target nodes for inner children (they are placed next to each other)
+    uint32 numInnerChildren = 0;
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        numInnerChildren += sourceNodes[children[i]].IsLeaf() ? 0 : 1;
+    }
+
+    const uint32 firstChildNodeIndex = mNodes.Size();
+    mNodes.Resize(firstChildNodeIndex + numInnerChildren);
+
+    Node& targetNode = mNodes[targetNodeIndex];
+
+    // setup grid spanning the decoded node box
+    float scale[3];
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+        const int32 exponent = CalculateScaleExponent(decodedBox.min[axis], decodedBox.max[axis]);
+        targetNode.scaleExponent[axis] = static_cast<uint8>(exponent + ScaleExponentBias);
+        scale[axis] = std::ldexp(1.0f, exponent);
+    }
+    targetNode.scaleExponent[3] = static_cast<uint8>(ScaleExponentBias);
+
+    uint32 innerChildIndex = firstChildNodeIndex;
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        const BVH::Node& child = sourceNodes[children[i]];
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+            targetNode.min[i][axis] = QuantizeMin((&child.min.x)[axis], decodedBox.min[axis], scale[axis]);
+            targetNode.max[i][axis] = QuantizeMax((&child.max.x)[axis], decodedBox.min[axis], scale[axis]);
+        }
+        targetNode.min[i][3] = 0;
+        targetNode.max[i][3] = 0;
+
+        if (child.IsLeaf())
+        {
+            RT_ASSERT(child.numLeaves <= UINT16_MAX, "Too many objects in BVH leaf");
+            targetNode.childIndex[i] = child.childIndex;
+            targetNode.numLeaves[i] = static_cast<uint16>(child.numLeaves);
+        }
+        else
+        {
+            targetNode.childIndex[i] = innerChildIndex++;
+            targetNode.numLeaves[i] = 0;
+        }
+    }
+
+    // decode children boxes exactly the same way as the traversal does
+    const Vector4 decodedScale = targetNode.GetScale();
+    const Box childBoxes[2] =
+    {
+        targetNode.GetChildBox(0, decodedBox.min, decodedScale),
+        targetNode.GetChildBox(1, decodedBox.min, decodedScale),
+    };
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        RT_ASSERT(BoxContains(childBoxes[i], sourceNodes[children[i]].GetBox()), "Quantized BVH node is not conservative");
+    }
+
+    // Note: 'targetNode' reference must not be used below, as the nodes array may grow
+    innerChildIndex = firstChildNodeIndex;
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        if (!sourceNodes[children[i]].IsLeaf())
+        {
+            QuantizeNode(source, children[i], innerChildIndex++, childBoxes[i]);
+        }
+    }
+}
+
+} // namespace rt
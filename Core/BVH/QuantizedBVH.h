@@ -0,0 +1,92 @@
+#pragma once
+
+#include "BVH.h"
+
+#include "../Math/Vector4.h"
+#include "../Math/Vector4Load.h"
+#include "../Math/VectorInt4.h"
+#include "../Math/Box.h"
+
+namespace rt {
+
+// Binary BVH with quantized nodes
+// Children bounds are stored as 8-bit offsets on a grid spanning the parent node's (decoded) box.
+// Grid cell size is a power of two, so decoding is exact and the traversal kernel decodes the bounds
+// with exactly the same arithmetic as the builder. Quantization is conservative (the decoded box
+// always contains the original one), so the traversal stays watertight.
+class RAYLIB_API QuantizedBVH
+{
+public:
+    static constexpr uint32 MaxDepth = BVH::MaxDepth;
+
+    // max number of entries on traversal stack
+    static constexpr uint32 MaxStackSize = MaxDepth + 1;
+
+    // number of grid cells per axis
+    static constexpr uint32 MaxQuantizedValue = 255;
+
+    struct RT_ALIGN(32) Node
+    {
+        // child node index (inner child) or first leaf index (leaf child)
+        uint32 childIndex[2];
+
+        // children bounds on the node grid: bound = origin + q * scale (last component is unused)
+        uint8 min[2][4];
+        uint8 max[2][4];
+
+        // biased (IEEE-754 style) exponent of the grid cell size, per axis (last component is unused)
+        uint8 scaleExponent[4];
+
+        // number of leaves (0 for inner children)
+        uint16 numLeaves[2];
+
+        // grid cell size
+        RT_FORCE_INLINE const math::Vector4 GetScale() const
+        {
+            const math::VectorInt4 exponent = math::VectorInt4::Convert(math::Vector4_Load_4xUint8(scaleExponent));
+            return (exponent << 23).CastToFloat();
+        }
+
+        // decode child bounds, 'origin' is minimum corner of the node's (decoded) box
+        RT_FORCE_INLINE const math::Box GetChildBox(uint32 child, const math::Vector4& origin, const math::Vector4& scale) const
+        {
+            const math::Vector4 childMin = math::Vector4::MulAndAdd(math::Vector4_Load_4xUint8(min[child]), scale, origin);
+            const math::Vector4 childMax = math::Vector4::MulAndAdd(math::Vector4_Load_4xUint8(max[child]), scale, origin);
+            return { childMin, childMax };
+        }
+    };
+
+    QuantizedBVH();
+    QuantizedBVH(QuantizedBVH&& rhs) = default;
+    QuantizedBVH& operator = (QuantizedBVH&& rhs) = default;
+
+    // build by quantizing binary BVH (nodes and leaves order is preserved)
+    bool Build(const BVH& source);
+
+    void Clear();
+
+    RT_FORCE_INLINE bool IsEmpty() const { return mRootNumLeaves == 0 && mNodes.Empty(); }
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.Data(); }
+    RT_FORCE_INLINE uint32 GetNumNodes() const { return mNodes.Size(); }
+
+    // root bounds (not quantized), its minimum corner is the root node's grid origin
+    RT_FORCE_INLINE const math::Box& GetRootBox() const { return mRootBox; }
+
+    // if the whole tree is a single leaf, these describe the leaf, otherwise root is the first node
+    RT_FORCE_INLINE uint32 GetRootChildIndex() const { return mRootChildIndex; }
+    RT_FORCE_INLINE uint32 GetRootNumLeaves() const { return mRootNumLeaves; }
+
+    // size of the nodes data in bytes
+    RT_FORCE_INLINE size_t GetMemorySize() const { return mNodes.Size() * sizeof(Node); }
+
+private:
+    void QuantizeNode(const BVH& source, uint32 sourceNodeIndex, uint32 targetNodeIndex, const math::Box& decodedBox);
+
+    DynArray<Node, SystemAllocator> mNodes;
+    math::Box mRootBox;
+    uint32 mRootChildIndex;
+    uint32 mRootNumLeaves;
+};
+
+} // namespace rt
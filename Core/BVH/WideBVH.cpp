@@ -0,0 +1,198 @@
+#include "PCH.h"
+#include "WideBVH.h"
+#include "Utils/Logger.h"
+
+
+namespace rt {
+
+using namespace math;
+
+static_assert(sizeof(BVH4::Node) == 128, "Invalid BVH4 node size");
+static_assert(sizeof(BVH8::Node) == 256, "Invalid BVH8 node size");
+
+template<uint32 Width>
+WideBVH<Width>::WideBVH() = default;
+
+template<uint32 Width>
+void WideBVH<Width>::Clear()
+{
+    mNodes.Clear(true);
+}
+
+template<uint32 Width>
+bool WideBVH<Width>::Build(const BVH& source)
+{
+    Clear();
+
+    if (source.GetNumNodes() == 0)
+    {
+        return true;
+    }
+
+    // collapsed BVH never has more nodes than the source one
+    if (!mNodes.Reserve(source.GetNumNodes()))
+    {
+        RT_LOG_ERROR("Failed to allocate memory for BVH%u nodes", Width);
+        return false;
+    }
+
+    mNodes.Resize(1);
+    CollapseNode(source, 0, 0);
+
+    RT_LOG_INFO("Collapsed BVH into BVH%u: %u nodes -> %u nodes", Width, source.GetNumNodes(), mNodes.Size());
+    return true;
+}
+
+template<uint32 Width>
+void WideBVH<Width>::CollapseNode(const BVH& source, uint32 sourceNodeIndex, uint32 targetNodeIndex)
+{
+    const BVH::Node* sourceNodes = source.GetNodes();
+    const BVH::Node& sourceNode = sourceNodes[sourceNodeIndex];
+
+    // gather children: keep opening the biggest inner child until the node is full
+    uint32 children[Width];
+    uint32 numChildren = 0;
+
+    if (sourceNode.IsLeaf())
+    {
+        // leaf root node
+        children[numChildren++] = sourceNodeIndex;
+    }
+    else
+    {
+        children[numChildren++] = sourceNode.childIndex;
+        children[numChildren++] = sourceNode.childIndex + 1;
+
+        while (numChildren < Width)
+        {
+            uint32 bestChild = UINT32_MAX;
+            float bestArea = -1.0f;
+
+            for (uint32 i = 0; i < numChildren; ++i)
+            {
+                const BVH::Node& child = sourceNodes[children[i]];
+                if (!child.IsLeaf())
+                {
+                    const float area = child.GetBox().SurfaceArea();
+                    if (area > bestArea)
+                    {
+                        bestArea = area;
+                        bestChild = i;
+                    }
+                }
+            }
+
+            if (bestChild == UINT32_MAX)
+            {
+                // only leaves left
+                break;
+            }
+
+            const BVH::Node& child = sourceNodes[children[bestChild]];
+            children[bestChild] = child.childIndex;
+            children[numChildren++] = child.childIndex + 1;
+        }
+    }
+
+    // allocate target nodes for inner children (they are placed next to each other)
+    uint32 numInnerChildren = 0;
+    for (uint32 i = 0; i < numChildren; ++i)
+    {
+        numInnerChildren += sourceNodes[children[i]].IsLeaf() ? 0 : 1;
+    }
+
+    const uint32 firstChildNodeIndex = mNodes.Size();
+    mNodes.Resize(firstChildNodeIndex + numInnerChildren);
+
+    Node& targetNode = mNodes[targetNodeIndex];
+    targetNode.numChildren = numChildren;
+
+    uint32 innerChildIndex = firstChildNodeIndex;
+    for (uint32 i = 0; i < Width; ++i)
+    {
+        if (i < numChildren)
+        {
+            const BVH::Node& child = sourceNodes[children[i]];
+            for (uint32 axis = 0; axis < 3; ++axis)
+            {
+                targetNode.min[axis][i] = (&child.min.x)[axis];
+                targetNode.max[axis][i] = (&child.max.x)[axis];
+            }
+
+            if (child.IsLeaf())
+            {
+                RT_ASSERT(child.numLeaves <= UINT16_MAX, "Too many objects in BVH leaf");
+                targetNode.childIndex[i] = child.childIndex;
+                targetNode.numLeaves[i] = static_cast<uint16>(child.numLeaves);
+            }
+            else
+            {
+                targetNode.childIndex[i] = innerChildIndex++;
+                targetNode.numLeaves[i] = 0;
+            }
+        }
+        else
+        {
+            // unused lane (masked out during traversal)
+            for (uint32 axis = 0; axis < 3; ++axis)
+            {
+                targetNode.min[axis][i] = 0.0f;
+                targetNode.max[axis][i] = 0.0f;
+            }
+            targetNode.childIndex[i] = 0;
+            targetNode.numLeaves[i] = 0;
+        }
+    }
+
+    // Note: 'targetNode' reference must not be used below, as the nodes array may grow
+    innerChildIndex = firstChildNodeIndex;
+    for (uint32 i = 0; i < numChildren; ++i)
+    {
+        if (!sourceNodes[children[i]].IsLeaf())
+        {
+            CollapseNode(source, children[i], innerChildIndex++);
+        }
+    }
+}
+
+template<uint32 Width>
+void WideBVH<Width>::CalculateStats(Stats& outStats) const
+{
+    outStats = Stats();
+
+    if (mNodes.Empty())
+    {
+        return;
+    }
+
+    CalculateStatsForNode(0, outStats, 1);
+
+    outStats.averageChildrenCount /= static_cast<double>(outStats.numInnerNodes);
+}
+
+template<uint32 Width>
+void WideBVH<Width>::CalculateStatsForNode(uint32 nodeIndex, Stats& outStats, uint32 depth) const
+{
+    const Node& node = mNodes[nodeIndex];
+
+    outStats.maxDepth = std::max(outStats.maxDepth, depth);
+    outStats.numInnerNodes++;
+    outStats.averageChildrenCount += static_cast<double>(node.numChildren);
+
+    for (uint32 i = 0; i < node.numChildren; ++i)
+    {
+        if (node.numLeaves[i] > 0)
+        {
+            outStats.numLeafChildren++;
+        }
+        else
+        {
+            CalculateStatsForNode(node.childIndex[i], outStats, depth + 1);
+        }
+    }
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+
+} // namespace rt
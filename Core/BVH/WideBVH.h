@@ -0,0 +1,101 @@
+#pragma once
+
+#include "BVH.h"
+
+#include "../Math/Vector4.h"
+#include "../Math/Vector8.h"
+
+#include <type_traits>
+
+namespace rt {
+
+// BVH node format used for traversal
+enum class BvhFormat : uint8
+{
+    Binary,     // regular BVH, two children per node
+    Wide4,      // collapsed BVH, up to 4 children per node (SSE)
+    Wide8,      // collapsed BVH, up to 8 children per node (AVX)
+    Quantized,  // binary BVH with 8-bit children bounds (half of the memory bandwidth)
+};
+
+// Multi-Bounding Volume Hierarchy (BVH4 / BVH8)
+// Built by collapsing a binary BVH. Children bounds are stored in SoA form,
+// so a ray can be tested against all the children with a single SIMD instruction sequence.
+template<uint32 Width>
+class RAYLIB_API WideBVH
+{
+    static_assert(Width == 4 || Width == 8, "Unsupported BVH width");
+
+public:
+    // SIMD vector type used to process all the children of a node at once
+    using VectorType = typename std::conditional<Width == 4, math::Vector4, math::Vector8>::type;
+
+    static constexpr uint32 MaxDepth = BVH::MaxDepth;
+
+    // max number of entries on traversal stack (each visited node pushes up to Width-1 additional entries)
+    static constexpr uint32 MaxStackSize = MaxDepth * (Width - 1) + 1;
+
+    struct RT_ALIGN(64) Node
+    {
+        // children bounds (SoA)
+        float min[3][Width];
+        float max[3][Width];
+
+        // child node index (inner child) or first leaf index (leaf child)
+        uint32 childIndex[Width];
+
+        // number of leaves (0 for inner children)
+        uint16 numLeaves[Width];
+
+        // children are packed, so only first 'numChildren' lanes are valid
+        uint32 numChildren;
+
+        RT_FORCE_INLINE uint32 GetValidChildrenMask() const
+        {
+            return (1u << numChildren) - 1u;
+        }
+    };
+
+    struct Stats
+    {
+        uint32 maxDepth;
+        uint32 numInnerNodes;
+        uint32 numLeafChildren;
+        double averageChildrenCount;
+
+        Stats()
+            : maxDepth(0)
+            , numInnerNodes(0)
+            , numLeafChildren(0)
+            , averageChildrenCount(0.0)
+        { }
+    };
+
+    WideBVH();
+    WideBVH(WideBVH&& rhs) = default;
+    WideBVH& operator = (WideBVH&& rhs) = default;
+
+    // build by collapsing binary BVH (leaves order is preserved)
+    bool Build(const BVH& source);
+
+    void Clear();
+
+    void CalculateStats(Stats& outStats) const;
+
+    RT_FORCE_INLINE const Node* GetNodes() const { return mNodes.Data(); }
+    RT_FORCE_INLINE uint32 GetNumNodes() const { return mNodes.Size(); }
+
+private:
+    void CollapseNode(const BVH& source, uint32 sourceNodeIndex, uint32 targetNodeIndex);
+    void CalculateStatsForNode(uint32 nodeIndex, Stats& outStats, uint32 depth) const;
+
+    DynArray<Node, SystemAllocator> mNodes;
+};
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+} // namespace rt
@@ -2,6 +2,7 @@
 
 #include "../RayLib.h"
 #include "../Math/Vector4.h"
+#include "../Math/Vector3x8.h"
 
 
 namespace rt {
@@ -14,7 +15,7 @@ RT_GLOBAL_CONST math::Vector4 XYZtoRGB_b = {  0.055648f, -0.204043f,  1.057311f,
 
 // Convert linear to sRGB
 template<typename T>
-RT_FORCE_INLINE math::Vector4 Convert_sRGB_To_Linear(const T& gammaColor)
+RT_FORCE_INLINE const T Convert_sRGB_To_Linear(const T& gammaColor)
 {
     // based on:
     // http://chilliant.blogspot.com/2012/08/srgb-approximations-for-hlsl.html
@@ -28,7 +29,7 @@ RT_FORCE_INLINE math::Vector4 Convert_sRGB_To_Linear(const T& gammaColor)
 
 // Convert sRGB to linear
 template<typename T>
-RT_FORCE_INLINE math::Vector4 Convert_Linear_To_sRGB(const T& linearColor)
+RT_FORCE_INLINE const T Convert_Linear_To_sRGB(const T& linearColor)
 {
     // based on:
     // http://chilliant.blogspot.com/2012/08/srgb-approximations-for-hlsl.html
@@ -55,6 +56,19 @@ RT_FORCE_INLINE math::Vector4 ConvertXYZtoRGB(const math::Vector4& xyzColor)
     return r + g + b;
 }
 
+// Convert CIE XYZ to linear RGB (Rec. BT.709), 8 colors at once
+RT_FORCE_INLINE const math::Vector3x8 ConvertXYZtoRGB(const math::Vector3x8& xyzColor)
+{
+    using math::Vector8;
+
+    return math::Vector3x8
+    (
+        Vector8::MulAndAdd(xyzColor.x, XYZtoRGB_r.x, Vector8::MulAndAdd(xyzColor.y, XYZtoRGB_r.y, xyzColor.z * XYZtoRGB_r.z)),
+        Vector8::MulAndAdd(xyzColor.x, XYZtoRGB_g.x, Vector8::MulAndAdd(xyzColor.y, XYZtoRGB_g.y, xyzColor.z * XYZtoRGB_g.z)),
+        Vector8::MulAndAdd(xyzColor.x, XYZtoRGB_b.x, Vector8::MulAndAdd(xyzColor.y, XYZtoRGB_b.y, xyzColor.z * XYZtoRGB_b.z))
+    );
+}
+
 // Convert linear RGB (Rec. BT.709) to CIE XYZ
 RT_FORCE_INLINE math::Vector4 ConvertRGBtoXYZ(const math::Vector4& rgbColor)
 {
@@ -1,7 +1,8 @@
 #pragma once
 
-// enables runtime counting of ray-triangle and ray-box intersection tests
-//#define RT_ENABLE_INTERSECTION_COUNTERS
+// compiles in counting of ray-triangle and ray-box intersection tests
+// Note: the counters are collected only when enabled at runtime (see RenderingParams::enableIntersectionCounters)
+#define RT_ENABLE_INTERSECTION_COUNTERS
 
 // enables code for collecting path tracing debug data
 #define RT_ENABLE_PATH_DEBUGGING
@@ -119,6 +119,17 @@ public:
     bool Resize_SkipConstructor(uint32 size);
     bool Resize(uint32 size, const ElementType& defaultElement);
 
+    /**
+     * Release unused memory, so the allocated size matches the number of elements.
+     * @return 'false' if memory allocation failed (the array is left untouched).
+     */
+    bool ShrinkToFit();
+
+    /**
+     * Get number of elements that can be stored without reallocation.
+     */
+    RT_FORCE_INLINE uint32 GetCapacity() const { return mAllocSize; }
+
     /**
      * Replace contents of two arrays.
      * @note Does not call any constructor or destructor, just pointers are swapped.
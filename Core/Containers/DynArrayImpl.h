@@ -442,6 +442,37 @@ bool DynArray<ElementType, Allocator>::Reserve(uint32 size)
     return true;
 }
 
+template<typename ElementType, typename Allocator>
+bool DynArray<ElementType, Allocator>::ShrinkToFit()
+{
+    if (this->mSize == mAllocSize)
+    {
+        return true;
+    }
+
+    if (this->mSize == 0)
+    {
+        Clear(true);
+        return true;
+    }
+
+    ElementType* newBuffer = static_cast<ElementType*>(Allocator::Allocate(this->mSize * sizeof(ElementType), alignof(ElementType)));
+    if (!newBuffer)
+    {
+        // memory allocation failed
+        return false;
+    }
+
+    // move elements
+    MemoryHelpers::MoveArray<ElementType>(newBuffer, this->mElements, this->mSize);
+
+    // replace buffer
+    Allocator::Free(this->mElements);
+    this->mElements = newBuffer;
+    mAllocSize = this->mSize;
+    return true;
+}
+
 template<typename ElementType, typename Allocator>
 bool DynArray<ElementType, Allocator>::Resize_SkipConstructor(uint32 size)
 {
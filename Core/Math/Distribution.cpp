@@ -3,8 +3,11 @@
 #include "Math.h"
 #include "Utils/Memory.h"
 #include "Utils/Logger.h"
+#include "Utils/ThreadPool.h"
+#include "Containers/DynArray.h"
 
 #include <algorithm>
+#include <cmath>
 
 namespace rt {
 namespace math {
@@ -12,20 +15,33 @@ namespace math {
 Distribution::Distribution()
     : mPDF(nullptr)
     , mCDF(nullptr)
+    , mAliasTable(nullptr)
+    , mAverage(0.0f)
     , mSize(0)
 {}
 
 Distribution::~Distribution()
 {
+    Release();
+}
+
+void Distribution::Release()
+{
+    DefaultAllocator::Free(mAliasTable);
     DefaultAllocator::Free(mCDF);
     DefaultAllocator::Free(mPDF);
 
+    mAliasTable = nullptr;
     mCDF = nullptr;
     mPDF = nullptr;
+    mAverage = 0.0f;
+    mSize = 0;
 }
 
-bool Distribution::Initialize(const float* pdfValues, uint32 numValues)
+bool Distribution::Initialize(const float* pdfValues, uint32 numValues, bool buildAliasTable)
 {
+    Release();
+
     if (numValues == 0)
     {
         RT_LOG_ERROR("Empty distribution");
@@ -64,7 +80,11 @@ bool Distribution::Initialize(const float* pdfValues, uint32 numValues)
         mCDF[i + 1] = accumulated;
     }
 
-    RT_ASSERT(accumulated > 0.0f, "Pdf must be non-zero");
+    if (!(accumulated > 0.0f))
+    {
+        RT_LOG_ERROR("Pdf must be non-zero");
+        return false;
+    }
 
     // normalize
     const float cdfNormFactor = 1.0f / accumulated;
@@ -74,16 +94,117 @@ bool Distribution::Initialize(const float* pdfValues, uint32 numValues)
         mCDF[i] *= cdfNormFactor;
         mPDF[i] = pdfValues[i] * pdfNormFactor;
     }
-    mCDF[numValues] *= cdfNormFactor;
+    mCDF[numValues] = 1.0f;
+
+    // make sure that trailing zero-probability buckets are never picked (because of rounding errors)
+    for (uint32 i = numValues; i > 0 && pdfValues[i - 1] == 0.0f; --i)
+    {
+        mCDF[i - 1] = 1.0f;
+    }
 
     // TODO Cumulative distribution function should be stored as unsigned integers, as it's only in 0-1 range
 
+    mAverage = accumulated / static_cast<float>(numValues);
     mSize = numValues;
+
+    if (buildAliasTable)
+    {
+        return BuildAliasTable();
+    }
+
     return true;
 }
 
-uint32 Distribution::SampleDiscrete(const float u, float& outPdf) const
+bool Distribution::BuildAliasTable()
 {
+    // based on "Darts, Dice, and Coins: Sampling from a Discrete Distribution" (Keith Schwarz)
+
+    mAliasTable = (AliasTableEntry*)DefaultAllocator::Allocate(sizeof(AliasTableEntry) * (size_t)mSize, RT_CACHE_LINE_SIZE);
+    if (!mAliasTable)
+    {
+        RT_LOG_ERROR("Failed to allocate memory for alias table");
+        return false;
+    }
+
+    // normalized pdf values average to one, so they can be directly used as bucket "heights"
+    DynArray<float> scaledProbabilities;
+    DynArray<uint32> smallBuckets;
+    DynArray<uint32> largeBuckets;
+    if (!scaledProbabilities.Resize(mSize) || !smallBuckets.Reserve(mSize) || !largeBuckets.Reserve(mSize))
+    {
+        RT_LOG_ERROR("Failed to allocate memory for alias table");
+        return false;
+    }
+
+    for (uint32 i = 0; i < mSize; ++i)
+    {
+        scaledProbabilities[i] = mPDF[i];
+
+        if (mPDF[i] < 1.0f)
+        {
+            smallBuckets.PushBack(i);
+        }
+        else
+        {
+            largeBuckets.PushBack(i);
+        }
+    }
+
+    // fill each small bucket up with a part of a large one
+    while (!smallBuckets.Empty() && !largeBuckets.Empty())
+    {
+        const uint32 small = smallBuckets[smallBuckets.Size() - 1];
+        const uint32 large = largeBuckets[largeBuckets.Size() - 1];
+        smallBuckets.PopBack();
+        largeBuckets.PopBack();
+
+        mAliasTable[small] = { scaledProbabilities[small], large };
+
+        scaledProbabilities[large] = (scaledProbabilities[large] + scaledProbabilities[small]) - 1.0f;
+        if (scaledProbabilities[large] < 1.0f)
+        {
+            smallBuckets.PushBack(large);
+        }
+        else
+        {
+            largeBuckets.PushBack(large);
+        }
+    }
+
+    // remaining buckets are full (up to rounding errors)
+    for (const uint32 index : largeBuckets)
+    {
+        mAliasTable[index] = { 1.0f, index };
+    }
+    for (const uint32 index : smallBuckets)
+    {
+        mAliasTable[index] = { 1.0f, index };
+    }
+
+    return true;
+}
+
+uint32 Distribution::SampleBucket(const float u, float& outRemappedU) const
+{
+    if (mAliasTable)
+    {
+        const float scaledU = u * static_cast<float>(mSize);
+        const uint32 index = Min(static_cast<uint32>(scaledU), mSize - 1u);
+        const float fraction = scaledU - static_cast<float>(index);
+
+        const AliasTableEntry& entry = mAliasTable[index];
+        if (fraction < entry.threshold)
+        {
+            outRemappedU = fraction / entry.threshold;
+            return index;
+        }
+        else
+        {
+            outRemappedU = (fraction - entry.threshold) / (1.0f - entry.threshold);
+            return entry.alias;
+        }
+    }
+
     uint32 low = 0u;
     uint32 high = mSize;
 
@@ -100,13 +221,168 @@ uint32 Distribution::SampleDiscrete(const float u, float& outPdf) const
             high = mid;
         }
     }
-    
-    uint32 offset = low - 1u;
+
+    const uint32 offset = low - 1u;
+
+    outRemappedU = (u - mCDF[offset]) / (mCDF[offset + 1] - mCDF[offset]);
+    return offset;
+}
+
+uint32 Distribution::SampleDiscrete(const float u, float& outPdf) const
+{
+    float remappedU;
+    const uint32 offset = SampleBucket(u, remappedU);
 
     outPdf = mPDF[offset];
 
     return offset;
 }
 
+float Distribution::SampleContinuous(const float u, float& outPdf, uint32& outOffset) const
+{
+    float remappedU;
+    const uint32 offset = SampleBucket(u, remappedU);
+    remappedU = Clamp(remappedU, 0.0f, 0.99999994f);
+
+    outPdf = mPDF[offset];
+    outOffset = offset;
+
+    // rounding may push the value to the next bucket (which could even have zero probability)
+    const float size = static_cast<float>(mSize);
+    float result = (static_cast<float>(offset) + remappedU) / size;
+    while (result > 0.0f && static_cast<uint32>(result * size) > offset)
+    {
+        result = std::nextafter(result, 0.0f);
+    }
+
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+Distribution2D::Distribution2D()
+    : mWidth(0)
+    , mHeight(0)
+{}
+
+Distribution2D::~Distribution2D() = default;
+
+bool Distribution2D::Initialize(const float* pdfValues, uint32 width, uint32 height, bool buildAliasTables, ThreadPool* threadPool)
+{
+    mConditionals.reset();
+    mWidth = 0;
+    mHeight = 0;
+
+    if (width == 0 || height == 0)
+    {
+        RT_LOG_ERROR("Empty distribution");
+        return false;
+    }
+
+    if (!pdfValues)
+    {
+        RT_LOG_ERROR("Invalid distribution pdf");
+        return false;
+    }
+
+    mConditionals = std::make_unique<Distribution[]>(height);
+
+    DynArray<float> rowValues;
+    if (!rowValues.Resize(height))
+    {
+        RT_LOG_ERROR("Failed to allocate memory for marginal distribution");
+        return false;
+    }
+
+    std::atomic<bool> success(true);
+
+    const auto initRow = [&](uint32 row, uint32)
+    {
+        const float* rowPdf = pdfValues + static_cast<size_t>(width) * row;
+
+        bool isEmpty = true;
+        for (uint32 i = 0; i < width; ++i)
+        {
+            if (rowPdf[i] > 0.0f)
+            {
+                isEmpty = false;
+                break;
+            }
+        }
+
+        if (isEmpty)
+        {
+            // the row will never be picked, but it still must be a valid distribution
+            rowValues[row] = 0.0f;
+            const float one = 1.0f;
+            if (!mConditionals[row].Initialize(&one, 1))
+            {
+                success = false;
+            }
+            return;
+        }
+
+        if (!mConditionals[row].Initialize(rowPdf, width, buildAliasTables))
+        {
+            success = false;
+            return;
+        }
+
+        rowValues[row] = mConditionals[row].GetAverage();
+    };
+
+    if (threadPool)
+    {
+        threadPool->RunParallelTask(initRow, height);
+    }
+    else
+    {
+        for (uint32 i = 0; i < height; ++i)
+        {
+            initRow(i, 0);
+        }
+    }
+
+    if (!success)
+    {
+        mConditionals.reset();
+        return false;
+    }
+
+    if (!mMarginal.Initialize(rowValues.Data(), height, buildAliasTables))
+    {
+        mConditionals.reset();
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    return true;
+}
+
+const Float2 Distribution2D::Sample(const Float2 u, float& outPdf) const
+{
+    float marginalPdf, conditionalPdf;
+    uint32 row, column;
+
+    const float y = mMarginal.SampleContinuous(u.y, marginalPdf, row);
+    const float x = mConditionals[row].SampleContinuous(u.x, conditionalPdf, column);
+
+    outPdf = marginalPdf * conditionalPdf;
+
+    return Float2(x, y);
+}
+
+float Distribution2D::Pdf(const Float2 coords) const
+{
+    const uint32 row = Min(static_cast<uint32>(Max(0.0f, coords.y) * static_cast<float>(mHeight)), mHeight - 1u);
+
+    const Distribution& conditional = mConditionals[row];
+    const uint32 conditionalSize = conditional.GetSize();
+    const uint32 column = Min(static_cast<uint32>(Max(0.0f, coords.x) * static_cast<float>(conditionalSize)), conditionalSize - 1u);
+
+    return mMarginal.GetPdf(row) * conditional.GetPdf(column);
+}
+
 } // namespace math
-} // namespace rt
\ No newline at end of file
+} // namespace rt
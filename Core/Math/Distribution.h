@@ -1,8 +1,14 @@
 #pragma once
 
 #include "../RayLib.h"
+#include "Float2.h"
+
+#include <memory>
 
 namespace rt {
+
+class ThreadPool;
+
 namespace math {
 
 // Utility class for fast sampling 1D probability distribution function
@@ -14,16 +20,70 @@ public:
     ~Distribution();
 
     // initialize with 1D pdf function
-    bool Initialize(const float* pdfValues, uint32 numValues);
+    // if 'buildAliasTable' is set, sampling is done in constant time (Walker's alias method) instead of binary search
+    bool Initialize(const float* pdfValues, uint32 numValues, bool buildAliasTable = false);
 
     // sample discrete
     uint32 SampleDiscrete(const float u, float& outPdf) const;
 
+    // sample continuous value in [0, 1) range, 'outOffset' is the sampled bucket index
+    float SampleContinuous(const float u, float& outPdf, uint32& outOffset) const;
+
+    RT_FORCE_INLINE uint32 GetSize() const { return mSize; }
+
+    // normalized pdf value of a bucket (pdf values average to one)
+    RT_FORCE_INLINE float GetPdf(const uint32 index) const { return mPDF[index]; }
+
+    // average of the input pdf values
+    RT_FORCE_INLINE float GetAverage() const { return mAverage; }
+
 private:
+    struct AliasTableEntry
+    {
+        float threshold;    // probability of picking the bucket itself instead of the alias
+        uint32 alias;
+    };
+
+    void Release();
+    bool BuildAliasTable();
+
+    // pick a bucket, 'outRemappedU' is the remaining part of 'u' (in [0, 1) range)
+    uint32 SampleBucket(const float u, float& outRemappedU) const;
+
     float* mPDF;
     float* mCDF; // Cumulative distribution function
+    AliasTableEntry* mAliasTable;
+    float mAverage;
     uint32 mSize;
 };
 
+// Utility class for sampling 2D piecewise constant distribution defined over [0, 1) x [0, 1) domain
+// (e.g. texture importance sampling). Row is picked with marginal distribution, then column within the row.
+class RAYLIB_API Distribution2D : public NoCopyable
+{
+public:
+    Distribution2D();
+    ~Distribution2D();
+
+    // initialize with 2D pdf function (row-major order)
+    // rows are processed in parallel if a thread pool is provided
+    bool Initialize(const float* pdfValues, uint32 width, uint32 height, bool buildAliasTables = false, ThreadPool* threadPool = nullptr);
+
+    // sample a point, the pdf is with respect to the domain area
+    const Float2 Sample(const Float2 u, float& outPdf) const;
+
+    // get pdf of sampling given point
+    float Pdf(const Float2 coords) const;
+
+    RT_FORCE_INLINE uint32 GetWidth() const { return mWidth; }
+    RT_FORCE_INLINE uint32 GetHeight() const { return mHeight; }
+
+private:
+    Distribution mMarginal;
+    std::unique_ptr<Distribution[]> mConditionals;
+    uint32 mWidth;
+    uint32 mHeight;
+};
+
 } // namespace math
-} // namespace rt
\ No newline at end of file
+} // namespace rt
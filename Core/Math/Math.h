@@ -11,6 +11,10 @@
 #include <emmintrin.h>
 #endif // RT_USE_SSE
 
+#if defined(WIN32)
+#include <intrin.h>
+#endif // defined(WIN32)
+
 #define RT_EPSILON (0.000001f)
 #define RT_PI (3.14159265359f)
 #define RT_SQRT_PI (1.77245385091f)
@@ -291,5 +295,26 @@ RT_FORCE_INLINE uint32 PopCount(uint32 x)
 #endif // defined(WIN32)
 }
 
+// index of the lowest set bit (x must be non-zero)
+RT_FORCE_INLINE uint32 FirstBitSet(uint32 x)
+{
+    RT_ASSERT(x != 0);
+#if defined(WIN32)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<uint32>(index);
+#elif defined(__LINUX__) | defined(__linux__)
+    return static_cast<uint32>(__builtin_ctz(x));
+#else
+    uint32 index = 0;
+    while ((x & 1u) == 0u)
+    {
+        x >>= 1;
+        index++;
+    }
+    return index;
+#endif // defined(WIN32)
+}
+
 } // namespace math
 } // namespace rt
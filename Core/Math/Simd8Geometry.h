@@ -186,6 +186,18 @@ RT_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
 #endif
 }
 
+// single ray vs. 8 triangles
+RT_FORCE_INLINE const VectorBool8 Intersect_TriangleRay_Simd8(
+    const Ray& ray,
+    const Triangle_Simd8& tri,
+    const float maxDistance,
+    Vector8& outU,
+    Vector8& outV,
+    Vector8& outDist)
+{
+    return Intersect_TriangleRay_Simd8(Vector3x8(ray.dir), Vector3x8(ray.origin), tri, Vector8(maxDistance), outU, outV, outDist);
+}
+
 
 } // namespace math
 } // namespace rt
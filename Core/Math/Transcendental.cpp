@@ -164,6 +164,30 @@ const Vector4 FastExp(const Vector4& a)
     return y;
 }
 
+const Vector8 FastExp(const Vector8& a)
+{
+#ifdef RT_USE_AVX2
+    const Vector8 t = a * 1.442695041f;
+    const Vector8 fi = Vector8::Floor(t);
+    const VectorInt8 i = VectorInt8::Convert(fi);
+    const Vector8 f = t - fi;
+
+    Vector8 y = Vector8::MulAndAdd(f, Vector8(0.3371894346f), Vector8(0.657636276f));
+    y = Vector8::MulAndAdd(f, y, Vector8(1.00172476f));
+
+    VectorInt8 yi = VectorInt8::Cast(y);
+    yi += (i << 23);
+    y = yi.CastToFloat();
+
+    const Vector8 range(87.0f);
+    y = Vector8::Select(y, Vector8::Zero(), -a >= range);
+    y = Vector8::Select(y, VECTOR8_INF, a >= range);
+    return y;
+#else
+    return Vector8{ FastExp(a.Low()), FastExp(a.High()) };
+#endif // RT_USE_AVX2
+}
+
 float Log(float x)
 {
     // based on:
@@ -232,6 +256,29 @@ const Vector4 FastLog(const Vector4& a)
     return r;
 }
 
+const Vector8 FastLog(const Vector8& a)
+{
+#ifdef RT_USE_AVX2
+    // range reduction
+    const VectorInt8 e = (VectorInt8::Cast(a) - VectorInt8(0x3f2aaaab)) & VectorInt8(0xff800000);
+    const Vector8 m = (VectorInt8::Cast(a) - e).CastToFloat();
+    const Vector8 i = e.ConvertToFloat() * 1.19209290e-7f;
+
+    const Vector8 f = m - Vector8(1.0f);
+    const Vector8 s = f * f;
+
+    // Compute log1p(f) for f in [-1/3, 1/3]
+    Vector8 r = Vector8::MulAndAdd(f, Vector8(0.230836749f), Vector8(-0.279208571f));
+    Vector8 t = Vector8::MulAndAdd(f, Vector8(0.331826031f), Vector8(-0.498910338f));
+    r = Vector8::MulAndAdd(r, s, t);
+    r = Vector8::MulAndAdd(r, s, f);
+    r = Vector8::MulAndAdd(i, Vector8(0.693147182f), r); // log(2)
+    return r;
+#else
+    return Vector8{ FastLog(a.Low()), FastLog(a.High()) };
+#endif // RT_USE_AVX2
+}
+
 float FastATan2(const float y, const float x)
 {
     // https://stackoverflow.com/questions/46210708/atan2-approximation-with-11bits-in-mantissa-on-x86with-sse2-and-armwith-vfpv4
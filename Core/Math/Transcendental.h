@@ -41,6 +41,7 @@ float FastATan2(const float y, const float x);
  */
 RAYLIB_API float FastExp(float x);
 RAYLIB_API const Vector4 FastExp(const Vector4& x);
+RAYLIB_API const Vector8 FastExp(const Vector8& x);
 
 /**
  * Accurate natural logarithm.
@@ -55,6 +56,7 @@ RAYLIB_API float Log(float x);
  */
 RAYLIB_API float FastLog(float x);
 RAYLIB_API const Vector4 FastLog(const Vector4& x);
+RAYLIB_API const Vector8 FastLog(const Vector8& x);
 
 } // namespace math
 } // namespace rt
@@ -72,6 +72,9 @@ struct RT_ALIGN(32) VectorInt8
     // convert from float vector to integer vector
     RT_FORCE_INLINE static const VectorInt8 Convert(const Vector8& v);
 
+    // convert from float vector to integer vector (with truncation towards zero)
+    RT_FORCE_INLINE static const VectorInt8 TruncateAndConvert(const Vector8& v);
+
     // convert to float vector
     RT_FORCE_INLINE const Vector8 ConvertToFloat() const;
 
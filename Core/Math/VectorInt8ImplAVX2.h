@@ -97,6 +97,11 @@ const VectorInt8 VectorInt8::Convert(const Vector8& v)
     return _mm256_cvtps_epi32(_mm256_round_ps(v, _MM_FROUND_TO_ZERO));
 }
 
+const VectorInt8 VectorInt8::TruncateAndConvert(const Vector8& v)
+{
+    return _mm256_cvttps_epi32(v);
+}
+
 const Vector8 VectorInt8::ConvertToFloat() const
 {
     return _mm256_cvtepi32_ps(v);
@@ -221,6 +226,11 @@ const VectorInt8 VectorInt8::Max(const VectorInt8& a, const VectorInt8& b)
     return _mm256_max_epi32(a, b);
 }
 
+const VectorInt8 VectorInt8::Clamped(const VectorInt8& min, const VectorInt8& max) const
+{
+    return Min(max, Max(min, *this));
+}
+
 const Vector8 Gather8(const float* basePtr, const VectorInt8& indices)
 {
     return _mm256_i32gather_ps(basePtr, indices, 4);
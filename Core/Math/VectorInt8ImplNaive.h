@@ -91,6 +91,11 @@ const VectorInt8 VectorInt8::Convert(const Vector8& v)
     return { VectorInt4::Convert(v.low), VectorInt4::Convert(v.high) };
 }
 
+const VectorInt8 VectorInt8::TruncateAndConvert(const Vector8& v)
+{
+    return { VectorInt4::TruncateAndConvert(v.low), VectorInt4::TruncateAndConvert(v.high) };
+}
+
 const Vector8 VectorInt8::ConvertToFloat() const
 {
     return { low.ConvertToFloat(), high.ConvertToFloat() };
@@ -239,6 +244,11 @@ const VectorInt8 VectorInt8::Max(const VectorInt8& a, const VectorInt8& b)
     return { VectorInt4::Max(a.low, b.low), VectorInt4::Max(a.high, b.high) };
 }
 
+const VectorInt8 VectorInt8::Clamped(const VectorInt8& min, const VectorInt8& max) const
+{
+    return Min(max, Max(min, *this));
+}
+
 const Vector8 Gather8(const float* basePtr, const VectorInt8& indices)
 {
     Vector8 result;
@@ -27,9 +27,9 @@ enum class TraversalMode : uint8
 
 enum class LightSamplingStrategy : uint8
 {
-    Single,
-    All,
-    // TODO "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+    Single,     // pick one light uniformly
+    All,        // sample all the lights
+    LightBVH,   // pick one light by importance, using light BVH (see LightBVH)
 };
 
 struct AdaptiveRenderingSettings
@@ -66,6 +66,10 @@ struct RenderingParams
     // NOTE: must be in [0...1] range
     float motionBlurStrength = 0.5f;
 
+    // number of samples rendered per pixel in a single pass (Viewport::Render call)
+    // Note: post-processing is performed once per pass, so higher values reduce the per-pass overhead
+    uint32 samplesPerPixel = 1;
+
     // maximum ray depth
     uint32 maxRayDepth = 20;
 
@@ -78,6 +82,23 @@ struct RenderingParams
     // select mode of ray traversal
     TraversalMode traversalMode = TraversalMode::Single;
 
+    // packet traversal: compact active rays into fewer groups when fraction of active SIMD lanes
+    // drops below this value (0.0 disables the reordering)
+    // Note: disabled by default, lane shuffling costs more than it saves for coherent (sorted) packets
+    float packetReorderingThreshold = 0.0f;
+
+    // packet traversal: continue BVH subtree traversal with SIMD-8 rays when number of active ray groups
+    // drops to this value (0 disables the fallback)
+    uint32 simdTraversalThreshold = 1;
+
+    // packet and SIMD-8 traversal: continue BVH subtree traversal with single rays when number of active rays
+    // drops to this value (0 disables the fallback)
+    uint32 singleRayTraversalThreshold = 2;
+
+    // collect ray-box and ray-triangle intersection counters (see Viewport::GetCounters)
+    // Note: costs a few percent of traversal performance when enabled
+    bool enableIntersectionCounters = false;
+
     // describes how lights should be sampled
     LightSamplingStrategy lightSamplingStrategy = LightSamplingStrategy::Single;
 
@@ -138,7 +159,11 @@ struct RT_ALIGN(64) RenderingContext
 
     RayPacket rayPacket;
 
-    HitPoint hitPoints[MaxRayPacketSize];
+    // packet traversal results, indexed by ray offset
+    HitPoint hitPoints[RayPacket::MaxNumRaySlots];
+
+    // packet shadow traversal results, bit per ray offset (set if the ray is occluded)
+    uint8 occludedRays[RayPacket::MaxNumGroups];
 
     // TODO separate stacks for scene and mesh
     uint8 activeRaysMask[RayPacket::MaxNumGroups];
@@ -14,6 +14,13 @@ struct LocalCounters
     uint32 numPassedRayBoxTests;
     uint32 numRayTriangleTests;
     uint32 numPassedRayTriangleTests;
+    uint32 numVisitedNodes;         // inner BVH nodes visited by all the rays
+    uint32 numPacketLanes;          // SIMD lanes used in ray packet box tests
+    uint32 numActivePacketLanes;    // SIMD lanes occupied by active rays in ray packet box tests
+
+    // counters are collected only when enabled, so the traversal pays just a single, well predicted branch otherwise
+    // Note: not cleared by Reset()
+    bool enabled = false;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
     RT_FORCE_INLINE LocalCounters()
@@ -21,6 +28,15 @@ struct LocalCounters
         Reset();
     }
 
+    RT_FORCE_INLINE bool IsEnabled() const
+    {
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        return enabled;
+#else
+        return false;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+    }
+
     RT_FORCE_INLINE void Reset()
     {
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
@@ -28,11 +44,35 @@ struct LocalCounters
         numPassedRayBoxTests = 0;
         numRayTriangleTests = 0;
         numPassedRayTriangleTests = 0;
+        numVisitedNodes = 0;
+        numPacketLanes = 0;
+        numActivePacketLanes = 0;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
     }
 };
 
 
+// statistics derived from counters of a single rendering pass
+struct RayTracingStats
+{
+    double time = 0.0;
+
+    // rays per second by type
+    double raysPerSecond = 0.0;
+    double primaryRaysPerSecond = 0.0;
+    double shadowRaysPerSecond = 0.0;
+    double traversedRaysPerSecond = 0.0;
+
+    // averages per traversed ray (available only when intersection counters are enabled)
+    double nodesPerRay = 0.0;
+    double rayBoxTestsPerRay = 0.0;
+    double leafTestsPerRay = 0.0;
+
+    // fraction of SIMD lanes doing useful work in ray packet traversal
+    double packetUtilization = 0.0;
+};
+
+
 struct RayTracingCounters
 {
     uint64 numRays;
@@ -41,10 +81,14 @@ struct RayTracingCounters
     uint64 numPrimaryRays;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    uint64 numTraversedRays;
     uint64 numRayBoxTests;
     uint64 numPassedRayBoxTests;
     uint64 numRayTriangleTests;
     uint64 numPassedRayTriangleTests;
+    uint64 numVisitedNodes;
+    uint64 numPacketLanes;
+    uint64 numActivePacketLanes;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
 
@@ -56,22 +100,32 @@ struct RayTracingCounters
         numPrimaryRays = 0;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedRays = 0;
         numRayBoxTests = 0;
         numPassedRayBoxTests = 0;
         numRayTriangleTests = 0;
         numPassedRayTriangleTests = 0;
+        numVisitedNodes = 0;
+        numPacketLanes = 0;
+        numActivePacketLanes = 0;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
     }
 
 
-    RT_FORCE_INLINE void Append(const LocalCounters& other)
+    // append counters of a single scene traversal
+    RT_FORCE_INLINE void Append(const LocalCounters& other, uint32 numTraversedRaysToAdd)
     {
         RT_UNUSED(other);
+        RT_UNUSED(numTraversedRaysToAdd);
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedRays += numTraversedRaysToAdd;
         numRayBoxTests += other.numRayBoxTests;
         numPassedRayBoxTests += other.numPassedRayBoxTests;
         numRayTriangleTests += other.numRayTriangleTests;
         numPassedRayTriangleTests += other.numPassedRayTriangleTests;
+        numVisitedNodes += other.numVisitedNodes;
+        numPacketLanes += other.numPacketLanes;
+        numActivePacketLanes += other.numActivePacketLanes;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
     }
 
@@ -84,12 +138,48 @@ struct RayTracingCounters
         numPrimaryRays += other.numPrimaryRays;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        numTraversedRays += other.numTraversedRays;
         numRayBoxTests += other.numRayBoxTests;
         numPassedRayBoxTests += other.numPassedRayBoxTests;
         numRayTriangleTests += other.numRayTriangleTests;
         numPassedRayTriangleTests += other.numPassedRayTriangleTests;
+        numVisitedNodes += other.numVisitedNodes;
+        numPacketLanes += other.numPacketLanes;
+        numActivePacketLanes += other.numActivePacketLanes;
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
     }
+
+
+    // compute derived statistics for counters collected within given time (in seconds)
+    RayTracingStats ComputeStats(double time) const
+    {
+        RayTracingStats stats;
+        stats.time = time;
+
+        const double invTime = time > 0.0 ? 1.0 / time : 0.0;
+        stats.raysPerSecond = static_cast<double>(numRays) * invTime;
+        stats.primaryRaysPerSecond = static_cast<double>(numPrimaryRays) * invTime;
+        stats.shadowRaysPerSecond = static_cast<double>(numShadowRays) * invTime;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        stats.traversedRaysPerSecond = static_cast<double>(numTraversedRays) * invTime;
+
+        if (numTraversedRays > 0)
+        {
+            const double invNumRays = 1.0 / static_cast<double>(numTraversedRays);
+            stats.nodesPerRay = static_cast<double>(numVisitedNodes) * invNumRays;
+            stats.rayBoxTestsPerRay = static_cast<double>(numRayBoxTests) * invNumRays;
+            stats.leafTestsPerRay = static_cast<double>(numRayTriangleTests) * invNumRays;
+        }
+
+        if (numPacketLanes > 0)
+        {
+            stats.packetUtilization = static_cast<double>(numActivePacketLanes) / static_cast<double>(numPacketLanes);
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        return stats;
+    }
 };
 
 
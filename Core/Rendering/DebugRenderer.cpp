@@ -23,6 +23,22 @@ const char* DebugRenderer::GetName() const
     return "Debug";
 }
 
+void DebugRenderer::PreRender(uint32, RenderingContext& ctx)
+{
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    // traversal statistics modes visualize the counters, so they must be collected regardless of the rendering params
+    if (mRenderingMode == DebugRenderingMode::RayBoxIntersection ||
+        mRenderingMode == DebugRenderingMode::RayBoxIntersectionPassed ||
+        mRenderingMode == DebugRenderingMode::RayTriIntersection ||
+        mRenderingMode == DebugRenderingMode::RayTriIntersectionPassed)
+    {
+        ctx.localCounters.enabled = true;
+    }
+#else
+    RT_UNUSED(ctx);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+}
+
 const RayColor DebugRenderer::RenderPixel(const math::Ray& ray, const RenderParam&, RenderingContext& ctx) const
 {
     HitPoint hitPoint;
@@ -186,9 +202,6 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, const Camera&, Film& film
     const uint32 numGroups = packet.GetNumGroups();
     for (uint32 i = 0; i < numGroups; ++i)
     {
-        Vector4 weights[RayPacket::RaysPerGroup];
-        packet.rayWeights[i].Unpack(weights);
-
         Vector4 rayOrigins[RayPacket::RaysPerGroup];
         Vector4 rayDirs[RayPacket::RaysPerGroup];
         packet.groups[i].rays[0].origin.Unpack(rayOrigins);
@@ -196,7 +209,13 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, const Camera&, Film& film
 
         for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
         {
-            const HitPoint& hitPoint = context.hitPoints[RayPacket::RaysPerGroup * i + j];
+            const int32 rayOffset = packet.groups[i].rayOffsets[j];
+            if (rayOffset == RayPacket::InvalidRayOffset)
+            {
+                continue;
+            }
+
+            const HitPoint& hitPoint = context.hitPoints[rayOffset];
 
             Vector4 color = Vector4::Zero();
 
@@ -252,7 +271,7 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, const Camera&, Film& film
                         const uint64 hash = Hash((uint64)hitPoint.objectId | ((uint64)hitPoint.subObjectId << 32));
                         const float hue = (float)(uint32)hash / (float)UINT32_MAX;
                         const float saturation = 0.5f + 0.5f * (float)(uint32)(hash >> 32) / (float)UINT32_MAX;
-                        color = weights[j] * HSVtoRGB(hue, saturation, 1.0f);
+                        color = packet.GetRayWeight(rayOffset) * HSVtoRGB(hue, saturation, 1.0f);
                         break;
                     }
                 }
@@ -261,7 +280,7 @@ void DebugRenderer::Raytrace_Packet(RayPacket& packet, const Camera&, Film& film
             // clamp color
             color = Vector4::Max(Vector4::Zero(), color);
 
-            const ImageLocationInfo& imageLocation = packet.imageLocations[RayPacket::RaysPerGroup * i + j];
+            const ImageLocationInfo& imageLocation = packet.imageLocations[rayOffset];
             film.AccumulateColor(imageLocation.x, imageLocation.y, color);
         }
     }
@@ -41,6 +41,7 @@ public:
     DebugRenderer(const Scene& scene);
 
     virtual const char* GetName() const;
+    virtual void PreRender(uint32 passNumber, RenderingContext& ctx) override;
     virtual const RayColor RenderPixel(const math::Ray& ray, const RenderParam& param, RenderingContext& ctx) const override;
     virtual void Raytrace_Packet(RayPacket& packet, const Camera& camera, Film& film, RenderingContext& context) const override;
 
@@ -1,6 +1,8 @@
 #include "PCH.h"
 #include "Film.h"
 #include "../Utils/Bitmap.h"
+#include "../Utils/ThreadPool.h"
+#include "../Utils/Profiler.h"
 #include "../Math/Random.h"
 #include "../Math/Vector4Load.h"
 
@@ -8,10 +10,71 @@ namespace rt {
 
 using namespace math;
 
-Film::Film(Bitmap& sum, Bitmap* secondarySum)
+void FilmSplatQueue::Push(uint32 x, uint32 y, const Vector4& color)
+{
+    mSplats.PushBack({ x, y, color.ToFloat3() });
+}
+
+void FilmSplatQueue::Clear()
+{
+    mSplats.Clear();
+    mSortedSplats.Clear();
+    mStripeOffsets.Clear();
+}
+
+void FilmSplatQueue::SortByStripe(uint32 numStripes, uint32 imageHeight)
+{
+    RT_ASSERT(numStripes > 0);
+    RT_ASSERT(imageHeight > 0);
+
+    mStripeOffsets.Clear();
+    mStripeOffsets.Resize(numStripes + 1);
+    memset(mStripeOffsets.Data(), 0, sizeof(uint32) * mStripeOffsets.Size());
+
+    mSortedSplats.Resize_SkipConstructor(mSplats.Size());
+
+    const auto getStripe = [numStripes, imageHeight](const Splat& splat)
+    {
+        return static_cast<uint32>(static_cast<uint64>(splat.y) * numStripes / imageHeight);
+    };
+
+    // counting sort
+    for (const Splat& splat : mSplats)
+    {
+        mStripeOffsets[getStripe(splat) + 1]++;
+    }
+
+    for (uint32 i = 0; i < numStripes; ++i)
+    {
+        mStripeOffsets[i + 1] += mStripeOffsets[i];
+    }
+
+    {
+        DynArray<uint32> writeOffsets(mStripeOffsets);
+        for (const Splat& splat : mSplats)
+        {
+            mSortedSplats[writeOffsets[getStripe(splat)]++] = splat;
+        }
+    }
+}
+
+const ArrayView<const FilmSplatQueue::Splat> FilmSplatQueue::GetStripe(uint32 stripe) const
+{
+    if (stripe + 1 >= mStripeOffsets.Size())
+    {
+        return ArrayView<const Splat>();
+    }
+
+    const uint32 begin = mStripeOffsets[stripe];
+    const uint32 end = mStripeOffsets[stripe + 1];
+    return ArrayView<const Splat>(mSortedSplats.Data() + begin, end - begin);
+}
+
+Film::Film(Bitmap& sum, Bitmap* secondarySum, FilmSplatQueue* splatQueue)
     : mFilmSize((float)sum.GetWidth(), (float)sum.GetHeight())
     , mSum(sum)
-    , mSecondarySum(secondarySum) 
+    , mSecondarySum(secondarySum)
+    , mSplatQueue(splatQueue)
     , mWidth(mSum.GetWidth())
     , mHeight(mSum.GetHeight())
 {
@@ -67,12 +130,56 @@ void Film::AccumulateColor(const Vector4& pos, const Vector4& sampleColor, Rando
 
     if (uint32(x) < mWidth && uint32(y) < mHeight)
     {
-        AccumulateToFloat3(mSum.GetPixelRef<Float3>(x, y), sampleColor);
+        if (mSplatQueue)
+        {
+            mSplatQueue->Push(x, y, sampleColor);
+        }
+        else
+        {
+            AccumulateColor(x, y, sampleColor);
+        }
+    }
+}
+
+void Film::MergeSplats(ArrayView<FilmSplatQueue> queues, ThreadPool& threadPool)
+{
+    RT_SCOPED_TRACE(Film_MergeSplats);
 
-        if (mSecondarySum)
+    uint32 numSplats = 0;
+    for (const FilmSplatQueue& queue : queues)
+    {
+        numSplats += queue.Size();
+    }
+
+    if (numSplats == 0)
+    {
+        return;
+    }
+
+    // Note: number of stripes does not affect the order in which a single pixel receives its splats
+    const uint32 numStripes = Min(mHeight, 4 * threadPool.GetNumThreads());
+
+    const auto sortCallback = [&queues, numStripes, this](uint32 id, uint32)
+    {
+        queues[id].SortByStripe(numStripes, mHeight);
+    };
+    threadPool.RunParallelTask(sortCallback, queues.Size());
+
+    const auto mergeCallback = [&queues, this](uint32 stripe, uint32)
+    {
+        for (const FilmSplatQueue& queue : queues)
         {
-            AccumulateToFloat3(mSecondarySum->GetPixelRef<Float3>(x, y), sampleColor);
+            for (const FilmSplatQueue::Splat& splat : queue.GetStripe(stripe))
+            {
+                AccumulateColor(splat.x, splat.y, Vector4(splat.color));
+            }
         }
+    };
+    threadPool.RunParallelTask(mergeCallback, numStripes);
+
+    for (FilmSplatQueue& queue : queues)
+    {
+        queue.Clear();
     }
 }
 
@@ -2,19 +2,57 @@
 
 #include "../RayLib.h"
 #include "../Math/Vector4.h"
+#include "../Math/Float3.h"
+#include "../Containers/DynArray.h"
+#include "../Containers/ArrayView.h"
 
 namespace rt {
 
 class Bitmap;
+class ThreadPool;
 
 namespace math {
 class Random;
 } // namespace math
 
-class Film
+// Splats (contributions landing in arbitrary pixels, e.g. from light tracing or VCM camera connections)
+// generated while rendering a single image tile.
+// Splatting directly to the film from multiple threads would be a data race, so the splats are queued
+// and merged into the film at the end of the rendering pass (see Film::MergeSplats).
+class RAYLIB_API FilmSplatQueue
 {
 public:
-    Film(Bitmap& sum, Bitmap* secondarySum = nullptr);
+    struct Splat
+    {
+        uint32 x;
+        uint32 y;
+        math::Float3 color;
+    };
+
+    void Push(uint32 x, uint32 y, const math::Vector4& color);
+
+    // remove all the splats (keeps the allocated memory)
+    void Clear();
+
+    RT_FORCE_INLINE bool Empty() const { return mSplats.Empty(); }
+    RT_FORCE_INLINE uint32 Size() const { return mSplats.Size(); }
+
+    // bin the splats into horizontal image stripes (preserves push order within a stripe)
+    void SortByStripe(uint32 numStripes, uint32 imageHeight);
+
+    // get splats landing in a given stripe (valid after SortByStripe)
+    const ArrayView<const Splat> GetStripe(uint32 stripe) const;
+
+private:
+    DynArray<Splat> mSplats;
+    DynArray<Splat> mSortedSplats;
+    DynArray<uint32> mStripeOffsets;
+};
+
+class RAYLIB_API Film
+{
+public:
+    Film(Bitmap& sum, Bitmap* secondarySum = nullptr, FilmSplatQueue* splatQueue = nullptr);
 
     RT_FORCE_INLINE uint32 GetWidth() const
     {
@@ -26,14 +64,24 @@ public:
         return mHeight;
     }
 
+    // splat a color at given film position
+    // Note: if the film has a splat queue assigned, the color is queued instead of being written immediately
     void AccumulateColor(const math::Vector4& pos, const math::Vector4& sampleColor, math::Random& randomGenerator);
+
+    // accumulate color at given pixel
+    // Note: the pixel must be owned by the calling thread
     void AccumulateColor(const uint32 x, const uint32 y, const math::Vector4& sampleColor);
 
+    // Merge queued splats into the film. Image stripes are processed in parallel and the splats
+    // are applied in queues order, so the result does not depend on threads scheduling.
+    void MergeSplats(ArrayView<FilmSplatQueue> queues, ThreadPool& threadPool);
+
 private:
     math::Vector4 mFilmSize;
 
     Bitmap& mSum;
     Bitmap* mSecondarySum;
+    FilmSplatQueue* mSplatQueue;
 
     const uint32 mWidth;
     const uint32 mHeight;
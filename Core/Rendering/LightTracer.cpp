@@ -27,17 +27,14 @@ const RayColor LightTracer::RenderPixel(const Ray&, const RenderParam& param, Re
 {
     uint32 depth = 0;
 
-    const auto& allLocalLights = mScene.GetLights();
-    if (allLocalLights.Empty())
+    float lightPickingProbability;
+    const LightSceneObject* lightObject = PickEmittingLight(ctx, lightPickingProbability);
+    if (!lightObject)
     {
         // no lights on the scene
         return RayColor::Zero();
     }
 
-    const float lightPickingProbability = 1.0f / (float)allLocalLights.Size();
-    const uint32 lightIndex = ctx.randomGenerator.GetInt() % allLocalLights.Size();
-
-    const LightSceneObject* lightObject = allLocalLights[lightIndex];
     const ILight& light = lightObject->GetLight();
 
     const ILight::EmitParam emitParam =
@@ -1,6 +1,8 @@
 #include "PCH.h"
 #include "PathTracer.h"
 #include "Context.h"
+#include "Film.h"
+#include "RendererContext.h"
 #include "Scene/Scene.h"
 #include "Scene/Light/Light.h"
 #include "Scene/Object/SceneObject.h"
@@ -13,6 +15,38 @@ namespace rt {
 
 using namespace math;
 
+// per-thread data used by wavefront path tracing
+class RT_ALIGN(64) PathTracerContext : public IRendererContext, public Aligned<64>
+{
+public:
+    // paths states (SoA)
+    // Note: paths are indexed by ray offset in the ray packet
+    struct PathStates
+    {
+        RayColor throughput[RayPacket::MaxNumRaySlots];
+        RayColor radiance[RayPacket::MaxNumRaySlots];
+        GenericSampler::PixelState samplerState[RayPacket::MaxNumRaySlots];
+        ImageLocationInfo location[RayPacket::MaxNumRaySlots];
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+        Wavelength wavelength[RayPacket::MaxNumRaySlots];
+#endif // RT_ENABLE_SPECTRAL_RENDERING
+    };
+
+    struct ShadingRequest
+    {
+        const Material* material;
+        uint32 pathIndex;
+        uint32 shadingDataIndex;
+    };
+
+    // current and next bounce (alive paths are compacted into the latter)
+    PathStates pathStates[2];
+
+    // shading data of paths that hit a surface
+    ShadingData shadingData[MaxRayPacketSize];
+    ShadingRequest shadingRequests[MaxRayPacketSize];
+};
+
 PathTracer::PathTracer(const Scene& scene)
     : IRenderer(scene)
 {
@@ -23,6 +57,11 @@ const char* PathTracer::GetName() const
     return "Path Tracer";
 }
 
+RendererContextPtr PathTracer::CreateContext() const
+{
+    return std::make_unique<PathTracerContext>();
+}
+
 const RayColor PathTracer::EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, const IntersectionData& intersection, RenderingContext& context) const
 {
     const float cosAtLight = -intersection.CosTheta(ray.dir);
@@ -126,49 +165,219 @@ const RayColor PathTracer::RenderPixel(const math::Ray& primaryRay, const Render
             break;
         }
 
-        // Russian roulette algorithm
-        if (depth >= context.params->minRussianRouletteDepth)
+        if (!SampleSecondaryRay(shadingData, depth, throughput, ray, context))
         {
-            const float minColorValue = 0.125f;
-            float threshold = minColorValue + (1.0f - minColorValue) * shadingData.materialParams.baseColor.Max();
+            break;
+        }
+
+        depth++;
+    }
+
+    context.counters.numRays += (uint64)depth + 1;
+
+    return resultColor;
+}
+
+bool PathTracer::SampleSecondaryRay(const ShadingData& shadingData, uint32 depth, RayColor& throughput, Ray& outRay, RenderingContext& context) const
+{
+    // Russian roulette algorithm
+    if (depth >= context.params->minRussianRouletteDepth)
+    {
+        const float minColorValue = 0.125f;
+        float threshold = minColorValue + (1.0f - minColorValue) * shadingData.materialParams.baseColor.Max();
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
-            if (context.wavelength.isSingle)
-            {
-                threshold *= 1.0f / static_cast<float>(Wavelength::NumComponents);
-            }
+        if (context.wavelength.isSingle)
+        {
+            threshold *= 1.0f / static_cast<float>(Wavelength::NumComponents);
+        }
 #endif
-            if (context.sampler.GetFloat() > threshold)
+        if (context.sampler.GetFloat() > threshold)
+        {
+            return false;
+        }
+
+        throughput *= 1.0f / threshold;
+        RT_ASSERT(throughput.IsValid());
+    }
+
+    // sample BSDF
+    Vector4 incomingDirWorldSpace;
+    const RayColor bsdfValue = shadingData.intersection.material->Sample(context.wavelength, incomingDirWorldSpace, shadingData, context.sampler.GetFloat3());
+
+    RT_ASSERT(bsdfValue.IsValid());
+    throughput *= bsdfValue;
+
+    // ray is not visible anymore
+    if (throughput.AlmostZero())
+    {
+        return false;
+    }
+
+    // generate secondary ray
+    outRay = Ray(shadingData.intersection.frame.GetTranslation(), incomingDirWorldSpace);
+    outRay.origin += outRay.dir * 0.001f;
+
+    return true;
+}
+
+void PathTracer::Raytrace_Packet(RayPacket& packet, const Camera&, Film& film, RenderingContext& context) const
+{
+    PathTracerContext& pathTracerContext = *static_cast<PathTracerContext*>(context.rendererContext.get());
+
+    PathTracerContext::PathStates* paths = &pathTracerContext.pathStates[0];
+    PathTracerContext::PathStates* nextPaths = &pathTracerContext.pathStates[1];
+
+    // start a path for each primary ray
+    for (uint32 i = 0; i < packet.GetNumGroups(); ++i)
+    {
+        for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+        {
+            const int32 rayOffset = packet.groups[i].rayOffsets[j];
+            if (rayOffset == RayPacket::InvalidRayOffset)
             {
-                break;
+                continue;
             }
 
-            throughput *= 1.0f / threshold;
-            RT_ASSERT(throughput.IsValid());
+            const ImageLocationInfo& location = packet.imageLocations[rayOffset];
+            context.sampler.ResetPixel(location.x, location.y);
+
+            paths->throughput[rayOffset] = RayColor::One();
+            paths->radiance[rayOffset] = RayColor::Zero();
+            paths->samplerState[rayOffset] = context.sampler.SavePixelState();
+            paths->location[rayOffset] = location;
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+            paths->wavelength[rayOffset] = context.wavelength;
+#endif // RT_ENABLE_SPECTRAL_RENDERING
         }
+    }
 
-        // sample BSDF
-        Vector4 incomingDirWorldSpace;
-        const RayColor bsdfValue = shadingData.intersection.material->Sample(context.wavelength, incomingDirWorldSpace, shadingData, context.sampler.GetFloat3());
+    const auto restorePathState = [&context](const PathTracerContext::PathStates& pathStates, uint32 pathIndex)
+    {
+        context.sampler.RestorePixelState(pathStates.samplerState[pathIndex]);
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+        context.wavelength = pathStates.wavelength[pathIndex];
+#endif // RT_ENABLE_SPECTRAL_RENDERING
+    };
+
+    const auto terminatePath = [&context, &film](const PathTracerContext::PathStates& pathStates, uint32 pathIndex)
+    {
+        const RayColor& radiance = pathStates.radiance[pathIndex];
+        RT_ASSERT(radiance.IsValid());
+
+        const ImageLocationInfo& location = pathStates.location[pathIndex];
+        film.AccumulateColor(location.x, location.y, radiance.ConvertToTristimulus(context.wavelength));
+    };
+
+    for (uint32 depth = 0; packet.numRays > 0; ++depth)
+    {
+        mScene.Traverse({ packet, context });
 
-        RT_ASSERT(bsdfValue.IsValid());
-        throughput *= bsdfValue;
+        context.counters.numRays += packet.numRays;
 
-        // ray is not visible anymore
-        if (throughput.AlmostZero())
+        // evaluate intersections, finish paths that missed the scene or hit a light
+        uint32 numShadingRequests = 0;
+        for (uint32 groupIndex = 0; groupIndex < packet.GetNumGroups(); ++groupIndex)
         {
-            break;
+            const RayGroup& rayGroup = packet.groups[groupIndex];
+
+            Vector4 rayOrigins[RayPacket::RaysPerGroup];
+            Vector4 rayDirs[RayPacket::RaysPerGroup];
+            rayGroup.rays[0].origin.Unpack(rayOrigins);
+            rayGroup.rays[0].dir.Unpack(rayDirs);
+
+            for (uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+            {
+                const int32 rayOffset = rayGroup.rayOffsets[lane];
+                if (rayOffset == RayPacket::InvalidRayOffset)
+                {
+                    continue;
+                }
+
+                const uint32 i = static_cast<uint32>(rayOffset);
+                restorePathState(*paths, i);
+
+                const Ray ray = Ray::BuildUnsafe(rayOrigins[lane], rayDirs[lane]);
+                const HitPoint& hitPoint = context.hitPoints[i];
+
+                // ray missed - return background light color
+                if (hitPoint.objectId == RT_INVALID_OBJECT)
+                {
+                    paths->radiance[i].MulAndAccumulate(paths->throughput[i], EvaluateGlobalLights(ray, context));
+                    terminatePath(*paths, i);
+                    continue;
+                }
+
+                ShadingData& shadingData = pathTracerContext.shadingData[numShadingRequests];
+                mScene.EvaluateIntersection(ray, hitPoint, context.time, shadingData.intersection);
+                shadingData.outgoingDirWorldSpace = -ray.dir;
+
+                // we hit a light directly
+                if (hitPoint.subObjectId == RT_LIGHT_OBJECT)
+                {
+                    const ISceneObject* sceneObject = mScene.GetHitObject(hitPoint.objectId);
+                    RT_ASSERT(sceneObject->GetType() == ISceneObject::Type::Light);
+                    const LightSceneObject* lightObject = static_cast<const LightSceneObject*>(sceneObject);
+
+                    const RayColor lightColor = EvaluateLight(lightObject, ray, shadingData.intersection, context);
+                    RT_ASSERT(lightColor.IsValid());
+                    paths->radiance[i].MulAndAccumulate(paths->throughput[i], lightColor);
+                    terminatePath(*paths, i);
+                    continue;
+                }
+
+                pathTracerContext.shadingRequests[numShadingRequests] = { shadingData.intersection.material, i, numShadingRequests };
+                numShadingRequests++;
+            }
         }
 
-        // generate secondary ray
-        ray = Ray(shadingData.intersection.frame.GetTranslation(), incomingDirWorldSpace);
-        ray.origin += ray.dir * 0.001f;
+        // sort by material, so the same material data is used by consecutive paths
+        std::sort(pathTracerContext.shadingRequests, pathTracerContext.shadingRequests + numShadingRequests,
+            [](const PathTracerContext::ShadingRequest& a, const PathTracerContext::ShadingRequest& b)
+        {
+            return (a.material < b.material) || (a.material == b.material && a.pathIndex < b.pathIndex);
+        });
 
-        depth++;
-    }
+        // shade the hit points and generate secondary rays
+        // Note: packet is reused for the next bounce, alive paths are compacted
+        packet.Clear();
 
-    context.counters.numRays += (uint64)depth + 1;
+        for (uint32 i = 0; i < numShadingRequests; ++i)
+        {
+            const PathTracerContext::ShadingRequest& request = pathTracerContext.shadingRequests[i];
+            const uint32 pathIndex = request.pathIndex;
+            ShadingData& shadingData = pathTracerContext.shadingData[request.shadingDataIndex];
 
-    return resultColor;
+            restorePathState(*paths, pathIndex);
+
+            RayColor throughput = paths->throughput[pathIndex];
+            RayColor& radiance = paths->radiance[pathIndex];
+
+            mScene.EvaluateShadingData(shadingData, context);
+
+            // accumulate emission color
+            RT_ASSERT(shadingData.materialParams.emissionColor.IsValid());
+            radiance.MulAndAccumulate(throughput, shadingData.materialParams.emissionColor);
+            RT_ASSERT(radiance.IsValid());
+
+            Ray secondaryRay;
+            if (depth >= context.params->maxRayDepth || !SampleSecondaryRay(shadingData, depth, throughput, secondaryRay, context))
+            {
+                terminatePath(*paths, pathIndex);
+                continue;
+            }
+
+            const uint32 nextPathIndex = packet.PushRay(secondaryRay, VECTOR_ONE, paths->location[pathIndex]);
+            nextPaths->throughput[nextPathIndex] = throughput;
+            nextPaths->radiance[nextPathIndex] = radiance;
+            nextPaths->samplerState[nextPathIndex] = context.sampler.SavePixelState();
+            nextPaths->location[nextPathIndex] = paths->location[pathIndex];
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+            nextPaths->wavelength[nextPathIndex] = context.wavelength;
+#endif // RT_ENABLE_SPECTRAL_RENDERING
+        }
+
+        std::swap(paths, nextPaths);
+    }
 }
 
 } // namespace rt
@@ -16,10 +16,18 @@ public:
     PathTracer(const Scene& scene);
 
     virtual const char* GetName() const override;
+    virtual RendererContextPtr CreateContext() const override;
     virtual const RayColor RenderPixel(const math::Ray& ray, const RenderParam& param, RenderingContext& ctx) const override;
 
+    // wavefront path tracing: all the paths in the packet are advanced by one bounce at a time
+    virtual void Raytrace_Packet(RayPacket& packet, const Camera& camera, Film& film, RenderingContext& context) const override;
+
 private:
 
+    // perform Russian roulette and sample BSDF
+    // returns false if the path should be terminated
+    bool SampleSecondaryRay(const ShadingData& shadingData, uint32 depth, RayColor& throughput, math::Ray& outRay, RenderingContext& context) const;
+
     // compute radiance from a hit local lights
     const RayColor EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, const IntersectionData& intersection, RenderingContext& context) const;
 
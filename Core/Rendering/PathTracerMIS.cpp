@@ -40,7 +40,8 @@ const char* PathTracerMIS::GetName() const
     return "Path Tracer MIS";
 }
 
-const RayColor PathTracerMIS::SampleLight(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const
+const RayColor PathTracerMIS::SampleLight_Unoccluded(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability,
+                                                     Ray& outShadowRay, float& outShadowRayDistance) const
 {
     const ILight& light = lightObject->GetLight();
 
@@ -80,25 +81,10 @@ const RayColor PathTracerMIS::SampleLight(const LightSceneObject* lightObject, c
 
     RT_ASSERT(bsdfPdfW >= 0.0f && IsValid(bsdfPdfW));
 
-    // cast shadow ray
-    {
-        HitPoint hitPoint;
-        hitPoint.distance = illuminateResult.distance * 0.999f;
-
-        Ray shadowRay(shadingData.intersection.frame.GetTranslation(), illuminateResult.directionToLight);
-        shadowRay.origin += shadowRay.dir * 0.0001f;
-
-        context.counters.numShadowRays++;
-        if (mScene.Traverse_Shadow({ shadowRay, hitPoint, context }))
-        {
-            // shadow ray missed the light - light is occluded
-            return RayColor::Zero();
-        }
-        else
-        {
-            context.counters.numShadowRaysHit++;
-        }
-    }
+    // shadow ray
+    outShadowRay = Ray(shadingData.intersection.frame.GetTranslation(), illuminateResult.directionToLight);
+    outShadowRay.origin += outShadowRay.dir * 0.0001f;
+    outShadowRayDistance = illuminateResult.distance * 0.999f;
 
     float weight = 1.0f;
 
@@ -122,7 +108,29 @@ const RayColor PathTracerMIS::SampleLight(const LightSceneObject* lightObject, c
     return result;
 }
 
-const RayColor PathTracerMIS::SampleLights(const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const
+const RayColor PathTracerMIS::SampleLight(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const
+{
+    HitPoint hitPoint;
+    Ray shadowRay;
+    const RayColor result = SampleLight_Unoccluded(lightObject, shadingData, pathState, context, lightPickProbability, shadowRay, hitPoint.distance);
+    if (result.AlmostZero())
+    {
+        return RayColor::Zero();
+    }
+
+    // cast shadow ray
+    context.counters.numShadowRays++;
+    if (mScene.Traverse_Shadow({ shadowRay, hitPoint, context }))
+    {
+        // shadow ray missed the light - light is occluded
+        return RayColor::Zero();
+    }
+
+    context.counters.numShadowRaysHit++;
+    return result;
+}
+
+const RayColor PathTracerMIS::SampleLights(const ShadingData& shadingData, const PathState& pathState, RenderingContext& context) const
 {
     RayColor accumulatedColor = RayColor::Zero();
 
@@ -134,15 +142,76 @@ const RayColor PathTracerMIS::SampleLights(const ShadingData& shadingData, const
             case LightSamplingStrategy::Single:
             {
                 const uint32 lightIndex = context.randomGenerator.GetInt() % lights.Size();
-                accumulatedColor = SampleLight(lights[lightIndex], shadingData, pathState, context, lightPickProbability);
+                accumulatedColor = SampleLight(lights[lightIndex], shadingData, pathState, context, 1.0f / static_cast<float>(lights.Size()));
                 break;
             }
 
             case LightSamplingStrategy::All:
             {
-                for (const LightSceneObject* lightObject : lights)
+                // shadow rays are tested in groups of 8
+                RayColor pendingColors[RayPacket::RaysPerGroup];
+                Ray pendingRays[RayPacket::RaysPerGroup];
+                HitPoint_Simd8 pendingHitPoint;
+                uint32 numPendingRays = 0;
+
+                for (uint32 i = 0; i < lights.Size(); ++i)
                 {
-                    accumulatedColor += SampleLight(lightObject, shadingData, pathState, context, lightPickProbability);
+                    Ray& shadowRay = pendingRays[numPendingRays];
+                    float shadowRayDistance;
+                    const RayColor color = SampleLight_Unoccluded(lights[i], shadingData, pathState, context, 1.0f, shadowRay, shadowRayDistance);
+                    if (!color.AlmostZero())
+                    {
+                        pendingColors[numPendingRays] = color;
+                        pendingHitPoint.distance[numPendingRays] = shadowRayDistance;
+                        numPendingRays++;
+                    }
+
+                    if (numPendingRays == RayPacket::RaysPerGroup || (numPendingRays > 0 && i + 1 == lights.Size()))
+                    {
+                        context.counters.numShadowRays += numPendingRays;
+
+                        uint32 occludedRaysMask = 0;
+                        if (numPendingRays == 1)
+                        {
+                            HitPoint hitPoint;
+                            hitPoint.distance = pendingHitPoint.distance[0];
+                            occludedRaysMask = mScene.Traverse_Shadow({ pendingRays[0], hitPoint, context }) ? 1u : 0u;
+                        }
+                        else
+                        {
+                            // unused lanes are inactive (zero max distance)
+                            for (uint32 j = numPendingRays; j < RayPacket::RaysPerGroup; ++j)
+                            {
+                                pendingRays[j] = pendingRays[0];
+                                pendingHitPoint.distance[j] = 0.0f;
+                            }
+
+                            const Ray_Simd8 simdRay(pendingRays[0], pendingRays[1], pendingRays[2], pendingRays[3], pendingRays[4], pendingRays[5], pendingRays[6], pendingRays[7]);
+                            occludedRaysMask = mScene.Traverse_Shadow(SimdTraversalContext{ simdRay, pendingHitPoint, context });
+                        }
+
+                        for (uint32 j = 0; j < numPendingRays; ++j)
+                        {
+                            if (!((occludedRaysMask >> j) & 1u))
+                            {
+                                accumulatedColor += pendingColors[j];
+                                context.counters.numShadowRaysHit++;
+                            }
+                        }
+
+                        numPendingRays = 0;
+                    }
+                }
+                break;
+            }
+
+            case LightSamplingStrategy::LightBVH:
+            {
+                float lightPickProbability;
+                const LightSceneObject* lightObject = mScene.GetLightBVH().Sample(shadingData.intersection.frame.GetTranslation(), shadingData.intersection.frame[2], context.sampler.GetFloat(), lightPickProbability);
+                if (lightObject)
+                {
+                    accumulatedColor = SampleLight(lightObject, shadingData, pathState, context, lightPickProbability);
                 }
                 break;
             }
@@ -154,7 +223,7 @@ const RayColor PathTracerMIS::SampleLights(const ShadingData& shadingData, const
     return accumulatedColor;
 }
 
-float PathTracerMIS::GetLightPickingProbability(RenderingContext& context) const
+float PathTracerMIS::GetLightPickingProbability(const LightSceneObject* lightObject, const PathState& pathState, RenderingContext& context) const
 {
     switch (context.params->lightSamplingStrategy)
     {
@@ -164,6 +233,9 @@ float PathTracerMIS::GetLightPickingProbability(RenderingContext& context) const
     case LightSamplingStrategy::All:
         return 1.0f;
 
+    case LightSamplingStrategy::LightBVH:
+        return mScene.GetLightBVH().Pdf(pathState.lastPosition, pathState.lastNormal, lightObject);
+
     default:
         RT_FATAL("Invalid light sampling strategy");
     };
@@ -171,7 +243,7 @@ float PathTracerMIS::GetLightPickingProbability(RenderingContext& context) const
     return 0.0f;
 }
 
-const RayColor PathTracerMIS::EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, float dist, const IntersectionData& intersection, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const
+const RayColor PathTracerMIS::EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, float dist, const IntersectionData& intersection, const PathState& pathState, RenderingContext& context) const
 {
     const ILight& light = lightObject->GetLight();
 
@@ -203,7 +275,7 @@ const RayColor PathTracerMIS::EvaluateLight(const LightSceneObject* lightObject,
     if (pathState.depth > 0 && !pathState.lastSpecular)
     {
         const float directPdfW = PdfAtoW(directPdfA, dist, cosAtLight);
-        misWeight = CombineMis(pathState.lastPdfW, directPdfW * lightPickProbability);
+        misWeight = CombineMis(pathState.lastPdfW, directPdfW * GetLightPickingProbability(lightObject, pathState, context));
     }
 
     lightContribution *= RayColor::Resolve(context.wavelength, Spectrum(mBSDFSamplingWeight));
@@ -211,7 +283,7 @@ const RayColor PathTracerMIS::EvaluateLight(const LightSceneObject* lightObject,
     return lightContribution * misWeight;
 }
 
-const RayColor PathTracerMIS::EvaluateGlobalLights(const Ray& ray, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const
+const RayColor PathTracerMIS::EvaluateGlobalLights(const Ray& ray, const PathState& pathState, RenderingContext& context) const
 {
     RayColor result = RayColor::Zero();
 
@@ -239,7 +311,7 @@ const RayColor PathTracerMIS::EvaluateGlobalLights(const Ray& ray, const PathSta
             float misWeight = 1.0f;
             if (pathState.depth > 0 && !pathState.lastSpecular)
             {
-                misWeight = CombineMis(pathState.lastPdfW, directPdfW * lightPickProbability);
+                misWeight = CombineMis(pathState.lastPdfW, directPdfW * GetLightPickingProbability(globalLightObject, pathState, context));
             }
 
             result.MulAndAccumulate(lightContribution, misWeight);
@@ -265,8 +337,6 @@ const RayColor PathTracerMIS::RenderPixel(const math::Ray& primaryRay, const Ren
 
     PathState pathState;
 
-    const float lightPickProbability = GetLightPickingProbability(context);
-
     for (;;)
     {
         hitPoint.objectId = RT_INVALID_OBJECT;
@@ -276,7 +346,7 @@ const RayColor PathTracerMIS::RenderPixel(const math::Ray& primaryRay, const Ren
         // ray missed - return background light color
         if (hitPoint.objectId == RT_INVALID_OBJECT)
         {
-            resultColor.MulAndAccumulate(throughput, EvaluateGlobalLights(ray, pathState, context, lightPickProbability));
+            resultColor.MulAndAccumulate(throughput, EvaluateGlobalLights(ray, pathState, context));
             pathTerminationReason = PathTerminationReason::HitBackground;
             break;
         }
@@ -293,7 +363,7 @@ const RayColor PathTracerMIS::RenderPixel(const math::Ray& primaryRay, const Ren
             RT_ASSERT(sceneObject->GetType() == ISceneObject::Type::Light);
             const LightSceneObject* lightObject = static_cast<const LightSceneObject*>(sceneObject);
             
-            const RayColor lightColor = EvaluateLight(lightObject, ray, hitPoint.distance, shadingData.intersection, pathState, context, lightPickProbability);
+            const RayColor lightColor = EvaluateLight(lightObject, ray, hitPoint.distance, shadingData.intersection, pathState, context);
             RT_ASSERT(lightColor.IsValid());
             resultColor.MulAndAccumulate(throughput, lightColor);
 
@@ -317,7 +387,7 @@ const RayColor PathTracerMIS::RenderPixel(const math::Ray& primaryRay, const Ren
         }
 
         // sample lights directly (a.k.a. next event estimation)
-        resultColor.MulAndAccumulate(throughput, SampleLights(shadingData, pathState, context, lightPickProbability));
+        resultColor.MulAndAccumulate(throughput, SampleLights(shadingData, pathState, context));
 
         // check if the ray depth won't be exeeded in the next iteration
         if (pathState.depth >= context.params->maxRayDepth)
@@ -371,6 +441,8 @@ const RayColor PathTracerMIS::RenderPixel(const math::Ray& primaryRay, const Ren
         RT_ASSERT(pdf >= 0.0f);
         pathState.lastSpecular = (lastSampledBsdfEvent & BSDF::SpecularEvent) != 0;
         pathState.lastPdfW = pdf;
+        pathState.lastPosition = shadingData.intersection.frame.GetTranslation();
+        pathState.lastNormal = shadingData.intersection.frame[2];
 
         // TODO check for NaNs
 
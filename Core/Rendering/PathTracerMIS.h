@@ -28,24 +28,32 @@ private:
 
     struct PathState
     {
+        math::Vector4 lastPosition = math::Vector4::Zero();
+        math::Vector4 lastNormal = math::Vector4::Zero();
         uint32 depth = 0u;
         float lastPdfW = 1.0f;
         bool lastSpecular = true;
     };
 
-    float GetLightPickingProbability(RenderingContext& context) const;
+    // probability of picking given light when sampling lights at the last path vertex
+    float GetLightPickingProbability(const LightSceneObject* lightObject, const PathState& pathState, RenderingContext& context) const;
 
     // importance sample light sources
-    const RayColor SampleLights(const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const;
+    const RayColor SampleLights(const ShadingData& shadingData, const PathState& pathState, RenderingContext& context) const;
 
     // importance sample single light source
     const RayColor SampleLight(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const;
 
+    // importance sample single light source without the visibility test
+    // returns zero if the sample has no contribution, otherwise outputs shadow ray that has to be tested by the caller
+    const RayColor SampleLight_Unoccluded(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& context, const float lightPickProbability,
+                                          math::Ray& outShadowRay, float& outShadowRayDistance) const;
+
     // compute radiance from a hit local lights
-    const RayColor EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, float dist, const IntersectionData& intersection, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const;
+    const RayColor EvaluateLight(const LightSceneObject* lightObject, const math::Ray& ray, float dist, const IntersectionData& intersection, const PathState& pathState, RenderingContext& context) const;
 
     // compute radiance from global lights
-    const RayColor EvaluateGlobalLights(const math::Ray& ray, const PathState& pathState, RenderingContext& context, const float lightPickProbability) const;
+    const RayColor EvaluateGlobalLights(const math::Ray& ray, const PathState& pathState, RenderingContext& context) const;
 };
 
 } // namespace rt
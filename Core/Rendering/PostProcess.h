@@ -20,6 +20,9 @@ struct RT_ALIGN(16) PostprocessParams
     // tonemapping curve
     Tonemapper tonemapper = Tonemapper::ACES;
 
+    // process 8 pixels at once (the per-pixel path is used for the remaining pixels of a row or if disabled)
+    bool useSimd = true;
+
     RAYLIB_API PostprocessParams();
 
 
@@ -5,6 +5,8 @@
 #include "LightTracer.h"
 #include "VertexConnectionAndMerging.h"
 #include "DebugRenderer.h"
+#include "Context.h"
+#include "Scene/Scene.h"
 
 namespace rt {
 
@@ -20,7 +22,7 @@ RendererContextPtr IRenderer::CreateContext() const
     return nullptr;
 }
 
-void IRenderer::PreRender(uint32, const Film&)
+void IRenderer::PreRender(uint32, const Film&, uint32)
 {
 }
 
@@ -40,6 +42,34 @@ void IRenderer::Raytrace_Packet(RayPacket&, const Camera&, Film&, RenderingConte
 {
 }
 
+const LightSceneObject* IRenderer::PickEmittingLight(RenderingContext& ctx, float& outPickProbability) const
+{
+    const auto& lights = mScene.GetLights();
+    if (lights.Empty())
+    {
+        return nullptr;
+    }
+
+    if (ctx.params && ctx.params->lightSamplingStrategy == LightSamplingStrategy::LightBVH)
+    {
+        // lights are picked proportionally to their power
+        return mScene.GetLightBVH().SampleEmission(ctx.randomGenerator.GetFloat(), outPickProbability);
+    }
+
+    outPickProbability = 1.0f / (float)lights.Size();
+    return lights[ctx.randomGenerator.GetInt() % lights.Size()];
+}
+
+float IRenderer::GetEmittingLightPickProbability(const LightSceneObject* lightObject, const RenderingContext& ctx) const
+{
+    if (ctx.params && ctx.params->lightSamplingStrategy == LightSamplingStrategy::LightBVH)
+    {
+        return mScene.GetLightBVH().PdfEmission(lightObject);
+    }
+
+    return 1.0f / (float)mScene.GetLights().Size();
+}
+
 
 // TODO use reflection
 RendererPtr CreateRenderer(const std::string& name, const Scene& scene)
@@ -11,6 +11,7 @@ namespace rt {
 class Film;
 class Scene;
 class Camera;
+class LightSceneObject;
 struct RenderingContext;
 struct RayPacket;
 
@@ -42,7 +43,8 @@ public:
     // idea: each renderer should report what passes it requires, etc.
 
     // optional rendering pre-pass, called once per frame
-    virtual void PreRender(uint32 passNumber, const Film& film);
+    // Note: 'samplesPerPixel' samples will be rendered for every pixel in this pass
+    virtual void PreRender(uint32 passNumber, const Film& film, uint32 samplesPerPixel);
 
     // optional rendering pre-pass, called once per frame for every thread
     virtual void PreRender(uint32 passNumber, RenderingContext& ctx);
@@ -59,6 +61,13 @@ public:
     virtual void Raytrace_Packet(RayPacket& packet, const Camera& camera, Film& film, RenderingContext& context) const;
 
 protected:
+    // pick a light for emitting a light path (according to light sampling strategy)
+    // returns nullptr if there are no lights on the scene
+    const LightSceneObject* PickEmittingLight(RenderingContext& ctx, float& outPickProbability) const;
+
+    // probability of picking given light with PickEmittingLight()
+    float GetEmittingLightPickProbability(const LightSceneObject* lightObject, const RenderingContext& ctx) const;
+
     const Scene& mScene;
 
 private:
@@ -51,7 +51,10 @@ static_assert(sizeof(VertexConnectionAndMerging::Photon) == 32, "Invalid photon
 
 VertexConnectionAndMerging::VertexConnectionAndMerging(const Scene& scene)
     : IRenderer(scene)
-    , mLightPathsCount(0)
+    , mLightPathsCountVC(0)
+    , mLightPathsCountVM(0)
+    , mNumIterations(0)
+    , mHasPreviousPassPhotons(false)
 {
     mBSDFSamplingWeight = Vector4(1.0f);
     mLightSamplingWeight = Vector4(1.0f);
@@ -80,44 +83,59 @@ RendererContextPtr VertexConnectionAndMerging::CreateContext() const
     return std::make_unique<VertexConnectionAndMergingContext>();
 }
 
-void VertexConnectionAndMerging::PreRender(uint32 passNumber, const Film& film)
+void VertexConnectionAndMerging::PreRender(uint32 passNumber, const Film& film, uint32 samplesPerPixel)
 {
     RT_ASSERT(mInitialMergingRadius >= mMinMergingRadius);
     RT_ASSERT(mMergingRadiusMultiplier > 0.0f);
     RT_ASSERT(mMergingRadiusMultiplier <= 1.0f);
     RT_ASSERT(mMaxPathLength > 0);
+    RT_ASSERT(samplesPerPixel > 0);
 
-    mLightPathsCount = film.GetHeight() * film.GetWidth();
+    // every rendered sample traces its own light path, all of them are merged with camera paths of the next pass
+    const uint32 lightPathsCount = film.GetHeight() * film.GetWidth() * samplesPerPixel;
 
-    if (passNumber == 0)
+    // there are no photons from a previous pass when rendering starts or is resumed (e.g. from a checkpoint)
+    // with a freshly created renderer
+    mHasPreviousPassPhotons = passNumber > 0 && mLightPathsCountVC > 0;
+
+    if (!mHasPreviousPassPhotons)
     {
-        mMergingRadiusVC = mInitialMergingRadius;
-        mMergingRadiusVM = mInitialMergingRadius;
+        // assume that all the previous passes were rendered with the same number of samples per pixel
+        mNumIterations = passNumber * samplesPerPixel;
+        mLightPathsCountVC = mLightPathsCountVM = lightPathsCount;
+
+        mMergingRadiusVC = mInitialMergingRadius * powf(mMergingRadiusMultiplier, static_cast<float>(mNumIterations));
+        mMergingRadiusVC = mMergingRadiusVM = Max(mMergingRadiusVC, mMinMergingRadius);
     }
     else
     {
-        // merging radius for vertex merging is delayed by 1 frame
+        // vertex merging is delayed by 1 frame
+        mLightPathsCountVM = mLightPathsCountVC;
+        mLightPathsCountVC = lightPathsCount;
         mMergingRadiusVM = mMergingRadiusVC;
 
-        mMergingRadiusVC *= mMergingRadiusMultiplier;
+        // radius is reduced for every sample (iteration), not for every pass
+        mMergingRadiusVC = mInitialMergingRadius * powf(mMergingRadiusMultiplier, static_cast<float>(mNumIterations));
         mMergingRadiusVC = Max(mMergingRadiusVC, mMinMergingRadius);
     }
 
+    mNumIterations += samplesPerPixel;
+
     // Factor used to normalize vertex merging contribution.
     // We divide the summed up energy by disk radius and number of light paths
-    mVertexMergingNormalizationFactor = 1.0f / (Sqr(mMergingRadiusVM) * RT_PI * mLightPathsCount);
+    mVertexMergingNormalizationFactor = 1.0f / (Sqr(mMergingRadiusVM) * RT_PI * mLightPathsCountVM);
 
     // compute MIS weights for vertex connection
     {
-        const float etaVCM = RT_PI * Sqr(mMergingRadiusVC) * mLightPathsCount;
-        // Note: we don't use merging in the first iteration
-        mMisVertexMergingWeightFactorVC = (mUseVertexMerging && passNumber > 0) ? Mis(etaVCM) : 0.0f;
+        const float etaVCM = RT_PI * Sqr(mMergingRadiusVC) * mLightPathsCountVC;
+        // Note: we don't use merging in the first pass
+        mMisVertexMergingWeightFactorVC = (mUseVertexMerging && mHasPreviousPassPhotons) ? Mis(etaVCM) : 0.0f;
         mMisVertexConnectionWeightFactorVC = mUseVertexConnection ? Mis(1.f / etaVCM) : 0.0f;
     }
 
     // set MIS weights for vertex merging (delayed by 1 iteration)
     {
-        const float etaVCM = RT_PI * Sqr(mMergingRadiusVM) * mLightPathsCount;
+        const float etaVCM = RT_PI * Sqr(mMergingRadiusVM) * mLightPathsCountVM;
         mMisVertexMergingWeightFactorVM = mUseVertexMerging ? Mis(etaVCM) : 0.0f;
         mMisVertexConnectionWeightFactorVM = mUseVertexConnection ? Mis(1.f / etaVCM) : 0.0f;
     }
@@ -207,7 +225,7 @@ const RayColor VertexConnectionAndMerging::RenderPixel(const math::Ray& ray, con
         // ray missed - return background light color
         if (hitPoint.distance == HitPoint::DefaultDistance)
         {
-            resultColor.MulAndAccumulate(pathState.throughput, EvaluateGlobalLights(param.iteration, pathState, ctx));
+            resultColor.MulAndAccumulate(pathState.throughput, EvaluateGlobalLights(pathState, ctx));
             break;
         }
 
@@ -232,7 +250,7 @@ const RayColor VertexConnectionAndMerging::RenderPixel(const math::Ray& ray, con
             const LightSceneObject* lightObject = static_cast<const LightSceneObject*>(sceneObject);
 
             const float cosAtLight = -shadingData.intersection.CosTheta(pathState.ray.dir);
-            const RayColor lightColor = EvaluateLight(param.iteration, lightObject, &shadingData.intersection, pathState, ctx);
+            const RayColor lightColor = EvaluateLight(lightObject, &shadingData.intersection, pathState, ctx);
             RT_ASSERT(lightColor.IsValid());
             resultColor.MulAndAccumulate(pathState.throughput, lightColor);
             break;
@@ -292,7 +310,7 @@ const RayColor VertexConnectionAndMerging::RenderPixel(const math::Ray& ray, con
         }
 
         // Vertex Merging - merge camera vertex to light vertices nearby
-        if (!isDeltaBsdf && mUseVertexMerging && param.iteration > 0)
+        if (!isDeltaBsdf && mUseVertexMerging && mHasPreviousPassPhotons)
         {
             RayColor vertexMergingColor = MergeVertices(pathState, shadingData, ctx);
             RT_ASSERT(vertexMergingColor.IsValid());
@@ -426,17 +444,14 @@ void VertexConnectionAndMerging::TraceLightPath(const Camera& camera, Film& film
 
 bool VertexConnectionAndMerging::GenerateLightSample(PathState& outPath, RenderingContext& ctx) const
 {
-    const auto& allLocalLights = mScene.GetLights();
-    if (allLocalLights.Empty())
+    float lightPickProbability;
+    const LightSceneObject* lightObject = PickEmittingLight(ctx, lightPickProbability);
+    if (!lightObject)
     {
         // no lights on the scene
         return false;
     }
 
-    const float lightPickProbability = 1.0f / (float)allLocalLights.Size();
-    const uint32 lightIndex = ctx.randomGenerator.GetInt() % allLocalLights.Size(); // TODO get rid of division
-
-    const LightSceneObject* lightObject = allLocalLights[lightIndex];
     const ILight& light = lightObject->GetLight();
 
     const ILight::EmitParam emitParam =
@@ -458,7 +473,7 @@ bool VertexConnectionAndMerging::GenerateLightSample(PathState& outPath, Renderi
 
     RT_ASSERT(emitResult.emissionPdfW > 0.0f);
 
-    emitResult.directPdfA *= lightPickProbability;
+    // Note: all the lights are sampled during next event estimation, so direct sampling pdf doesn't include pick probability
     emitResult.emissionPdfW *= lightPickProbability;
     
     const float emissionInvPdfW = 1.0f / emitResult.emissionPdfW;
@@ -576,7 +591,7 @@ bool VertexConnectionAndMerging::AdvancePath(PathState& path, const ShadingData&
     return true;
 }
 
-const RayColor VertexConnectionAndMerging::EvaluateLight(uint32 iteration, const LightSceneObject* lightObject, const IntersectionData* intersection, const PathState& pathState, RenderingContext& ctx) const
+const RayColor VertexConnectionAndMerging::EvaluateLight(const LightSceneObject* lightObject, const IntersectionData* intersection, const PathState& pathState, RenderingContext& ctx) const
 {
     const Matrix4 worldToLight = lightObject->GetInverseTransform(ctx.time);
     const Ray lightSpaceRay = worldToLight.TransformRay_Unsafe(pathState.ray);
@@ -606,10 +621,12 @@ const RayColor VertexConnectionAndMerging::EvaluateLight(uint32 iteration, const
     RT_ASSERT(directPdfA >= 0.0f && IsValid(directPdfA));
     RT_ASSERT(emissionPdfW >= 0.0f && IsValid(emissionPdfW));
 
+    emissionPdfW *= GetEmittingLightPickProbability(lightObject, ctx);
+
     // no weighting required for directly visible lights
     if (pathState.length > 1)
     {
-        const bool useVertexMerging = mUseVertexMerging && iteration > 0;
+        const bool useVertexMerging = mUseVertexMerging && mHasPreviousPassPhotons;
         if (useVertexMerging && !mUseVertexConnection) // special case for photon mapping
         {
             if (!pathState.lastSpecular)
@@ -690,10 +707,9 @@ const RayColor VertexConnectionAndMerging::SampleLight(const LightSceneObject* l
         }
     }
 
-    // TODO
-    //const auto& allLocalLights = mScene.GetLights();
-    //const float lightPickProbability = 1.0f / (float)allLocalLights.size();
+    // all the lights are sampled
     const float lightPickProbability = 1.0f;
+    const float emissionPdfW = illuminateResult.emissionPdfW * GetEmittingLightPickProbability(lightObject, ctx);
 
     // TODO
     const bool isDeltaLight = light.GetFlags() & ILight::Flag_IsDelta;
@@ -708,7 +724,7 @@ const RayColor VertexConnectionAndMerging::SampleLight(const LightSceneObject* l
     }
 
     const float wLight = Mis(bsdfPdfW / (lightPickProbability * illuminateResult.directPdfW));
-    const float wCamera = Mis(illuminateResult.emissionPdfW * cosToLight / (illuminateResult.directPdfW * illuminateResult.cosAtLight)) * (mMisVertexMergingWeightFactorVC + pathState.dVCM + pathState.dVC * Mis(bsdfRevPdfW));
+    const float wCamera = Mis(emissionPdfW * cosToLight / (illuminateResult.directPdfW * illuminateResult.cosAtLight)) * (mMisVertexMergingWeightFactorVC + pathState.dVCM + pathState.dVC * Mis(bsdfRevPdfW));
     const float misWeight = 1.0f / (wLight + 1.0f + wCamera);
     RT_ASSERT(misWeight >= 0.0f);
 
@@ -731,13 +747,13 @@ const RayColor VertexConnectionAndMerging::SampleLights(const ShadingData& shadi
     return accumulatedColor;
 }
 
-const RayColor VertexConnectionAndMerging::EvaluateGlobalLights(uint32 iteration, const PathState& pathState, RenderingContext& ctx) const
+const RayColor VertexConnectionAndMerging::EvaluateGlobalLights(const PathState& pathState, RenderingContext& ctx) const
 {
     RayColor result = RayColor::Zero();
 
     for (const LightSceneObject* globalLightObject : mScene.GetGlobalLights())
     {
-        result += EvaluateLight(iteration, globalLightObject, nullptr, pathState, ctx);
+        result += EvaluateLight(globalLightObject, nullptr, pathState, ctx);
     }
 
     return result;
@@ -35,7 +35,7 @@ public:
     virtual const char* GetName() const override;
     virtual RendererContextPtr CreateContext() const;
 
-    virtual void PreRender(uint32 passNumber, const Film& film) override;
+    virtual void PreRender(uint32 passNumber, const Film& film, uint32 samplesPerPixel) override;
     virtual void PreRender(uint32 passNumber, RenderingContext& ctx) override;
     virtual void PreRenderGlobal(RenderingContext& ctx) override;
     virtual void PreRenderGlobal() override;
@@ -118,10 +118,10 @@ private:
     const RayColor SampleLight(const LightSceneObject* lightObject, const ShadingData& shadingData, const PathState& pathState, RenderingContext& ctx) const;
 
     // compute radiance from a hit local lights
-    const RayColor EvaluateLight(uint32 iteration, const LightSceneObject* lightObject, const IntersectionData* intersection, const PathState& pathState, RenderingContext& ctx) const;
+    const RayColor EvaluateLight(const LightSceneObject* lightObject, const IntersectionData* intersection, const PathState& pathState, RenderingContext& ctx) const;
 
     // compute radiance from global lights
-    const RayColor EvaluateGlobalLights(uint32 iteration, const PathState& pathState, RenderingContext& ctx) const;
+    const RayColor EvaluateGlobalLights(const PathState& pathState, RenderingContext& ctx) const;
 
     // generate initial camera ray
     bool GenerateCameraPath(PathState& path, RenderingContext& ctx) const;
@@ -142,7 +142,15 @@ private:
     // connect a light path to camera directly and splat the contribution onto film
     void ConnectToCamera(const Camera& camera, Film& film, const LightVertex& lightVertex, RenderingContext& ctx) const;
 
-    uint32 mLightPathsCount;
+    // number of light paths traced in current and previous pass (vertex merging is delayed by 1 pass)
+    uint32 mLightPathsCountVC;
+    uint32 mLightPathsCountVM;
+
+    // number of samples per pixel (VCM iterations) rendered in previous passes
+    uint32 mNumIterations;
+
+    // photons traced in the previous pass are available for vertex merging
+    bool mHasPreviousPassPhotons;
 
     float mMergingRadiusVC;
     float mMergingRadiusVM;
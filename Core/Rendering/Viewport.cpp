@@ -5,12 +5,17 @@
 #include "RendererContext.h"
 #include "Utils/Logger.h"
 #include "Utils/Timer.h"
+#include "Utils/Profiler.h"
+#include "Utils/ExrWriter.h"
 #include "Scene/Camera.h"
 #include "Color/LdrColor.h"
 #include "Color/ColorHelpers.h"
 #include "Math/SamplingHelpers.h"
 #include "Math/Vector4Load.h"
 #include "Math/Transcendental.h"
+#include "Math/Vector3x8.h"
+#include "Math/VectorInt8.h"
+#include "Traversal/Traversal_Simd.h"
 
 namespace rt {
 
@@ -18,6 +23,135 @@ using namespace math;
 
 static const uint32 MAX_IMAGE_SZIE = 1 << 16;
 
+// weights of the blurred images used for bloom
+static const float BloomWeights[] = { 0.35f, 0.25f, 0.15f, 0.15f, 0.1f };
+
+// size of a block of lines captured for background HDR image export
+static const size_t HdrExportBlockSize = 16u << 20u;
+
+// don't capture more lines for background HDR image export if the writer is lagging behind
+static const size_t MaxPendingHdrExportSize = 256u << 20u;
+
+static const uint32 CheckpointMagic = 0x50435452; // "RTCP"
+static const uint32 CheckpointVersion = 1;
+
+struct CheckpointHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 width;
+    uint32 height;
+    uint32 numBlocks;
+    uint32 sumDataSize;
+};
+
+// divide each pixel of Float3 image row by number of samples accumulated in it
+RT_FORCE_INLINE static void NormalizeRow(Float3* targetRow, const Float3* sourceRow, const uint32* numSamples, uint32 width)
+{
+    for (uint32 x = 0; x < width; ++x)
+    {
+        const float scaling = 1.0f / (float)Max(1u, numSamples[x]);
+        targetRow[x] = (Vector4_Load_Float3_Unsafe(sourceRow[x]) * scaling).ToFloat3();
+    }
+}
+
+// divide each pixel of Float3 image by number of samples accumulated in it
+static void NormalizeImage(Bitmap& target, const Bitmap& source, const DynArray<uint32>& samplesPerPixel, ThreadPool& threadPool)
+{
+    const auto taskCallback = [&target, &source, &samplesPerPixel](uint32 y, uint32)
+    {
+        const uint32 width = source.GetWidth();
+        NormalizeRow(&target.GetPixelRef<Float3>(0, y), &source.GetPixelRef<Float3>(0, y), samplesPerPixel.Data() + width * y, width);
+    };
+
+    threadPool.RunParallelTask(taskCallback, target.GetHeight());
+}
+
+// downsample Float3 image by a factor of 2 (2x2 box filter)
+static void DownsampleImage(Bitmap& target, const Bitmap& source, ThreadPool& threadPool)
+{
+    const auto taskCallback = [&target, &source](uint32 y, uint32)
+    {
+        const uint32 srcY0 = Min(2 * y, source.GetHeight() - 1);
+        const uint32 srcY1 = Min(2 * y + 1, source.GetHeight() - 1);
+
+        for (uint32 x = 0; x < target.GetWidth(); ++x)
+        {
+            const uint32 srcX0 = Min(2 * x, source.GetWidth() - 1);
+            const uint32 srcX1 = Min(2 * x + 1, source.GetWidth() - 1);
+
+            Vector4 sum = Vector4_Load_Float3_Unsafe(source.GetPixelRef<Float3>(srcX0, srcY0));
+            sum += Vector4_Load_Float3_Unsafe(source.GetPixelRef<Float3>(srcX1, srcY0));
+            sum += Vector4_Load_Float3_Unsafe(source.GetPixelRef<Float3>(srcX0, srcY1));
+            sum += Vector4_Load_Float3_Unsafe(source.GetPixelRef<Float3>(srcX1, srcY1));
+
+            target.GetPixelRef<Float3>(x, y) = (sum * 0.25f).ToFloat3();
+        }
+    };
+
+    threadPool.RunParallelTask(taskCallback, target.GetHeight());
+}
+
+// target = target * targetWeight + upsampled(source) * sourceWeight
+// source image must be 2 times smaller than the target (bilinear filtering is used)
+static void AddUpsampledImage(Bitmap& target, float targetWeight, const Bitmap& source, float sourceWeight, ThreadPool& threadPool)
+{
+    const auto taskCallback = [&target, &source, targetWeight, sourceWeight](uint32 y, uint32)
+    {
+        // target pixel center mapped to the source image lies in 1/4 or 3/4 between the source pixels
+        const uint32 srcY0 = Min(static_cast<uint32>(Max(0, (static_cast<int32>(y) - 1) / 2)), source.GetHeight() - 1);
+        const uint32 srcY1 = Min((y + 1) / 2, source.GetHeight() - 1);
+        const float weightY = (y & 1) ? 0.25f : 0.75f;
+
+        const Float3* srcRow0 = &source.GetPixelRef<Float3>(0, srcY0);
+        const Float3* srcRow1 = &source.GetPixelRef<Float3>(0, srcY1);
+        Float3* targetRow = &target.GetPixelRef<Float3>(0, y);
+
+        for (uint32 x = 0; x < target.GetWidth(); ++x)
+        {
+            const uint32 srcX0 = Min(static_cast<uint32>(Max(0, (static_cast<int32>(x) - 1) / 2)), source.GetWidth() - 1);
+            const uint32 srcX1 = Min((x + 1) / 2, source.GetWidth() - 1);
+            const float weightX = (x & 1) ? 0.25f : 0.75f;
+
+            const Vector4 row0 = Vector4::Lerp(Vector4_Load_Float3_Unsafe(srcRow0[srcX0]), Vector4_Load_Float3_Unsafe(srcRow0[srcX1]), weightX);
+            const Vector4 row1 = Vector4::Lerp(Vector4_Load_Float3_Unsafe(srcRow1[srcX0]), Vector4_Load_Float3_Unsafe(srcRow1[srcX1]), weightX);
+            const Vector4 upsampled = Vector4::Lerp(row0, row1, weightY);
+
+            const Vector4 targetValue = Vector4_Load_Float3_Unsafe(targetRow[x]);
+            targetRow[x] = Vector4::MulAndAdd(upsampled, sourceWeight, targetValue * targetWeight).ToFloat3();
+        }
+    };
+
+    threadPool.RunParallelTask(taskCallback, target.GetHeight());
+}
+
+// load 8 consecutive pixels from a Float3 bitmap
+RT_FORCE_INLINE static const Vector3x8 LoadPixels_Simd8(const Bitmap& bitmap, uint32 x, uint32 y)
+{
+    const Float3* pixels = &bitmap.GetPixelRef<Float3>(x, y);
+
+    return Vector3x8(
+        Vector4_Load_Float3_Unsafe(pixels[0]), Vector4_Load_Float3_Unsafe(pixels[1]),
+        Vector4_Load_Float3_Unsafe(pixels[2]), Vector4_Load_Float3_Unsafe(pixels[3]),
+        Vector4_Load_Float3_Unsafe(pixels[4]), Vector4_Load_Float3_Unsafe(pixels[5]),
+        Vector4_Load_Float3_Unsafe(pixels[6]), Vector4_Load_Float3_Unsafe(pixels[7]));
+}
+
+// convert 8 colors to 8-bit BGR and store them as 8 consecutive pixels
+RT_FORCE_INLINE static void StorePixels_Simd8(Bitmap& bitmap, uint32 x, uint32 y, const Vector3x8& color)
+{
+    const VectorInt8 zero = VectorInt8::Zero();
+    const VectorInt8 maxValue(255);
+
+    // truncate, the same way as Vector4::ToBGR does
+    const VectorInt8 r = VectorInt8::TruncateAndConvert(color.x * 255.0f).Clamped(zero, maxValue);
+    const VectorInt8 g = VectorInt8::TruncateAndConvert(color.y * 255.0f).Clamped(zero, maxValue);
+    const VectorInt8 b = VectorInt8::TruncateAndConvert(color.z * 255.0f).Clamped(zero, maxValue);
+    const VectorInt8 bgr = (r << 16) | (g << 8) | b;
+
+    memcpy(&bitmap.GetPixelRef<uint32>(x, y), &bgr, sizeof(uint32) * 8);
+}
+
 Viewport::Viewport()
 {
     InitThreadData();
@@ -25,7 +159,13 @@ Viewport::Viewport()
     mBlurredImages.Resize(5);
 }
 
-Viewport::~Viewport() = default;
+Viewport::~Viewport()
+{
+    if (mHdrImageExport)
+    {
+        FinishHdrImageExport();
+    }
+}
 
 void Viewport::InitThreadData()
 {
@@ -62,6 +202,11 @@ bool Viewport::Resize(uint32 width, uint32 height)
         return true;
     }
 
+    if (mHdrImageExport)
+    {
+        FinishHdrImageExport();
+    }
+
     Bitmap::InitData initData;
     initData.linearSpace = true;
     initData.width = width;
@@ -78,11 +223,18 @@ bool Viewport::Resize(uint32 width, uint32 height)
         return false;
     }
 
-    for (Bitmap& blurredImage : mBlurredImages)
+    // bloom images pyramid, each level is downsampled by a factor of 2
     {
-        if (!blurredImage.Init(initData))
+        Bitmap::InitData levelInitData = initData;
+        for (Bitmap& blurredImage : mBlurredImages)
         {
-            return false;
+            if (!blurredImage.Init(levelInitData))
+            {
+                return false;
+            }
+
+            levelInitData.width = Max(1u, (levelInitData.width + 1) / 2);
+            levelInitData.height = Max(1u, (levelInitData.height + 1) / 2);
         }
     }
 
@@ -93,7 +245,7 @@ bool Viewport::Resize(uint32 width, uint32 height)
         return false;
     }
 
-    mPassesPerPixel.Resize(width * height);
+    mSamplesPerPixel.Resize(width * height);
 
     mPixelSalt.Resize(width * height);
     for (uint32 i = 0; i < width * height; ++i)
@@ -132,7 +284,7 @@ void Viewport::Reset()
         blurredImage.Clear();
     }
 
-    memset(mPassesPerPixel.Data(), 0, sizeof(uint32) * GetWidth() * GetHeight());
+    memset(mSamplesPerPixel.Data(), 0, sizeof(uint32) * GetWidth() * GetHeight());
 
     BuildInitialBlocksList();
 }
@@ -163,6 +315,283 @@ bool Viewport::SetRenderingParams(const RenderingParams& params)
     return true;
 }
 
+void Viewport::UpdateFrontBuffer()
+{
+    if (GetWidth() == 0 || GetHeight() == 0)
+    {
+        return;
+    }
+
+    mPostprocessParams.fullUpdateRequired = true;
+    PerformPostProcess();
+}
+
+bool Viewport::GetHdrImage(Bitmap& outImage)
+{
+    if (GetWidth() == 0 || GetHeight() == 0)
+    {
+        return false;
+    }
+
+    if (outImage.GetWidth() != GetWidth() || outImage.GetHeight() != GetHeight() || outImage.GetFormat() != mSum.GetFormat())
+    {
+        Bitmap::InitData initData;
+        initData.linearSpace = true;
+        initData.width = GetWidth();
+        initData.height = GetHeight();
+        initData.format = mSum.GetFormat();
+
+        if (!outImage.Init(initData))
+        {
+            return false;
+        }
+    }
+
+    NormalizeImage(outImage, mSum, mSamplesPerPixel, mThreadPool);
+    return true;
+}
+
+bool Viewport::SaveHdrImage(const char* path)
+{
+    const uint32 width = GetWidth();
+    const uint32 height = GetHeight();
+    if (width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    DynArray<Float3> line;
+    if (!line.Resize(width))
+    {
+        return false;
+    }
+
+    ExrWriter writer;
+    if (!writer.Open(path, width, height))
+    {
+        return false;
+    }
+
+    for (uint32 y = 0; y < height; ++y)
+    {
+        NormalizeRow(line.Data(), &mSum.GetPixelRef<Float3>(0, y), mSamplesPerPixel.Data() + width * y, width);
+        if (!writer.WriteLine(line.Data()))
+        {
+            return false;
+        }
+    }
+
+    return writer.Close();
+}
+
+bool Viewport::BeginHdrImageExport(const char* path)
+{
+    if (GetWidth() == 0 || GetHeight() == 0)
+    {
+        return false;
+    }
+
+    if (mHdrImageExport)
+    {
+        RT_LOG_ERROR("Viewport: HDR image export is already in progress");
+        return false;
+    }
+
+    mHdrImageExport = std::make_unique<AsyncExrWriter>();
+    if (!mHdrImageExport->Open(path, GetWidth(), GetHeight()))
+    {
+        mHdrImageExport.reset();
+        return false;
+    }
+
+    // capture the first blocks immediately, the rest is captured after the following passes
+    return ContinueHdrImageExport(false);
+}
+
+bool Viewport::FinishHdrImageExport()
+{
+    if (!mHdrImageExport)
+    {
+        return false;
+    }
+
+    return ContinueHdrImageExport(true);
+}
+
+bool Viewport::ContinueHdrImageExport(bool finish)
+{
+    RT_SCOPED_TRACE(Viewport_HdrImageExport);
+
+    AsyncExrWriter& writer = *mHdrImageExport;
+
+    const uint32 width = writer.GetWidth();
+    const uint32 height = writer.GetHeight();
+    const uint32 linesPerBlock = Max(1u, static_cast<uint32>(HdrExportBlockSize / (sizeof(Float3) * width)));
+
+    bool success = true;
+    while (success && writer.GetNumQueuedLines() < height)
+    {
+        if (!finish && writer.GetNumPendingBytes() >= MaxPendingHdrExportSize)
+        {
+            break;
+        }
+
+        const uint32 firstLine = writer.GetNumQueuedLines();
+        const uint32 numLines = Min(linesPerBlock, height - firstLine);
+
+        DynArray<Float3> pixels;
+        if (!pixels.Resize(width * numLines))
+        {
+            success = false;
+            break;
+        }
+
+        const auto taskCallback = [&](uint32 i, uint32)
+        {
+            const uint32 y = firstLine + i;
+            NormalizeRow(pixels.Data() + width * i, &mSum.GetPixelRef<Float3>(0, y), mSamplesPerPixel.Data() + width * y, width);
+        };
+        mThreadPool.RunParallelTask(taskCallback, numLines);
+
+        success = writer.PushLines(std::move(pixels));
+    }
+
+    // close the file once everything is written (or right away when finishing - it waits for the writer thread)
+    if (!success || finish || (writer.GetNumQueuedLines() == height && writer.GetNumPendingBytes() == 0))
+    {
+        success &= writer.Close();
+        mHdrImageExport.reset();
+    }
+
+    return success;
+}
+
+bool Viewport::SaveCheckpoint(const char* path) const
+{
+    if (GetWidth() == 0 || GetHeight() == 0)
+    {
+        return false;
+    }
+
+    // write to a temporary file first, so the previous checkpoint is not lost if writing fails
+    const std::string tempPath = std::string(path) + ".tmp";
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        RT_LOG_ERROR("Viewport: Failed to open checkpoint file '%s'", tempPath.c_str());
+        return false;
+    }
+
+    CheckpointHeader header;
+    header.magic = CheckpointMagic;
+    header.version = CheckpointVersion;
+    header.width = GetWidth();
+    header.height = GetHeight();
+    header.numBlocks = mBlocks.Size();
+    header.sumDataSize = static_cast<uint32>(mSum.GetDataSize());
+
+    // Note: the buffers are written directly, without any intermediate copies
+    bool success = true;
+    success &= fwrite(&header, sizeof(header), 1, file) == 1;
+    success &= fwrite(&mProgress, sizeof(mProgress), 1, file) == 1;
+    success &= fwrite(mSum.GetData(), mSum.GetDataSize(), 1, file) == 1;
+    success &= fwrite(mSecondarySum.GetData(), mSecondarySum.GetDataSize(), 1, file) == 1;
+    success &= fwrite(mSamplesPerPixel.Data(), sizeof(uint32) * mSamplesPerPixel.Size(), 1, file) == 1;
+    if (!mBlocks.Empty())
+    {
+        success &= fwrite(mBlocks.Data(), sizeof(Block) * mBlocks.Size(), 1, file) == 1;
+    }
+    success &= mHaltonSequence.SaveState(file);
+    success &= fflush(file) == 0;
+    success &= fclose(file) == 0;
+
+    if (!success)
+    {
+        RT_LOG_ERROR("Viewport: Failed to write checkpoint file '%s'", tempPath.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    // Note: rename() doesn't overwrite existing files on Windows
+    if (rename(tempPath.c_str(), path) != 0)
+    {
+        remove(path);
+        if (rename(tempPath.c_str(), path) != 0)
+        {
+            RT_LOG_ERROR("Viewport: Failed to rename checkpoint file '%s' to '%s'", tempPath.c_str(), path);
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    RT_LOG_INFO("Checkpoint '%s' saved (%u passes)", path, mProgress.passesFinished);
+    return true;
+}
+
+bool Viewport::LoadCheckpoint(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        RT_LOG_ERROR("Viewport: Failed to open checkpoint file '%s'", path);
+        return false;
+    }
+
+    CheckpointHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CheckpointMagic || header.version != CheckpointVersion)
+    {
+        RT_LOG_ERROR("Viewport: Invalid checkpoint file '%s'", path);
+        fclose(file);
+        return false;
+    }
+
+    // there is at most one block per pixel
+    if (!Resize(header.width, header.height) || header.sumDataSize != mSum.GetDataSize() || header.numBlocks > header.width * header.height)
+    {
+        RT_LOG_ERROR("Viewport: Checkpoint file '%s' does not match the viewport", path);
+        fclose(file);
+        return false;
+    }
+
+    Reset();
+
+    bool success = mBlocks.Resize(header.numBlocks);
+    success = success && fread(&mProgress, sizeof(mProgress), 1, file) == 1;
+    success = success && fread(mSum.GetData(), mSum.GetDataSize(), 1, file) == 1;
+    success = success && fread(mSecondarySum.GetData(), mSecondarySum.GetDataSize(), 1, file) == 1;
+    success = success && fread(mSamplesPerPixel.Data(), sizeof(uint32) * mSamplesPerPixel.Size(), 1, file) == 1;
+    if (!mBlocks.Empty())
+    {
+        success = success && fread(mBlocks.Data(), sizeof(Block) * mBlocks.Size(), 1, file) == 1;
+    }
+    success = success && mHaltonSequence.LoadState(file);
+    fclose(file);
+
+    if (!success)
+    {
+        RT_LOG_ERROR("Viewport: Failed to read checkpoint file '%s'", path);
+        Reset();
+        return false;
+    }
+
+    for (const Block& block : mBlocks)
+    {
+        if (block.minX >= block.maxX || block.maxX > header.width || block.minY >= block.maxY || block.maxY > header.height)
+        {
+            RT_LOG_ERROR("Viewport: Checkpoint file '%s' contains invalid block", path);
+            Reset();
+            return false;
+        }
+    }
+
+    GenerateRenderingTiles();
+    UpdateFrontBuffer();
+
+    RT_LOG_INFO("Checkpoint '%s' loaded (%u passes)", path, mProgress.passesFinished);
+    return true;
+}
+
 bool Viewport::SetPostprocessParams(const PostprocessParams& params)
 {
     if (mPostprocessParams.params != params)
@@ -178,12 +607,16 @@ bool Viewport::SetPostprocessParams(const PostprocessParams& params)
 
 void Viewport::ComputeError()
 {
+    RT_SCOPED_TRACE(Viewport_ComputeError);
+
     const Block fullImageBlock(0, GetWidth(), 0, GetHeight());
     mProgress.averageError = ComputeBlockError(fullImageBlock);
 }
 
 bool Viewport::Render(const Camera& camera)
 {
+    RT_SCOPED_TRACE(Viewport_Render);
+
     const uint32 width = GetWidth();
     const uint32 height = GetHeight();
     if (width == 0 || height == 0)
@@ -197,24 +630,43 @@ bool Viewport::Render(const Camera& camera)
         return false;
     }
 
-    mHaltonSequence.NextSample();
-    DynArray<uint32> seed(mHaltonSequence.GetNumDimensions());
-    for (uint32 i = 0; i < mHaltonSequence.GetNumDimensions(); ++i)
+    Timer timer;
+    timer.Start();
+
+    const uint32 samplesPerPixel = Max(1u, mParams.samplesPerPixel);
+    const uint32 numDimensions = mHaltonSequence.GetNumDimensions();
+
+    // sampler seed and randomized pixel offset for each sample rendered in this pass
+    mSampleSeeds.Resize(samplesPerPixel * numDimensions);
+    mSampleOffsets.Resize(samplesPerPixel);
+    for (uint32 sampleIndex = 0; sampleIndex < samplesPerPixel; ++sampleIndex)
     {
-        seed[i] = mHaltonSequence.GetInt(i);
+        mHaltonSequence.NextSample();
+        for (uint32 i = 0; i < numDimensions; ++i)
+        {
+            mSampleSeeds[sampleIndex * numDimensions + i] = mHaltonSequence.GetInt(i);
+        }
+
+        const Vector4 u = SamplingHelpers::GetFloatNormal2(mRandomGenerator.GetFloat2());
+        mSampleOffsets[sampleIndex] = u * mParams.antiAliasingSpread;
     }
 
+    const ArrayView<const uint32> firstSampleSeed(mSampleSeeds.Data(), numDimensions);
+
     for (uint32 i = 0; i < mThreadData.Size(); ++i)
     {
         RenderingContext& ctx = mThreadData[i];
         ctx.counters.Reset();
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        ctx.localCounters.enabled = mParams.enableIntersectionCounters;
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
         ctx.params = &mParams;
         ctx.camera = &camera;
 #ifndef RT_CONFIGURATION_FINAL
         ctx.pixelBreakpoint = mPendingPixelBreakpoint;
 #endif // RT_CONFIGURATION_FINAL
 
-        ctx.sampler.ResetFrame(seed, ctx.params->samplingParams.useBlueNoiseDithering);
+        ctx.sampler.ResetFrame(firstSampleSeed, ctx.params->samplingParams.useBlueNoiseDithering);
 
         mRenderer->PreRender(mProgress.passesFinished, ctx);
     }
@@ -231,24 +683,26 @@ bool Viewport::Render(const Camera& camera)
 
     // render
     {
-        // randomize pixel offset
-        const Vector4 u = SamplingHelpers::GetFloatNormal2(mRandomGenerator.GetFloat2());
-
         const TileRenderingContext tileContext =
         {
             *mRenderer,
             camera,
-            u * mThreadData[0].params->antiAliasingSpread
+            samplesPerPixel
         };
 
         {
             const Film film(mSum, mProgress.passesFinished % 2 == 0 ? &mSecondarySum : nullptr);
-            mRenderer->PreRender(mProgress.passesFinished, film);
+            mRenderer->PreRender(mProgress.passesFinished, film, samplesPerPixel);
+        }
+
+        if (mSplatQueues.Size() < mRenderingTiles.Size())
+        {
+            mSplatQueues.Resize(mRenderingTiles.Size());
         }
 
         const auto renderCallback = [&](uint32 id, uint32 threadID)
         {
-            RenderTile(tileContext, mThreadData[threadID], mRenderingTiles[id]);
+            RenderTile(tileContext, mThreadData[threadID], mRenderingTiles[id], mSplatQueues[id]);
         };
 
         for (RenderingContext& ctx : mThreadData)
@@ -259,12 +713,15 @@ bool Viewport::Render(const Camera& camera)
         mRenderer->PreRenderGlobal();
 
         mThreadPool.RunParallelTask(renderCallback, mRenderingTiles.Size());
-    }
 
-    PerformPostProcess();
+        Film film(mSum, mProgress.passesFinished % 2 == 0 ? &mSecondarySum : nullptr);
+        film.MergeSplats(ArrayView<FilmSplatQueue>(mSplatQueues.Data(), mRenderingTiles.Size()), mThreadPool);
+    }
 
     mProgress.passesFinished++;
 
+    PerformPostProcess();
+
     if ((mProgress.passesFinished > 0) && (mProgress.passesFinished % 2 == 0))
     {
         if (mParams.adaptiveSettings.enable)
@@ -284,12 +741,20 @@ bool Viewport::Render(const Camera& camera)
     {
         mCounters.Append(ctx.counters);
     }
+    mStats = mCounters.ComputeStats(timer.Stop());
+
+    if (mHdrImageExport)
+    {
+        ContinueHdrImageExport(false);
+    }
 
     return true;
 }
 
-void Viewport::RenderTile(const TileRenderingContext& tileContext, RenderingContext& ctx, const Block& tile)
+void Viewport::RenderTile(const TileRenderingContext& tileContext, RenderingContext& ctx, const Block& tile, FilmSplatQueue& splatQueue)
 {
+    RT_SCOPED_TRACE(Viewport_RenderTile);
+
     Timer timer;
 
     RT_ASSERT(tile.minX < tile.maxX);
@@ -300,154 +765,208 @@ void Viewport::RenderTile(const TileRenderingContext& tileContext, RenderingCont
     const Vector4 filmSize = Vector4::FromIntegers(GetWidth(), GetHeight(), 1, 1);
     const Vector4 invSize = VECTOR_ONE2 / filmSize;
 
-    Film film(mSum, mProgress.passesFinished % 2 == 0 ? &mSecondarySum : nullptr);
+    Film film(mSum, mProgress.passesFinished % 2 == 0 ? &mSecondarySum : nullptr, &splatQueue);
+
+    // Note: depth of field lens samples are taken from the low-discrepancy sampler only when rays are generated one by one
+    const bool batchedRayGeneration = !tileContext.camera.mDOF.enable;
+
+    const uint32 numDimensions = mHaltonSequence.GetNumDimensions();
 
-    if (ctx.params->traversalMode == TraversalMode::Single)
+    for (uint32 sampleIndex = 0; sampleIndex < tileContext.samplesPerPixel; ++sampleIndex)
     {
-        for (uint32 y = tile.minY; y < tile.maxY; ++y)
-        {
-            const uint32 realY = GetHeight() - 1u - y;
+        const Vector4 sampleOffset = mSampleOffsets[sampleIndex];
+
+        ctx.sampler.ResetFrame(ArrayView<const uint32>(mSampleSeeds.Data() + sampleIndex * numDimensions, numDimensions), ctx.params->samplingParams.useBlueNoiseDithering);
 
-            for (uint32 x = tile.minX; x < tile.maxX; ++x)
+        if (ctx.params->traversalMode == TraversalMode::Single)
+        {
+            for (uint32 y = tile.minY; y < tile.maxY; ++y)
             {
-#ifndef RT_CONFIGURATION_FINAL
-                if (ctx.pixelBreakpoint.x == x && ctx.pixelBreakpoint.y == y)
+                const uint32 realY = GetHeight() - 1u - y;
+
+                for (uint32 firstX = tile.minX; firstX < tile.maxX; firstX += 8)
                 {
-                    RT_BREAK();
-                }
+                    const uint32 numPixels = Min(8u, tile.maxX - firstX);
+
+                    // generate camera rays for up to 8 consecutive pixels at once
+                    Ray_Simd8 simdRay;
+                    if (batchedRayGeneration)
+                    {
+                        Vector2x8 coords{ Vector8::FromInteger(firstX), Vector8::FromInteger(realY) };
+                        coords.x += Vector8(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+                        coords.x += Vector8(sampleOffset.x);
+                        coords.y += Vector8(sampleOffset.y);
+                        coords.x *= invSize.x;
+                        coords.y *= invSize.y;
+
+                        simdRay = tileContext.camera.GenerateRay_Simd8(coords, ctx);
+                    }
+
+                    for (uint32 i = 0; i < numPixels; ++i)
+                    {
+                        const uint32 x = firstX + i;
+
+#ifndef RT_CONFIGURATION_FINAL
+                        if (ctx.pixelBreakpoint.x == x && ctx.pixelBreakpoint.y == y)
+                        {
+                            RT_BREAK();
+                        }
 #endif // RT_CONFIGURATION_FINAL
 
-                const uint32 pixelIndex = y * GetHeight() + x;
-                const Vector4 coords = (Vector4::FromIntegers(x, realY, 0, 0) + tileContext.sampleOffset) * invSize;
+                        const uint32 pixelIndex = y * GetHeight() + x;
 
-                ctx.sampler.ResetPixel(x, y);
-                ctx.time = ctx.randomGenerator.GetFloat() * ctx.params->motionBlurStrength;
+                        ctx.sampler.ResetPixel(x, y);
+                        ctx.time = ctx.randomGenerator.GetFloat() * ctx.params->motionBlurStrength;
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
-                ctx.wavelength.Randomize(ctx.sampler.GetFloat());
+                        ctx.wavelength.Randomize(ctx.sampler.GetFloat());
 #endif // RT_ENABLE_SPECTRAL_RENDERING
 
-                // generate primary ray
-                const Ray ray = tileContext.camera.GenerateRay(coords, ctx);
-                const IRenderer::RenderParam renderParam = { mProgress.passesFinished, pixelIndex, tileContext.camera, film };
+                        // generate primary ray
+                        Ray ray;
+                        if (batchedRayGeneration)
+                        {
+                            ray = GetRayFromLane(simdRay, i);
+                        }
+                        else
+                        {
+                            const Vector4 coords = (Vector4::FromIntegers(x, realY, 0, 0) + sampleOffset) * invSize;
+                            ray = tileContext.camera.GenerateRay(coords, ctx);
+                        }
 
-                if (ctx.params->visualizeTimePerPixel)
-                {
-                    timer.Start();
-                }
+                        const IRenderer::RenderParam renderParam = { mProgress.passesFinished, pixelIndex, tileContext.camera, film };
 
-                RayColor color = tileContext.renderer.RenderPixel(ray, renderParam, ctx);
-                RT_ASSERT(color.IsValid());
+                        if (ctx.params->visualizeTimePerPixel)
+                        {
+                            timer.Start();
+                        }
 
-                if (ctx.params->visualizeTimePerPixel)
-                {
-                    const float timePerRay = 1000.0f * static_cast<float>(timer.Stop());
-                    color = RayColor(timePerRay);
-                }
+                        RayColor color = tileContext.renderer.RenderPixel(ray, renderParam, ctx);
+                        RT_ASSERT(color.IsValid());
 
-                const Vector4 sampleColor = color.ConvertToTristimulus(ctx.wavelength);
+                        if (ctx.params->visualizeTimePerPixel)
+                        {
+                            const float timePerRay = 1000.0f * static_cast<float>(timer.Stop());
+                            color = RayColor(timePerRay);
+                        }
+
+                        const Vector4 sampleColor = color.ConvertToTristimulus(ctx.wavelength);
 
 #ifndef RT_ENABLE_SPECTRAL_RENDERING
-                // exception: in spectral rendering these values can get below zero due to RGB->Spectrum conversion
-                RT_ASSERT((sampleColor >= Vector4::Zero()).All());
+                        // exception: in spectral rendering these values can get below zero due to RGB->Spectrum conversion
+                        RT_ASSERT((sampleColor >= Vector4::Zero()).All());
 #endif // RT_ENABLE_SPECTRAL_RENDERING
 
-                film.AccumulateColor(x, y, sampleColor);
+                        film.AccumulateColor(x, y, sampleColor);
+                    }
+                }
             }
         }
-    }
-    else if (ctx.params->traversalMode == TraversalMode::Packet)
-    {
-        ctx.time = ctx.randomGenerator.GetFloat() * ctx.params->motionBlurStrength;
+        else if (ctx.params->traversalMode == TraversalMode::Packet)
+        {
+            ctx.time = ctx.randomGenerator.GetFloat() * ctx.params->motionBlurStrength;
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
-        ctx.wavelength.Randomize(ctx.sampler.GetFloat());
+            ctx.wavelength.Randomize(ctx.sampler.GetFloat());
 #endif // RT_ENABLE_SPECTRAL_RENDERING
 
-        RayPacket& primaryPacket = ctx.rayPacket;
-        primaryPacket.Clear();
+            RayPacket& primaryPacket = ctx.rayPacket;
+            primaryPacket.Clear();
 
-        // TODO multisampling
-        // TODO handle case where tile size does not fit ray group size
-        RT_ASSERT((tile.maxY - tile.minY) % 2 == 0);
-        RT_ASSERT((tile.maxX - tile.minX) % 4 == 0);
-        /*
-        for (uint32 y = tile.minY; y < tile.maxY; ++y)
-        {
-            const uint32 realY = GetHeight() - 1u - y;
+            // TODO handle case where tile size does not fit ray group size
+            RT_ASSERT((tile.maxY - tile.minY) % 2 == 0);
+            RT_ASSERT((tile.maxX - tile.minX) % 4 == 0);
+
+            constexpr uint32 rayGroupSizeX = 4;
+            constexpr uint32 rayGroupSizeY = 2;
 
-            for (uint32 x = tile.minX; x < tile.maxX; ++x)
+            for (uint32 y = tile.minY; y < tile.maxY; y += rayGroupSizeY)
             {
-                const Vector4 coords = (Vector4::FromIntegers(x, realY, 0, 0) + tileContext.sampleOffset) * invSize;
+                const uint32 realY = GetHeight() - 1u - y;
 
-                for (uint32 s = 0; s < samplesPerPixel; ++s)
+                for (uint32 x = tile.minX; x < tile.maxX; x += rayGroupSizeX)
                 {
-                    // generate primary ray
-                    const Ray ray = tileContext.camera.GenerateRay(coords, ctx);
-
-                    const ImageLocationInfo location = { (uint16)x, (uint16)y };
-                    primaryPacket.PushRay(ray, Vector4(sampleScale), location);
+                    // generate ray group with following layout:
+                    //  0 1 2 3
+                    //  4 5 6 7
+                    Vector2x8 coords{ Vector8::FromInteger(x), Vector8::FromInteger(realY) };
+                    coords.x += Vector8(0.0f, 1.0f, 2.0f, 3.0f, 0.0f, 1.0f, 2.0f, 3.0f);
+                    coords.y -= Vector8(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+                    coords.x += Vector8(sampleOffset.x);
+                    coords.y += Vector8(sampleOffset.y);
+                    coords.x *= invSize.x;
+                    coords.y *= invSize.y;
+
+                    const ImageLocationInfo locations[] =
+                    {
+                        { x + 0, y + 0 }, { x + 1, y + 0 }, { x + 2, y + 0 }, { x + 3, y + 0 },
+                        { x + 0, y + 1 }, { x + 1, y + 1 }, { x + 2, y + 1 }, { x + 3, y + 1 },
+                    };
+
+                    const Ray_Simd8 simdRay = tileContext.camera.GenerateRay_Simd8(coords, ctx);
+                    primaryPacket.PushRays(simdRay, Vector3x8(1.0f), locations);
                 }
             }
-        }
-        */
 
-        constexpr uint32 rayGroupSizeX = 4;
-        constexpr uint32 rayGroupSizeY = 2;
+            tileContext.renderer.Raytrace_Packet(primaryPacket, tileContext.camera, film, ctx);
+        }
+    }
 
-        for (uint32 y = tile.minY; y < tile.maxY; y += rayGroupSizeY)
+    // Note: tiles don't overlap, so there's no need for synchronization
+    for (uint32 y = tile.minY; y < tile.maxY; ++y)
+    {
+        uint32* samplesPerPixel = mSamplesPerPixel.Data() + GetWidth() * y;
+        for (uint32 x = tile.minX; x < tile.maxX; ++x)
         {
-            const uint32 realY = GetHeight() - 1u - y;
+            samplesPerPixel[x] += tileContext.samplesPerPixel;
+        }
+    }
 
-            for (uint32 x = tile.minX; x < tile.maxX; x += rayGroupSizeX)
-            {
-                // generate ray group with following layout:
-                //  0 1 2 3
-                //  4 5 6 7
-                Vector2x8 coords{ Vector8::FromInteger(x), Vector8::FromInteger(realY) };
-                coords.x += Vector8(0.0f, 1.0f, 2.0f, 3.0f, 0.0f, 1.0f, 2.0f, 3.0f);
-                coords.y -= Vector8(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f);
-                coords.x += Vector8(tileContext.sampleOffset.x);
-                coords.y += Vector8(tileContext.sampleOffset.y);
-                coords.x *= invSize.x;
-                coords.y *= invSize.y;
-
-                const ImageLocationInfo locations[] =
-                {
-                    { x + 0, y + 0 }, { x + 1, y + 0 }, { x + 2, y + 0 }, { x + 3, y + 0 },
-                    { x + 0, y + 1 }, { x + 1, y + 1 }, { x + 2, y + 1 }, { x + 3, y + 1 },
-                };
+    ctx.counters.numPrimaryRays += (uint64)(tile.maxY - tile.minY) * (uint64)(tile.maxX - tile.minX) * (uint64)tileContext.samplesPerPixel;
+}
 
-                const Ray_Simd8 simdRay = tileContext.camera.GenerateRay_Simd8(coords, ctx);
-                primaryPacket.PushRays(simdRay, Vector3x8(1.0f), locations);
-            }
+void Viewport::BuildBloomImage()
+{
+    RT_SCOPED_TRACE(Viewport_BuildBloomImage);
+
+    const uint32 numLevels = mBlurredImages.Size();
+
+    // blur each level of the pyramid, next level is downsampled from the previous (already blurred) one
+    // Note: the blur radius (in pixels of a given level) grows slowly, because the blur accumulates across the levels
+    float blurSigma = 2.0f;
+    for (uint32 i = 0; i < numLevels; ++i)
+    {
+        if (i == 0)
+        {
+            NormalizeImage(mBlurredImages[0], mSum, mSamplesPerPixel, mThreadPool);
         }
+        else
+        {
+            DownsampleImage(mBlurredImages[i], mBlurredImages[i - 1], mThreadPool);
+        }
+
+        mBlurredImages[i].GaussianBlur(blurSigma, 8, &mThreadPool, &mBlurScratchBuffer);
+        blurSigma *= 1.25f;
+    }
 
-        ctx.localCounters.Reset();
-        tileContext.renderer.Raytrace_Packet(primaryPacket, tileContext.camera, film, ctx);
-        ctx.counters.Append(ctx.localCounters);
+    // combine the levels from the smallest one, the final bloom image lands in the first level
+    for (uint32 i = numLevels - 1; i-- > 0; )
+    {
+        const float sourceWeight = (i + 2 == numLevels) ? BloomWeights[i + 1] : 1.0f;
+        AddUpsampledImage(mBlurredImages[i], BloomWeights[i], mBlurredImages[i + 1], sourceWeight, mThreadPool);
     }
 
-    ctx.counters.numPrimaryRays += (uint64)(tile.maxY - tile.minY) * (uint64)(tile.maxX - tile.minX);
+    if (numLevels == 1)
+    {
+        mBlurredImages[0].Scale(Vector4(BloomWeights[0]));
+    }
 }
 
 void Viewport::PerformPostProcess()
 {
+    RT_SCOPED_TRACE(Viewport_PostProcess);
+
     if (!mBlurredImages.Empty() && mPostprocessParams.params.bloomFactor > 0.0f)
     {
-        Timer timer;
-
-        float blurSigma = 2.0f;
-        for (uint32 i = 0; i < mBlurredImages.Size(); ++i)
-        {
-            Bitmap::Copy(mBlurredImages[i], i == 0 ? mSum : mBlurredImages[i - 1]);
-            mBlurredImages[i].GaussianBlur(blurSigma, 8);
-            blurSigma *= 2.5f;
-        }
-
-        float curTime = (float)timer.Stop();
-        static float minTime = FLT_MAX;
-        minTime = Min(curTime, minTime);
-
-        RT_LOG_INFO("Bluring took %.3f ms (min: %.3f ms)", curTime * 1000.0, minTime * 1000.0);
+        BuildBloomImage();
     }
 
     mPostprocessParams.colorScale = mPostprocessParams.params.colorFilter * powf(2.0f, mPostprocessParams.params.exposure);
@@ -491,62 +1010,144 @@ void Viewport::PerformPostProcess()
 
 void Viewport::PostProcessTile(const Block& block, uint32 threadID)
 {
-    Random& randomGenerator = mThreadData[threadID].randomGenerator;
+    RT_SCOPED_TRACE(Viewport_PostProcessTile);
 
-    const bool useBloom = mPostprocessParams.params.bloomFactor > 0.0f && !mBlurredImages.Empty();
-    const float bloomWeights[] = { 0.35f, 0.25f, 0.15f, 0.15f, 0.1f };
+    Random& randomGenerator = mThreadData[threadID].randomGenerator;
 
-    const float pixelScaling = 1.0f / (float)(1u + mProgress.passesFinished);
-  
     for (uint32 y = block.minY; y < block.maxY; ++y)
     {
-        for (uint32 x = block.minX; x < block.maxX; ++x)
+        uint32 x = block.minX;
+
+#ifdef RT_USE_AVX
+        if (mPostprocessParams.params.useSimd)
         {
-            const Vector4 rawValue = Vector4_Load_Float3_Unsafe(mSum.GetPixelRef<Float3>(x, y));
+            for (; x + 8 <= block.maxX; x += 8)
+            {
+                PostProcessPixels_Simd8(x, y, randomGenerator);
+            }
+        }
+#endif // RT_USE_AVX
+
+        for (; x < block.maxX; ++x)
+        {
+            PostProcessPixel(x, y, randomGenerator);
+        }
+    }
+}
+
+void Viewport::PostProcessPixel(uint32 x, uint32 y, Random& randomGenerator)
+{
+    const PostprocessParams& params = mPostprocessParams.params;
+
+    const float pixelScaling = 1.0f / (float)Max(1u, mSamplesPerPixel[GetWidth() * y + x]);
+
+    const Vector4 rawValue = Vector4_Load_Float3_Unsafe(mSum.GetPixelRef<Float3>(x, y));
 #ifdef RT_ENABLE_SPECTRAL_RENDERING
-            Vector4 rgbColor = Vector4::Max(Vector4::Zero(), ConvertXYZtoRGB(rawValue));
+    Vector4 rgbColor = Vector4::Max(Vector4::Zero(), ConvertXYZtoRGB(rawValue));
 #else
-            Vector4 rgbColor = rawValue;
+    Vector4 rgbColor = rawValue;
 #endif
 
-            // add bloom
-            if (useBloom)
-            {
-                rgbColor *= 1.0f - mPostprocessParams.params.bloomFactor;
+    // scale down by number of samples accumulated in this pixel
+    rgbColor *= pixelScaling;
 
-                Vector4 bloomColor = Vector4::Zero();
-                for (uint32 i = 0; i < mBlurredImages.Size(); ++i)
-                {
-                    const Vector4 blurredColor = Vector4_Load_Float3_Unsafe(mBlurredImages[i].GetPixelRef<Float3>(x, y));
-                    bloomColor = Vector4::MulAndAdd(blurredColor, bloomWeights[i], bloomColor);
-                }
-                rgbColor = Vector4::MulAndAdd(bloomColor, mPostprocessParams.params.bloomFactor, rgbColor);
-            }
+    // add bloom (the bloom image is already normalized)
+    if (params.bloomFactor > 0.0f && !mBlurredImages.Empty())
+    {
+        rgbColor *= 1.0f - params.bloomFactor;
+
+        const Vector4 bloomColor = Vector4_Load_Float3_Unsafe(mBlurredImages[0].GetPixelRef<Float3>(x, y));
+        rgbColor = Vector4::MulAndAdd(bloomColor, params.bloomFactor, rgbColor);
+    }
 
-            // scale down by number of rendering passes finished
-            // TODO support different number of passes per-pixel (adaptive rendering)
-            rgbColor *= pixelScaling;
+    // apply saturation
+    const float grayscale = Vector4::Dot3(rgbColor, Vector4(0.2126f, 0.7152f, 0.0722f));
+    rgbColor = Vector4::Max(Vector4::Zero(), Vector4::Lerp(Vector4(grayscale), rgbColor, params.saturation));
 
-            // apply saturation
-            const float grayscale = Vector4::Dot3(rgbColor, Vector4(0.2126f, 0.7152f, 0.0722f));
-            rgbColor = Vector4::Max(Vector4::Zero(), Vector4::Lerp(Vector4(grayscale), rgbColor, mPostprocessParams.params.saturation));
+    // apply contrast
+    rgbColor = FastExp(FastLog(rgbColor) * params.contrast);
 
-            // apply contrast
-            rgbColor = FastExp(FastLog(rgbColor) * mPostprocessParams.params.contrast);
+    // apply exposure
+    rgbColor *= mPostprocessParams.colorScale;
 
-            // apply exposure
-            rgbColor *= mPostprocessParams.colorScale;
+    // apply tonemapping
+    const Vector4 toneMapped = ToneMap(rgbColor, params.tonemapper);
 
-            // apply tonemapping
-            const Vector4 toneMapped = ToneMap(rgbColor, mPostprocessParams.params.tonemapper);
+    // add dither
+    // TODO blue noise dithering
+    const Vector4 dithered = Vector4::MulAndAdd(randomGenerator.GetVector4Bipolar(), params.ditheringStrength, toneMapped);
 
-            // add dither
-            // TODO blue noise dithering
-            const Vector4 dithered = Vector4::MulAndAdd(randomGenerator.GetVector4Bipolar(), mPostprocessParams.params.ditheringStrength, toneMapped);
+    mFrontBuffer.GetPixelRef<uint32>(x, y) = dithered.ToBGR();
+}
 
-            mFrontBuffer.GetPixelRef<uint32>(x, y) = dithered.ToBGR();
-        }
+void Viewport::PostProcessPixels_Simd8(uint32 x, uint32 y, Random& randomGenerator)
+{
+    const PostprocessParams& params = mPostprocessParams.params;
+
+    const uint32* samplesPerPixel = mSamplesPerPixel.Data() + GetWidth() * y + x;
+    const VectorInt8 numSamples = VectorInt8::Max(VectorInt8(1),
+        VectorInt8(samplesPerPixel[0], samplesPerPixel[1], samplesPerPixel[2], samplesPerPixel[3], samplesPerPixel[4], samplesPerPixel[5], samplesPerPixel[6], samplesPerPixel[7]));
+    const Vector8 pixelScaling = Vector8::Reciprocal(numSamples.ConvertToFloat());
+
+    // same pipeline as in PostProcessPixel, but with 8 pixels stored in SoA form
+    const Vector3x8 rawValue = LoadPixels_Simd8(mSum, x, y);
+#ifdef RT_ENABLE_SPECTRAL_RENDERING
+    Vector3x8 rgbColor = Vector3x8::Max(Vector3x8::Zero(), ConvertXYZtoRGB(rawValue));
+#else
+    Vector3x8 rgbColor = rawValue;
+#endif
+
+    // scale down by number of samples accumulated in each pixel
+    rgbColor *= pixelScaling;
+
+    // add bloom
+    if (params.bloomFactor > 0.0f && !mBlurredImages.Empty())
+    {
+        rgbColor *= 1.0f - params.bloomFactor;
+
+        const Vector3x8 bloomColor = LoadPixels_Simd8(mBlurredImages[0], x, y);
+        rgbColor = Vector3x8::MulAndAdd(bloomColor, Vector8(params.bloomFactor), rgbColor);
     }
+
+    // apply saturation
+    const Vector8 grayscale = Vector3x8::Dot(rgbColor, Vector3x8(Vector4(0.2126f, 0.7152f, 0.0722f)));
+    rgbColor.x = Vector8::Max(Vector8::Zero(), Vector8::Lerp(grayscale, rgbColor.x, params.saturation));
+    rgbColor.y = Vector8::Max(Vector8::Zero(), Vector8::Lerp(grayscale, rgbColor.y, params.saturation));
+    rgbColor.z = Vector8::Max(Vector8::Zero(), Vector8::Lerp(grayscale, rgbColor.z, params.saturation));
+
+    // apply contrast
+    rgbColor.x = FastExp(FastLog(rgbColor.x) * params.contrast);
+    rgbColor.y = FastExp(FastLog(rgbColor.y) * params.contrast);
+    rgbColor.z = FastExp(FastLog(rgbColor.z) * params.contrast);
+
+    // apply exposure
+    rgbColor *= Vector3x8(mPostprocessParams.colorScale);
+
+    // apply tonemapping
+    Vector3x8 toneMapped;
+    toneMapped.x = ToneMap(rgbColor.x, params.tonemapper);
+    toneMapped.y = ToneMap(rgbColor.y, params.tonemapper);
+    toneMapped.z = ToneMap(rgbColor.z, params.tonemapper);
+
+    // add dither
+    Vector3x8 dithered;
+    dithered.x = Vector8::MulAndAdd(randomGenerator.GetVector8Bipolar(), params.ditheringStrength, toneMapped.x);
+    dithered.y = Vector8::MulAndAdd(randomGenerator.GetVector8Bipolar(), params.ditheringStrength, toneMapped.y);
+    dithered.z = Vector8::MulAndAdd(randomGenerator.GetVector8Bipolar(), params.ditheringStrength, toneMapped.z);
+
+    StorePixels_Simd8(mFrontBuffer, x, y, dithered);
+}
+
+float Viewport::ComputePixelError(uint32 x, uint32 y) const
+{
+    // the secondary image contains every second pass of the pixel, so it's compared against twice the scaling
+    const uint32 numSamples = mSamplesPerPixel[GetWidth() * y + x];
+    const float imageScalingFactor = 1.0f / (float)Max(1u, numSamples);
+
+    const Vector4 a = imageScalingFactor * Vector4_Load_Float3_Unsafe(mSum.GetPixelRef<Float3>(x, y));
+    const Vector4 b = (2.0f * imageScalingFactor) * Vector4_Load_Float3_Unsafe(mSecondarySum.GetPixelRef<Float3>(x, y));
+    const Vector4 diff = Vector4::Abs(a - b);
+    return (diff.x + 2.0f * diff.y + diff.z) / Sqrt(RT_EPSILON + a.x + 2.0f * a.y + a.z);
 }
 
 float Viewport::ComputeBlockError(const Block& block) const
@@ -558,19 +1159,13 @@ float Viewport::ComputeBlockError(const Block& block) const
 
     RT_ASSERT(mProgress.passesFinished % 2 == 0, "This funcion can be only called after even number of passes");
 
-    const float imageScalingFactor = 1.0f / (float)mProgress.passesFinished;
-
     float totalError = 0.0f;
     for (uint32 y = block.minY; y < block.maxY; ++y)
     {
         float rowError = 0.0f;
         for (uint32 x = block.minX; x < block.maxX; ++x)
         {
-            const Vector4 a = imageScalingFactor * Vector4_Load_Float3_Unsafe(mSum.GetPixelRef<Float3>(x, y));
-            const Vector4 b = (2.0f * imageScalingFactor) * Vector4_Load_Float3_Unsafe(mSecondarySum.GetPixelRef<Float3>(x, y));
-            const Vector4 diff = Vector4::Abs(a - b);
-            const float error = (diff.x + 2.0f * diff.y + diff.z) / Sqrt(RT_EPSILON + a.x + 2.0f * a.y + a.z);
-            rowError += error;
+            rowError += ComputePixelError(x, y);
         }
         totalError += rowError;
     }
@@ -580,6 +1175,62 @@ float Viewport::ComputeBlockError(const Block& block) const
     return totalError * Sqrt((float)blockArea / (float)totalArea) / (float)blockArea;
 }
 
+uint32 Viewport::FindBlockSplitPoint(const Block& block, bool splitHorizontally) const
+{
+    const uint32 minCoord = splitHorizontally ? block.minX : block.minY;
+    const uint32 maxCoord = splitHorizontally ? block.maxX : block.maxY;
+    RT_ASSERT(maxCoord - minCoord > 1);
+
+    // accumulate error of each column (or row) of the block
+    DynArray<float> cumulativeError;
+    cumulativeError.Resize_SkipConstructor(maxCoord - minCoord);
+
+    float totalError = 0.0f;
+    for (uint32 i = minCoord; i < maxCoord; ++i)
+    {
+        float lineError = 0.0f;
+        if (splitHorizontally)
+        {
+            for (uint32 y = block.minY; y < block.maxY; ++y)
+            {
+                lineError += ComputePixelError(i, y);
+            }
+        }
+        else
+        {
+            for (uint32 x = block.minX; x < block.maxX; ++x)
+            {
+                lineError += ComputePixelError(x, i);
+            }
+        }
+
+        totalError += lineError;
+        cumulativeError[i - minCoord] = totalError;
+    }
+
+    // don't produce blocks much smaller than the minimum block size
+    const uint32 minChildSize = Clamp(mParams.adaptiveSettings.minBlockSize / 2u, 1u, (maxCoord - minCoord) / 2u);
+    const uint32 firstSplitPoint = minCoord + minChildSize;
+    const uint32 lastSplitPoint = maxCoord - minChildSize;
+
+    // find the first point where the error on the left (top) side reaches half of the total
+    uint32 splitPoint = (minCoord + maxCoord) / 2u;
+    if (totalError > 0.0f)
+    {
+        const float halfError = 0.5f * totalError;
+        for (uint32 i = minCoord; i < maxCoord; ++i)
+        {
+            if (cumulativeError[i - minCoord] >= halfError)
+            {
+                splitPoint = i + 1;
+                break;
+            }
+        }
+    }
+
+    return Clamp(splitPoint, firstSplitPoint, lastSplitPoint);
+}
+
 void Viewport::GenerateRenderingTiles()
 {
     mRenderingTiles.Clear();
@@ -643,6 +1294,8 @@ void Viewport::BuildInitialBlocksList()
 
 void Viewport::UpdateBlocksList()
 {
+    RT_SCOPED_TRACE(Viewport_UpdateBlocksList);
+
     DynArray<Block> newBlocks;
 
     const AdaptiveRenderingSettings& settings = mParams.adaptiveSettings;
@@ -652,72 +1305,49 @@ void Viewport::UpdateBlocksList()
         return;
     }
 
-    for (uint32 i = 0; i < mBlocks.Size(); ++i)
+    newBlocks.Reserve(mBlocks.Size());
+
+    for (const Block& block : mBlocks)
     {
-        const Block block = mBlocks[i];
         const float blockError = ComputeBlockError(block);
 
         if (blockError < settings.convergenceTreshold)
         {
             // block is fully converged - remove it
-            mBlocks[i] = mBlocks.Back();
-            mBlocks.PopBack();
             continue;
         }
 
         if ((blockError < settings.subdivisionTreshold) &&
             (block.Width() > settings.minBlockSize || block.Height() > settings.minBlockSize))
         {
-            // block is somewhat converged - split it into two parts
-
-            mBlocks[i] = mBlocks.Back();
-            mBlocks.PopBack();
-
-            Block childA, childB;
+            // block is somewhat converged - split it into two parts, so the error is equal on both sides
 
-            // TODO split the block so the error is equal on both sides
+            Block childA = block;
+            Block childB = block;
 
             if (block.Width() > block.Height())
             {
-                const uint32 halfPoint = (block.minX + block.maxX) / 2u;
-
-                childA.minX = block.minX;
-                childA.maxX = halfPoint;
-                childA.minY = block.minY;
-                childA.maxY = block.maxY;
-
-                childB.minX = halfPoint;
-                childB.maxX = block.maxX;
-                childB.minY = block.minY;
-                childB.maxY = block.maxY;
+                const uint32 splitPoint = FindBlockSplitPoint(block, true);
+                childA.maxX = splitPoint;
+                childB.minX = splitPoint;
             }
             else
             {
-                const uint32 halfPoint = (block.minY + block.maxY) / 2u;
-
-                childA.minX = block.minX;
-                childA.maxX = block.maxX;
-                childA.minY = block.minY;
-                childA.maxY = halfPoint;
-
-                childB.minX = block.minX;
-                childB.maxX = block.maxX;
-                childB.minY = halfPoint;
-                childB.maxY = block.maxY;
+                const uint32 splitPoint = FindBlockSplitPoint(block, false);
+                childA.maxY = splitPoint;
+                childB.minY = splitPoint;
             }
 
             newBlocks.PushBack(childA);
             newBlocks.PushBack(childB);
+            continue;
         }
-    }
 
-    // add splitted blocks to the list
-    mBlocks.Reserve(mBlocks.Size() + newBlocks.Size());
-    for (const Block& block : newBlocks)
-    {
-        mBlocks.PushBack(block);
+        newBlocks.PushBack(block);
     }
 
+    mBlocks = std::move(newBlocks);
+
     // calculate number of active pixels
     {
         mProgress.activePixels = 0;
@@ -5,6 +5,7 @@
 #include "Context.h"
 #include "Counters.h"
 #include "PostProcess.h"
+#include "Film.h"
 
 #include "../Math/Random.h"
 #include "../Sampling/HaltonSampler.h"
@@ -19,6 +20,7 @@ namespace rt {
 
 class IRenderer;
 class Camera;
+class AsyncExrWriter;
 
 using RendererPtr = std::shared_ptr<IRenderer>;
 
@@ -46,14 +48,43 @@ public:
 
     RAYLIB_API void SetPixelBreakpoint(uint32 x, uint32 y);
 
+    // regenerate the whole front buffer from the sum buffer (without rendering new samples)
+    RAYLIB_API void UpdateFrontBuffer();
+
     RT_FORCE_INLINE const Bitmap& GetFrontBuffer() const { return mFrontBuffer; }
     RT_FORCE_INLINE const Bitmap& GetSumBuffer() const { return mSum; }
 
+    // get HDR image (sum buffer divided by number of samples accumulated in each pixel)
+    RAYLIB_API bool GetHdrImage(Bitmap& outImage);
+
+    // write HDR image to an EXR file line by line, without creating a copy of the whole image
+    RAYLIB_API bool SaveHdrImage(const char* path);
+
+    // start writing HDR image to an EXR file on a background thread
+    // Note: the lines are captured in blocks after subsequent passes, so the rendering is not blocked by the file writing
+    RAYLIB_API bool BeginHdrImageExport(const char* path);
+
+    // capture all the remaining lines and wait for the background writer
+    RAYLIB_API bool FinishHdrImageExport();
+
+    RT_FORCE_INLINE bool IsHdrImageExportInProgress() const { return mHdrImageExport != nullptr; }
+
+    // save accumulated samples and rendering progress, so the rendering can be resumed later
+    RAYLIB_API bool SaveCheckpoint(const char* path) const;
+
+    // restore rendering state saved with SaveCheckpoint (the viewport is resized if needed)
+    RAYLIB_API bool LoadCheckpoint(const char* path);
+
     RT_FORCE_INLINE uint32 GetWidth() const { return mSum.GetWidth(); }
     RT_FORCE_INLINE uint32 GetHeight() const { return mSum.GetHeight(); }
 
     RT_FORCE_INLINE const RenderingProgress& GetProgress() const { return mProgress; }
+    // counters and derived statistics of the last rendering pass
     RT_FORCE_INLINE const RayTracingCounters& GetCounters() const { return mCounters; }
+    RT_FORCE_INLINE const RayTracingStats& GetStats() const { return mStats; }
+
+    // number of samples accumulated in each pixel (row-major order)
+    RT_FORCE_INLINE const DynArray<uint32>& GetSamplesPerPixel() const { return mSamplesPerPixel; }
 
     RAYLIB_API void VisualizeActiveBlocks(Bitmap& bitmap) const;
 
@@ -67,7 +98,7 @@ private:
     {
         const IRenderer& renderer;
         const Camera& camera;
-        const math::Vector4 sampleOffset;
+        const uint32 samplesPerPixel;
     };
 
     struct RT_ALIGN(16) PostprocessParamsInternal
@@ -80,25 +111,43 @@ private:
 
     void BuildInitialBlocksList();
 
+    // capture next blocks of lines for the pending HDR image export
+    bool ContinueHdrImageExport(bool finish);
+
     // compute average error (variance) in the image
     void ComputeError();
 
+    // calculate estimated error (variance) of a single pixel
+    float ComputePixelError(uint32 x, uint32 y) const;
+
     // calculate estimated error (variance) of a given block
     float ComputeBlockError(const Block& block) const;
 
+    // find split coordinate of a block (along X or Y axis), so the error is equal on both sides
+    uint32 FindBlockSplitPoint(const Block& block, bool splitHorizontally) const;
+
     // generate list of tiles to be rendered (updates mRenderingTiles)
     void GenerateRenderingTiles();
 
     void UpdateBlocksList();
 
     // raytrace single image tile (will be called from multiple threads)
-    void RenderTile(const TileRenderingContext& tileContext, RenderingContext& renderingContext, const Block& tile);
+    void RenderTile(const TileRenderingContext& tileContext, RenderingContext& renderingContext, const Block& tile, FilmSplatQueue& splatQueue);
+
+    // blur the sum image at multiple resolutions and combine the results into the first blurred image
+    void BuildBloomImage();
 
     void PerformPostProcess();
 
     // generate "front buffer" image from "sum" image
     void PostProcessTile(const Block& tile, uint32 threadID);
 
+    // post process single pixel
+    void PostProcessPixel(uint32 x, uint32 y, math::Random& randomGenerator);
+
+    // post process 8 consecutive pixels in a row at once
+    void PostProcessPixels_Simd8(uint32 x, uint32 y, math::Random& randomGenerator);
+
     ThreadPool mThreadPool;
 
     RendererPtr mRenderer;
@@ -112,19 +161,26 @@ private:
     Bitmap mSum;                        // image with accumulated samples (floating point, high dynamic range)
     Bitmap mSecondarySum;               // contains image with every second sample - required for adaptive rendering
     Bitmap mFrontBuffer;                // postprocesses image (low dynamic range)
-    DynArray<Bitmap> mBlurredImages;    // blurred images for bloom
-    DynArray<uint32> mPassesPerPixel;
+    DynArray<Bitmap> mBlurredImages;    // blurred images for bloom (each level has half the resolution of the previous one)
+    DynArray<math::Vector8> mBlurScratchBuffer; // temporary memory for blurring the bloom images (reused across frames)
+    DynArray<uint32> mSamplesPerPixel;  // number of samples accumulated in each pixel of the sum image
     DynArray<math::Float2> mPixelSalt; // salt value for each pixel
+    DynArray<uint32> mSampleSeeds;      // low-discrepancy sampler seeds for each sample of the current pass
+    DynArray<math::Vector4> mSampleOffsets; // pixel offsets (anti-aliasing) for each sample of the current pass
 
     RenderingParams mParams;
     PostprocessParamsInternal mPostprocessParams;
 
     RayTracingCounters mCounters;
+    RayTracingStats mStats;
 
     RenderingProgress mProgress;
 
     DynArray<Block> mBlocks;
     DynArray<Block> mRenderingTiles;
+    DynArray<FilmSplatQueue> mSplatQueues; // per-tile splats (merged into the film after each pass)
+
+    std::unique_ptr<AsyncExrWriter> mHdrImageExport;
 
 #ifndef RT_CONFIGURATION_FINAL
     PixelBreakpoint mPendingPixelBreakpoint;
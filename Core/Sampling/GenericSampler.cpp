@@ -66,9 +66,17 @@ GenericSampler::GenericSampler()
 {
 }
 
-void GenericSampler::ResetFrame(const DynArray<uint32>& seed, bool useBlueNoise)
+void GenericSampler::ResetFrame(const ArrayView<const uint32> seed, bool useBlueNoise)
 {
-    mCurrentSample = seed;
+    // Note: called for every sample of every tile, so the memory is reused
+    if (mCurrentSample.Size() != seed.Size())
+    {
+        mCurrentSample.Resize(seed.Size());
+    }
+    if (!seed.Empty())
+    {
+        memcpy(mCurrentSample.Data(), seed.Data(), sizeof(uint32) * seed.Size());
+    }
     mBlueNoiseTextureLayers = mBlueNoiseTexture && useBlueNoise ? BlueNoise::TextureLayers : 0;
 }
 
@@ -80,6 +88,24 @@ void GenericSampler::ResetPixel(const uint32 x, const uint32 y)
     mSamplesGenerated = 0;
 }
 
+const GenericSampler::PixelState GenericSampler::SavePixelState() const
+{
+    PixelState state;
+    state.blueNoisePixelX = static_cast<uint16>(mBlueNoisePixelX);
+    state.blueNoisePixelY = static_cast<uint16>(mBlueNoisePixelY);
+    state.salt = mSalt;
+    state.samplesGenerated = mSamplesGenerated;
+    return state;
+}
+
+void GenericSampler::RestorePixelState(const PixelState& state)
+{
+    mBlueNoisePixelX = state.blueNoisePixelX;
+    mBlueNoisePixelY = state.blueNoisePixelY;
+    mSalt = state.salt;
+    mSamplesGenerated = state.samplesGenerated;
+}
+
 uint32 GenericSampler::GetInt()
 {
     uint32 sample;
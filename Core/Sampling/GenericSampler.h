@@ -13,15 +13,29 @@ class Random;
 class GenericSampler
 {
 public:
+    // per-pixel sampling state
+    // allows for interleaved sampling of multiple pixels (e.g. in wavefront rendering)
+    struct PixelState
+    {
+        uint16 blueNoisePixelX;
+        uint16 blueNoisePixelY;
+        uint32 salt;
+        uint32 samplesGenerated;
+    };
+
     GenericSampler();
     ~GenericSampler() = default;
 
     // move to next frame
-    void ResetFrame(const DynArray<uint32>& sample, bool useBlueNoise);
+    void ResetFrame(const ArrayView<const uint32> sample, bool useBlueNoise);
 
     // move to next pixel
     void ResetPixel(const uint32 x, const uint32 y);
 
+    // save/restore sampling state of current pixel
+    const PixelState SavePixelState() const;
+    void RestorePixelState(const PixelState& state);
+
     // get next sample
     // NOTE: effectively goes to next sample dimension
     uint32 GetInt();
@@ -105,6 +105,42 @@ void HaltonSequence::NextSample()
     }
 }
 
+bool HaltonSequence::SaveState(FILE* file) const
+{
+    bool success = fwrite(&mDimensions, sizeof(mDimensions), 1, file) == 1;
+
+    for (uint32 i = 0; i < mDimensions && success; i++)
+    {
+        success &= fwrite(ppm[i], sizeof(uint64), mBase[i], file) == mBase[i];
+        success &= fwrite(digit[i].Data(), sizeof(uint64), Width, file) == Width;
+        success &= fwrite(rnd[i].Data(), sizeof(double), Width, file) == Width;
+    }
+
+    return success;
+}
+
+bool HaltonSequence::LoadState(FILE* file)
+{
+    uint32 dimensions = 0;
+    if (fread(&dimensions, sizeof(dimensions), 1, file) != 1 || dimensions > MaxDimensions)
+    {
+        return false;
+    }
+
+    // bases and power buffers are not stored, they only depend on the number of dimensions
+    Initialize(dimensions);
+
+    bool success = true;
+    for (uint32 i = 0; i < mDimensions && success; i++)
+    {
+        success &= fread(ppm[i], sizeof(uint64), mBase[i], file) == mBase[i];
+        success &= fread(digit[i].Data(), sizeof(uint64), Width, file) == Width;
+        success &= fread(rnd[i].Data(), sizeof(double), Width, file) == Width;
+    }
+
+    return success;
+}
+
 uint64 HaltonSequence::Permute(uint32 i, uint8 j)
 {
     return *(*(ppm + i) + digit[i][j]);
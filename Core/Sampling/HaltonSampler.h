@@ -22,6 +22,10 @@ public:
 
     RAYLIB_API void NextSample();
 
+    // write/read state of the sequence (randomization and current position), so it can be continued later
+    RAYLIB_API bool SaveState(FILE* file) const;
+    RAYLIB_API bool LoadState(FILE* file);
+
     RT_FORCE_INLINE double GetDouble(uint32 dimension) { return rnd[dimension][0]; }
     RT_FORCE_INLINE uint32 GetInt(uint32 dimension) { return uint32(rnd[dimension][0] * (double)UINT32_MAX); }
 
@@ -186,4 +186,14 @@ ILight::Flags AreaLight::GetFlags() const
     return Flag_IsFinite;
 }
 
+const ILight::EmissionBounds AreaLight::GetEmissionBounds() const
+{
+    // one-sided lambertian emitter
+    EmissionBounds bounds;
+    bounds.power = RT_PI * mShape->GetSurfaceArea() * GetColorLuminance();
+    bounds.cosThetaE = 0.0f;
+    mShape->GetNormalCone(bounds.axis, bounds.cosThetaO);
+    return bounds;
+}
+
 } // namespace rt
@@ -7,6 +7,7 @@
 #include "../../Math/Geometry.h"
 #include "../../Math/SamplingHelpers.h"
 #include "../Camera.h"
+#include "../../Utils/Logger.h"
 
 namespace rt {
 
@@ -60,14 +61,90 @@ const RayColor BackgroundLight::GetBackgroundColor(const Vector4& dir, const Wav
     return RayColor::Resolve(wavelength, color);
 }
 
+bool BackgroundLight::MakeSamplable(bool useAliasTables, ThreadPool* threadPool)
+{
+    mIsImportanceSampled = false;
+
+    if (!mTexture)
+    {
+        // uniform background, nothing to do
+        return true;
+    }
+
+    TextureSamplingDesc desc;
+    desc.latLongMapping = true;
+    desc.useAliasTables = useAliasTables;
+    desc.coverFilteredTexels = true;
+    desc.threadPool = threadPool;
+
+    if (!mTexture->MakeSamplable(desc))
+    {
+        RT_LOG_WARNING("BackgroundLight: Failed to make texture '%s' samplable, falling back to uniform sampling", mTexture->GetName());
+        return false;
+    }
+
+    mIsImportanceSampled = true;
+    return true;
+}
+
+const Vector4 BackgroundLight::SampleTexture(const Float2 u, Vector4& outDirection, float& outPdfW) const
+{
+    Vector4 coords;
+    float pdf = 0.0f;
+    const Vector4 textureColor = mTexture->Sample(u, coords, &pdf);
+
+    // inverse of CartesianToSphericalCoordinates()
+    const float theta = coords.y * RT_PI;
+    const float phi = (coords.x - 0.5f) * (2.0f * RT_PI);
+    const float sinTheta = Sin(theta);
+    outDirection = Vector4(sinTheta * Cos(phi), Cos(theta), sinTheta * Sin(phi));
+
+    // convert pdf from lat-long map area to solid angle
+    outPdfW = sinTheta > 0.0f ? pdf / (2.0f * RT_PI * RT_PI * sinTheta) : 0.0f;
+
+    return Vector4::Max(Vector4::Zero(), textureColor);
+}
+
+float BackgroundLight::GetTexturePdfW(const Vector4& dir) const
+{
+    const float sinTheta = sqrtf(Max(0.0f, 1.0f - dir.y * dir.y));
+    if (sinTheta <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    const Vector4 coords = CartesianToSphericalCoordinates(dir);
+    return mTexture->Pdf(coords) / (2.0f * RT_PI * RT_PI * sinTheta);
+}
+
 const RayColor BackgroundLight::Illuminate(const IlluminateParam& param, IlluminateResult& outResult) const
 {
+    outResult.distance = BackgroundLightDistance;
+    outResult.cosAtLight = 1.0f;
+
+    if (mIsImportanceSampled)
+    {
+        float pdfW;
+        const Vector4 textureColor = SampleTexture(param.sample, outResult.directionToLight, pdfW);
+        outResult.directPdfW = pdfW;
+        outResult.emissionPdfW = pdfW * UniformCirclePdf(SceneRadius);
+
+        if (pdfW <= 0.0f)
+        {
+            return RayColor::Zero();
+        }
+
+        Spectrum color = GetColor();
+        color.rgbValues *= textureColor;
+
+        // TODO include light rotation
+        return RayColor::Resolve(param.wavelength, color);
+    }
+
     const Vector4 randomDirLocalSpace = SamplingHelpers::GetHemishpere(param.sample);
     outResult.directionToLight = param.intersection.LocalToWorld(randomDirLocalSpace);
     outResult.directPdfW = UniformHemispherePdf();
     outResult.emissionPdfW = UniformSpherePdf() * UniformCirclePdf(SceneRadius);
-    outResult.distance = BackgroundLightDistance;
-    outResult.cosAtLight = 1.0f;
 
     // TODO include light rotation
     return GetBackgroundColor(outResult.directionToLight, param.wavelength);
@@ -75,14 +152,16 @@ const RayColor BackgroundLight::Illuminate(const IlluminateParam& param, Illumin
 
 const RayColor BackgroundLight::GetRadiance(const RadianceParam& param, float* outDirectPdfA, float* outEmissionPdfW) const
 {
+    const float directionPdf = mIsImportanceSampled ? GetTexturePdfW(param.ray.dir) : UniformHemispherePdf();
+
     if (outDirectPdfA)
     {
-        *outDirectPdfA = UniformHemispherePdf();
+        *outDirectPdfA = directionPdf;
     }
 
     if (outEmissionPdfW)
     {
-        *outEmissionPdfW = UniformSpherePdf() * UniformCirclePdf(SceneRadius);
+        *outEmissionPdfW = (mIsImportanceSampled ? directionPdf : UniformSpherePdf()) * UniformCirclePdf(SceneRadius);
     }
 
     // TODO include light rotation
@@ -91,9 +170,30 @@ const RayColor BackgroundLight::GetRadiance(const RadianceParam& param, float* o
 
 const RayColor BackgroundLight::Emit(const EmitParam& param, EmitResult& outResult) const
 {
-    // generate random direction on sphere
-    // TODO texture importance sampling
-    outResult.direction = SamplingHelpers::GetSphere(param.directionSample);
+    Spectrum color = GetColor();
+
+    if (mIsImportanceSampled)
+    {
+        // light travels in the opposite direction
+        float pdfW;
+        Vector4 dirToLight;
+        color.rgbValues *= SampleTexture(param.directionSample, dirToLight, pdfW);
+        outResult.direction = -dirToLight;
+        outResult.directPdfA = pdfW;
+        outResult.emissionPdfW = pdfW * UniformCirclePdf(SceneRadius);
+
+        if (pdfW <= 0.0f)
+        {
+            color.rgbValues = Vector4::Zero();
+        }
+    }
+    else
+    {
+        // generate random direction on sphere
+        outResult.direction = SamplingHelpers::GetSphere(param.directionSample);
+        outResult.directPdfA = UniformHemispherePdf();
+        outResult.emissionPdfW = UniformSpherePdf() * UniformCirclePdf(SceneRadius);
+    }
 
     // generate random origin
     const Vector4 uv = SamplingHelpers::GetCircle(param.positionSample);
@@ -104,10 +204,14 @@ const RayColor BackgroundLight::Emit(const EmitParam& param, EmitResult& outResu
         outResult.position = SceneRadius * (u * uv.x + v * uv.y - outResult.direction);
     }
 
-    outResult.directPdfA = UniformHemispherePdf();
-    outResult.emissionPdfW = UniformSpherePdf() * UniformCirclePdf(SceneRadius);
     outResult.cosAtLight = 1.0f;
 
+    if (mIsImportanceSampled)
+    {
+        // TODO include light rotation
+        return RayColor::Resolve(param.wavelength, color);
+    }
+
     // TODO include light rotation
     return GetBackgroundColor(-outResult.direction, param.wavelength);
 }
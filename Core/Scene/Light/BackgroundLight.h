@@ -5,6 +5,7 @@
 namespace rt {
 
 class ITexture;
+class ThreadPool;
 using TexturePtr = std::shared_ptr<ITexture>;
 
 class BackgroundLight : public ILight
@@ -24,6 +25,19 @@ public:
     virtual Flags GetFlags() const override final;
 
     const RayColor GetBackgroundColor(const math::Vector4& dir, const Wavelength& wavelength) const;
+
+    // build importance map of the background texture, so the light is sampled proportionally to radiance
+    // must be called after setting the texture and before rendering, otherwise directions are sampled uniformly
+    RAYLIB_API bool MakeSamplable(bool useAliasTables = false, ThreadPool* threadPool = nullptr);
+
+private:
+    // sample direction using the texture importance map, returns the texture color
+    const math::Vector4 SampleTexture(const math::Float2 u, math::Vector4& outDirection, float& outPdfW) const;
+
+    // solid angle pdf of sampling given direction with SampleTexture()
+    float GetTexturePdfW(const math::Vector4& dir) const;
+
+    bool mIsImportanceSampled = false;
 };
 
 } // namespace rt
@@ -26,4 +26,14 @@ const RayColor ILight::GetRadiance(const RadianceParam&, float*, float*) const
     return RayColor();
 }
 
+const ILight::EmissionBounds ILight::GetEmissionBounds() const
+{
+    return EmissionBounds();
+}
+
+float ILight::GetColorLuminance() const
+{
+    return Vector4::Dot3(mColor.rgbValues, Vector4(0.2126f, 0.7152f, 0.0722f));
+}
+
 } // namespace rt
@@ -68,6 +68,15 @@ public:
         float cosAtLight = -1.0f;
     };
 
+    // bounds of the emitted light in local space, used for importance sampling of many lights
+    struct EmissionBounds
+    {
+        math::Vector4 axis = math::VECTOR_Z;    // axis of the cone bounding surface normals
+        float power = 0.0f;                     // total emitted power
+        float cosThetaO = -1.0f;                // cosine of the normals cone spread angle
+        float cosThetaE = 0.0f;                 // cosine of the emission angle around a normal
+    };
+
     struct EmitParam
     {
         const math::Matrix4 lightToWorld; // transform from light local space to world space
@@ -114,6 +123,14 @@ public:
     // Get light flags.
     virtual Flags GetFlags() const = 0;
 
+    // Get bounds of the emitted light (only finite lights are bounded)
+    // Note: default implementation returns zero power
+    virtual const EmissionBounds GetEmissionBounds() const;
+
+protected:
+    // luminance of the light color
+    float GetColorLuminance() const;
+
 private:
     // light object cannot be copied
     ILight(const ILight&) = delete;
@@ -66,4 +66,12 @@ ILight::Flags PointLight::GetFlags() const
     return Flags(Flag_IsFinite | Flag_IsDelta);
 }
 
+const ILight::EmissionBounds PointLight::GetEmissionBounds() const
+{
+    // emits uniformly in all directions
+    EmissionBounds bounds;
+    bounds.power = 4.0f * RT_PI * GetColorLuminance();
+    return bounds;
+}
+
 } // namespace rt
@@ -49,7 +49,7 @@ const RayColor SpotLight::Illuminate(const IlluminateParam& param, IlluminateRes
     outResult.cosAtLight = 1.0f;
     outResult.emissionPdfW = mIsDelta ? 1.0f : SphereCapPdf(mCosAngle);
 
-    const float angle = Vector4::Dot3(outResult.directionToLight, -VECTOR_Z);
+    const float angle = Vector4::Dot3(param.worldToLight.TransformVector(outResult.directionToLight), -VECTOR_Z);
     
     if (angle < mCosAngle)
     {
@@ -84,6 +84,7 @@ const RayColor SpotLight::Emit(const EmitParam& param, EmitResult& outResult) co
         outResult.emissionPdfW = SphereCapPdf(mCosAngle);
     }
 
+    outResult.direction = param.lightToWorld.TransformVector(outResult.direction);
     outResult.position = param.lightToWorld.GetTranslation();
     outResult.directPdfA = 1.0f;
     outResult.cosAtLight = 1.0f;
@@ -97,4 +98,16 @@ ILight::Flags SpotLight::GetFlags() const
     return mIsDelta ? Flags(Flag_IsFinite | Flag_IsDelta) : Flag_IsFinite;
 }
 
+const ILight::EmissionBounds SpotLight::GetEmissionBounds() const
+{
+    // emits in a cone around local Z axis
+    // Note: power is never zero, so the 'laser' light can be still picked
+    EmissionBounds bounds;
+    bounds.axis = VECTOR_Z;
+    bounds.power = RT_2PI * Max(1.0f - mCosAngle, 1.0e-6f) * GetColorLuminance();
+    bounds.cosThetaO = 1.0f;
+    bounds.cosThetaE = Min(mCosAngle, CosEpsilon);
+    return bounds;
+}
+
 } // namespace rt
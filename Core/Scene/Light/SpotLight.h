@@ -15,6 +15,7 @@ public:
     virtual const RayColor Illuminate(const IlluminateParam& param, IlluminateResult& outResult) const override;
     virtual const RayColor Emit(const EmitParam& param, EmitResult& outResult) const override;
     virtual Flags GetFlags() const override final;
+    virtual const EmissionBounds GetEmissionBounds() const override;
 
 private:
     float mAngle;
@@ -0,0 +1,522 @@
+#include "PCH.h"
+#include "LightBVH.h"
+#include "Light/Light.h"
+#include "Object/SceneObject_Light.h"
+#include "Utils/Logger.h"
+#include "Utils/Timer.h"
+
+namespace rt {
+
+using namespace math;
+
+namespace {
+
+static constexpr uint32 NumBuckets = 12;
+
+// cos(a - b), clamped to 1 if a < b
+RT_FORCE_INLINE float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    return cosA > cosB ? 1.0f : (cosA * cosB + sinA * sinB);
+}
+
+// sin(a - b), clamped to 0 if a < b
+RT_FORCE_INLINE float SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    return cosA > cosB ? 0.0f : (sinA * cosB - cosA * sinB);
+}
+
+RT_FORCE_INLINE float SafeSqrt(float x)
+{
+    return sqrtf(Max(0.0f, x));
+}
+
+RT_FORCE_INLINE float SafeACos(float x)
+{
+    return acosf(Clamp(x, -1.0f, 1.0f));
+}
+
+// orientation cost term of the surface area orientation heuristic (SAOH)
+float OrientationMeasure(const LightBVH::Bounds& bounds)
+{
+    const float thetaO = SafeACos(bounds.cosThetaO);
+    const float thetaE = SafeACos(bounds.cosThetaE);
+    const float thetaW = Min(thetaO + thetaE, RT_PI);
+    const float sinThetaO = SafeSqrt(1.0f - Sqr(bounds.cosThetaO));
+
+    return RT_2PI * (1.0f - bounds.cosThetaO) +
+        0.5f * RT_PI * (2.0f * thetaW * sinThetaO - cosf(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + bounds.cosThetaO);
+}
+
+float SplitCost(const LightBVH::Bounds& bounds, const float regularization)
+{
+    if (bounds.power <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    return bounds.power * OrientationMeasure(bounds) * regularization * Max(bounds.box.SurfaceArea(), FLT_MIN);
+}
+
+LightBVH::Bounds GetLightBounds(const LightSceneObject* lightObject)
+{
+    const ILight::EmissionBounds emissionBounds = lightObject->GetLight().GetEmissionBounds();
+    const ISceneObject* sceneObject = lightObject;
+
+    LightBVH::Bounds bounds;
+    bounds.box = sceneObject->GetBoundingBox();
+    bounds.axis = lightObject->GetBaseTransform().TransformVector(emissionBounds.axis).Normalized3();
+    bounds.power = emissionBounds.power;
+    bounds.cosThetaO = emissionBounds.cosThetaO;
+    bounds.cosThetaE = emissionBounds.cosThetaE;
+    return bounds;
+}
+
+} // namespace
+
+float LightBVH::Bounds::Importance(const Vector4& position, const Vector4& normal) const
+{
+    const Vector4 center = box.GetCenter();
+    const Vector4 toPoint = position - center;
+
+    // Note: distance is clamped (to the bounding sphere radius) only in the falloff term,
+    // so the importance doesn't explode for points inside the bounds
+    const float sqrDistance = Max(toPoint.SqrLength3(), 0.25f * (box.max - box.min).SqrLength3(), FLT_EPSILON);
+    const Vector4 dir = toPoint.SqrLength3() > 0.0f ? toPoint.Normalized3() : axis;
+
+    // angle between the cone axis and the direction to the point
+    const float cosThetaW = Vector4::Dot3(axis, dir);
+    const float sinThetaW = SafeSqrt(1.0f - Sqr(cosThetaW));
+
+    // angle subtended by the bounds (bounding sphere) as seen from the point
+    float cosThetaB = -1.0f;
+    if (!box.Intersects(position))
+    {
+        const float sqrRadius = 0.25f * (box.max - box.min).SqrLength3();
+        const float sinSqrThetaB = sqrRadius / toPoint.SqrLength3();
+        if (sinSqrThetaB < 1.0f)
+        {
+            cosThetaB = SafeSqrt(1.0f - sinSqrThetaB);
+        }
+    }
+    const float sinThetaB = SafeSqrt(1.0f - Sqr(cosThetaB));
+
+    // minimum angle between emission direction and the direction to the point: max(0, thetaW - thetaO - thetaB)
+    const float sinThetaO = SafeSqrt(1.0f - Sqr(cosThetaO));
+    const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= cosThetaE)
+    {
+        return 0.0f;
+    }
+
+    float importance = power * cosThetaP / sqrDistance;
+
+    // account for incident angle at the shading point (two-sided, because of transmissive materials)
+    if (normal.SqrLength3() > 0.0f)
+    {
+        const float cosThetaI = Abs(Vector4::Dot3(dir, normal));
+        const float sinThetaI = SafeSqrt(1.0f - Sqr(cosThetaI));
+        importance *= CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return Max(importance, 0.0f);
+}
+
+const LightBVH::Bounds LightBVH::Bounds::Union(const Bounds& a, const Bounds& b)
+{
+    if (a.power <= 0.0f)
+    {
+        return b;
+    }
+    if (b.power <= 0.0f)
+    {
+        return a;
+    }
+
+    Bounds result;
+    result.box = Box(a.box, b.box);
+    result.power = a.power + b.power;
+    result.cosThetaE = Min(a.cosThetaE, b.cosThetaE);
+
+    // merge normal cones
+    const float thetaA = SafeACos(a.cosThetaO);
+    const float thetaB = SafeACos(b.cosThetaO);
+    const float thetaD = SafeACos(Vector4::Dot3(a.axis, b.axis));
+
+    if (Min(thetaD + thetaB, RT_PI) <= thetaA)
+    {
+        result.axis = a.axis;
+        result.cosThetaO = a.cosThetaO;
+    }
+    else if (Min(thetaD + thetaA, RT_PI) <= thetaB)
+    {
+        result.axis = b.axis;
+        result.cosThetaO = b.cosThetaO;
+    }
+    else
+    {
+        const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+        const Vector4 rotationAxis = Vector4::Cross3(a.axis, b.axis);
+        if (thetaO >= RT_PI || rotationAxis.SqrLength3() < Sqr(FLT_EPSILON))
+        {
+            // whole sphere
+            result.axis = a.axis;
+            result.cosThetaO = -1.0f;
+        }
+        else
+        {
+            // rotate the first axis towards the second one
+            const float thetaR = thetaO - thetaA;
+            const Vector4 bitangent = Vector4::Cross3(rotationAxis.Normalized3(), a.axis);
+            result.axis = (a.axis * cosf(thetaR) + bitangent * sinf(thetaR)).Normalized3();
+            result.cosThetaO = cosf(thetaO);
+        }
+    }
+
+    return result;
+}
+
+LightBVH::LightBVH() = default;
+
+LightBVH::~LightBVH() = default;
+
+LightBVH::LightBVH(LightBVH&&) = default;
+
+LightBVH& LightBVH::operator = (LightBVH&&) = default;
+
+void LightBVH::Clear()
+{
+    mNodes.Clear();
+    mLocalLights.Clear();
+    mGlobalLights.Clear();
+    mLightLeaves.clear();
+}
+
+bool LightBVH::Build(const DynArray<const LightSceneObject*>& lights)
+{
+    Timer timer;
+
+    Clear();
+
+    DynArray<BuildItem> items;
+    for (const LightSceneObject* lightObject : lights)
+    {
+        if (lightObject->GetLight().GetFlags() & ILight::Flag_IsFinite)
+        {
+            BuildItem item;
+            item.bounds = GetLightBounds(lightObject);
+            item.lightIndex = mLocalLights.Size();
+            items.PushBack(item);
+
+            mLocalLights.PushBack(lightObject);
+        }
+        else
+        {
+            mGlobalLights.PushBack(lightObject);
+            mLightLeaves[lightObject] = UINT32_MAX;
+        }
+    }
+
+    if (!items.Empty())
+    {
+        if (!mNodes.Reserve(2 * items.Size() - 1))
+        {
+            RT_LOG_ERROR("Failed to allocate light BVH nodes");
+            return false;
+        }
+
+        BuildNode(items.Data(), items.Size(), UINT32_MAX);
+    }
+
+    RT_LOG_INFO("Building light BVH for %u lights took %.2f ms", mLocalLights.Size(), timer.Stop() * 1000.0);
+
+    return true;
+}
+
+uint32 LightBVH::BuildNode(BuildItem* items, uint32 numItems, uint32 parent)
+{
+    const uint32 nodeIndex = mNodes.Size();
+    mNodes.PushBack(Node());
+
+    if (numItems == 1)
+    {
+        Node& node = mNodes[nodeIndex];
+        node.bounds = items[0].bounds;
+        node.parent = parent;
+        node.child = items[0].lightIndex;
+        node.isLeaf = true;
+
+        mLightLeaves[mLocalLights[items[0].lightIndex]] = nodeIndex;
+        return nodeIndex;
+    }
+
+    Bounds bounds;
+    Box centroidsBox = Box::Empty();
+    for (uint32 i = 0; i < numItems; ++i)
+    {
+        bounds = Bounds::Union(bounds, items[i].bounds);
+        centroidsBox.AddPoint(items[i].bounds.box.GetCenter());
+    }
+
+    // find the best split using surface area orientation heuristic
+    const Vector4 boundsSize = bounds.box.max - bounds.box.min;
+    const Vector4 centroidsSize = centroidsBox.max - centroidsBox.min;
+    const float maxBoundsSize = Max(boundsSize.x, boundsSize.y, boundsSize.z);
+
+    float bestCost = FLT_MAX;
+    uint32 bestAxis = UINT32_MAX;
+    uint32 bestBucket = 0;
+
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+        if (centroidsSize[axis] <= 0.0f)
+        {
+            continue;
+        }
+
+        Bounds buckets[NumBuckets];
+        for (uint32 i = 0; i < numItems; ++i)
+        {
+            const float relativePosition = (items[i].bounds.box.GetCenter()[axis] - centroidsBox.min[axis]) / centroidsSize[axis];
+            const uint32 bucket = Min(static_cast<uint32>(relativePosition * NumBuckets), NumBuckets - 1);
+            buckets[bucket] = Bounds::Union(buckets[bucket], items[i].bounds);
+        }
+
+        // penalize thin boxes
+        const float regularization = maxBoundsSize / Max(boundsSize[axis], FLT_MIN);
+
+        for (uint32 split = 0; split + 1 < NumBuckets; ++split)
+        {
+            Bounds left, right;
+            for (uint32 i = 0; i <= split; ++i)
+            {
+                left = Bounds::Union(left, buckets[i]);
+            }
+            for (uint32 i = split + 1; i < NumBuckets; ++i)
+            {
+                right = Bounds::Union(right, buckets[i]);
+            }
+
+            const float cost = SplitCost(left, regularization) + SplitCost(right, regularization);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBucket = split;
+            }
+        }
+    }
+
+    uint32 numLeftItems = 0;
+    if (bestAxis != UINT32_MAX)
+    {
+        const BuildItem* splitPoint = std::partition(items, items + numItems, [&](const BuildItem& item)
+        {
+            const float relativePosition = (item.bounds.box.GetCenter()[bestAxis] - centroidsBox.min[bestAxis]) / centroidsSize[bestAxis];
+            return Min(static_cast<uint32>(relativePosition * NumBuckets), NumBuckets - 1) <= bestBucket;
+        });
+        numLeftItems = static_cast<uint32>(splitPoint - items);
+    }
+
+    // all the lights are in one bucket (e.g. zero power or the same position) - split in the middle
+    if (numLeftItems == 0 || numLeftItems == numItems)
+    {
+        numLeftItems = numItems / 2;
+    }
+
+    BuildNode(items, numLeftItems, nodeIndex);
+    const uint32 rightChild = BuildNode(items + numLeftItems, numItems - numLeftItems, nodeIndex);
+
+    Node& node = mNodes[nodeIndex];
+    node.bounds = bounds;
+    node.parent = parent;
+    node.child = rightChild;
+    node.isLeaf = false;
+
+    return nodeIndex;
+}
+
+float LightBVH::GetTreePickProbability() const
+{
+    if (mNodes.Empty())
+    {
+        return 0.0f;
+    }
+
+    return 1.0f / static_cast<float>(mGlobalLights.Size() + 1);
+}
+
+template<typename ImportanceFunc>
+const LightSceneObject* LightBVH::SampleTree(float u, float& outPdf, const ImportanceFunc& importance) const
+{
+    uint32 nodeIndex = 0;
+    float pdf = 1.0f;
+
+    if (importance(mNodes[nodeIndex].bounds) <= 0.0f)
+    {
+        return nullptr;
+    }
+
+    while (!mNodes[nodeIndex].isLeaf)
+    {
+        const uint32 children[2] = { nodeIndex + 1, mNodes[nodeIndex].child };
+        const float importanceA = importance(mNodes[children[0]].bounds);
+        const float importanceB = importance(mNodes[children[1]].bounds);
+        const float totalImportance = importanceA + importanceB;
+
+        if (totalImportance <= 0.0f)
+        {
+            return nullptr;
+        }
+
+        // pick child randomly and reuse the random number
+        const float probabilityA = importanceA / totalImportance;
+        if (u < probabilityA)
+        {
+            nodeIndex = children[0];
+            pdf *= probabilityA;
+            u = Min(u / probabilityA, 0.99999994f);
+        }
+        else
+        {
+            nodeIndex = children[1];
+            pdf *= 1.0f - probabilityA;
+            u = Min((u - probabilityA) / (1.0f - probabilityA), 0.99999994f);
+        }
+    }
+
+    outPdf = pdf;
+    return mLocalLights[mNodes[nodeIndex].child];
+}
+
+template<typename ImportanceFunc>
+float LightBVH::PdfTree(uint32 nodeIndex, const ImportanceFunc& importance) const
+{
+    if (importance(mNodes[nodeIndex].bounds) <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    // walk up the tree to the root
+    float pdf = 1.0f;
+    for (uint32 parentIndex = mNodes[nodeIndex].parent; parentIndex != UINT32_MAX; nodeIndex = parentIndex, parentIndex = mNodes[nodeIndex].parent)
+    {
+        const float importanceA = importance(mNodes[parentIndex + 1].bounds);
+        const float importanceB = importance(mNodes[mNodes[parentIndex].child].bounds);
+        const float totalImportance = importanceA + importanceB;
+
+        if (totalImportance <= 0.0f)
+        {
+            return 0.0f;
+        }
+
+        pdf *= (nodeIndex == parentIndex + 1 ? importanceA : importanceB) / totalImportance;
+    }
+
+    return pdf;
+}
+
+const LightSceneObject* LightBVH::Sample(const Vector4& position, const Vector4& normal, float u, float& outPdf) const
+{
+    outPdf = 0.0f;
+
+    if (mNodes.Empty() && mGlobalLights.Empty())
+    {
+        return nullptr;
+    }
+
+    const float treePickProbability = GetTreePickProbability();
+    const float globalLightPickProbability = (1.0f - treePickProbability) / static_cast<float>(Max(1u, mGlobalLights.Size()));
+
+    if (u < 1.0f - treePickProbability)
+    {
+        // pick global light uniformly
+        const uint32 index = Min(static_cast<uint32>(u / globalLightPickProbability), mGlobalLights.Size() - 1);
+        outPdf = globalLightPickProbability;
+        return mGlobalLights[index];
+    }
+
+    u = Min((u - (1.0f - treePickProbability)) / treePickProbability, 0.99999994f);
+
+    float treePdf = 0.0f;
+    const LightSceneObject* light = SampleTree(u, treePdf, [&](const Bounds& bounds)
+    {
+        return bounds.Importance(position, normal);
+    });
+
+    outPdf = treePickProbability * treePdf;
+    return light;
+}
+
+float LightBVH::Pdf(const Vector4& position, const Vector4& normal, const LightSceneObject* light) const
+{
+    const auto iter = mLightLeaves.find(light);
+    if (iter == mLightLeaves.end())
+    {
+        return 0.0f;
+    }
+
+    const float treePickProbability = GetTreePickProbability();
+    if (iter->second == UINT32_MAX)
+    {
+        return (1.0f - treePickProbability) / static_cast<float>(mGlobalLights.Size());
+    }
+
+    return treePickProbability * PdfTree(iter->second, [&](const Bounds& bounds)
+    {
+        return bounds.Importance(position, normal);
+    });
+}
+
+const LightSceneObject* LightBVH::SampleEmission(float u, float& outPdf) const
+{
+    outPdf = 0.0f;
+
+    if (mNodes.Empty() && mGlobalLights.Empty())
+    {
+        return nullptr;
+    }
+
+    const float treePickProbability = GetTreePickProbability();
+    const float globalLightPickProbability = (1.0f - treePickProbability) / static_cast<float>(Max(1u, mGlobalLights.Size()));
+
+    if (u < 1.0f - treePickProbability)
+    {
+        const uint32 index = Min(static_cast<uint32>(u / globalLightPickProbability), mGlobalLights.Size() - 1);
+        outPdf = globalLightPickProbability;
+        return mGlobalLights[index];
+    }
+
+    u = Min((u - (1.0f - treePickProbability)) / treePickProbability, 0.99999994f);
+
+    // nodes importance is based on power only, so the lights are picked proportionally to power
+    float treePdf = 0.0f;
+    const LightSceneObject* light = SampleTree(u, treePdf, [](const Bounds& bounds)
+    {
+        return bounds.power;
+    });
+
+    outPdf = treePickProbability * treePdf;
+    return light;
+}
+
+float LightBVH::PdfEmission(const LightSceneObject* light) const
+{
+    const auto iter = mLightLeaves.find(light);
+    if (iter == mLightLeaves.end())
+    {
+        return 0.0f;
+    }
+
+    const float treePickProbability = GetTreePickProbability();
+    if (iter->second == UINT32_MAX)
+    {
+        return (1.0f - treePickProbability) / static_cast<float>(mGlobalLights.Size());
+    }
+
+    // Note: power of a node is the sum of children powers
+    return treePickProbability * mNodes[iter->second].bounds.power / mNodes.Front().bounds.power;
+}
+
+} // namespace rt
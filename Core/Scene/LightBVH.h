@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../RayLib.h"
+#include "../Math/Box.h"
+#include "../Containers/DynArray.h"
+
+#include <unordered_map>
+
+namespace rt {
+
+class LightSceneObject;
+
+// Bounding volume hierarchy of lights, used for importance sampling of many lights.
+// Based on "Importance Sampling of Many Lights with Adaptive Tree Splitting" (Conty Estevez, Kulla),
+// without the splitting - exactly one light is picked by stochastic traversal of the tree.
+// Global lights (background, directional) can't be bounded, so they are picked uniformly
+// and the whole tree is treated as one more global light.
+class LightBVH
+{
+public:
+    // world-space bounds of light emission
+    struct Bounds
+    {
+        math::Box box = math::Box::Empty();
+        math::Vector4 axis = math::VECTOR_Z;    // axis of the cone bounding surface normals
+        float power = 0.0f;                     // total emitted power
+        float cosThetaO = 1.0f;                 // cosine of the normals cone spread angle
+        float cosThetaE = 1.0f;                 // cosine of the emission angle around a normal
+
+        // estimate of light contribution to a shading point, zero if the bounded lights can't illuminate the point
+        // Note: normal can be zero (e.g. for media)
+        float Importance(const math::Vector4& position, const math::Vector4& normal) const;
+
+        static const Bounds Union(const Bounds& a, const Bounds& b);
+    };
+
+    RAYLIB_API LightBVH();
+    RAYLIB_API ~LightBVH();
+    RAYLIB_API LightBVH(LightBVH&&);
+    RAYLIB_API LightBVH& operator = (LightBVH&&);
+
+    RAYLIB_API bool Build(const DynArray<const LightSceneObject*>& lights);
+    RAYLIB_API void Clear();
+
+    RT_FORCE_INLINE uint32 GetNumNodes() const { return mNodes.Size(); }
+
+    // pick a light for a shading point, the pick probability is returned in 'outPdf'
+    // returns nullptr if none of the lights can illuminate the point
+    RAYLIB_API const LightSceneObject* Sample(const math::Vector4& position, const math::Vector4& normal, float u, float& outPdf) const;
+
+    // probability of picking given light with Sample()
+    RAYLIB_API float Pdf(const math::Vector4& position, const math::Vector4& normal, const LightSceneObject* light) const;
+
+    // pick a light proportionally to its power (regardless of shading point), e.g. for light paths emission
+    RAYLIB_API const LightSceneObject* SampleEmission(float u, float& outPdf) const;
+
+    // probability of picking given light with SampleEmission()
+    RAYLIB_API float PdfEmission(const LightSceneObject* light) const;
+
+private:
+    LightBVH(const LightBVH&) = delete;
+    LightBVH& operator = (const LightBVH&) = delete;
+
+    struct Node
+    {
+        Bounds bounds;
+        uint32 parent;      // parent node index (UINT32_MAX for the root)
+        uint32 child;       // second child index (the first child directly follows the node) or light index for a leaf
+        bool isLeaf;
+    };
+
+    struct BuildItem
+    {
+        Bounds bounds;
+        uint32 lightIndex;
+    };
+
+    uint32 BuildNode(BuildItem* items, uint32 numItems, uint32 parent);
+
+    // probability of choosing the tree instead of one of the global lights
+    float GetTreePickProbability() const;
+
+    template<typename ImportanceFunc>
+    const LightSceneObject* SampleTree(float u, float& outPdf, const ImportanceFunc& importance) const;
+
+    template<typename ImportanceFunc>
+    float PdfTree(uint32 leafIndex, const ImportanceFunc& importance) const;
+
+    DynArray<Node> mNodes;
+    DynArray<const LightSceneObject*> mLocalLights;
+    DynArray<const LightSceneObject*> mGlobalLights;
+
+    // maps local lights to leaf node index, global lights to UINT32_MAX
+    std::unordered_map<const LightSceneObject*, uint32> mLightLeaves;
+};
+
+} // namespace rt
@@ -13,6 +13,7 @@ namespace rt {
 struct HitPoint;
 struct IntersectionData;
 struct SingleTraversalContext;
+struct SimdTraversalContext;
 struct PacketTraversalContext;
 
 class Material;
@@ -59,11 +60,19 @@ class ITraceableSceneObject : public ISceneObject
 public:
     // traverse the object and return hit points
     virtual void Traverse(const SingleTraversalContext& context, const uint32 objectID) const = 0;
+    virtual void Traverse(const SimdTraversalContext& context, const uint32 objectID) const = 0;
     virtual void Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const = 0;
 
     // check shadow ray occlusion
     virtual bool Traverse_Shadow(const SingleTraversalContext& context) const = 0;
 
+    // check shadow rays occlusion for SIMD-8 ray, returns bitmask of occluded rays
+    // NOTE: occluded rays are terminated by setting negative max distance
+    virtual uint32 Traverse_Shadow(const SimdTraversalContext& context) const = 0;
+
+    // check shadow rays occlusion for a ray packet, occluded rays are marked in the rendering context
+    virtual void Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const = 0;
+
     // Calculate input data for shading routine
     // NOTE: all calculations are performed in local space
     // NOTE: frame[3] (translation) will be already filled, because it can be always calculated from ray distance
@@ -4,6 +4,8 @@
 #include "../Light/AreaLight.h"
 #include "../../Shapes/Shape.h"
 #include "Traversal/TraversalContext.h"
+#include "Traversal/Traversal_Simd.h"
+#include "Traversal/Traversal_Packet.h"
 
 namespace rt {
 
@@ -52,12 +54,24 @@ bool LightSceneObject::Traverse_Shadow(const SingleTraversalContext& context) co
     return false;
 }
 
+uint32 LightSceneObject::Traverse_Shadow(const SimdTraversalContext& context) const
+{
+    return GenericTraverse_Shadow_SingleRays<ITraceableSceneObject>(context, this);
+}
+
+void LightSceneObject::Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const
+{
+    GenericTraverse_Shadow_SingleRays<ITraceableSceneObject>(context, this, numActiveGroups);
+}
+
+void LightSceneObject::Traverse(const SimdTraversalContext& context, const uint32 objectID) const
+{
+    GenericTraverse_SingleRays<ITraceableSceneObject>(context, objectID, this);
+}
+
 void LightSceneObject::Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const
 {
-    RT_UNUSED(context);
-    RT_UNUSED(objectID);
-    RT_UNUSED(numActiveGroups);
-    // TODO
+    GenericTraverse_SingleRays<ITraceableSceneObject>(context, objectID, this, numActiveGroups);
 }
 
 void LightSceneObject::EvaluateIntersection(const HitPoint& hitPoint, IntersectionData& outIntersectionData) const
@@ -20,9 +20,12 @@ private:
     virtual math::Box GetBoundingBox() const override;
 
     virtual void Traverse(const SingleTraversalContext& context, const uint32 objectID) const override;
+    virtual void Traverse(const SimdTraversalContext& context, const uint32 objectID) const override;
     virtual void Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const override;
 
     virtual bool Traverse_Shadow(const SingleTraversalContext& context) const override;
+    virtual uint32 Traverse_Shadow(const SimdTraversalContext& context) const override;
+    virtual void Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const override;
 
     virtual void EvaluateIntersection(const HitPoint& hitPoint, IntersectionData& outIntersectionData) const override;
 
@@ -48,13 +48,24 @@ bool ShapeSceneObject::Traverse_Shadow(const SingleTraversalContext& context) co
     return mShape->Traverse_Shadow(context);
 }
 
-void ShapeSceneObject::Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const
+uint32 ShapeSceneObject::Traverse_Shadow(const SimdTraversalContext& context) const
+{
+    return mShape->Traverse_Shadow(context);
+}
+
+void ShapeSceneObject::Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const
 {
-    // TODO
+    mShape->Traverse_Shadow(context, numActiveGroups);
+}
 
-    RT_UNUSED(context);
-    RT_UNUSED(objectID);
-    RT_UNUSED(numActiveGroups);
+void ShapeSceneObject::Traverse(const SimdTraversalContext& context, const uint32 objectID) const
+{
+    mShape->Traverse(context, objectID);
+}
+
+void ShapeSceneObject::Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const
+{
+    mShape->Traverse(context, objectID, numActiveGroups);
 }
 
 void ShapeSceneObject::EvaluateIntersection(const HitPoint& hitPoint, IntersectionData& outIntersectionData) const
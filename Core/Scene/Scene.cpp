@@ -9,6 +9,7 @@
 #include "Utils/Profiler.h"
 
 #include "Traversal/Traversal_Single.h"
+#include "Traversal/Traversal_Simd.h"
 #include "Traversal/Traversal_Packet.h"
 
 namespace rt {
@@ -77,9 +78,13 @@ bool Scene::BuildBVH()
             boxes.PushBack(obj->GetBoundingBox());
         }
 
+        // number of objects is small, so the high quality algorithm is affordable
+        BvhBuildingParams params;
+        params.algorithm = BvhBuildingParams::Algorithm::FullSweep;
+
         BVHBuilder::Indices newOrder;
         BVHBuilder bvhBuilder(mTraceableObjectsBVH);
-        if (!bvhBuilder.Build(boxes.Data(), mTraceableObjects.Size(), BvhBuildingParams(), newOrder))
+        if (!bvhBuilder.Build(boxes.Data(), mTraceableObjects.Size(), params, newOrder))
         {
             return false;
         }
@@ -94,6 +99,12 @@ bool Scene::BuildBVH()
         mTraceableObjects = std::move(newObjectsArray);
     }
 
+    // build BVH for lights importance sampling
+    if (!mLightBVH.Build(mLights))
+    {
+        return false;
+    }
+
     // build BVH for decals
     {
         DynArray<Box> boxes;
@@ -104,6 +115,7 @@ bool Scene::BuildBVH()
 
         BvhBuildingParams params;
         params.heuristics = BvhBuildingParams::Heuristics::Volume;
+        params.algorithm = BvhBuildingParams::Algorithm::FullSweep;
 
         BVHBuilder::Indices newOrder;
         BVHBuilder bvhBuilder(mDecalsBVH);
@@ -144,6 +156,22 @@ void Scene::Traverse_Object(const SingleTraversalContext& context, const uint32
     object->Traverse(objectContext, objectID);
 }
 
+namespace {
+
+// transform rays of the active groups to object's local space
+RT_FORCE_INLINE void TransformRayGroups(const PacketTraversalContext& context, const Matrix4& invTransform, uint32 numActiveGroups)
+{
+    for (uint32 j = 0; j < numActiveGroups; ++j)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+        rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
+        rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
+        rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
+    }
+}
+
+} // namespace
+
 bool Scene::Traverse_Object_Shadow(const SingleTraversalContext& context, const uint32 objectID) const
 {
     const ITraceableSceneObject* object = mTraceableObjects[objectID];
@@ -164,6 +192,20 @@ bool Scene::Traverse_Object_Shadow(const SingleTraversalContext& context, const
     return object->Traverse_Shadow(objectContext);
 }
 
+uint32 Scene::Traverse_Object_Shadow(const SimdTraversalContext& context, const uint32 objectID) const
+{
+    const ITraceableSceneObject* object = mTraceableObjects[objectID];
+    const Matrix4 invTransform = object->GetInverseTransform(context.context.time);
+
+    // transform ray to local-space
+    Ray_Simd8 transformedRay;
+    transformedRay.origin = invTransform.TransformPoint(context.ray.origin);
+    transformedRay.dir = invTransform.TransformVector(context.ray.dir);
+    transformedRay.invDir = Vector3x8::FastReciprocal(transformedRay.dir);
+
+    return object->Traverse_Shadow(SimdTraversalContext{ transformedRay, context.hitPoint, context.context });
+}
+
 void Scene::Traverse_Leaf(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
 {
     RT_UNUSED(objectID);
@@ -193,7 +235,21 @@ bool Scene::Traverse_Leaf_Shadow(const SingleTraversalContext& context, const BV
     return false;
 }
 
-void Scene::Traverse_Leaf(const PacketTraversalContext& context, const uint32 objectID, const BVH::Node& node, uint32 numActiveGroups) const
+uint32 Scene::Traverse_Leaf_Shadow(const SimdTraversalContext& context, const BVH::Node& node) const
+{
+    const uint32 activeRaysMask = static_cast<uint32>((Vector8::Zero() < context.hitPoint.distance).GetMask());
+    uint32 occludedRaysMask = 0;
+
+    // Note: occluded rays are terminated, so they are not tested against the following objects
+    for (uint32 i = 0; i < node.numLeaves && occludedRaysMask != activeRaysMask; ++i)
+    {
+        occludedRaysMask |= Traverse_Object_Shadow(context, node.childIndex + i);
+    }
+
+    return occludedRaysMask;
+}
+
+void Scene::Traverse_Leaf(const SimdTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
 {
     RT_UNUSED(objectID);
 
@@ -204,23 +260,50 @@ void Scene::Traverse_Leaf(const PacketTraversalContext& context, const uint32 ob
         const Matrix4 invTransform = object->GetInverseTransform(context.context.time);
 
         // transform ray to local-space
-        for (uint32 j = 0; j < numActiveGroups; ++j)
-        {
-            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
-            rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
-            rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
-            rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
-        }
+        Ray_Simd8 transformedRay;
+        transformedRay.origin = invTransform.TransformPoint(context.ray.origin);
+        transformedRay.dir = invTransform.TransformVector(context.ray.dir);
+        transformedRay.invDir = Vector3x8::FastReciprocal(transformedRay.dir);
+
+        object->Traverse(SimdTraversalContext{ transformedRay, context.hitPoint, context.context }, objectIndex);
+    }
+}
+
+void Scene::Traverse_Leaf(const PacketTraversalContext& context, const uint32 objectID, const BVH::Node& node, uint32 numActiveGroups) const
+{
+    RT_UNUSED(objectID);
+
+    for (uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const uint32 objectIndex = node.childIndex + i;
+        const ITraceableSceneObject* object = mTraceableObjects[objectIndex];
+
+        TransformRayGroups(context, object->GetInverseTransform(context.context.time), numActiveGroups);
 
         object->Traverse(context, objectIndex, numActiveGroups);
     }
 }
 
+void Scene::Traverse_Leaf_Shadow(const PacketTraversalContext& context, const BVH::Node& node, uint32 numActiveGroups) const
+{
+    for (uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const ITraceableSceneObject* object = mTraceableObjects[node.childIndex + i];
+
+        TransformRayGroups(context, object->GetInverseTransform(context.context.time), numActiveGroups);
+
+        object->Traverse_Shadow(context, numActiveGroups);
+    }
+}
+
 void Scene::Traverse(const SingleTraversalContext& context) const
 {
     RT_SCOPED_TIMER(Scene_Traverse);
 
-    context.context.localCounters.Reset();
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.localCounters.Reset();
+    }
 
     const uint32 numObjects = mTraceableObjects.Size();
 
@@ -239,25 +322,40 @@ void Scene::Traverse(const SingleTraversalContext& context) const
         GenericTraverse(context, 0, this);
     }
 
-    context.context.counters.Append(context.context.localCounters);
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.counters.Append(context.context.localCounters, 1);
+    }
 }
 
 bool Scene::Traverse_Shadow(const SingleTraversalContext& context) const
 {
     const uint32 numObjects = mTraceableObjects.Size();
 
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.localCounters.Reset();
+    }
+
+    bool occluded = false;
     if (numObjects == 0) // scene is empty
     {
-        return false;
     }
     else if (numObjects == 1) // bypass BVH
     {
-        return Traverse_Object_Shadow(context, 0);
+        occluded = Traverse_Object_Shadow(context, 0);
     }
     else // full BVH traversal
     {
-        return GenericTraverse_Shadow(context, this);
+        occluded = GenericTraverse_Shadow(context, this);
+    }
+
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.counters.Append(context.context.localCounters, 1);
     }
+
+    return occluded;
 }
 
 void Scene::Traverse(const PacketTraversalContext& context) const
@@ -267,38 +365,153 @@ void Scene::Traverse(const PacketTraversalContext& context) const
     const uint32 numRayGroups = context.ray.GetNumGroups();
     for (uint32 i = 0; i < numRayGroups; ++i)
     {
-        context.ray.groups[i].maxDistances = VECTOR8_MAX;
-        context.context.activeGroupsIndices[i] = (uint16)i;
+        RayGroup& rayGroup = context.ray.groups[i];
+        for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+        {
+            const int32 rayOffset = rayGroup.rayOffsets[j];
+            if (rayOffset == RayPacket::InvalidRayOffset)
+            {
+                // Note: zero max distance prevents unused lanes from reporting any hit
+                rayGroup.maxDistances[j] = 0.0f;
+            }
+            else
+            {
+                rayGroup.maxDistances[j] = FLT_MAX;
+                context.context.hitPoints[rayOffset].distance = FLT_MAX;
+                context.context.hitPoints[rayOffset].objectId = UINT32_MAX;
+            }
+        }
     }
 
-    for (uint32 i = 0; i < context.ray.numRays; ++i)
+    if (numObjects == 0) // scene is empty
     {
-        context.context.hitPoints[i].distance = FLT_MAX;
-        context.context.hitPoints[i].objectId = UINT32_MAX;
+        return;
     }
 
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.localCounters.Reset();
+    }
+
+    // traverse each ray octant separately, so the BVH nodes are visited in front-to-back order for all the rays
+    for (uint32 octant = 0; octant < RayPacket::NumOctants; ++octant)
+    {
+        uint32 numActiveGroups = 0;
+        for (uint32 i = 0; i < numRayGroups; ++i)
+        {
+            if (context.ray.groupOctants[i] == octant)
+            {
+                context.context.activeGroupsIndices[numActiveGroups++] = (uint16)i;
+            }
+        }
+
+        if (numActiveGroups == 0)
+        {
+            continue;
+        }
+
+        if (numObjects == 1) // bypass BVH
+        {
+            const ISceneObject* object = mTraceableObjects.Front();
+            TransformRayGroups(context, object->GetInverseTransform(context.context.time), numActiveGroups);
+
+            mTraceableObjects.Front()->Traverse(context, 0, numActiveGroups);
+        }
+        else // full BVH traversal
+        {
+            GenericTraverse<Scene, 0>(context, 0, this, numActiveGroups);
+        }
+    }
+
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.counters.Append(context.context.localCounters, context.ray.numRays);
+    }
+}
+
+uint32 Scene::Traverse_Shadow(const SimdTraversalContext& context) const
+{
+    const uint32 numObjects = mTraceableObjects.Size();
+
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.localCounters.Reset();
+    }
+
+    uint32 occludedRaysMask = 0;
     if (numObjects == 0) // scene is empty
     {
-        return;
     }
     else if (numObjects == 1) // bypass BVH
     {
-        const ISceneObject* object = mTraceableObjects.Front();
-        const Matrix4 invTransform = object->GetInverseTransform(context.context.time);
+        occludedRaysMask = Traverse_Object_Shadow(context, 0);
+    }
+    else // full BVH traversal
+    {
+        occludedRaysMask = GenericTraverse_Shadow(context, this);
+    }
+
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.counters.Append(context.context.localCounters, RayPacket::RaysPerGroup);
+    }
+
+    return occludedRaysMask;
+}
+
+void Scene::Traverse_Shadow(const PacketTraversalContext& context) const
+{
+    const uint32 numObjects = mTraceableObjects.Size();
+    const uint32 numRayGroups = context.ray.GetNumGroups();
+
+    for (uint32 i = 0; i < numRayGroups; ++i)
+    {
+        context.context.occludedRays[i] = 0;
+    }
 
-        for (uint32 j = 0; j < numRayGroups; ++j)
+    if (numObjects == 0) // scene is empty
+    {
+        return;
+    }
+
+    if (context.context.localCounters.IsEnabled())
+    {
+        context.context.localCounters.Reset();
+    }
+
+    // traverse each ray octant separately, so the children order is the same for all the rays
+    for (uint32 octant = 0; octant < RayPacket::NumOctants; ++octant)
+    {
+        uint32 numActiveGroups = 0;
+        for (uint32 i = 0; i < numRayGroups; ++i)
         {
-            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
-            rayGroup.rays[1].origin = invTransform.TransformPoint(rayGroup.rays[0].origin);
-            rayGroup.rays[1].dir = invTransform.TransformVector(rayGroup.rays[0].dir);
-            rayGroup.rays[1].invDir = Vector3x8::FastReciprocal(rayGroup.rays[1].dir);
+            if (context.ray.groupOctants[i] == octant)
+            {
+                context.context.activeGroupsIndices[numActiveGroups++] = (uint16)i;
+            }
         }
 
-        mTraceableObjects.Front()->Traverse(context, 0, numRayGroups);
+        if (numActiveGroups == 0)
+        {
+            continue;
+        }
+
+        if (numObjects == 1) // bypass BVH
+        {
+            const ITraceableSceneObject* object = mTraceableObjects.Front();
+            TransformRayGroups(context, object->GetInverseTransform(context.context.time), numActiveGroups);
+
+            object->Traverse_Shadow(context, numActiveGroups);
+        }
+        else // full BVH traversal
+        {
+            GenericTraverse_Shadow<Scene, 0>(context, this, numActiveGroups);
+        }
     }
-    else // full BVH traversal
+
+    if (context.context.localCounters.IsEnabled())
     {
-        GenericTraverse<Scene, 0>(context, 0, this, numRayGroups);
+        context.context.counters.Append(context.context.localCounters, context.ray.numRays);
     }
 }
 
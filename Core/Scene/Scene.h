@@ -5,6 +5,7 @@
 #include "../Color/RayColor.h"
 #include "../Traversal/HitPoint.h"
 #include "../BVH/BVH.h"
+#include "LightBVH.h"
 #include "../Containers/DynArray.h"
 
 namespace rt {
@@ -20,6 +21,7 @@ struct HitPoint;
 struct ShadingData;
 struct IntersectionData;
 struct SingleTraversalContext;
+struct SimdTraversalContext;
 struct PacketTraversalContext;
 
 using SceneObjectPtr = std::unique_ptr<ISceneObject>;
@@ -51,22 +53,34 @@ public:
     RT_FORCE_INLINE const ITraceableSceneObject* GetHitObject(uint32 id) const { return mTraceableObjects[id]; }
     RT_FORCE_INLINE const DynArray<const LightSceneObject*>& GetLights() const { return mLights; }
     RT_FORCE_INLINE const DynArray<const LightSceneObject*>& GetGlobalLights() const { return mGlobalLights; }
+    RT_FORCE_INLINE const LightBVH& GetLightBVH() const { return mLightBVH; }
 
     // traverse the scene, returns hit points
     RAYLIB_API void Traverse(const SingleTraversalContext& context) const;
     RAYLIB_API void Traverse(const PacketTraversalContext& context) const;
 
     // cast shadow ray
-    bool Traverse_Shadow(const SingleTraversalContext& context) const;
+    RAYLIB_API bool Traverse_Shadow(const SingleTraversalContext& context) const;
+
+    // cast 8 shadow rays at once (max distances are taken from the hit point)
+    // returns bitmask of occluded rays
+    RAYLIB_API uint32 Traverse_Shadow(const SimdTraversalContext& context) const;
+
+    // cast shadow rays packet (max distances are passed to RayPacket::PushRay)
+    // occluded rays are marked in RenderingContext::occludedRays
+    RAYLIB_API void Traverse_Shadow(const PacketTraversalContext& context) const;
 
     RAYLIB_API void EvaluateIntersection(const math::Ray& ray, const HitPoint& hitPoint, const float time, IntersectionData& outIntersectionData) const;
 
     void TraceRay_Simd8(const math::Ray_Simd8& ray, RenderingContext& context, RayColor* outColors) const;
 
     void Traverse_Leaf(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const;
+    void Traverse_Leaf(const SimdTraversalContext& context, const uint32 objectID, const BVH::Node& node) const;
     void Traverse_Leaf(const PacketTraversalContext& context, const uint32 objectID, const BVH::Node& node, uint32 numActiveGroups) const;
 
     bool Traverse_Leaf_Shadow(const SingleTraversalContext& context, const BVH::Node& node) const;
+    uint32 Traverse_Leaf_Shadow(const SimdTraversalContext& context, const BVH::Node& node) const;
+    void Traverse_Leaf_Shadow(const PacketTraversalContext& context, const BVH::Node& node, uint32 numActiveGroups) const;
 
     void EvaluateShadingData(ShadingData& shadingData, RenderingContext& context) const;
 
@@ -76,6 +90,7 @@ private:
 
     RT_FORCE_NOINLINE void Traverse_Object(const SingleTraversalContext& context, const uint32 objectID) const;
     RT_FORCE_NOINLINE bool Traverse_Object_Shadow(const SingleTraversalContext& context, const uint32 objectID) const;
+    RT_FORCE_NOINLINE uint32 Traverse_Object_Shadow(const SimdTraversalContext& context, const uint32 objectID) const;
 
     void EvaluateDecals(ShadingData& shadingData, RenderingContext& context) const;
 
@@ -84,6 +99,7 @@ private:
 
     DynArray<const LightSceneObject*> mLights;
     DynArray<const LightSceneObject*> mGlobalLights;
+    LightBVH mLightBVH;
 
     DynArray<const ITraceableSceneObject*> mTraceableObjects;
     BVH mTraceableObjectsBVH;
@@ -0,0 +1,287 @@
+#include "PCH.h"
+#include "MeshCache.h"
+#include "Utils/Logger.h"
+#include "Math/Math.h"
+
+
+namespace rt {
+
+using namespace math;
+
+namespace {
+
+// bump the version whenever the file layout, BVH builder or triangle preprocessing change
+// Note: BVH building parameters are part of the hash
+static const uint32 MeshCacheFileVersion = 1;
+static const uint32 MeshCacheMagic = 'mshc';
+
+// file sections are aligned, so the mapped data can be accessed directly
+static const uint64 MeshCacheSectionAlignment = 64;
+
+struct MeshCacheFileHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint64 hash;
+    uint32 numNodes;
+    uint32 numTriangles;
+    uint64 nodesOffset;
+    uint64 vertexIndexBufferOffset;
+    uint64 materialIndexBufferOffset;
+    uint64 trianglesOffset;
+    uint64 fileSize;
+};
+
+uint64 HashData(const void* data, size_t size, uint64 seed)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+
+    uint64 hash = Hash(seed ^ static_cast<uint64>(size));
+    if (!bytes)
+    {
+        return hash;
+    }
+
+    size_t i = 0;
+    for (; i + sizeof(uint64) <= size; i += sizeof(uint64))
+    {
+        uint64 word;
+        memcpy(&word, bytes + i, sizeof(uint64));
+        hash = Hash(hash ^ word) + 0x9e3779b97f4a7c15ull;
+    }
+
+    if (i < size)
+    {
+        uint64 word = 0;
+        memcpy(&word, bytes + i, size - i);
+        hash = Hash(hash ^ word) + 0x9e3779b97f4a7c15ull;
+    }
+
+    return hash;
+}
+
+bool WritePadding(FILE* file, uint64& offset)
+{
+    static const uint8 zeros[MeshCacheSectionAlignment] = { 0 };
+
+    const uint64 alignedOffset = RoundUp(offset, MeshCacheSectionAlignment);
+    const size_t paddingSize = static_cast<size_t>(alignedOffset - offset);
+    if (paddingSize > 0 && fwrite(zeros, 1, paddingSize, file) != paddingSize)
+    {
+        return false;
+    }
+
+    offset = alignedOffset;
+    return true;
+}
+
+bool WriteSection(FILE* file, const void* data, uint64 size, uint64& offset, uint64& outSectionOffset)
+{
+    if (!WritePadding(file, offset))
+    {
+        return false;
+    }
+
+    outSectionOffset = offset;
+
+    if (size > 0 && fwrite(data, static_cast<size_t>(size), 1, file) != 1)
+    {
+        return false;
+    }
+
+    offset += size;
+    return true;
+}
+
+bool IsSectionValid(const MeshCacheFileHeader& header, uint64 offset, uint64 size)
+{
+    return (offset % MeshCacheSectionAlignment == 0) && (offset >= sizeof(MeshCacheFileHeader)) && (offset + size <= header.fileSize);
+}
+
+} // namespace
+
+MeshCache::MeshCache()
+    : mNumNodes(0)
+    , mNumTriangles(0)
+    , mNodes(nullptr)
+    , mVertexIndexBuffer(nullptr)
+    , mMaterialIndexBuffer(nullptr)
+    , mTriangles(nullptr)
+{
+}
+
+MeshCache::~MeshCache() = default;
+
+uint64 MeshCache::CalculateHash(const VertexBufferDesc& desc, const BvhBuildingParams& bvhParams)
+{
+    // thread pool doesn't affect the BVH, so it's not hashed
+    const uint32 bvhParamsData[] =
+    {
+        bvhParams.maxLeafNodeSize,
+        static_cast<uint32>(bvhParams.heuristics),
+        static_cast<uint32>(bvhParams.algorithm),
+        bvhParams.numBins,
+    };
+
+    uint64 hash = Hash((static_cast<uint64>(desc.numVertices) << 32) | static_cast<uint64>(desc.numTriangles));
+    hash = HashData(bvhParamsData, sizeof(bvhParamsData), hash);
+    hash = HashData(desc.positions, sizeof(Float3) * desc.numVertices, hash);
+    hash = HashData(desc.vertexIndexBuffer, sizeof(uint32) * 3 * desc.numTriangles, hash);
+    hash = HashData(desc.materialIndexBuffer, sizeof(uint32) * desc.numTriangles, hash);
+    return hash;
+}
+
+std::string MeshCache::GetFilePath(const std::string& directory, uint64 hash)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".meshcache", hash);
+
+    if (directory.empty())
+    {
+        return fileName;
+    }
+
+    const char lastChar = directory.back();
+    if (lastChar == '/' || lastChar == '\\')
+    {
+        return directory + fileName;
+    }
+
+    return directory + '/' + fileName;
+}
+
+bool MeshCache::Save(const std::string& filePath, uint64 hash, const BVH& bvh,
+                     const uint32* vertexIndexBuffer, const uint32* materialIndexBuffer,
+                     const ProcessedTriangle* triangles, uint32 numTriangles)
+{
+    const std::string tempFilePath = filePath + ".tmp";
+
+    FILE* file = fopen(tempFilePath.c_str(), "wb");
+    if (!file)
+    {
+        RT_LOG_ERROR("Failed to open mesh cache file '%s' for writing. Error code: %i", tempFilePath.c_str(), errno);
+        return false;
+    }
+
+    MeshCacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MeshCacheMagic;
+    header.version = MeshCacheFileVersion;
+    header.hash = hash;
+    header.numNodes = bvh.GetNumNodes();
+    header.numTriangles = numTriangles;
+
+    // header is written twice: first as a placeholder, then with the sections offsets filled
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint64 offset = sizeof(header);
+    success = success && WriteSection(file, bvh.GetNodes(), sizeof(BVH::Node) * header.numNodes, offset, header.nodesOffset);
+    success = success && WriteSection(file, vertexIndexBuffer, sizeof(uint32) * 3 * numTriangles, offset, header.vertexIndexBufferOffset);
+    success = success && WriteSection(file, materialIndexBuffer, sizeof(uint32) * numTriangles, offset, header.materialIndexBufferOffset);
+    success = success && WriteSection(file, triangles, sizeof(ProcessedTriangle) * numTriangles, offset, header.trianglesOffset);
+    success = success && WritePadding(file, offset);
+
+    header.fileSize = offset;
+    success = success && fseek(file, 0, SEEK_SET) == 0;
+    success = success && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if (fclose(file) != 0)
+    {
+        success = false;
+    }
+
+    if (!success)
+    {
+        RT_LOG_ERROR("Failed to write mesh cache file '%s'", tempFilePath.c_str());
+        remove(tempFilePath.c_str());
+        return false;
+    }
+
+    // replace the old file only when the new one is complete
+    // Note: rename() doesn't overwrite existing files on Windows
+    if (rename(tempFilePath.c_str(), filePath.c_str()) != 0)
+    {
+        remove(filePath.c_str());
+        if (rename(tempFilePath.c_str(), filePath.c_str()) != 0)
+        {
+            RT_LOG_ERROR("Failed to rename mesh cache file '%s' to '%s'. Error code: %i", tempFilePath.c_str(), filePath.c_str(), errno);
+            remove(tempFilePath.c_str());
+            return false;
+        }
+    }
+
+    RT_LOG_INFO("Mesh cache file '%s' written (%" PRIu64 " bytes)", filePath.c_str(), header.fileSize);
+    return true;
+}
+
+bool MeshCache::Load(const std::string& filePath, uint64 hash)
+{
+    // missing file is not an error
+    FILE* file = fopen(filePath.c_str(), "rb");
+    if (!file)
+    {
+        RT_LOG_INFO("Mesh cache file '%s' not found", filePath.c_str());
+        return false;
+    }
+    fclose(file);
+
+    if (!mFile.Open(filePath))
+    {
+        return false;
+    }
+
+    if (mFile.GetSize() < sizeof(MeshCacheFileHeader))
+    {
+        RT_LOG_ERROR("Corrupted mesh cache file '%s' (file is too small)", filePath.c_str());
+        mFile.Close();
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(mFile.GetData());
+    const MeshCacheFileHeader& header = *reinterpret_cast<const MeshCacheFileHeader*>(data);
+
+    if (header.magic != MeshCacheMagic)
+    {
+        RT_LOG_ERROR("Corrupted mesh cache file '%s' (invalid magic value)", filePath.c_str());
+        mFile.Close();
+        return false;
+    }
+
+    if (header.version != MeshCacheFileVersion)
+    {
+        RT_LOG_WARNING("Outdated mesh cache file '%s' (version %u, expected %u)", filePath.c_str(), header.version, MeshCacheFileVersion);
+        mFile.Close();
+        return false;
+    }
+
+    if (header.hash != hash)
+    {
+        RT_LOG_WARNING("Mesh cache file '%s' does not match the mesh data", filePath.c_str());
+        mFile.Close();
+        return false;
+    }
+
+    const uint64 numTriangles = header.numTriangles;
+    if (header.fileSize != mFile.GetSize() ||
+        !IsSectionValid(header, header.nodesOffset, sizeof(BVH::Node) * header.numNodes) ||
+        !IsSectionValid(header, header.vertexIndexBufferOffset, sizeof(uint32) * 3 * numTriangles) ||
+        !IsSectionValid(header, header.materialIndexBufferOffset, sizeof(uint32) * numTriangles) ||
+        !IsSectionValid(header, header.trianglesOffset, sizeof(ProcessedTriangle) * numTriangles))
+    {
+        RT_LOG_ERROR("Corrupted mesh cache file '%s' (invalid sections)", filePath.c_str());
+        mFile.Close();
+        return false;
+    }
+
+    mNumNodes = header.numNodes;
+    mNumTriangles = header.numTriangles;
+    mNodes = reinterpret_cast<const BVH::Node*>(data + header.nodesOffset);
+    mVertexIndexBuffer = reinterpret_cast<const uint32*>(data + header.vertexIndexBufferOffset);
+    mMaterialIndexBuffer = reinterpret_cast<const uint32*>(data + header.materialIndexBufferOffset);
+    mTriangles = reinterpret_cast<const ProcessedTriangle*>(data + header.trianglesOffset);
+
+    RT_LOG_INFO("Mesh cache file '%s' loaded (%u BVH nodes, %u triangles)", filePath.c_str(), mNumNodes, mNumTriangles);
+    return true;
+}
+
+} // namespace rt
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VertexBufferDesc.h"
+
+#include "../../BVH/BVH.h"
+#include "../../BVH/BVHBuilder.h"
+#include "../../Math/Triangle.h"
+#include "../../Utils/MappedFile.h"
+
+#include <string>
+
+namespace rt {
+
+// On-disk cache of mesh data that is expensive to compute: BVH nodes, reordered index buffer
+// and preprocessed triangles. Cache files are keyed by hash of the mesh geometry and are memory mapped,
+// so the data can be used directly without any copies.
+class RAYLIB_API MeshCache
+{
+public:
+    MeshCache();
+    ~MeshCache();
+
+    // hash of the mesh data the cache depends on (positions, indices, material indices and BVH building parameters)
+    static uint64 CalculateHash(const VertexBufferDesc& desc, const BvhBuildingParams& bvhParams);
+
+    // cache file path for given cache directory and mesh hash
+    static std::string GetFilePath(const std::string& directory, uint64 hash);
+
+    // write cache file
+    // Note: the data is written to a temporary file first, so a partially written cache file is never picked up
+    static bool Save(const std::string& filePath, uint64 hash, const BVH& bvh,
+                     const uint32* vertexIndexBuffer, const uint32* materialIndexBuffer,
+                     const math::ProcessedTriangle* triangles, uint32 numTriangles);
+
+    // map and validate cache file
+    // Note: returned data pointers are valid as long as the cache object is alive
+    bool Load(const std::string& filePath, uint64 hash);
+
+    RT_FORCE_INLINE uint32 GetNumNodes() const { return mNumNodes; }
+    RT_FORCE_INLINE uint32 GetNumTriangles() const { return mNumTriangles; }
+    RT_FORCE_INLINE const BVH::Node* GetNodes() const { return mNodes; }
+    RT_FORCE_INLINE const uint32* GetVertexIndexBuffer() const { return mVertexIndexBuffer; }
+    RT_FORCE_INLINE const uint32* GetMaterialIndexBuffer() const { return mMaterialIndexBuffer; }
+    RT_FORCE_INLINE const math::ProcessedTriangle* GetTriangles() const { return mTriangles; }
+
+private:
+    MappedFile mFile;
+
+    uint32 mNumNodes;
+    uint32 mNumTriangles;
+    const BVH::Node* mNodes;
+    const uint32* mVertexIndexBuffer;
+    const uint32* mMaterialIndexBuffer;
+    const math::ProcessedTriangle* mTriangles;
+};
+
+} // namespace rt
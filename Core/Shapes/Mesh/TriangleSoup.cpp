@@ -0,0 +1,48 @@
+#include "PCH.h"
+#include "TriangleSoup.h"
+#include "Math/Random.h"
+
+
+namespace rt {
+
+using namespace math;
+
+bool TriangleSoup::Generate(Random& random, uint32 numTriangles, float sceneSize, float triangleSize)
+{
+    const uint32 numVertices = 3 * numTriangles;
+
+    if (!positions.Resize(numVertices) || !normals.Resize(numVertices, Float3(0.0f, 0.0f, 1.0f)) ||
+        !tangents.Resize(numVertices, Float3(1.0f, 0.0f, 0.0f)) || !vertexIndices.Resize(numVertices) ||
+        !materialIndices.Resize(numTriangles, UINT32_MAX))
+    {
+        return false;
+    }
+
+    for (uint32 i = 0; i < numTriangles; ++i)
+    {
+        const Vector4 center = random.GetVector4Bipolar() * sceneSize;
+        for (uint32 j = 0; j < 3; ++j)
+        {
+            const uint32 vertexIndex = 3 * i + j;
+            vertexIndices[vertexIndex] = vertexIndex;
+            positions[vertexIndex] = (center + random.GetVector4Bipolar() * triangleSize).ToFloat3();
+        }
+    }
+
+    return true;
+}
+
+const VertexBufferDesc TriangleSoup::GetVertexBufferDesc() const
+{
+    VertexBufferDesc desc;
+    desc.numTriangles = materialIndices.Size();
+    desc.numVertices = positions.Size();
+    desc.positions = positions.Data();
+    desc.normals = normals.Data();
+    desc.tangents = tangents.Data();
+    desc.vertexIndexBuffer = vertexIndices.Data();
+    desc.materialIndexBuffer = materialIndices.Data();
+    return desc;
+}
+
+} // namespace rt
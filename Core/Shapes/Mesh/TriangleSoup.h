@@ -0,0 +1,30 @@
+#pragma once
+
+#include "VertexBufferDesc.h"
+
+#include "../../Containers/DynArray.h"
+
+namespace rt {
+
+namespace math {
+class Random;
+}
+
+// Random triangle soup (used for testing and benchmarking).
+// Owns the vertex data referenced by the vertex buffer description.
+struct TriangleSoup
+{
+    DynArray<math::Float3> positions;
+    DynArray<math::Float3> normals;
+    DynArray<math::Float3> tangents;
+    DynArray<uint32> vertexIndices;
+    DynArray<uint32> materialIndices;
+
+    // generate triangles with centers in [-sceneSize, sceneSize] cube, each vertex is up to 'triangleSize' away from the center
+    RAYLIB_API bool Generate(math::Random& random, uint32 numTriangles, float sceneSize, float triangleSize = 1.0f);
+
+    // vertex buffer description pointing to the data above (valid as long as the arrays are not resized)
+    RAYLIB_API const VertexBufferDesc GetVertexBufferDesc() const;
+};
+
+} // namespace rt
@@ -17,6 +17,8 @@ using namespace math;
 VertexBuffer::VertexBuffer()
     : mBuffer(nullptr)
     , mPreprocessedTriangles(nullptr)
+    , mOwnsPreprocessedTriangles(false)
+    , mTriangleBlocks(nullptr)
 {
     Clear();
 }
@@ -34,10 +36,17 @@ void VertexBuffer::Clear()
         mBuffer = nullptr;
     }
 
-    if (mPreprocessedTriangles)
+    if (mPreprocessedTriangles && mOwnsPreprocessedTriangles)
     {
-        SystemAllocator::Free(mPreprocessedTriangles);
-        mPreprocessedTriangles = nullptr;
+        SystemAllocator::Free(const_cast<ProcessedTriangle*>(mPreprocessedTriangles));
+    }
+    mPreprocessedTriangles = nullptr;
+    mOwnsPreprocessedTriangles = false;
+
+    if (mTriangleBlocks)
+    {
+        SystemAllocator::Free(mTriangleBlocks);
+        mTriangleBlocks = nullptr;
     }
 
     mNumVertices = 0;
@@ -49,7 +58,7 @@ void VertexBuffer::Clear()
     mMaterials.Clear();
 }
 
-bool VertexBuffer::Initialize(const VertexBufferDesc& desc)
+bool VertexBuffer::Initialize(const VertexBufferDesc& desc, const ProcessedTriangle* externalTriangles)
 {
     Clear();
 
@@ -106,14 +115,22 @@ bool VertexBuffer::Initialize(const VertexBufferDesc& desc)
     }
 
     // preprocess triangles
+    if (externalTriangles)
     {
-        mPreprocessedTriangles = (ProcessedTriangle*)SystemAllocator::Allocate(preprocessedTrianglesBufferSize);
-        if (!mPreprocessedTriangles)
+        mPreprocessedTriangles = externalTriangles;
+    }
+    else
+    {
+        ProcessedTriangle* preprocessedTriangles = (ProcessedTriangle*)SystemAllocator::Allocate(preprocessedTrianglesBufferSize);
+        if (!preprocessedTriangles)
         {
             RT_LOG_ERROR("Memory allocation failed");
             return false;
         }
 
+        mPreprocessedTriangles = preprocessedTriangles;
+        mOwnsPreprocessedTriangles = true;
+
         const Float3* positions = desc.positions;
         const uint32* indexBuffer = desc.vertexIndexBuffer;
 
@@ -123,9 +140,9 @@ bool VertexBuffer::Initialize(const VertexBufferDesc& desc)
             const Vector4 v1(positions[indexBuffer[3 * i + 1]]);
             const Vector4 v2(positions[indexBuffer[3 * i + 2]]);
 
-            mPreprocessedTriangles[i].v0 = v0.ToFloat3();
-            mPreprocessedTriangles[i].edge1 = (v1 - v0).ToFloat3();
-            mPreprocessedTriangles[i].edge2 = (v2 - v0).ToFloat3();
+            preprocessedTriangles[i].v0 = v0.ToFloat3();
+            preprocessedTriangles[i].edge1 = (v1 - v0).ToFloat3();
+            preprocessedTriangles[i].edge2 = (v2 - v0).ToFloat3();
         }
     }
 
@@ -186,6 +203,47 @@ bool VertexBuffer::Initialize(const VertexBufferDesc& desc)
     return true;
 }
 
+bool VertexBuffer::BuildTriangleBlocks()
+{
+    RT_ASSERT(!mTriangleBlocks, "Triangle blocks are already built");
+
+    if (mNumTriangles == 0)
+    {
+        return true;
+    }
+
+    const uint32 numBlocks = (mNumTriangles + 7u) / 8u;
+    mTriangleBlocks = (Triangle_Simd8*)SystemAllocator::Allocate(sizeof(Triangle_Simd8) * numBlocks, alignof(Triangle_Simd8));
+    if (!mTriangleBlocks)
+    {
+        RT_LOG_ERROR("Memory allocation failed");
+        return false;
+    }
+
+    for (uint32 i = 0; i < numBlocks; ++i)
+    {
+        Triangle_Simd8& block = mTriangleBlocks[i];
+        for (uint32 j = 0; j < 8; ++j)
+        {
+            // zero edges make the padding triangles degenerate, so they are never hit
+            const uint32 triangleIndex = 8 * i + j;
+            const ProcessedTriangle tri = triangleIndex < mNumTriangles ? mPreprocessedTriangles[triangleIndex] : ProcessedTriangle(Vector4::Zero(), Vector4::Zero(), Vector4::Zero());
+
+            block.v0.x[j] = tri.v0.x;
+            block.v0.y[j] = tri.v0.y;
+            block.v0.z[j] = tri.v0.z;
+            block.edge1.x[j] = tri.edge1.x;
+            block.edge1.y[j] = tri.edge1.y;
+            block.edge1.z[j] = tri.edge1.z;
+            block.edge2.x[j] = tri.edge2.x;
+            block.edge2.y[j] = tri.edge2.y;
+            block.edge2.z[j] = tri.edge2.z;
+        }
+    }
+
+    return true;
+}
+
 void VertexBuffer::GetVertexIndices(const uint32 triangleIndex, VertexIndices& indices) const
 {
     RT_ASSERT(triangleIndex < mNumTriangles);
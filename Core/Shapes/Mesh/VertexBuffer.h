@@ -4,15 +4,12 @@
 
 #include "../../Math/Vector4.h"
 #include "../../Math/Triangle.h"
+#include "../../Math/Simd8Triangle.h"
 #include "../../Math/Float3.h"
 #include "../../Containers/DynArray.h"
 
 namespace rt {
 
-namespace math {
-class Triangle_Simd8;
-}
-
 class Material;
 
 struct RT_ALIGN(16) VertexIndices
@@ -42,7 +39,13 @@ public:
     void Clear();
 
     // Initialize the vertex buffer with a new content
-    bool Initialize(const VertexBufferDesc& desc);
+    // If 'externalTriangles' is provided, the preprocessed triangles are not calculated, but referenced
+    // directly (e.g. from a memory mapped cache file), so the memory must outlive the vertex buffer.
+    bool Initialize(const VertexBufferDesc& desc, const math::ProcessedTriangle* externalTriangles = nullptr);
+
+    // Build SoA copy of the preprocessed triangles, in blocks of 8 consecutive triangles
+    // (for intersecting single ray with multiple triangles at once).
+    bool BuildTriangleBlocks();
 
     // get vertex indices for given triangle
     void GetVertexIndices(const uint32 triangleIndex, VertexIndices& indices) const;
@@ -54,15 +57,25 @@ public:
     const math::ProcessedTriangle& GetTriangle(const uint32 triangleIndex) const;
     void GetTriangle(const uint32 triangleIndex, math::Triangle_Simd8& outTriangle) const;
 
+    // get block containing triangles [8 * blockIndex, 8 * blockIndex + 7]
+    // Note: lanes past the last triangle are filled with degenerate triangles
+    RT_FORCE_INLINE const math::Triangle_Simd8& GetTriangleBlock(const uint32 blockIndex) const { return mTriangleBlocks[blockIndex]; }
+    RT_FORCE_INLINE bool HasTriangleBlocks() const { return mTriangleBlocks != nullptr; }
+
     void GetShadingData(const VertexIndices& indices, VertexShadingData& a, VertexShadingData& b, VertexShadingData& c) const;
 
+    RT_FORCE_INLINE const math::ProcessedTriangle* GetTriangles() const { return mPreprocessedTriangles; }
+
     RT_FORCE_INLINE uint32 GetNumVertices() const { return mNumVertices; }
     RT_FORCE_INLINE uint32 GetNumTriangles() const { return mNumTriangles; }
 
 private:
 
     char* mBuffer;
-    math::ProcessedTriangle* mPreprocessedTriangles;
+    const math::ProcessedTriangle* mPreprocessedTriangles;
+    bool mOwnsPreprocessedTriangles;
+
+    math::Triangle_Simd8* mTriangleBlocks;
 
     size_t mVertexIndexBufferOffset;
     size_t mShadingDataBufferOffset;
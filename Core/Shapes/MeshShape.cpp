@@ -1,12 +1,18 @@
 #include "PCH.h"
 
 #include "MeshShape.h"
+#include "Mesh/MeshCache.h"
 #include "BVH/BVHBuilder.h"
 
 #include "Rendering/Context.h"
 #include "Rendering/ShadingData.h"
+#include "Material/Material.h"
 #include "Traversal/TraversalContext.h"
 #include "Traversal/Traversal_Single.h"
+#include "Traversal/Traversal_Wide.h"
+#include "Traversal/Traversal_Quantized.h"
+#include "Traversal/Traversal_Simd.h"
+#include "Traversal/Traversal_Packet.h"
 
 #include "Math/Geometry.h"
 #include "Math/Simd8Geometry.h"
@@ -19,6 +25,8 @@ namespace rt {
 using namespace math;
 
 MeshShape::MeshShape()
+    : mBvhFormat(BvhFormat::Binary)
+    , mHasMaskedMaterials(false)
 {
 }
 
@@ -33,29 +41,35 @@ const Box MeshShape::GetBoundingBox() const
 
 bool MeshShape::Initialize(const MeshDesc& desc)
 {
-    mBoundingBox = Box::Empty();
+    mVertexBuffer.Clear();
+    mBVH = BVH();
+    mCache.reset();
 
-    const Float3* positions = desc.vertexBufferDesc.positions;
-    const uint32* indexBuffer = desc.vertexBufferDesc.vertexIndexBuffer;
-
-    DynArray<Box> boxes;
-    boxes.Reserve(desc.vertexBufferDesc.numTriangles);
-    for (uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+    if (desc.maxLeafSize == 0 || desc.maxLeafSize > UINT16_MAX)
     {
-        const Vector4 v0(positions[indexBuffer[3 * i + 0]]);
-        const Vector4 v1(positions[indexBuffer[3 * i + 1]]);
-        const Vector4 v2(positions[indexBuffer[3 * i + 2]]);
+        RT_LOG_ERROR("Invalid max BVH leaf size: %u", desc.maxLeafSize);
+        return false;
+    }
 
-        Box triBox(v0, v1, v2);
+    bool initialized = false;
 
-        boxes.PushBack(triBox);
+    if (!desc.cacheDirectory.empty() && desc.vertexBufferDesc.numTriangles > 0)
+    {
+        const uint64 cacheHash = MeshCache::CalculateHash(desc.vertexBufferDesc, GetBvhBuildingParams(desc));
+        const std::string cacheFilePath = MeshCache::GetFilePath(desc.cacheDirectory, cacheHash);
 
-        mBoundingBox = Box(mBoundingBox, triBox);
+        initialized = InitializeFromCache(desc, cacheFilePath, cacheHash);
+        if (!initialized)
+        {
+            initialized = InitializeFromScratch(desc, cacheFilePath, cacheHash);
+        }
+    }
+    else
+    {
+        initialized = InitializeFromScratch(desc, std::string(), 0);
     }
 
-    BVHBuilder::Indices newTrianglesOrder;
-    BVHBuilder bvhBuilder(mBVH);
-    if (!bvhBuilder.Build(boxes.Data(), desc.vertexBufferDesc.numTriangles, BvhBuildingParams(), newTrianglesOrder))
+    if (!initialized)
     {
         return false;
     }
@@ -79,6 +93,126 @@ bool MeshShape::Initialize(const MeshDesc& desc)
         RT_LOG_INFO("    - leaf nodes histogram: %s", str.str().c_str());
     }
 
+    mHasMaskedMaterials = false;
+    for (uint32 i = 0; i < desc.vertexBufferDesc.numMaterials; ++i)
+    {
+        const MaterialPtr& material = desc.vertexBufferDesc.materials[i];
+        if (material && material->maskMap)
+        {
+            mHasMaskedMaterials = true;
+        }
+    }
+
+    if (desc.useTriangleBlocks)
+    {
+        if (!mVertexBuffer.BuildTriangleBlocks())
+        {
+            return false;
+        }
+    }
+
+    mBvhFormat = desc.bvhFormat;
+    mBVH4.Clear();
+    mBVH8.Clear();
+    mQuantizedBVH.Clear();
+
+    if (mBvhFormat == BvhFormat::Wide4)
+    {
+        if (!mBVH4.Build(mBVH))
+        {
+            return false;
+        }
+    }
+    else if (mBvhFormat == BvhFormat::Wide8)
+    {
+        if (!mBVH8.Build(mBVH))
+        {
+            return false;
+        }
+    }
+    else if (mBvhFormat == BvhFormat::Quantized)
+    {
+        if (!mQuantizedBVH.Build(mBVH))
+        {
+            return false;
+        }
+    }
+
+    // the binary BVH is only needed for building other formats
+    if (mBvhFormat != BvhFormat::Binary)
+    {
+        mBVH = BVH();
+    }
+
+    RT_LOG_INFO("MeshShape '%s' created successfully", !desc.path.empty() ? desc.path.c_str() : "unnamed");
+    return true;
+}
+
+bool MeshShape::InitializeFromCache(const MeshDesc& desc, const std::string& cacheFilePath, uint64 cacheHash)
+{
+    std::unique_ptr<MeshCache> cache = std::make_unique<MeshCache>();
+    if (!cache->Load(cacheFilePath, cacheHash))
+    {
+        return false;
+    }
+
+    if (cache->GetNumTriangles() != desc.vertexBufferDesc.numTriangles || cache->GetNumNodes() == 0)
+    {
+        RT_LOG_WARNING("Mesh cache file '%s' does not match the mesh data", cacheFilePath.c_str());
+        return false;
+    }
+
+    // index buffers and preprocessed triangles are already in the BVH leaves order
+    VertexBufferDesc vertexBufferDesc = desc.vertexBufferDesc;
+    vertexBufferDesc.vertexIndexBuffer = cache->GetVertexIndexBuffer();
+    vertexBufferDesc.materialIndexBuffer = cache->GetMaterialIndexBuffer();
+
+    if (!mVertexBuffer.Initialize(vertexBufferDesc, cache->GetTriangles()))
+    {
+        RT_LOG_ERROR("Failed to initialize vertex buffer");
+        return false;
+    }
+
+    mBVH.InitializeExternal(cache->GetNodes(), cache->GetNumNodes());
+
+    // root node bounds are the mesh bounds
+    mBoundingBox = mBVH.GetNodes()[0].GetBox();
+
+    mCache = std::move(cache);
+    return true;
+}
+
+bool MeshShape::InitializeFromScratch(const MeshDesc& desc, const std::string& cacheFilePath, uint64 cacheHash)
+{
+    mBoundingBox = Box::Empty();
+
+    const Float3* positions = desc.vertexBufferDesc.positions;
+    const uint32* indexBuffer = desc.vertexBufferDesc.vertexIndexBuffer;
+
+    DynArray<Box> boxes;
+    boxes.Reserve(desc.vertexBufferDesc.numTriangles);
+    for (uint32 i = 0; i < desc.vertexBufferDesc.numTriangles; ++i)
+    {
+        const Vector4 v0(positions[indexBuffer[3 * i + 0]]);
+        const Vector4 v1(positions[indexBuffer[3 * i + 1]]);
+        const Vector4 v2(positions[indexBuffer[3 * i + 2]]);
+
+        Box triBox(v0, v1, v2);
+
+        boxes.PushBack(triBox);
+
+        mBoundingBox = Box(mBoundingBox, triBox);
+    }
+
+    const BvhBuildingParams params = GetBvhBuildingParams(desc);
+
+    BVHBuilder::Indices newTrianglesOrder;
+    BVHBuilder bvhBuilder(mBVH);
+    if (!bvhBuilder.Build(boxes.Data(), desc.vertexBufferDesc.numTriangles, params, newTrianglesOrder))
+    {
+        return false;
+    }
+
     // reorder triangles
     {
         DynArray<uint32> newIndexBuffer(desc.vertexBufferDesc.numTriangles * 3);
@@ -103,14 +237,34 @@ bool MeshShape::Initialize(const MeshDesc& desc)
             RT_LOG_ERROR("Failed to initialize vertex buffer");
             return false;
         }
-    }
 
-    // TODO reorder indices
+        if (!cacheFilePath.empty())
+        {
+            MeshCache::Save(cacheFilePath, cacheHash, mBVH, newIndexBuffer.Data(), newMaterialIndexBuffer.Data(),
+                            mVertexBuffer.GetTriangles(), desc.vertexBufferDesc.numTriangles);
+        }
+    }
 
-    RT_LOG_INFO("MeshShape '%s' created successfully", !desc.path.empty() ? desc.path.c_str() : "unnamed");
     return true;
 }
 
+BvhBuildingParams MeshShape::GetBvhBuildingParams(const MeshDesc& desc)
+{
+    BvhBuildingParams params;
+    params.maxLeafNodeSize = desc.maxLeafSize;
+    params.threadPool = desc.threadPool;
+    return params;
+}
+
+size_t MeshShape::GetBvhMemorySize() const
+{
+    // all the BVHs that are kept in memory
+    return mBVH.GetNumNodes() * sizeof(BVH::Node) +
+        mBVH4.GetNumNodes() * sizeof(BVH4::Node) +
+        mBVH8.GetNumNodes() * sizeof(BVH8::Node) +
+        mQuantizedBVH.GetMemorySize();
+}
+
 float MeshShape::GetSurfaceArea() const
 {
     RT_FATAL("Not implemented yet");
@@ -128,7 +282,69 @@ const Vector4 MeshShape::Sample(const Float3& u, math::Vector4* outNormal, float
 
 void MeshShape::Traverse(const SingleTraversalContext& context, const uint32 objectID) const
 {
-    GenericTraverse<MeshShape>(context, objectID, this);
+    switch (mBvhFormat)
+    {
+        case BvhFormat::Wide4:
+            GenericTraverse_Wide<4, MeshShape>(context, objectID, this, mBVH4);
+            break;
+        case BvhFormat::Wide8:
+            GenericTraverse_Wide<8, MeshShape>(context, objectID, this, mBVH8);
+            break;
+        case BvhFormat::Quantized:
+            GenericTraverse_Quantized<MeshShape>(context, objectID, this, mQuantizedBVH);
+            break;
+        default:
+            GenericTraverse<MeshShape>(context, objectID, this);
+    }
+}
+
+// Note: SIMD-8 and packet traversal are implemented only for the binary BVH,
+// with other formats the rays are traced one by one (the binary BVH is not kept in memory then)
+
+void MeshShape::Traverse(const SimdTraversalContext& context, const uint32 objectID) const
+{
+    if (mBvhFormat == BvhFormat::Binary)
+    {
+        GenericTraverse<MeshShape>(context, objectID, this);
+    }
+    else
+    {
+        GenericTraverse_SingleRays<MeshShape>(context, objectID, this);
+    }
+}
+
+void MeshShape::Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const
+{
+    if (mBvhFormat == BvhFormat::Binary)
+    {
+        GenericTraverse<MeshShape, 1>(context, objectID, this, numActiveGroups);
+    }
+    else
+    {
+        GenericTraverse_SingleRays<MeshShape>(context, objectID, this, numActiveGroups);
+    }
+}
+
+uint32 MeshShape::Traverse_Shadow(const SimdTraversalContext& context) const
+{
+    if (mBvhFormat == BvhFormat::Binary)
+    {
+        return GenericTraverse_Shadow<MeshShape>(context, this);
+    }
+
+    return GenericTraverse_Shadow_SingleRays<MeshShape>(context, this);
+}
+
+void MeshShape::Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const
+{
+    if (mBvhFormat == BvhFormat::Binary)
+    {
+        GenericTraverse_Shadow<MeshShape, 1>(context, this, numActiveGroups);
+    }
+    else
+    {
+        GenericTraverse_Shadow_SingleRays<MeshShape>(context, this, numActiveGroups);
+    }
 }
 
 void MeshShape::Traverse_Leaf(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
@@ -136,9 +352,18 @@ void MeshShape::Traverse_Leaf(const SingleTraversalContext& context, const uint3
     float distance, u, v;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-    context.context.localCounters.numRayTriangleTests += node.numLeaves;
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += node.numLeaves;
+    }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
+    if (mVertexBuffer.HasTriangleBlocks())
+    {
+        Traverse_Leaf_Blocks<false>(context, objectID, node);
+        return;
+    }
+
     const uint32 numLeaves = node.numLeaves;
     const uint32 childIndex = node.childIndex;
 
@@ -151,7 +376,7 @@ void MeshShape::Traverse_Leaf(const SingleTraversalContext& context, const uint3
         {
             HitPoint& hitPoint = context.hitPoint;
 
-            if (distance < hitPoint.distance)
+            if (distance < hitPoint.distance && AcceptHit(triangleIndex, u, v))
             {
                 hitPoint.distance = distance;
                 hitPoint.subObjectId = triangleIndex;
@@ -160,7 +385,10 @@ void MeshShape::Traverse_Leaf(const SingleTraversalContext& context, const uint3
                 hitPoint.v = v;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-                context.context.localCounters.numPassedRayTriangleTests++;
+                if (context.context.localCounters.enabled)
+                {
+                    context.context.localCounters.numPassedRayTriangleTests++;
+                }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
             }
         }
@@ -169,7 +397,17 @@ void MeshShape::Traverse_Leaf(const SingleTraversalContext& context, const uint3
 
 bool MeshShape::Traverse_Shadow(const SingleTraversalContext& context) const
 {
-    return GenericTraverse_Shadow<MeshShape>(context, this);
+    switch (mBvhFormat)
+    {
+        case BvhFormat::Wide4:
+            return GenericTraverse_Wide_Shadow<4, MeshShape>(context, this, mBVH4);
+        case BvhFormat::Wide8:
+            return GenericTraverse_Wide_Shadow<8, MeshShape>(context, this, mBVH8);
+        case BvhFormat::Quantized:
+            return GenericTraverse_Quantized_Shadow<MeshShape>(context, this, mQuantizedBVH);
+        default:
+            return GenericTraverse_Shadow<MeshShape>(context, this);
+    }
 }
 
 bool MeshShape::Traverse_Leaf_Shadow(const SingleTraversalContext& context, const BVH::Node& node) const
@@ -177,9 +415,17 @@ bool MeshShape::Traverse_Leaf_Shadow(const SingleTraversalContext& context, cons
     float distance, u, v;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-    context.context.localCounters.numRayTriangleTests += node.numLeaves;
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += node.numLeaves;
+    }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
+    if (mVertexBuffer.HasTriangleBlocks())
+    {
+        return Traverse_Leaf_Blocks<true>(context, 0, node);
+    }
+
     const uint32 numLeaves = node.numLeaves;
     const uint32 childIndex = node.childIndex;
 
@@ -190,12 +436,15 @@ bool MeshShape::Traverse_Leaf_Shadow(const SingleTraversalContext& context, cons
         if (Intersect_TriangleRay(context.ray, Vector4(&tri.v0.x), Vector4(&tri.edge1.x), Vector4(&tri.edge2.x), u, v, distance))
         {
             HitPoint& hitPoint = context.hitPoint;
-            if (distance < hitPoint.distance)
+            if (distance < hitPoint.distance && AcceptHit(triangleIndex, u, v))
             {
                 hitPoint.distance = distance;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-                context.context.localCounters.numPassedRayTriangleTests++;
+                if (context.context.localCounters.enabled)
+                {
+                    context.context.localCounters.numPassedRayTriangleTests++;
+                }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
                 return true;
@@ -206,46 +455,108 @@ bool MeshShape::Traverse_Leaf_Shadow(const SingleTraversalContext& context, cons
     return false;
 }
 
-/*
-void MeshShape::Traverse_Leaf_Simd8(const SimdTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
+template<bool Shadow>
+bool MeshShape::Traverse_Leaf_Blocks(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
+{
+    HitPoint& hitPoint = context.hitPoint;
+    Vector8 distance, u, v;
+    bool hitFound = false;
+
+    // leaf triangles don't have to be aligned to the blocks - lanes of the neighbouring leaves are masked out
+    const uint32 firstTriangle = node.childIndex;
+    const uint32 endTriangle = node.childIndex + node.numLeaves;
+
+    for (uint32 blockStart = firstTriangle & ~7u; blockStart < endTriangle; blockStart += 8)
+    {
+        const uint32 firstLane = blockStart < firstTriangle ? firstTriangle - blockStart : 0;
+        const uint32 endLane = Min(8u, endTriangle - blockStart);
+        const uint32 lanesMask = ((1u << endLane) - 1u) & ~((1u << firstLane) - 1u);
+
+        const Triangle_Simd8& tri = mVertexBuffer.GetTriangleBlock(blockStart / 8);
+        uint32 hitMask = lanesMask & Intersect_TriangleRay_Simd8(context.ray, tri, hitPoint.distance, u, v, distance).GetMask();
+
+        // there are rarely more than one hit in a block
+        while (hitMask)
+        {
+            const uint32 lane = FirstBitSet(hitMask);
+            hitMask &= hitMask - 1;
+
+            if (distance[lane] < hitPoint.distance && AcceptHit(blockStart + lane, u[lane], v[lane]))
+            {
+                hitPoint.distance = distance[lane];
+                hitFound = true;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+                if (context.context.localCounters.enabled)
+                {
+                    context.context.localCounters.numPassedRayTriangleTests++;
+                }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+                if (Shadow)
+                {
+                    return true;
+                }
+
+                hitPoint.subObjectId = blockStart + lane;
+                hitPoint.objectId = objectID;
+                hitPoint.u = u[lane];
+                hitPoint.v = v[lane];
+            }
+        }
+    }
+
+    return hitFound;
+}
+
+void MeshShape::Traverse_Leaf(const SimdTraversalContext& context, const uint32 objectID, const BVH::Node& node) const
 {
-    const VectorInt8 objectIndexVec(objectID);
+    const Vector8 objectIndexVec = VectorInt8(objectID).CastToFloat();
 
     Vector8 distance, u, v;
     Triangle_Simd8 tri;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves;
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves;
+    }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
+    HitPoint_Simd8& hitPoint = context.hitPoint;
+
     for (uint32 i = 0; i < node.numLeaves; ++i)
     {
-        HitPoint_Simd8& hitPoint = context.hitPoint;
         const uint32 triangleIndex = node.childIndex + i;
-        const VectorInt8 triangleIndexVec(triangleIndex);
+        const Vector8 triangleIndexVec = VectorInt8(triangleIndex).CastToFloat();
 
         mVertexBuffer.GetTriangle(triangleIndex, tri);
 
-        const Vector8 mask = Intersect_TriangleRay_Simd8(context.ray.dir, context.ray.origin, tri, hitPoint.distance, u, v, distance);
-        const uint32 intMask = mask.GetSignMask();
+        VectorBool8 mask = Intersect_TriangleRay_Simd8(context.ray.dir, context.ray.origin, tri, hitPoint.distance, u, v, distance);
+        if (mHasMaskedMaterials)
+        {
+            mask = FilterHits(triangleIndex, u, v, mask);
+        }
+        const uint32 intMask = mask.GetMask();
 
-        // TODO triangle & object filtering
         if (intMask)
         {
             // combine results according to mask
-            hitPoint.u = Vector8::SelectBySign(hitPoint.u, u, mask);
-            hitPoint.v = Vector8::SelectBySign(hitPoint.v, v, mask);
-            hitPoint.distance = Vector8::SelectBySign(hitPoint.distance, distance, mask);
-            hitPoint.subObjectId = VectorInt8::SelectBySign(hitPoint.subObjectId, triangleIndexVec, VectorInt8::Cast(mask));
-            hitPoint.objectId = VectorInt8::SelectBySign(hitPoint.objectId, objectIndexVec, VectorInt8::Cast(mask));
+            hitPoint.u = Vector8::Select(hitPoint.u, u, mask);
+            hitPoint.v = Vector8::Select(hitPoint.v, v, mask);
+            hitPoint.distance = Vector8::Select(hitPoint.distance, distance, mask);
+            hitPoint.subObjectId = VectorInt8::Cast(Vector8::Select(hitPoint.subObjectId.CastToFloat(), triangleIndexVec, mask));
+            hitPoint.objectId = VectorInt8::Cast(Vector8::Select(hitPoint.objectId.CastToFloat(), objectIndexVec, mask));
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+            }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
         }
     }
 }
-*/
 
 void MeshShape::Traverse_Leaf(const PacketTraversalContext& context, const uint32 objectID, const BVH::Node& node, const uint32 numActiveGroups) const
 {
@@ -253,7 +564,10 @@ void MeshShape::Traverse_Leaf(const PacketTraversalContext& context, const uint3
     Triangle_Simd8 tri;
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-    context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+    }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
     for (uint32 i = 0; i < node.numLeaves; ++i)
@@ -267,19 +581,163 @@ void MeshShape::Traverse_Leaf(const PacketTraversalContext& context, const uint3
         {
             RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
 
-            const VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+            VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+            if (mHasMaskedMaterials)
+            {
+                mask = FilterHits(triangleIndex, u, v, mask);
+            }
 
             context.StoreIntersection(rayGroup, distance, u, v, mask, objectID, triangleIndex);
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numPassedRayTriangleTests += PopCount(mask.GetMask());
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numPassedRayTriangleTests += PopCount(mask.GetMask());
+            }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
         }
     }
 }
 
+uint32 MeshShape::Traverse_Leaf_Shadow(const SimdTraversalContext& context, const BVH::Node& node) const
+{
+    Vector8 distance, u, v;
+    Triangle_Simd8 tri;
+
+    HitPoint_Simd8& hitPoint = context.hitPoint;
+
+    const uint32 activeRaysMask = static_cast<uint32>((Vector8::Zero() < hitPoint.distance).GetMask());
+    uint32 occludedRaysMask = 0;
+
+    uint32 i = 0;
+    for (; i < node.numLeaves && occludedRaysMask != activeRaysMask; ++i)
+    {
+        const uint32 triangleIndex = node.childIndex + i;
+
+        mVertexBuffer.GetTriangle(triangleIndex, tri);
+
+        VectorBool8 mask = Intersect_TriangleRay_Simd8(context.ray.dir, context.ray.origin, tri, hitPoint.distance, u, v, distance);
+        if (mHasMaskedMaterials)
+        {
+            mask = FilterHits(triangleIndex, u, v, mask);
+        }
+        const uint32 intMask = mask.GetMask();
+
+        if (intMask)
+        {
+            // terminate occluded rays
+            hitPoint.distance = Vector8::Select(hitPoint.distance, Vector8(-FLT_MAX), mask);
+            occludedRaysMask |= intMask;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+            }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+        }
+    }
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += 8 * i;
+    }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    return occludedRaysMask;
+}
+
+void MeshShape::Traverse_Leaf_Shadow(const PacketTraversalContext& context, const BVH::Node& node, const uint32 numActiveGroups) const
+{
+    Vector8 distance, u, v;
+    Triangle_Simd8 tri;
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    if (context.context.localCounters.enabled)
+    {
+        context.context.localCounters.numRayTriangleTests += 8 * node.numLeaves * numActiveGroups;
+    }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    for (uint32 i = 0; i < node.numLeaves; ++i)
+    {
+        const uint32 triangleIndex = node.childIndex + i;
+
+        mVertexBuffer.GetTriangle(triangleIndex, tri);
+
+        for (uint32 j = 0; j < numActiveGroups; ++j)
+        {
+            RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[j]];
+
+            // Note: occluded rays have negative max distance, so they can't be hit again
+            VectorBool8 mask = Intersect_TriangleRay_Simd8(rayGroup.rays[1].dir, rayGroup.rays[1].origin, tri, rayGroup.maxDistances, u, v, distance);
+            if (mHasMaskedMaterials)
+            {
+                mask = FilterHits(triangleIndex, u, v, mask);
+            }
+
+            const uint32 intMask = mask.GetMask();
+            if (intMask)
+            {
+                context.StoreOcclusion(rayGroup, intMask);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+                if (context.context.localCounters.enabled)
+                {
+                    context.context.localCounters.numPassedRayTriangleTests += PopCount(intMask);
+                }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+            }
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+const VectorBool8 MeshShape::FilterHits(const uint32 triangleIndex, const Vector8& u, const Vector8& v, const VectorBool8& mask) const
+{
+    const uint32 intMask = mask.GetMask();
+    if (intMask == 0)
+    {
+        return mask;
+    }
+
+    bool accepted[8];
+    for (uint32 i = 0; i < 8; ++i)
+    {
+        accepted[i] = ((intMask >> i) & 1u) && EvaluateMask(triangleIndex, u[i], v[i]);
+    }
+
+    return VectorBool8(accepted[0], accepted[1], accepted[2], accepted[3], accepted[4], accepted[5], accepted[6], accepted[7]);
+}
+
+bool MeshShape::EvaluateMask(const uint32 triangleIndex, const float u, const float v) const
+{
+    VertexIndices indices;
+    mVertexBuffer.GetVertexIndices(triangleIndex, indices);
+
+    if (indices.materialIndex == UINT32_MAX)
+    {
+        return true;
+    }
+
+    const Material* material = mVertexBuffer.GetMaterial(indices.materialIndex);
+    if (!material->maskMap)
+    {
+        return true;
+    }
+
+    VertexShadingData vertexShadingData[3];
+    mVertexBuffer.GetShadingData(indices, vertexShadingData[0], vertexShadingData[1], vertexShadingData[2]);
+
+    Vector4 texCoord = Vector4(vertexShadingData[1].texCoord) * u;
+    texCoord = Vector4::MulAndAdd(Vector4(vertexShadingData[2].texCoord), v, texCoord);
+    texCoord = Vector4::MulAndAdd(Vector4(vertexShadingData[0].texCoord), 1.0f - u - v, texCoord);
+
+    return material->GetMaskValue(texCoord);
+}
+
 void MeshShape::EvaluateIntersection(const HitPoint& hitPoint, IntersectionData& outData) const
  {
     VertexIndices indices;
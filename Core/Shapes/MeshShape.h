@@ -5,6 +5,9 @@
 
 #include "../Traversal/HitPoint.h"
 #include "../BVH/BVH.h"
+#include "../BVH/BVHBuilder.h"
+#include "../BVH/WideBVH.h"
+#include "../BVH/QuantizedBVH.h"
 
 #include "../Math/Box.h"
 #include "../Math/Ray.h"
@@ -14,13 +17,33 @@
 namespace rt {
 
 struct IntersectionData;
+class MeshCache;
+class ThreadPool;
 struct SingleTraversalContext;
+struct SimdTraversalContext;
 struct PacketTraversalContext;
 
 struct MeshDesc
 {
     VertexBufferDesc vertexBufferDesc;
     std::string path;
+
+    // BVH node format
+    // Note: only binary BVH supports SIMD-8 and packet traversal, with other formats such rays are traced one by one
+    BvhFormat bvhFormat = BvhFormat::Binary;
+
+    // max number of triangles in BVH leaf nodes
+    uint32 maxLeafSize = 2;
+
+    // intersect single rays with leaf triangles in SIMD blocks of 8 instead of one by one
+    // (pays off with bigger leaves, as the BVH gets shallower)
+    bool useTriangleBlocks = false;
+
+    // directory for mesh cache files (BVH and preprocessed triangles), caching is disabled if empty
+    std::string cacheDirectory;
+
+    // optional thread pool used for building the BVH (should be shared when loading many meshes)
+    ThreadPool* threadPool = nullptr;
 };
 
 class RT_ALIGN(16) MeshShape : public IShape
@@ -36,22 +59,63 @@ public:
     virtual const math::Box GetBoundingBox() const override;
     virtual float GetSurfaceArea() const override;
     virtual void Traverse(const SingleTraversalContext& context, const uint32 objectID) const override;
+    virtual void Traverse(const SimdTraversalContext& context, const uint32 objectID) const override;
+    virtual void Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const override;
     virtual bool Traverse_Shadow(const SingleTraversalContext& context) const override;
+    virtual uint32 Traverse_Shadow(const SimdTraversalContext& context) const override;
+    virtual void Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const override;
     virtual const math::Vector4 Sample(const math::Float3& u, math::Vector4 * outNormal, float* outPdf = nullptr) const override;
     virtual void EvaluateIntersection(const HitPoint& hitPoint, IntersectionData& outIntersectionData) const override;
 
+    // binary BVH (empty if other BVH format was selected)
     RT_FORCE_INLINE const BVH& GetBVH() const { return mBVH; }
 
+    // size (in bytes) of all the BVH nodes kept in memory
+    RAYLIB_API size_t GetBvhMemorySize() const;
+
+    // BVH building parameters for given mesh description (mesh cache files depend on them)
+    RAYLIB_API static BvhBuildingParams GetBvhBuildingParams(const MeshDesc& desc);
+
     // Intersect ray(s) with BVH leaf
     void Traverse_Leaf(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const;
+    void Traverse_Leaf(const SimdTraversalContext& context, const uint32 objectID, const BVH::Node& node) const;
     void Traverse_Leaf(const PacketTraversalContext& context, const uint32 objectID, const BVH::Node& node, const uint32 numActiveGroups) const;
 
     // Intersect shadow ray(s) with BVH leaf
-    // Returns true if any hit was found
+    // Returns true if any hit was found (or bitmask of occluded rays for SIMD-8 ray)
     bool Traverse_Leaf_Shadow(const SingleTraversalContext& context, const BVH::Node& node) const;
+    uint32 Traverse_Leaf_Shadow(const SimdTraversalContext& context, const BVH::Node& node) const;
+    void Traverse_Leaf_Shadow(const PacketTraversalContext& context, const BVH::Node& node, const uint32 numActiveGroups) const;
 
 private:
 
+    // intersect single ray with leaf triangles using SoA triangle blocks
+    // in shadow mode returns on the first hit found
+    template<bool Shadow>
+    bool Traverse_Leaf_Blocks(const SingleTraversalContext& context, const uint32 objectID, const BVH::Node& node) const;
+
+    // any-hit test, called for every ray-triangle hit found
+    // returns false if the hit should be ignored (transparent part of alpha-masked material)
+    RT_FORCE_INLINE bool AcceptHit(const uint32 triangleIndex, const float u, const float v) const
+    {
+        return !mHasMaskedMaterials || EvaluateMask(triangleIndex, u, v);
+    }
+
+    // apply any-hit test to all the hits found in SIMD traversal
+    const math::VectorBool8 FilterHits(const uint32 triangleIndex, const math::Vector8& u, const math::Vector8& v, const math::VectorBool8& mask) const;
+
+    // evaluate alpha mask of triangle's material at given barycentric coordinates
+    bool EvaluateMask(const uint32 triangleIndex, const float u, const float v) const;
+
+    // try to initialize BVH and vertex buffer from a cache file
+    bool InitializeFromCache(const MeshDesc& desc, const std::string& cacheFilePath, uint64 cacheHash);
+
+    // build BVH and vertex buffer from scratch (and write the cache file if the path is not empty)
+    bool InitializeFromScratch(const MeshDesc& desc, const std::string& cacheFilePath, uint64 cacheHash);
+
+    // memory mapped cache file (BVH and vertex buffer may reference its data)
+    std::unique_ptr<MeshCache> mCache;
+
     // bounding box after scaling
     math::Box mBoundingBox;
 
@@ -61,6 +125,15 @@ private:
     // bounding volume hierarchy for tracing acceleration
     BVH mBVH;
 
+    // optional collapsed or quantized BVH (replaces the binary one)
+    BVH4 mBVH4;
+    BVH8 mBVH8;
+    QuantizedBVH mQuantizedBVH;
+    BvhFormat mBvhFormat;
+
+    // set if any of the materials has alpha mask (so hits need to be validated)
+    bool mHasMaskedMaterials;
+
     std::string mPath;
 };
 
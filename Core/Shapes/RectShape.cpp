@@ -29,6 +29,12 @@ float RectShape::GetSurfaceArea() const
     return 4.0f * mSize.x * mSize.y;
 }
 
+void RectShape::GetNormalCone(Vector4& outAxis, float& outCosAngle) const
+{
+    outAxis = VECTOR_Z;
+    outCosAngle = 1.0f;
+}
+
 bool RectShape::Intersect(const math::Ray& ray, ShapeIntersection& outResult) const
 {
     const float t = -ray.origin.z * ray.invDir.z;
@@ -12,6 +12,7 @@ public:
 private:
     virtual const math::Box GetBoundingBox() const override;
     virtual float GetSurfaceArea() const override;
+    virtual void GetNormalCone(math::Vector4& outAxis, float& outCosAngle) const override;
     virtual bool Intersect(const math::Ray& ray, ShapeIntersection& outResult) const override;
     virtual const math::Vector4 Sample(const math::Float3& u, math::Vector4* outNormal, float* outPdf = nullptr) const override;
     virtual bool Sample(const math::Vector4& ref, const math::Float3& u, ShapeSampleResult& result) const override;
@@ -1,6 +1,8 @@
 #include "PCH.h"
 #include "Shape.h"
 #include "Traversal/TraversalContext.h"
+#include "Traversal/Traversal_Simd.h"
+#include "Traversal/Traversal_Packet.h"
 
 namespace rt {
 
@@ -44,6 +46,16 @@ void IShape::Traverse(const SingleTraversalContext& context, const uint32 object
     }
 }
 
+void IShape::Traverse(const SimdTraversalContext& context, const uint32 objectID) const
+{
+    GenericTraverse_SingleRays(context, objectID, this);
+}
+
+void IShape::Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const
+{
+    GenericTraverse_SingleRays(context, objectID, this, numActiveGroups);
+}
+
 bool IShape::Traverse_Shadow(const SingleTraversalContext& context) const
 {
     ShapeIntersection intersection;
@@ -56,6 +68,16 @@ bool IShape::Traverse_Shadow(const SingleTraversalContext& context) const
     return intersection.farDist > 0.0f && intersection.nearDist < context.hitPoint.distance;
 }
 
+uint32 IShape::Traverse_Shadow(const SimdTraversalContext& context) const
+{
+    return GenericTraverse_Shadow_SingleRays(context, this);
+}
+
+void IShape::Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const
+{
+    GenericTraverse_Shadow_SingleRays(context, this, numActiveGroups);
+}
+
 bool IShape::Intersect(const Ray&, ShapeIntersection&) const
 {
     RT_FATAL("This shape has no volume");
@@ -98,4 +120,10 @@ float IShape::Pdf(const math::Vector4& ref, const math::Vector4& point) const
     return 1.0f / GetSurfaceArea();
 }
 
+void IShape::GetNormalCone(Vector4& outAxis, float& outCosAngle) const
+{
+    outAxis = VECTOR_Z;
+    outCosAngle = -1.0f;
+}
+
 } // namespace rt
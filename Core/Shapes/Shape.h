@@ -13,6 +13,8 @@ namespace rt {
 struct HitPoint;
 struct IntersectionData;
 struct SingleTraversalContext;
+struct SimdTraversalContext;
+struct PacketTraversalContext;
 
 class Material;
 using MaterialPtr = std::shared_ptr<rt::Material>;
@@ -46,9 +48,26 @@ public:
     // traverse the object and find nearest intersection
     virtual void Traverse(const SingleTraversalContext& context, const uint32 objectID) const;
 
+    // traverse the object with SIMD-8 ray (rays are already transformed to local space)
+    // Note: default implementation traverses the rays one by one
+    virtual void Traverse(const SimdTraversalContext& context, const uint32 objectID) const;
+
+    // traverse the object with a ray packet (rays are already transformed to local space)
+    // Note: default implementation traverses the rays one by one
+    virtual void Traverse(const PacketTraversalContext& context, const uint32 objectID, const uint32 numActiveGroups) const;
+
     // traverse the object and check if the ray is occluded
     virtual bool Traverse_Shadow(const SingleTraversalContext& context) const;
 
+    // check occlusion of SIMD-8 shadow ray (rays are already transformed to local space)
+    // returns bitmask of occluded rays
+    // Note: default implementation traverses the rays one by one
+    virtual uint32 Traverse_Shadow(const SimdTraversalContext& context) const;
+
+    // check occlusion of shadow rays packet (rays are already transformed to local space)
+    // Note: default implementation traverses the rays one by one
+    virtual void Traverse_Shadow(const PacketTraversalContext& context, const uint32 numActiveGroups) const;
+
     // intersect with a ray and return hit points
     // TODO return array of all hit points along the ray
     virtual bool Intersect(const math::Ray& ray, ShapeIntersection& outResult) const;
@@ -68,6 +87,10 @@ public:
 
     // Get world-space bounding box
     virtual const math::Box GetBoundingBox() const = 0;
+
+    // get cone bounding all the surface normals (axis and cosine of the spread angle)
+    // Note: default implementation returns the whole sphere of directions
+    virtual void GetNormalCone(math::Vector4& outAxis, float& outCosAngle) const;
 };
 
 using ShapePtr = std::shared_ptr<IShape>;
@@ -2,9 +2,12 @@
 #include "BitmapTexture.h"
 #include "../Utils/Bitmap.h"
 #include "../Utils/Logger.h"
+#include "../Utils/Timer.h"
+#include "../Utils/ThreadPool.h"
 #include "../Math/Distribution.h"
 #include "../Containers/DynArray.h"
 #include "../Color/ColorHelpers.h"
+#include "../Math/Transcendental.h"
 
 namespace rt {
 
@@ -97,19 +100,9 @@ const Vector4 BitmapTexture::Sample(const Float2 u, Vector4& outCoords, float* o
     RT_ASSERT(mImportanceMap, "Bitmap texture is not samplable");
 
     float pdf = 0.0f;
-    const uint32 pixelIndex = mImportanceMap->SampleDiscrete(u.x, pdf);
+    const Float2 coords = mImportanceMap->Sample(u, pdf);
 
-    const uint32 width = mBitmap->GetWidth();
-    const uint32 height = mBitmap->GetHeight();
-
-    // TODO get rid of division
-    const uint32 x = pixelIndex % width;
-    const uint32 y = pixelIndex / width;
-    RT_ASSERT(x < width);
-    RT_ASSERT(y < height);
-
-    // TODO this is redundant, because BitmapTexture::Evaluate multiplies coords by size again...
-    outCoords = Vector4::FromIntegers(x, y, 0, 0) / mBitmap->mFloatSize;
+    outCoords = Vector4(coords);
 
     if (outPdf)
     {
@@ -119,9 +112,17 @@ const Vector4 BitmapTexture::Sample(const Float2 u, Vector4& outCoords, float* o
     return BitmapTexture::Evaluate(outCoords);
 }
 
-bool BitmapTexture::MakeSamplable()
+float BitmapTexture::Pdf(const Vector4& coords) const
 {
-    if (mImportanceMap)
+    RT_ASSERT(mImportanceMap, "Bitmap texture is not samplable");
+
+    const Vector4 warpedCoords = Vector4::Mod1(coords);
+    return mImportanceMap->Pdf(Float2(warpedCoords.x, warpedCoords.y));
+}
+
+bool BitmapTexture::MakeSamplable(const TextureSamplingDesc& desc)
+{
+    if (mImportanceMap && mImportanceMapLatLong == desc.latLongMapping)
     {
         return true;
     }
@@ -132,25 +133,90 @@ bool BitmapTexture::MakeSamplable()
         return false;
     }
 
+    if (mImportanceMap)
+    {
+        RT_LOG_WARNING("BitmapTexture: Rebuilding importance map for bitmap '%s' with different mapping", mBitmap->GetDebugName());
+        mImportanceMap.reset();
+    }
+
     RT_LOG_INFO("BitmapTexture: Generating importance map for bitmap '%s'...", mBitmap->GetDebugName());
 
+    Timer timer;
+
     const uint32 width = mBitmap->GetWidth();
     const uint32 height = mBitmap->GetHeight();
 
+    DynArray<float> texelIntensities;
     DynArray<float> importancePdf;
-    importancePdf.Resize(width * height);
+    if (!texelIntensities.Resize(width * height) || !importancePdf.Resize(width * height))
+    {
+        RT_LOG_ERROR("BitmapTexture: Failed to allocate importance map");
+        return false;
+    }
 
-    for (uint32 j = 0; j < height; ++j)
+    const auto runTasks = [&desc](const ParallelTask& task, uint32 numTasks)
+    {
+        if (desc.threadPool)
+        {
+            desc.threadPool->RunParallelTask(task, numTasks);
+        }
+        else
+        {
+            for (uint32 i = 0; i < numTasks; ++i)
+            {
+                task(i, 0);
+            }
+        }
+    };
+
+    runTasks([&](uint32 j, uint32)
     {
         for (uint32 i = 0; i < width; ++i)
         {
-            const Vector4 value = mBitmap->GetPixel(i, j);
-            importancePdf[width * j + i] = Vector4::Dot3(c_rgbIntensityWeights, value);
+            const Vector4 value = Vector4::Max(Vector4::Zero(), mBitmap->GetPixel(i, j, mForceLinearSpace));
+            texelIntensities[width * j + i] = Vector4::Dot3(c_rgbIntensityWeights, value);
         }
+    }, height);
+
+    runTasks([&](uint32 j, uint32)
+    {
+        const uint32 nextJ = (j + 1 < height) ? (j + 1) : 0;
+
+        // solid angle of lat-long map row is proportional to sin(theta)
+        const float rowWeight = desc.latLongMapping ? Sin(RT_PI * (static_cast<float>(j) + 0.5f) / static_cast<float>(height)) : 1.0f;
+
+        for (uint32 i = 0; i < width; ++i)
+        {
+            float intensity = texelIntensities[width * j + i];
+
+            // Each cell of the importance map spans between four texels, because texel centers lie at integer coordinates
+            // when evaluating the texture. Taking the maximum guarantees non-zero pdf wherever filtered value is non-zero.
+            if (desc.coverFilteredTexels)
+            {
+                const uint32 nextI = (i + 1 < width) ? (i + 1) : 0;
+
+                intensity = Max(
+                    Max(intensity, texelIntensities[width * j + nextI]),
+                    Max(texelIntensities[width * nextJ + i], texelIntensities[width * nextJ + nextI]));
+            }
+
+            importancePdf[width * j + i] = intensity * rowWeight;
+        }
+    }, height);
+
+    auto importanceMap = std::make_unique<math::Distribution2D>();
+    if (!importanceMap->Initialize(importancePdf.Data(), width, height, desc.useAliasTables, desc.threadPool))
+    {
+        RT_LOG_ERROR("BitmapTexture: Failed to build importance map for bitmap '%s'", mBitmap->GetDebugName());
+        return false;
     }
 
-    mImportanceMap = std::make_unique<math::Distribution>();
-    return mImportanceMap->Initialize(importancePdf.Data(), importancePdf.Size());
+    mImportanceMap = std::move(importanceMap);
+    mImportanceMapLatLong = desc.latLongMapping;
+
+    const float elapsedTime = static_cast<float>(1000.0 * timer.Stop());
+    RT_LOG_INFO("BitmapTexture: Importance map generated in %.3fms", elapsedTime);
+    return true;
 }
 
 bool BitmapTexture::IsSamplable() const
@@ -5,7 +5,7 @@
 namespace rt {
 
 namespace math {
-class Distribution;
+class Distribution2D;
 }
 
 class Bitmap;
@@ -29,13 +29,15 @@ public:
     virtual const char* GetName() const override;
     virtual const math::Vector4 Evaluate(const math::Vector4& coords) const override;
     virtual const math::Vector4 Sample(const math::Float2 u, math::Vector4& outCoords, float* outPdf) const override;
+    virtual float Pdf(const math::Vector4& coords) const override;
 
-    virtual bool MakeSamplable() override;
+    virtual bool MakeSamplable(const TextureSamplingDesc& desc) override;
     virtual bool IsSamplable() const override;
 
 private:
     BitmapPtr mBitmap;
-    std::unique_ptr<math::Distribution> mImportanceMap;
+    std::unique_ptr<math::Distribution2D> mImportanceMap;
+    bool mImportanceMapLatLong = false;
     BitmapTextureFilter mFilter;
     bool mForceLinearSpace;
 };
@@ -5,8 +5,18 @@ namespace rt {
 
 ITexture::~ITexture() = default;
 
-bool ITexture::MakeSamplable()
+float ITexture::Pdf(const math::Vector4& coords) const
 {
+    RT_UNUSED(coords);
+
+    // uniform sampling by default
+    return 1.0f;
+}
+
+bool ITexture::MakeSamplable(const TextureSamplingDesc& desc)
+{
+    RT_UNUSED(desc);
+
     return true;
 }
 
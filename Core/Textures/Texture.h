@@ -7,6 +7,25 @@
 
 namespace rt {
 
+class ThreadPool;
+
+// texture importance sampling setup
+struct TextureSamplingDesc
+{
+    // weight texels by sin(theta), so that sampling is proportional to solid angle of equirectangular (lat-long) environment map
+    bool latLongMapping = false;
+
+    // use alias tables for constant-time sampling (instead of binary search)
+    bool useAliasTables = false;
+
+    // take maximum of four neighbouring texels for each importance map cell, so the pdf is non-zero wherever
+    // bilinearly filtered texture value is non-zero (required when sampled value is used in radiance estimators)
+    bool coverFilteredTexels = false;
+
+    // optional thread pool used to build the importance map
+    ThreadPool* threadPool = nullptr;
+};
+
 /**
  * Class representing 2D texture.
  */
@@ -24,8 +43,11 @@ public:
     // generate random sample on the texture
     virtual const math::Vector4 Sample(const math::Float2 u, math::Vector4& outCoords, float* outPdf = nullptr) const = 0;
 
+    // get probability density of sampling given coordinates with Sample() (with respect to texture area)
+    virtual float Pdf(const math::Vector4& coords) const;
+
     // must be called before using Sample() method
-    virtual bool MakeSamplable();
+    virtual bool MakeSamplable(const TextureSamplingDesc& desc = TextureSamplingDesc());
 
     // check if the texture is samplable (if it's not, calling Sample is illegal)
     virtual bool IsSamplable() const;
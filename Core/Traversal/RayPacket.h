@@ -32,37 +32,96 @@ struct RT_ALIGN(32) RayGroup
 };
 
 // packet of coherent rays (8-SIMD version)
+// Rays are split into groups by direction octant, so each group (and the whole packet traversed
+// for a given octant) has the same front-to-back BVH node order.
 struct RT_ALIGN(32) RayPacket
 {
     static constexpr uint32 RaysPerGroup = 8;
-    static constexpr uint32 MaxNumGroups = MaxRayPacketSize / RaysPerGroup;
+    static constexpr uint32 NumOctants = 8;
+
+    // every octant can leave one partially filled group
+    static constexpr uint32 MaxNumGroups = MaxRayPacketSize / RaysPerGroup + NumOctants;
+    static constexpr uint32 MaxNumRaySlots = MaxNumGroups * RaysPerGroup;
+
+    // ray offset of unused lanes in partially filled groups
+    static constexpr int32 InvalidRayOffset = -1;
+
+    static constexpr uint16 InvalidGroup = UINT16_MAX;
 
     RayGroup groups[MaxNumGroups];
 
-    // rays influence on the image (e.g. 1.0 for primary rays)
+    // direction octant of rays in each group
+    uint8 groupOctants[MaxNumGroups];
+
+    // rays influence on the image (e.g. 1.0 for primary rays), indexed by ray offset
     math::Vector3x8 rayWeights[MaxNumGroups];
 
-    // corresponding image pixels
-    ImageLocationInfo imageLocations[MaxRayPacketSize];
+    // corresponding image pixels, indexed by ray offset
+    ImageLocationInfo imageLocations[MaxNumRaySlots];
 
     // number of rays (not groups!)
     uint32 numRays;
 
+    // number of allocated groups (including partially filled ones)
+    uint32 numGroups;
+
+    // partially filled group for each octant
+    uint16 openGroups[NumOctants];
+    uint8 openGroupSizes[NumOctants];
+
     RT_FORCE_INLINE RayPacket()
-        : numRays(0)
-    { }
+    {
+        Clear();
+    }
 
     RT_FORCE_INLINE uint32 GetNumGroups() const
     {
-        return (numRays + RaysPerGroup - 1) / RaysPerGroup;
+        return numGroups;
+    }
+
+    RT_FORCE_INLINE static uint32 GetRayOctant(const math::Ray& ray)
+    {
+        return (ray.dir.x < 0.0f ? 1u : 0u) | (ray.dir.y < 0.0f ? 2u : 0u) | (ray.dir.z < 0.0f ? 4u : 0u);
+    }
+
+    RT_FORCE_INLINE const math::Vector4 GetRayWeight(uint32 rayOffset) const
+    {
+        const math::Vector3x8& weights = rayWeights[rayOffset / RaysPerGroup];
+        const uint32 lane = rayOffset % RaysPerGroup;
+        return math::Vector4(weights.x[lane], weights.y[lane], weights.z[lane]);
     }
 
-    RT_FORCE_INLINE void PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& location)
+    // push a single ray to a group matching its octant
+    // returns ray offset (index to imageLocations and hit points)
+    // Note: max distance is used only by shadow rays traversal (closest hit traversal resets it)
+    RT_FORCE_INLINE uint32 PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& location, const float maxDistance = FLT_MAX)
     {
         RT_ASSERT(numRays < MaxRayPacketSize);
 
-        const uint32 groupIndex = numRays / RaysPerGroup;
-        const uint32 rayIndex = numRays % RaysPerGroup;
+        const uint32 octant = GetRayOctant(ray);
+
+        uint32 groupIndex = openGroups[octant];
+        if (groupIndex == InvalidGroup)
+        {
+            groupIndex = AllocateGroup(octant);
+            openGroups[octant] = (uint16)groupIndex;
+            openGroupSizes[octant] = 0;
+
+            // fill unused lanes with copies of the first ray, so they don't produce NaNs
+            // Note: zero max distance and invalid offset prevent them from reporting any hit
+            RayGroup& group = groups[groupIndex];
+            group.rays[0] = math::Ray_Simd8(ray);
+            group.maxDistances = math::Vector8::Zero();
+            group.rayOffsets = math::VectorInt8(InvalidRayOffset);
+        }
+
+        const uint32 rayIndex = openGroupSizes[octant]++;
+        if (openGroupSizes[octant] == RaysPerGroup)
+        {
+            openGroups[octant] = InvalidGroup;
+        }
+
+        const uint32 rayOffset = RaysPerGroup * groupIndex + rayIndex;
 
         RayGroup& group = groups[groupIndex];
         group.rays[0].dir.x[rayIndex] = ray.dir.x;
@@ -74,32 +133,53 @@ struct RT_ALIGN(32) RayPacket
         group.rays[0].invDir.x[rayIndex] = ray.invDir.x;
         group.rays[0].invDir.y[rayIndex] = ray.invDir.y;
         group.rays[0].invDir.z[rayIndex] = ray.invDir.z;
-        group.maxDistances[rayIndex] = FLT_MAX;
-        group.rayOffsets[rayIndex] = numRays;
+        group.maxDistances[rayIndex] = maxDistance;
+        group.rayOffsets[rayIndex] = rayOffset;
 
         rayWeights[groupIndex].x[rayIndex] = weight.x;
         rayWeights[groupIndex].y[rayIndex] = weight.y;
         rayWeights[groupIndex].z[rayIndex] = weight.z;
 
-        imageLocations[numRays] = location;
+        imageLocations[rayOffset] = location;
 
         numRays++;
+
+        return rayOffset;
     }
 
     // TODO use non-temporal stores?
     RT_FORCE_INLINE void PushRays(const math::Ray_Simd8& rays, const math::Vector3x8& weights, const ImageLocationInfo* locations)
     {
-        RT_ASSERT((numRays < MaxRayPacketSize) && (numRays % RaysPerGroup == 0));
+        RT_ASSERT(numRays + RaysPerGroup <= MaxRayPacketSize);
+
+        const uint32 octant = rays.GetOctant();
+        if (octant >= NumOctants)
+        {
+            // mixed octants - distribute the rays one by one
+            math::Vector4 origins[RaysPerGroup], dirs[RaysPerGroup], unpackedWeights[RaysPerGroup];
+            rays.origin.Unpack(origins);
+            rays.dir.Unpack(dirs);
+            weights.Unpack(unpackedWeights);
+
+            for (uint32 i = 0; i < RaysPerGroup; ++i)
+            {
+                PushRay(math::Ray::BuildUnsafe(origins[i], dirs[i]), unpackedWeights[i], locations[i]);
+            }
+            return;
+        }
+
+        const uint32 groupIndex = AllocateGroup(octant);
+        const uint32 firstRayOffset = RaysPerGroup * groupIndex;
 
-        RayGroup& group = groups[numRays / RaysPerGroup];
+        RayGroup& group = groups[groupIndex];
         group.rays[0] = rays;
         group.maxDistances = math::VECTOR8_MAX;
-        group.rayOffsets = math::VectorInt8(numRays) + math::VectorInt8(0, 1, 2, 3, 4, 5, 6, 7);
+        group.rayOffsets = math::VectorInt8(firstRayOffset) + math::VectorInt8(0, 1, 2, 3, 4, 5, 6, 7);
 
-        rayWeights[numRays / RaysPerGroup] = weights;
+        rayWeights[groupIndex] = weights;
 
         // Note: this should be replaced with a single MOVUPS instruction
-        memcpy(imageLocations + numRays, locations, sizeof(ImageLocationInfo) * 8);
+        memcpy(imageLocations + firstRayOffset, locations, sizeof(ImageLocationInfo) * 8);
 
         numRays += RaysPerGroup;
     }
@@ -107,6 +187,23 @@ struct RT_ALIGN(32) RayPacket
     RT_FORCE_INLINE void Clear()
     {
         numRays = 0;
+        numGroups = 0;
+
+        for (uint32 i = 0; i < NumOctants; ++i)
+        {
+            openGroups[i] = InvalidGroup;
+            openGroupSizes[i] = 0;
+        }
+    }
+
+private:
+    RT_FORCE_INLINE uint32 AllocateGroup(uint32 octant)
+    {
+        RT_ASSERT(numGroups < MaxNumGroups);
+
+        const uint32 groupIndex = numGroups++;
+        groupOctants[groupIndex] = (uint8)octant;
+        return groupIndex;
     }
 };
 
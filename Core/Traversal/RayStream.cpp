@@ -1,48 +1,144 @@
 #include "PCH.h"
 #include "RayStream.h"
+#include "Utils/Logger.h"
 
 namespace rt {
 
+using namespace math;
+
+namespace {
+
+// number of bits per axis used for origin and direction quantization
+static constexpr uint32 OriginBits = 10;
+static constexpr uint32 DirectionBits = 3;
+
+// insert two zero bits between each of 10 lowest bits
+RT_FORCE_INLINE uint32 SplitBits(uint32 x)
+{
+    x &= 0x000003FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+RT_FORCE_INLINE uint32 MortonCode(uint32 x, uint32 y, uint32 z)
+{
+    return SplitBits(x) | (SplitBits(y) << 1) | (SplitBits(z) << 2);
+}
+
+// map [0...1] value to integer grid
+RT_FORCE_INLINE uint32 Quantize(float value, uint32 numBits)
+{
+    const uint32 maxValue = (1u << numBits) - 1u;
+    return static_cast<uint32>(Clamp(value * static_cast<float>(maxValue + 1u), 0.0f, static_cast<float>(maxValue)));
+}
+
+} // namespace
+
 RayStream::RayStream()
-    : mNumRays(0)
+    : mOriginsBox(Box::Empty())
+    , mNumPoppedRays(0)
+    , mIsSorted(false)
 {
 }
 
 RayStream::~RayStream() = default;
 
+void RayStream::Clear()
+{
+    mRays.Clear();
+    mSortKeys.Clear();
+    mOriginsBox = Box::Empty();
+    mNumPoppedRays = 0;
+    mIsSorted = false;
+}
+
 void RayStream::PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& imageLocation)
 {
-    RT_ASSERT(mNumRays < MaxRays);
+    RT_ASSERT(mNumPoppedRays == 0, "Can't push rays while popping packets");
 
-    PendingRay& pendingRay = mRays[mNumRays];
+    PendingRay pendingRay;
     pendingRay.rayWeight = weight;
     pendingRay.rayDir = ray.dir.ToFloat3();
     pendingRay.rayOrigin = ray.origin.ToFloat3();
     pendingRay.imageLocation = imageLocation;
+    mRays.PushBack(pendingRay);
+
+    mOriginsBox.AddPoint(ray.origin);
 
-    mNumRays++;
+    mIsSorted = false;
 }
 
 void RayStream::Sort()
 {
-    // TODO sort rays by position (median axis split partitioning) - O(N log N) or can be better?
-    // TODO sort rays by direction (map ray direction to cube-map grids) - O(N)
+    const uint32 numRays = mRays.Size();
+    if (numRays == 0)
+    {
+        return;
+    }
+
+    if (!mSortKeys.Resize_SkipConstructor(numRays))
+    {
+        RT_LOG_ERROR("Failed to allocate ray stream sort keys");
+        return;
+    }
+
+    const Vector4 boxSize = mOriginsBox.max - mOriginsBox.min;
+    const Vector4 invBoxSize = Vector4::Select(Vector4::Reciprocal(boxSize), Vector4::Zero(), boxSize <= Vector4::Zero());
+
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const PendingRay& ray = mRays[i];
+
+        // quantized direction (the most significant bits represent direction octant)
+        const Vector4 dir = (Vector4(ray.rayDir) + VECTOR_ONE) * 0.5f;
+        const uint32 dirCode = MortonCode(Quantize(dir.x, DirectionBits), Quantize(dir.y, DirectionBits), Quantize(dir.z, DirectionBits));
+
+        // origin position within the rays bounding box
+        const Vector4 origin = (Vector4(ray.rayOrigin) - mOriginsBox.min) * invBoxSize;
+        const uint32 originCode = MortonCode(Quantize(origin.x, OriginBits), Quantize(origin.y, OriginBits), Quantize(origin.z, OriginBits));
+
+        mSortKeys[i].key = (static_cast<uint64>(dirCode) << (3u * OriginBits)) | static_cast<uint64>(originCode);
+        mSortKeys[i].rayIndex = i;
+    }
+
+    std::sort(mSortKeys.begin(), mSortKeys.end(), [](const SortKey& a, const SortKey& b)
+    {
+        return a.key < b.key;
+    });
+
+    mIsSorted = true;
 }
 
 bool RayStream::PopPacket(RayPacket& outPacket)
 {
-    if (mNumRays == 0)
+    outPacket.Clear();
+
+    const uint32 numRays = mRays.Size();
+    if (mNumPoppedRays >= numRays)
     {
         return false;
     }
 
-    uint32 numRaysInPacket = math::Min(mNumRays, MaxRayPacketSize);
-    uint32 numRayGroups = math::RoundUp(numRaysInPacket, RayPacket::RaysPerGroup) / RayPacket::RaysPerGroup;
+    const uint32 numRaysInPacket = Min(numRays - mNumPoppedRays, MaxRayPacketSize);
+    for (uint32 i = 0; i < numRaysInPacket; ++i)
+    {
+        const uint32 rayIndex = mIsSorted ? mSortKeys[mNumPoppedRays + i].rayIndex : (mNumPoppedRays + i);
+        const PendingRay& pendingRay = mRays[rayIndex];
 
-    // TODO
-    (void)outPacket;
-    (void)numRaysInPacket;
-    (void)numRayGroups;
+        const Ray ray = Ray::BuildUnsafe(Vector4(pendingRay.rayOrigin), Vector4(pendingRay.rayDir));
+        outPacket.PushRay(ray, pendingRay.rayWeight, pendingRay.imageLocation);
+    }
+
+    mNumPoppedRays += numRaysInPacket;
+
+    // all rays were emitted
+    if (mNumPoppedRays == numRays)
+    {
+        Clear();
+    }
 
     return true;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "RayPacket.h"
+#include "../Containers/DynArray.h"
+#include "../Math/Box.h"
 
 
 namespace rt {
@@ -8,26 +10,30 @@ namespace rt {
 
 // Ray stream - generator of ray packets
 // Push incoherent rays, pops coherent ray packets
-class RayStream
+class RAYLIB_API RayStream
 {
 public:
-    static constexpr uint32 MaxRays = 1024 * 1024;
-
     RayStream();
     ~RayStream();
 
     // push a new ray to the stream
     void PushRay(const math::Ray& ray, const math::Vector4& weight, const ImageLocationInfo& imageLocation);
 
-    // Convert collected rays into ray packets.
-    // This will flush all the pushed rays and generate list of fresh ray packets
+    // Sort collected rays, so the packets generated by PopPacket are coherent.
+    // Rays are binned by direction (quantized) first and by origin (Morton code) second.
+    // If not called, the packets are generated in push order.
     void Sort();
 
     // Pop generated packet
     // If there's no packets pending the function returns false
-    // Note: ray stream keeps the packet ownership
+    // Note: the stream is cleared (keeping the allocated memory) after the last packet was popped
     bool PopPacket(RayPacket& outPacket);
 
+    RT_FORCE_INLINE uint32 GetNumRays() const { return mRays.Size(); }
+
+    // clear the stream, but keep the allocated memory
+    void Clear();
+
 private:
 
     struct PendingRay
@@ -38,8 +44,25 @@ private:
         ImageLocationInfo imageLocation;
     };
 
-    uint32 mNumRays;
-    PendingRay mRays[MaxRays];
+    struct SortKey
+    {
+        uint64 key;
+        uint32 rayIndex;
+    };
+
+    // pending rays (storage grows on demand and is reused between frames)
+    DynArray<PendingRay> mRays;
+
+    // rays order after sorting
+    DynArray<SortKey> mSortKeys;
+
+    // bounding box of all the pending rays origins
+    math::Box mOriginsBox;
+
+    // number of rays already emitted by PopPacket
+    uint32 mNumPoppedRays;
+
+    bool mIsSorted;
 };
 
 
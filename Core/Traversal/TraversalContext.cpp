@@ -33,4 +33,18 @@ void PacketTraversalContext::StoreIntersection(RayGroup& rayGroup, const Vector8
     }
 }
 
+void PacketTraversalContext::StoreOcclusion(RayGroup& rayGroup, uint32 mask) const
+{
+    for (; mask; mask &= mask - 1u)
+    {
+        const uint32 lane = FirstBitSet(mask);
+        const uint32 rayOffset = static_cast<uint32>(rayGroup.rayOffsets[lane]);
+
+        // negative max distance makes the ray fail all the following box and triangle tests
+        rayGroup.maxDistances[lane] = -FLT_MAX;
+
+        context.occludedRays[rayOffset / RayPacket::RaysPerGroup] |= static_cast<uint8>(1u << (rayOffset % RayPacket::RaysPerGroup));
+    }
+}
+
 } // namespace rt
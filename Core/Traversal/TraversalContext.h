@@ -31,6 +31,9 @@ struct PacketTraversalContext
     RenderingContext& context;
 
     void StoreIntersection(RayGroup& rayGroup, const math::Vector8& t, const math::Vector8& u, const math::Vector8& v, const math::VectorBool8& mask, uint32 objectID, uint32 subObjectID = 0) const;
+
+    // mark shadow rays (bitmask of group lanes) as occluded and terminate them
+    void StoreOcclusion(RayGroup& rayGroup, uint32 mask) const;
 };
 
 } // namespace rt
@@ -55,30 +55,37 @@ uint32 RemoveMissedGroups(RenderingContext& context, uint32 numGroups)
     }
 }
 
-// TODO this is ugly AF, but actually works
-static void SwapRays(RenderingContext& context, uint32 a, uint32 b, uint32 traversalDepth)
-{
-    RayGroup& groupA = context.rayPacket.groups[context.activeGroupsIndices[a / RayPacket::RaysPerGroup]];
-    RayGroup& groupB = context.rayPacket.groups[context.activeGroupsIndices[b / RayPacket::RaysPerGroup]];
+namespace {
 
-    std::swap(groupA.rays[traversalDepth].dir.x[a % 8], groupB.rays[traversalDepth].dir.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].dir.y[a % 8], groupB.rays[traversalDepth].dir.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].dir.z[a % 8], groupB.rays[traversalDepth].dir.z[b % RayPacket::RaysPerGroup]);
+RT_FORCE_INLINE void SwapLanes(Vector3x8& a, Vector3x8& b, uint32 laneA, uint32 laneB)
+{
+    std::swap(a.x[laneA], b.x[laneB]);
+    std::swap(a.y[laneA], b.y[laneB]);
+    std::swap(a.z[laneA], b.z[laneB]);
+}
 
-    std::swap(groupA.rays[traversalDepth].origin.x[a % 8], groupB.rays[traversalDepth].origin.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].origin.y[a % 8], groupB.rays[traversalDepth].origin.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].origin.z[a % 8], groupB.rays[traversalDepth].origin.z[b % RayPacket::RaysPerGroup]);
+RT_FORCE_INLINE void SwapRays(RayPacket& packet, const RenderingContext& context, uint32 a, uint32 b, uint32 traversalDepth)
+{
+    RayGroup& groupA = packet.groups[context.activeGroupsIndices[a / RayPacket::RaysPerGroup]];
+    RayGroup& groupB = packet.groups[context.activeGroupsIndices[b / RayPacket::RaysPerGroup]];
 
-    std::swap(groupA.rays[traversalDepth].invDir.x[a % 8], groupB.rays[traversalDepth].invDir.x[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].invDir.y[a % 8], groupB.rays[traversalDepth].invDir.y[b % RayPacket::RaysPerGroup]);
-    std::swap(groupA.rays[traversalDepth].invDir.z[a % 8], groupB.rays[traversalDepth].invDir.z[b % RayPacket::RaysPerGroup]);
+    const uint32 laneA = a % RayPacket::RaysPerGroup;
+    const uint32 laneB = b % RayPacket::RaysPerGroup;
 
-    std::swap(groupA.maxDistances[a % 8], groupB.maxDistances[b % 8]);
+    // Note: world-space rays must be moved even when reordering in local space,
+    // local-space rays are recomputed when entering an object, so they can be skipped at the scene level
+    for (uint32 i = 0; i <= traversalDepth; ++i)
+    {
+        SwapLanes(groupA.rays[i].dir, groupB.rays[i].dir, laneA, laneB);
+        SwapLanes(groupA.rays[i].origin, groupB.rays[i].origin, laneA, laneB);
+        SwapLanes(groupA.rays[i].invDir, groupB.rays[i].invDir, laneA, laneB);
+    }
 
-    std::swap(groupA.rayOffsets[a % 8], groupB.rayOffsets[b % 8]);
+    std::swap(groupA.maxDistances[laneA], groupB.maxDistances[laneB]);
+    std::swap(groupA.rayOffsets[laneA], groupB.rayOffsets[laneB]);
 }
 
-static void SwapBits(uint8& a, uint8& b, uint32 indexA, uint32 indexB)
+RT_FORCE_INLINE void SwapBits(uint8& a, uint8& b, uint32 indexA, uint32 indexB)
 {
     const uint8 bitA = (a >> indexA) & 1;
     const uint8 bitB = (b >> indexB) & 1;
@@ -86,8 +93,12 @@ static void SwapBits(uint8& a, uint8& b, uint32 indexA, uint32 indexB)
     b ^= (-bitA ^ b) & (1UL << indexB);
 }
 
-void ReorderRays(RenderingContext& context, uint32 numGroups, uint32 traversalDepth)
+} // namespace
+
+void ReorderRays(RayPacket& packet, RenderingContext& context, uint32 numGroups, uint32 traversalDepth)
 {
+    // Note: rays are only moved between the active groups, so the set of rays in the active groups
+    // (referenced by the traversal stack frames) stays the same
     uint32 numRays = numGroups * RayPacket::RaysPerGroup;
     uint32 i = 0;
     while (i < numRays)
@@ -102,8 +113,8 @@ void ReorderRays(RenderingContext& context, uint32 numGroups, uint32 traversalDe
         else
         {
             numRays--;
-            SwapRays(context, i, numRays, traversalDepth);
-            SwapBits(context.activeRaysMask[i / 8], context.activeRaysMask[numRays / 8], i % 8, numRays % 8);
+            SwapRays(packet, context, i, numRays, traversalDepth);
+            SwapBits(context.activeRaysMask[groupIndex], context.activeRaysMask[numRays / RayPacket::RaysPerGroup], rayIndex, numRays % RayPacket::RaysPerGroup);
         }
     }
 }
@@ -3,6 +3,7 @@
 #include "RayPacket.h"
 #include "HitPoint.h"
 #include "TraversalContext.h"
+#include "Traversal_Simd.h"
 #include "Math/Ray.h"
 #include "BVH/BVH.h"
 #include "Math/Geometry.h"
@@ -11,8 +12,6 @@
 #include "Rendering/Counters.h"
 #include "Rendering/Context.h"
 
-#define RT_NO_RAY_REORDERING
-
 namespace rt {
 
 struct RenderingContext;
@@ -20,12 +19,69 @@ struct RenderingContext;
 // remove groups where all rays missed a bounding box
 RT_FORCE_NOINLINE uint32 RemoveMissedGroups(RenderingContext& context, uint32 numGroups);
 
-// reorder rays to restore coherency
-RT_FORCE_NOINLINE void ReorderRays(RenderingContext& context, uint32 numRays, uint32 traversalDepth);
+// move active rays to the first groups to restore SIMD utilization
+RT_FORCE_NOINLINE void ReorderRays(RayPacket& packet, RenderingContext& context, uint32 numGroups, uint32 traversalDepth);
 
 // test all alive groups in a packet agains a BVH node
 RT_FORCE_NOINLINE uint32 TestRayPacket(RayPacket& packet, uint32 numGroups, const BVH::Node& node, RenderingContext& context, uint32 traversalDepth);
 
+// continue traversal of a BVH subtree with active rays traced one by one
+template <typename ObjectType>
+void GenericTraverse_Subtree_SingleRays(const PacketTraversalContext& context, const uint32 objectID, const ObjectType* object, const BVH::Node* node, uint32 numGroups, uint32 traversalDepth)
+{
+    for (uint32 i = 0; i < numGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
+
+        for (uint32 mask = context.context.activeRaysMask[i]; mask; mask &= mask - 1u)
+        {
+            const uint32 lane = math::FirstBitSet(mask);
+            const math::Ray ray = GetRayFromLane(rayGroup.rays[traversalDepth], lane);
+
+            HitPoint hitPoint;
+            hitPoint.distance = rayGroup.maxDistances[lane];
+
+            GenericTraverse(SingleTraversalContext{ ray, hitPoint, context.context }, objectID, object, node);
+
+            if (hitPoint.objectId != RT_INVALID_OBJECT)
+            {
+                rayGroup.maxDistances[lane] = hitPoint.distance;
+                context.context.hitPoints[rayGroup.rayOffsets[lane]] = hitPoint;
+            }
+        }
+    }
+}
+
+// continue traversal of a BVH subtree with SIMD-8 rays (group by group)
+template <typename ObjectType>
+void GenericTraverse_Subtree_Simd8(const PacketTraversalContext& context, const uint32 objectID, const ObjectType* object, const BVH::Node* node, uint32 numGroups, uint32 traversalDepth)
+{
+    for (uint32 i = 0; i < numGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
+        const uint32 activeRaysMask = context.context.activeRaysMask[i];
+
+        // Note: zero distance deactivates rays that missed the node
+        HitPoint_Simd8 hitPoint;
+        for (uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+        {
+            hitPoint.distance[lane] = ((activeRaysMask >> lane) & 1u) ? rayGroup.maxDistances[lane] : 0.0f;
+        }
+
+        GenericTraverse(SimdTraversalContext{ rayGroup.rays[traversalDepth], hitPoint, context.context }, objectID, object, node);
+
+        for (uint32 mask = activeRaysMask; mask; mask &= mask - 1u)
+        {
+            const uint32 lane = math::FirstBitSet(mask);
+            if (static_cast<uint32>(hitPoint.objectId[lane]) != RT_INVALID_OBJECT)
+            {
+                rayGroup.maxDistances[lane] = hitPoint.distance[lane];
+                context.context.hitPoints[rayGroup.rayOffsets[lane]] = hitPoint.Get(lane);
+            }
+        }
+    }
+}
+
 template <typename ObjectType, uint32 traversalDepth>
 void GenericTraverse(const PacketTraversalContext& context, const uint32 objectID, const ObjectType* object, uint32 numActiveGroups)
 {
@@ -45,13 +101,20 @@ void GenericTraverse(const PacketTraversalContext& context, const uint32 objectI
     uint32 stackSize = 1;
     stack[0].node = nodes;
     stack[0].numActiveGroups = numActiveGroups;
-    stack[0].numActiveRays = context.ray.numRays; // all rays are active at the beginning
+    stack[0].numActiveRays = numActiveGroups * RayPacket::RaysPerGroup; // all rays are active at the beginning
 
-    // TODO packets should be octant-sorted
+    // Note: world-space rays are traversed one octant at a time (see Scene::Traverse),
+    // so the first ray represents all of them (in local space it's an approximation)
+    const math::Ray_Simd8& firstRay = context.ray.groups[context.context.activeGroupsIndices[0]].rays[traversalDepth];
     uint32 rayOctant = 0;
-    rayOctant = context.ray.groups[0].rays[traversalDepth].dir.x[0] < 0.0f ? 1 : 0;
-    rayOctant |= context.ray.groups[0].rays[traversalDepth].dir.y[0] < 0.0f ? 2 : 0;
-    rayOctant |= context.ray.groups[0].rays[traversalDepth].dir.z[0] < 0.0f ? 4 : 0;
+    rayOctant = firstRay.dir.x[0] < 0.0f ? 1 : 0;
+    rayOctant |= firstRay.dir.y[0] < 0.0f ? 2 : 0;
+    rayOctant |= firstRay.dir.z[0] < 0.0f ? 4 : 0;
+
+    const RenderingParams* params = context.context.params;
+    const float reorderingThreshold = params ? params->packetReorderingThreshold : 0.0f;
+    const uint32 simdThreshold = params ? params->simdTraversalThreshold : 0;
+    const uint32 singleRayThreshold = params ? params->singleRayTraversalThreshold : 0;
 
     // BVH traversal
     while (stackSize > 0)
@@ -63,8 +126,14 @@ void GenericTraverse(const PacketTraversalContext& context, const uint32 objectI
         uint32 raysHit = TestRayPacket(context.ray, numGroups, *frame.node, context.context, traversalDepth);
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-        context.context.localCounters.numRayBoxTests += 8 * numGroups;
-        context.context.localCounters.numPassedRayBoxTests += raysHit;
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += 8 * numGroups;
+            context.context.localCounters.numPassedRayBoxTests += raysHit;
+            context.context.localCounters.numVisitedNodes += frame.numActiveRays;
+            context.context.localCounters.numPacketLanes += 8 * numGroups;
+            context.context.localCounters.numActivePacketLanes += frame.numActiveRays;
+        }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
         if (raysHit == 0)
@@ -78,22 +147,28 @@ void GenericTraverse(const PacketTraversalContext& context, const uint32 objectI
         {
             numGroups = RemoveMissedGroups(context.context, numGroups);
 
-#ifndef RT_NO_RAY_REORDERING
-            // reorder rays to restore coherency
-            if ((numGroups > 1) && ((4 * numGroups) >= raysHit)) // 50% utilization
+            // compact active rays if too many SIMD lanes are idle
+            if ((numGroups > 1) && (static_cast<float>(raysHit) < reorderingThreshold * static_cast<float>(RayPacket::RaysPerGroup * numGroups)))
             {
-                ReorderRays(context.context, numGroups);
-                numGroups = (raysHit + 7) / 8;
+                ReorderRays(context.ray, context.context, numGroups, traversalDepth);
+                numGroups = (raysHit + RayPacket::RaysPerGroup - 1) / RayPacket::RaysPerGroup;
             }
-#endif // RT_NO_RAY_REORDERING
         }
 
-        // TODO switching to Simd traversal if only one group left
-
         if (frame.node->IsLeaf())
         {
             object->Traverse_Leaf(context, objectID, *frame.node, numGroups);
         }
+        else if (raysHit <= singleRayThreshold)
+        {
+            // only few rays left - it's cheaper to trace them one by one
+            GenericTraverse_Subtree_SingleRays(context, objectID, object, frame.node, numGroups, traversalDepth);
+        }
+        else if (numGroups <= simdThreshold)
+        {
+            // only few groups left - avoid packet bookkeeping overhead
+            GenericTraverse_Subtree_Simd8(context, objectID, object, frame.node, numGroups, traversalDepth);
+        }
         else
         {
             const BVH::Node* __restrict children = nodes + frame.node->childIndex;
@@ -116,4 +191,209 @@ void GenericTraverse(const PacketTraversalContext& context, const uint32 objectI
     }
 }
 
+// continue shadow rays traversal of a BVH subtree with SIMD-8 rays (group by group)
+template <typename ObjectType>
+void GenericTraverse_Shadow_Subtree_Simd8(const PacketTraversalContext& context, const ObjectType* object, const BVH::Node* node, uint32 numGroups, uint32 traversalDepth)
+{
+    for (uint32 i = 0; i < numGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
+        const uint32 activeRaysMask = context.context.activeRaysMask[i];
+
+        // Note: zero distance deactivates rays that missed the node
+        HitPoint_Simd8 hitPoint;
+        for (uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+        {
+            hitPoint.distance[lane] = ((activeRaysMask >> lane) & 1u) ? rayGroup.maxDistances[lane] : 0.0f;
+        }
+
+        const uint32 occludedRaysMask = GenericTraverse_Shadow(SimdTraversalContext{ rayGroup.rays[traversalDepth], hitPoint, context.context }, object, node);
+        if (occludedRaysMask)
+        {
+            context.StoreOcclusion(rayGroup, occludedRaysMask);
+        }
+    }
+}
+
+// traverse shadow rays packet through a BVH
+// occluded rays are marked in RenderingContext::occludedRays and terminated
+template <typename ObjectType, uint32 traversalDepth>
+void GenericTraverse_Shadow(const PacketTraversalContext& context, const ObjectType* object, uint32 numActiveGroups)
+{
+    // all nodes
+    const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
+
+    struct StackFrame
+    {
+        const BVH::Node* node;
+        uint32 numActiveGroups;
+        uint32 numActiveRays;
+    };
+
+    StackFrame stack[BVH::MaxDepth];
+
+    // push root
+    uint32 stackSize = 1;
+    stack[0].node = nodes;
+    stack[0].numActiveGroups = numActiveGroups;
+    stack[0].numActiveRays = numActiveGroups * RayPacket::RaysPerGroup;
+
+    // Note: all the rays in the packet have the same octant (see GenericTraverse)
+    const math::Ray_Simd8& firstRay = context.ray.groups[context.context.activeGroupsIndices[0]].rays[traversalDepth];
+    uint32 rayOctant = 0;
+    rayOctant = firstRay.dir.x[0] < 0.0f ? 1 : 0;
+    rayOctant |= firstRay.dir.y[0] < 0.0f ? 2 : 0;
+    rayOctant |= firstRay.dir.z[0] < 0.0f ? 4 : 0;
+
+    const RenderingParams* params = context.context.params;
+    const float reorderingThreshold = params ? params->packetReorderingThreshold : 0.0f;
+    const uint32 simdThreshold = params ? params->simdTraversalThreshold : 0;
+
+    // BVH traversal
+    while (stackSize > 0)
+    {
+        // pop element from stack
+        const StackFrame& frame = stack[--stackSize];
+
+        // Note: occluded rays have negative max distance, so they never pass the test
+        uint32 numGroups = frame.numActiveGroups;
+        uint32 raysHit = TestRayPacket(context.ray, numGroups, *frame.node, context.context, traversalDepth);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += 8 * numGroups;
+            context.context.localCounters.numPassedRayBoxTests += raysHit;
+            context.context.localCounters.numVisitedNodes += frame.numActiveRays;
+            context.context.localCounters.numPacketLanes += 8 * numGroups;
+            context.context.localCounters.numActivePacketLanes += frame.numActiveRays;
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        if (raysHit == 0)
+        {
+            // all rays missed the node or are already occluded - skip it
+            continue;
+        }
+
+        // remove missed groups from the list
+        if (raysHit < frame.numActiveRays)
+        {
+            numGroups = RemoveMissedGroups(context.context, numGroups);
+
+            // compact active rays if too many SIMD lanes are idle
+            if ((numGroups > 1) && (static_cast<float>(raysHit) < reorderingThreshold * static_cast<float>(RayPacket::RaysPerGroup * numGroups)))
+            {
+                ReorderRays(context.ray, context.context, numGroups, traversalDepth);
+                numGroups = (raysHit + RayPacket::RaysPerGroup - 1) / RayPacket::RaysPerGroup;
+            }
+        }
+
+        if (frame.node->IsLeaf())
+        {
+            object->Traverse_Leaf_Shadow(context, *frame.node, numGroups);
+        }
+        else if (numGroups <= simdThreshold)
+        {
+            // only few groups left - avoid packet bookkeeping overhead
+            GenericTraverse_Shadow_Subtree_Simd8(context, object, frame.node, numGroups, traversalDepth);
+        }
+        else
+        {
+            const BVH::Node* __restrict children = nodes + frame.node->childIndex;
+            RT_PREFETCH_L1(children);
+
+            // any hit is enough, so the child lying on the rays origin side of the split plane is visited first
+            const uint32 firstIndex = (rayOctant >> frame.node->GetSplitAxis()) & 1u;
+            const uint32 secondIndex = firstIndex ^ 1u;
+
+            stack[stackSize].node = children + secondIndex;
+            stack[stackSize].numActiveGroups = numGroups;
+            stack[stackSize].numActiveRays = raysHit;
+            stackSize++;
+
+            stack[stackSize].node = children + firstIndex;
+            stack[stackSize].numActiveGroups = numGroups;
+            stack[stackSize].numActiveRays = raysHit;
+            stackSize++;
+        }
+    }
+}
+
+// fallback for objects without packet intersection code - trace the rays (in local space) one by one
+template <typename ObjectType>
+void GenericTraverse_SingleRays(const PacketTraversalContext& context, const uint32 objectID, const ObjectType* object, uint32 numActiveGroups)
+{
+    math::Vector4 rayOrigins[RayPacket::RaysPerGroup];
+    math::Vector4 rayDirs[RayPacket::RaysPerGroup];
+
+    for (uint32 i = 0; i < numActiveGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
+        rayGroup.rays[1].origin.Unpack(rayOrigins);
+        rayGroup.rays[1].dir.Unpack(rayDirs);
+
+        for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+        {
+            if (rayGroup.rayOffsets[j] == RayPacket::InvalidRayOffset)
+            {
+                continue;
+            }
+
+            const math::Ray ray = math::Ray::BuildUnsafe(rayOrigins[j], rayDirs[j]);
+
+            HitPoint hitPoint;
+            hitPoint.distance = rayGroup.maxDistances[j];
+
+            object->Traverse(SingleTraversalContext{ ray, hitPoint, context.context }, objectID);
+
+            if (hitPoint.objectId != RT_INVALID_OBJECT)
+            {
+                rayGroup.maxDistances[j] = hitPoint.distance;
+                context.context.hitPoints[rayGroup.rayOffsets[j]] = hitPoint;
+            }
+        }
+    }
+}
+
+// fallback for objects without packet intersection code - trace the shadow rays (in local space) one by one
+template <typename ObjectType>
+void GenericTraverse_Shadow_SingleRays(const PacketTraversalContext& context, const ObjectType* object, uint32 numActiveGroups)
+{
+    math::Vector4 rayOrigins[RayPacket::RaysPerGroup];
+    math::Vector4 rayDirs[RayPacket::RaysPerGroup];
+
+    for (uint32 i = 0; i < numActiveGroups; ++i)
+    {
+        RayGroup& rayGroup = context.ray.groups[context.context.activeGroupsIndices[i]];
+        rayGroup.rays[1].origin.Unpack(rayOrigins);
+        rayGroup.rays[1].dir.Unpack(rayDirs);
+
+        uint32 occludedRaysMask = 0;
+        for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+        {
+            // skip unused and already occluded rays
+            if (rayGroup.rayOffsets[j] == RayPacket::InvalidRayOffset || !(rayGroup.maxDistances[j] > 0.0f))
+            {
+                continue;
+            }
+
+            const math::Ray ray = math::Ray::BuildUnsafe(rayOrigins[j], rayDirs[j]);
+
+            HitPoint hitPoint;
+            hitPoint.distance = rayGroup.maxDistances[j];
+
+            if (object->Traverse_Shadow(SingleTraversalContext{ ray, hitPoint, context.context }))
+            {
+                occludedRaysMask |= 1u << j;
+            }
+        }
+
+        if (occludedRaysMask)
+        {
+            context.StoreOcclusion(rayGroup, occludedRaysMask);
+        }
+    }
+}
+
 } // namespace rt
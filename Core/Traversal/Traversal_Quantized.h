@@ -0,0 +1,189 @@
+#pragma once
+
+#include "HitPoint.h"
+#include "TraversalContext.h"
+#include "Math/Ray.h"
+#include "Math/Geometry.h"
+#include "BVH/QuantizedBVH.h"
+#include "Rendering/Counters.h"
+#include "Rendering/Context.h"
+
+
+namespace rt {
+
+// single-ray traversal of quantized BVH
+// children bounds are decoded on the fly, the grid origin of each node is kept on the stack
+template <typename ObjectType>
+void GenericTraverse_Quantized(const SingleTraversalContext& context, const uint32 objectID, const ObjectType* object, const QuantizedBVH& bvh)
+{
+    struct StackEntry
+    {
+        math::Vector4 origin;
+        uint32 childIndex;
+        uint32 numLeaves;
+        float distance;
+    };
+
+    if (bvh.IsEmpty())
+    {
+        // tree is empty
+        return;
+    }
+
+    const QuantizedBVH::Node* __restrict nodes = bvh.GetNodes();
+
+    // "nodes to visit" stack
+    uint32 stackSize = 0;
+    StackEntry stack[QuantizedBVH::MaxStackSize];
+    stack[stackSize++] = { bvh.GetRootBox().min, bvh.GetRootChildIndex(), bvh.GetRootNumLeaves(), 0.0f };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+
+        // closer hit was found since the entry was pushed
+        if (entry.distance >= context.hitPoint.distance)
+        {
+            continue;
+        }
+
+        if (entry.numLeaves > 0)
+        {
+            BVH::Node leafNode;
+            leafNode.childIndex = entry.childIndex;
+            leafNode.numLeaves = entry.numLeaves;
+            object->Traverse_Leaf(context, objectID, leafNode);
+            continue;
+        }
+
+        const QuantizedBVH::Node& node = nodes[entry.childIndex];
+        const math::Vector4 scale = node.GetScale();
+        const math::Box boxA = node.GetChildBox(0, entry.origin, scale);
+        const math::Box boxB = node.GetChildBox(1, entry.origin, scale);
+
+        float distanceA, distanceB;
+        bool hitA = Intersect_BoxRay(context.ray, boxA, distanceA);
+
+        // prefetch grand-children
+        RT_PREFETCH_L1(nodes + node.childIndex[0]);
+
+        bool hitB = Intersect_BoxRay(context.ray, boxB, distanceB);
+
+        // Note: according to Intel manuals, prefetch instructions should not be grouped together
+        RT_PREFETCH_L1(nodes + node.childIndex[1]);
+
+        // box occlusion
+        hitA &= (distanceA < context.hitPoint.distance);
+        hitB &= (distanceB < context.hitPoint.distance);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += 2;
+            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+            context.context.localCounters.numVisitedNodes++;
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        const StackEntry entryA = { boxA.min, node.childIndex[0], node.numLeaves[0], distanceA };
+        const StackEntry entryB = { boxB.min, node.childIndex[1], node.numLeaves[1], distanceB };
+
+        // the closer child ends up on top of the stack
+        if (hitA && hitB)
+        {
+            if (distanceB < distanceA)
+            {
+                stack[stackSize++] = entryA;
+                stack[stackSize++] = entryB;
+            }
+            else
+            {
+                stack[stackSize++] = entryB;
+                stack[stackSize++] = entryA;
+            }
+        }
+        else if (hitA)
+        {
+            stack[stackSize++] = entryA;
+        }
+        else if (hitB)
+        {
+            stack[stackSize++] = entryB;
+        }
+    }
+}
+
+template <typename ObjectType>
+bool GenericTraverse_Quantized_Shadow(const SingleTraversalContext& context, const ObjectType* object, const QuantizedBVH& bvh)
+{
+    struct StackEntry
+    {
+        math::Vector4 origin;
+        uint32 childIndex;
+        uint32 numLeaves;
+    };
+
+    if (bvh.IsEmpty())
+    {
+        // tree is empty
+        return false;
+    }
+
+    const QuantizedBVH::Node* __restrict nodes = bvh.GetNodes();
+
+    // "nodes to visit" stack
+    uint32 stackSize = 0;
+    StackEntry stack[QuantizedBVH::MaxStackSize];
+    stack[stackSize++] = { bvh.GetRootBox().min, bvh.GetRootChildIndex(), bvh.GetRootNumLeaves() };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+
+        if (entry.numLeaves > 0)
+        {
+            BVH::Node leafNode;
+            leafNode.childIndex = entry.childIndex;
+            leafNode.numLeaves = entry.numLeaves;
+            if (object->Traverse_Leaf_Shadow(context, leafNode))
+            {
+                return true;
+            }
+            continue;
+        }
+
+        const QuantizedBVH::Node& node = nodes[entry.childIndex];
+        const math::Vector4 scale = node.GetScale();
+        const math::Box boxA = node.GetChildBox(0, entry.origin, scale);
+        const math::Box boxB = node.GetChildBox(1, entry.origin, scale);
+
+        float distanceA, distanceB;
+        const bool hitA = Intersect_BoxRay(context.ray, boxA, distanceA) && (distanceA < context.hitPoint.distance);
+        const bool hitB = Intersect_BoxRay(context.ray, boxB, distanceB) && (distanceB < context.hitPoint.distance);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += 2;
+            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+            context.context.localCounters.numVisitedNodes++;
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        // any hit terminates the traversal, so the order does not matter
+        if (hitA)
+        {
+            stack[stackSize++] = { boxA.min, node.childIndex[0], node.numLeaves[0] };
+        }
+        if (hitB)
+        {
+            stack[stackSize++] = { boxB.min, node.childIndex[1], node.numLeaves[1] };
+        }
+    }
+
+    return false;
+}
+
+} // namespace rt
@@ -1,24 +1,69 @@
 #pragma once
 
 #include "HitPoint.h"
+#include "TraversalContext.h"
+#include "Traversal_Single.h"
 #include "Math/Ray.h"
+#include "Math/Simd8Ray.h"
 #include "BVH/BVH.h"
 #include "Math/Geometry.h"
 #include "Math/Simd8Geometry.h"
 #include "Utils/iacaMarks.h"
 #include "Rendering/Counters.h"
+#include "Rendering/Context.h"
 
 
 namespace rt {
 
-// traverse 8 rays at a time
-// no ray reordering/masking is performed
+// extract single ray from SIMD-8 ray
+RT_FORCE_INLINE const math::Ray GetRayFromLane(const math::Ray_Simd8& ray, uint32 lane)
+{
+    const math::Vector4 origin(ray.origin.x[lane], ray.origin.y[lane], ray.origin.z[lane]);
+    const math::Vector4 dir(ray.dir.x[lane], ray.dir.y[lane], ray.dir.z[lane]);
+    return math::Ray::BuildUnsafe(origin, dir);
+}
+
+RT_FORCE_INLINE void StoreHitPointInLane(HitPoint_Simd8& hitPoint, uint32 lane, const HitPoint& laneHitPoint)
+{
+    hitPoint.distance[lane] = laneHitPoint.distance;
+    hitPoint.u[lane] = laneHitPoint.u;
+    hitPoint.v[lane] = laneHitPoint.v;
+    hitPoint.objectId[lane] = laneHitPoint.objectId;
+    hitPoint.subObjectId[lane] = laneHitPoint.subObjectId;
+}
+
+// continue traversal of a BVH subtree for single lane of SIMD-8 ray
 template <typename ObjectType>
-static void GenericTraverse(const SimdTraversalContext& context, const uint32 objectID, const ObjectType* object)
+void GenericTraverse_Lane(const SimdTraversalContext& context, const uint32 objectID, const ObjectType* object, const BVH::Node* startNode, uint32 lane)
+{
+    const math::Ray ray = GetRayFromLane(context.ray, lane);
+
+    HitPoint hitPoint;
+    hitPoint.distance = context.hitPoint.distance[lane];
+
+    GenericTraverse(SingleTraversalContext{ ray, hitPoint, context.context }, objectID, object, startNode);
+
+    if (hitPoint.objectId != RT_INVALID_OBJECT)
+    {
+        StoreHitPointInLane(context.hitPoint, lane, hitPoint);
+    }
+}
+
+// traverse 8 rays at a time through a BVH subtree
+// no ray reordering is performed
+// Note: the start node itself is not tested against the rays
+// Note: rays with non-positive max distance (hitPoint.distance) are considered inactive
+template <typename ObjectType>
+void GenericTraverse(const SimdTraversalContext& context, const uint32 objectID, const ObjectType* object, const BVH::Node* startNode)
 {
     const math::Vector3x8 rayInvDir = context.ray.invDir;
     const math::Vector3x8 rayOriginDivDir = context.ray.origin * context.ray.invDir;
 
+    // distances can only decrease, but never reach zero, so the mask is constant
+    const int32 activeRaysMask = (math::Vector8::Zero() < context.hitPoint.distance).GetMask();
+
+    const uint32 singleRayThreshold = context.context.params ? context.context.params->singleRayTraversalThreshold : 0;
+
     // all nodes
     const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
 
@@ -27,7 +72,7 @@ static void GenericTraverse(const SimdTraversalContext& context, const uint32 ob
     const BVH::Node* __restrict nodesStack[BVH::MaxDepth];
 
     // BVH traversal
-    for (const BVH::Node* __restrict currentNode = nodes;;)
+    for (const BVH::Node* __restrict currentNode = startNode;;)
     {
         if (currentNode->IsLeaf())
         {
@@ -41,24 +86,37 @@ static void GenericTraverse(const SimdTraversalContext& context, const uint32 ob
             RT_PREFETCH_L1(nodes + childA->childIndex);
 
             math::Vector8 distanceA;
-            const math::Vector8 maskA = Intersect_BoxRay(rayInvDir, rayOriginDivDir, childA->GetBox(), context.hitPoint.distance, distanceA);
-            const int32 intMaskA = maskA.GetSignMask();
+            const int32 intMaskA = activeRaysMask & Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childA->GetBox_Simd8(), context.hitPoint.distance, distanceA).GetMask();
 
             // Note: according to Intel manuals, prefetch instructions should not be grouped together
             RT_PREFETCH_L1(nodes + childB->childIndex);
 
             math::Vector8 distanceB;
-            const math::Vector8 maskB = Intersect_BoxRay(rayInvDir, rayOriginDivDir, childB->GetBox(), context.hitPoint.distance, distanceB);
-            const int32 intMaskB = maskB.GetSignMask();
+            const int32 intMaskB = activeRaysMask & Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childB->GetBox_Simd8(), context.hitPoint.distance, distanceB).GetMask();
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numRayBoxTests += 2 * 8;
-            context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskA);
-            context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskB);
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numRayBoxTests += 2 * 8;
+                context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskA);
+                context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskB);
+                context.context.localCounters.numVisitedNodes += math::PopCount(activeRaysMask);
+            }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
-            if (const int32 intMaskAB = intMaskA & intMaskB)
+            const uint32 intMaskAny = static_cast<uint32>(intMaskA | intMaskB);
+            if (intMaskAny && math::PopCount(intMaskAny) <= singleRayThreshold)
             {
+                // only few rays left - it's cheaper to trace them one by one
+                for (uint32 mask = intMaskAny; mask; mask &= mask - 1u)
+                {
+                    GenericTraverse_Lane(context, objectID, object, currentNode, math::FirstBitSet(mask));
+                }
+            }
+            else if (intMaskA && intMaskB)
+            {
+                // Note: both children must be visited even if no ray hits both of them
+                const int32 intMaskAB = intMaskA & intMaskB;
                 const int32 intOrderMask = (distanceA < distanceB).GetMask();
                 const int32 orderMaskA = intOrderMask & intMaskAB;
                 const int32 orderMaskB = (~intOrderMask) & intMaskAB;
@@ -71,18 +129,128 @@ static void GenericTraverse(const SimdTraversalContext& context, const uint32 ob
 
                 currentNode = childA;
                 nodesStack[stackSize++] = childB;
-
-                // TODO switching to single-ray traversal if pop count is equal to one?
                 continue;
             }
-
-            if (intMaskA)
+            else if (intMaskA)
             {
                 currentNode = childA;
                 continue;
             }
+            else if (intMaskB)
+            {
+                currentNode = childB;
+                continue;
+            }
+        }
 
-            if (intMaskB)
+        if (stackSize == 0)
+        {
+            break;
+        }
+
+        // pop a node
+        currentNode = nodesStack[--stackSize];
+    }
+}
+
+// traverse 8 rays at a time
+template <typename ObjectType>
+void GenericTraverse(const SimdTraversalContext& context, const uint32 objectID, const ObjectType* object)
+{
+    if (object->GetBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    GenericTraverse(context, objectID, object, object->GetBVH().GetNodes());
+}
+
+// traverse 8 shadow rays at a time through a BVH subtree
+// returns bitmask of occluded rays, each ray is terminated at its first hit
+// Note: the start node itself is not tested against the rays
+// Note: rays with non-positive max distance (hitPoint.distance) are considered inactive
+// Note: occluded rays get negative max distance, so they fail all the following box and triangle tests
+template <typename ObjectType>
+uint32 GenericTraverse_Shadow(const SimdTraversalContext& context, const ObjectType* object, const BVH::Node* startNode)
+{
+    const math::Vector3x8 rayInvDir = context.ray.invDir;
+    const math::Vector3x8 rayOriginDivDir = context.ray.origin * context.ray.invDir;
+
+    uint32 activeRaysMask = static_cast<uint32>((math::Vector8::Zero() < context.hitPoint.distance).GetMask());
+    uint32 occludedRaysMask = 0;
+
+    // bit set for each ray going towards negative values on given axis
+    const uint32 dirSignMasks[3] =
+    {
+        static_cast<uint32>(context.ray.dir.x.GetSignMask()),
+        static_cast<uint32>(context.ray.dir.y.GetSignMask()),
+        static_cast<uint32>(context.ray.dir.z.GetSignMask()),
+    };
+
+    // all nodes
+    const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
+
+    // "nodes to visit" stack
+    uint32 stackSize = 0;
+    const BVH::Node* __restrict nodesStack[BVH::MaxDepth];
+
+    // BVH traversal
+    for (const BVH::Node* __restrict currentNode = startNode; activeRaysMask;)
+    {
+        if (currentNode->IsLeaf())
+        {
+            const uint32 leafOccludedMask = object->Traverse_Leaf_Shadow(context, *currentNode);
+            occludedRaysMask |= leafOccludedMask;
+            activeRaysMask &= ~leafOccludedMask;
+        }
+        else
+        {
+            const BVH::Node* __restrict childA = nodes + currentNode->childIndex;
+            const BVH::Node* __restrict childB = childA + 1;
+
+            RT_PREFETCH_L1(nodes + childA->childIndex);
+
+            math::Vector8 distanceA;
+            const uint32 intMaskA = activeRaysMask & Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childA->GetBox_Simd8(), context.hitPoint.distance, distanceA).GetMask();
+
+            // Note: according to Intel manuals, prefetch instructions should not be grouped together
+            RT_PREFETCH_L1(nodes + childB->childIndex);
+
+            math::Vector8 distanceB;
+            const uint32 intMaskB = activeRaysMask & Intersect_BoxRay_Simd8(rayInvDir, rayOriginDivDir, childB->GetBox_Simd8(), context.hitPoint.distance, distanceB).GetMask();
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numRayBoxTests += 2 * 8;
+                context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskA);
+                context.context.localCounters.numPassedRayBoxTests += math::PopCount(intMaskB);
+                context.context.localCounters.numVisitedNodes += math::PopCount(activeRaysMask);
+            }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+            if (intMaskA && intMaskB)
+            {
+                // any hit is enough, so visit the child lying on the origin side of the split plane
+                // for the majority of the rays first (left child is on the lower side)
+                const uint32 intMaskAny = intMaskA | intMaskB;
+                const uint32 reverseOrderMask = dirSignMasks[currentNode->GetSplitAxis()] & intMaskAny;
+                if (2 * math::PopCount(reverseOrderMask) > math::PopCount(intMaskAny))
+                {
+                    std::swap(childB, childA);
+                }
+
+                currentNode = childA;
+                nodesStack[stackSize++] = childB;
+                continue;
+            }
+            else if (intMaskA)
+            {
+                currentNode = childA;
+                continue;
+            }
+            else if (intMaskB)
             {
                 currentNode = childB;
                 continue;
@@ -97,6 +265,70 @@ static void GenericTraverse(const SimdTraversalContext& context, const uint32 ob
         // pop a node
         currentNode = nodesStack[--stackSize];
     }
+
+    return occludedRaysMask;
+}
+
+// traverse 8 shadow rays at a time
+// returns bitmask of occluded rays
+template <typename ObjectType>
+uint32 GenericTraverse_Shadow(const SimdTraversalContext& context, const ObjectType* object)
+{
+    if (object->GetBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return 0;
+    }
+
+    return GenericTraverse_Shadow(context, object, object->GetBVH().GetNodes());
+}
+
+// fallback for objects without SIMD intersection code - trace the active rays one by one
+template <typename ObjectType>
+void GenericTraverse_SingleRays(const SimdTraversalContext& context, const uint32 objectID, const ObjectType* object)
+{
+    const int32 activeRaysMask = (math::Vector8::Zero() < context.hitPoint.distance).GetMask();
+
+    for (uint32 mask = static_cast<uint32>(activeRaysMask); mask; mask &= mask - 1u)
+    {
+        const uint32 lane = math::FirstBitSet(mask);
+        const math::Ray ray = GetRayFromLane(context.ray, lane);
+
+        HitPoint hitPoint;
+        hitPoint.distance = context.hitPoint.distance[lane];
+
+        object->Traverse(SingleTraversalContext{ ray, hitPoint, context.context }, objectID);
+
+        if (hitPoint.objectId != RT_INVALID_OBJECT)
+        {
+            StoreHitPointInLane(context.hitPoint, lane, hitPoint);
+        }
+    }
+}
+
+// fallback for objects without SIMD intersection code - trace the active shadow rays one by one
+template <typename ObjectType>
+uint32 GenericTraverse_Shadow_SingleRays(const SimdTraversalContext& context, const ObjectType* object)
+{
+    const int32 activeRaysMask = (math::Vector8::Zero() < context.hitPoint.distance).GetMask();
+
+    uint32 occludedRaysMask = 0;
+    for (uint32 mask = static_cast<uint32>(activeRaysMask); mask; mask &= mask - 1u)
+    {
+        const uint32 lane = math::FirstBitSet(mask);
+        const math::Ray ray = GetRayFromLane(context.ray, lane);
+
+        HitPoint hitPoint;
+        hitPoint.distance = context.hitPoint.distance[lane];
+
+        if (object->Traverse_Shadow(SingleTraversalContext{ ray, hitPoint, context.context }))
+        {
+            context.hitPoint.distance[lane] = -FLT_MAX;
+            occludedRaysMask |= 1u << lane;
+        }
+    }
+
+    return occludedRaysMask;
 }
 
 } // namespace rt
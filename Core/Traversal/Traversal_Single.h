@@ -7,22 +7,18 @@
 #include "Math/Geometry.h"
 #include "Utils/iacaMarks.h"
 #include "Rendering/Counters.h"
+#include "Rendering/Context.h"
 
 
 namespace rt {
 
-// simple single-ray traversal
+// simple single-ray traversal of a BVH subtree
+// Note: the start node itself is not tested against the ray
 template <typename ObjectType>
-void GenericTraverse(const SingleTraversalContext& context, const uint32 objectID, const ObjectType* object)
+void GenericTraverse(const SingleTraversalContext& context, const uint32 objectID, const ObjectType* object, const BVH::Node* startNode)
 {
     float distanceA, distanceB;
 
-    if (object->GetBVH().GetNumNodes() == 0)
-    {
-        // tree is empty
-        return;
-    }
-
     // all nodes
     const BVH::Node* __restrict nodes = object->GetBVH().GetNodes();
 
@@ -31,7 +27,7 @@ void GenericTraverse(const SingleTraversalContext& context, const uint32 objectI
     const BVH::Node* __restrict nodesStack[BVH::MaxDepth];
 
     // BVH traversal
-    for (const BVH::Node* __restrict currentNode = nodes;;)
+    for (const BVH::Node* __restrict currentNode = startNode;;)
     {
         if (currentNode->IsLeaf())
         {
@@ -57,9 +53,13 @@ void GenericTraverse(const SingleTraversalContext& context, const uint32 objectI
             hitB &= (distanceB < context.hitPoint.distance);
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numRayBoxTests += 2;
-            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
-            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numRayBoxTests += 2;
+                context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+                context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+                context.context.localCounters.numVisitedNodes++;
+            }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
             if (hitA && hitB)
@@ -95,6 +95,19 @@ void GenericTraverse(const SingleTraversalContext& context, const uint32 objectI
     }
 }
 
+// simple single-ray traversal
+template <typename ObjectType>
+void GenericTraverse(const SingleTraversalContext& context, const uint32 objectID, const ObjectType* object)
+{
+    if (object->GetBVH().GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    GenericTraverse(context, objectID, object, object->GetBVH().GetNodes());
+}
+
 template <typename ObjectType>
 bool GenericTraverse_Shadow(const SingleTraversalContext& context, const ObjectType* object)
 {
@@ -113,6 +126,9 @@ bool GenericTraverse_Shadow(const SingleTraversalContext& context, const ObjectT
     uint32 stackSize = 0;
     const BVH::Node* __restrict nodesStack[BVH::MaxDepth];
 
+    // bit set if the ray goes towards negative values on given axis
+    const uint32 dirSignMask = static_cast<uint32>(context.ray.dir.GetSignMask());
+
     // BVH traversal
     for (const BVH::Node* __restrict currentNode = nodes;;)
     {
@@ -143,15 +159,22 @@ bool GenericTraverse_Shadow(const SingleTraversalContext& context, const ObjectT
             hitB &= (distanceB < context.hitPoint.distance);
 
 #ifdef RT_ENABLE_INTERSECTION_COUNTERS
-            context.context.localCounters.numRayBoxTests += 2;
-            context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
-            context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+            if (context.context.localCounters.enabled)
+            {
+                context.context.localCounters.numRayBoxTests += 2;
+                context.context.localCounters.numPassedRayBoxTests += hitA ? 1 : 0;
+                context.context.localCounters.numPassedRayBoxTests += hitB ? 1 : 0;
+                context.context.localCounters.numVisitedNodes++;
+            }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
             if (hitA && hitB)
             {
-                currentNode = childA;
-                nodesStack[stackSize++] = childB;
+                // any hit is enough, so instead of sorting by distance visit the child lying
+                // on the ray origin side of the split plane first (left child is on the lower side)
+                const bool reverseOrder = (dirSignMask >> currentNode->GetSplitAxis()) & 1u;
+                currentNode = reverseOrder ? childB : childA;
+                nodesStack[stackSize++] = reverseOrder ? childA : childB;
                 continue;
             }
             if (hitA)
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "HitPoint.h"
+#include "TraversalContext.h"
+#include "Math/Ray.h"
+#include "BVH/WideBVH.h"
+#include "Rendering/Counters.h"
+#include "Rendering/Context.h"
+
+
+namespace rt {
+
+// single ray splatted for testing against all the children of a wide BVH node
+template<typename VectorType>
+struct WideBVHRay
+{
+    VectorType invDir[3];
+    VectorType originDivDir[3];
+
+    RT_FORCE_INLINE explicit WideBVHRay(const math::Ray& ray)
+    {
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+            invDir[axis] = VectorType(ray.invDir[axis]);
+            originDivDir[axis] = VectorType(ray.originDivDir[axis]);
+        }
+    }
+};
+
+// test ray against all the children of a node, returns bitmask of hit children
+template<uint32 Width>
+RT_FORCE_INLINE uint32 Intersect_WideNode(
+    const WideBVHRay<typename WideBVH<Width>::VectorType>& ray,
+    const typename WideBVH<Width>::Node& node,
+    const typename WideBVH<Width>::VectorType& maxDistance,
+    typename WideBVH<Width>::VectorType& outDistance)
+{
+    using VectorType = typename WideBVH<Width>::VectorType;
+
+    VectorType nearDist = VectorType::Zero();
+    VectorType farDist = maxDistance;
+
+    for (uint32 axis = 0; axis < 3; ++axis)
+    {
+        const VectorType tmp1 = VectorType::MulAndSub(VectorType(node.min[axis]), ray.invDir[axis], ray.originDivDir[axis]);
+        const VectorType tmp2 = VectorType::MulAndSub(VectorType(node.max[axis]), ray.invDir[axis], ray.originDivDir[axis]);
+        nearDist = VectorType::Max(nearDist, VectorType::Min(tmp1, tmp2));
+        farDist = VectorType::Min(farDist, VectorType::Max(tmp1, tmp2));
+    }
+
+    outDistance = nearDist;
+
+    return static_cast<uint32>((nearDist <= farDist).GetMask()) & node.GetValidChildrenMask();
+}
+
+// single-ray traversal of wide BVH (BVH4/BVH8)
+// children are visited in front-to-back order
+template <uint32 Width, typename ObjectType>
+void GenericTraverse_Wide(const SingleTraversalContext& context, const uint32 objectID, const ObjectType* object, const WideBVH<Width>& bvh)
+{
+    using VectorType = typename WideBVH<Width>::VectorType;
+
+    struct StackEntry
+    {
+        uint32 childIndex;
+        uint32 numLeaves;
+        float distance;
+    };
+
+    if (bvh.GetNumNodes() == 0)
+    {
+        // tree is empty
+        return;
+    }
+
+    const typename WideBVH<Width>::Node* __restrict nodes = bvh.GetNodes();
+    const WideBVHRay<VectorType> ray(context.ray);
+
+    // "nodes to visit" stack
+    uint32 stackSize = 0;
+    StackEntry stack[WideBVH<Width>::MaxStackSize];
+    stack[stackSize++] = { 0, 0, 0.0f };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+
+        // closer hit was found since the entry was pushed
+        if (entry.distance >= context.hitPoint.distance)
+        {
+            continue;
+        }
+
+        if (entry.numLeaves > 0)
+        {
+            BVH::Node leafNode;
+            leafNode.childIndex = entry.childIndex;
+            leafNode.numLeaves = entry.numLeaves;
+            object->Traverse_Leaf(context, objectID, leafNode);
+            continue;
+        }
+
+        const typename WideBVH<Width>::Node& node = nodes[entry.childIndex];
+
+        VectorType distances;
+        uint32 hitMask = Intersect_WideNode<Width>(ray, node, VectorType(context.hitPoint.distance), distances);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += node.numChildren;
+            context.context.localCounters.numPassedRayBoxTests += math::PopCount(hitMask);
+            context.context.localCounters.numVisitedNodes++;
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        // push hit children sorted by distance (the closest one ends up on top of the stack)
+        const uint32 firstEntry = stackSize;
+        while (hitMask)
+        {
+            const uint32 lane = math::FirstBitSet(hitMask);
+            hitMask &= hitMask - 1;
+
+            RT_PREFETCH_L1(nodes + node.childIndex[lane]);
+
+            const StackEntry newEntry = { node.childIndex[lane], node.numLeaves[lane], distances[lane] };
+
+            uint32 j = stackSize++;
+            for (; j > firstEntry && stack[j - 1].distance < newEntry.distance; --j)
+            {
+                stack[j] = stack[j - 1];
+            }
+            stack[j] = newEntry;
+        }
+    }
+}
+
+template <uint32 Width, typename ObjectType>
+bool GenericTraverse_Wide_Shadow(const SingleTraversalContext& context, const ObjectType* object, const WideBVH<Width>& bvh)
+{
+    using VectorType = typename WideBVH<Width>::VectorType;
+
+    struct StackEntry
+    {
+        uint32 childIndex;
+        uint32 numLeaves;
+    };
+
+    if (bvh.GetNumNodes() == 0)
+    {
+        // tree is empty
+        return false;
+    }
+
+    const typename WideBVH<Width>::Node* __restrict nodes = bvh.GetNodes();
+    const WideBVHRay<VectorType> ray(context.ray);
+    const VectorType maxDistance(context.hitPoint.distance);
+
+    // "nodes to visit" stack
+    uint32 stackSize = 0;
+    StackEntry stack[WideBVH<Width>::MaxStackSize];
+    stack[stackSize++] = { 0, 0 };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+
+        if (entry.numLeaves > 0)
+        {
+            BVH::Node leafNode;
+            leafNode.childIndex = entry.childIndex;
+            leafNode.numLeaves = entry.numLeaves;
+            if (object->Traverse_Leaf_Shadow(context, leafNode))
+            {
+                return true;
+            }
+            continue;
+        }
+
+        const typename WideBVH<Width>::Node& node = nodes[entry.childIndex];
+
+        VectorType distances;
+        uint32 hitMask = Intersect_WideNode<Width>(ray, node, maxDistance, distances);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (context.context.localCounters.enabled)
+        {
+            context.context.localCounters.numRayBoxTests += node.numChildren;
+            context.context.localCounters.numPassedRayBoxTests += math::PopCount(hitMask);
+            context.context.localCounters.numVisitedNodes++;
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+        // any hit terminates the traversal, so the order does not matter
+        while (hitMask)
+        {
+            const uint32 lane = math::FirstBitSet(hitMask);
+            hitMask &= hitMask - 1;
+            stack[stackSize++] = { node.childIndex[lane], node.numLeaves[lane] };
+        }
+    }
+
+    return false;
+}
+
+} // namespace rt
@@ -4,8 +4,10 @@
 #include "BlockCompression.h"
 #include "Timer.h"
 #include "MemoryHelpers.h"
+#include "ThreadPool.h"
 #include "../Math/Packed.h"
 #include "../Math/Vector4Load.h"
+#include "../Math/Vector8.h"
 #include "../Color/ColorHelpers.h"
 
 namespace rt {
@@ -276,7 +278,16 @@ bool Bitmap::Copy(Bitmap& target, const Bitmap& source)
     if (target.mStride == source.mStride)
     {
         RT_ASSERT(target.GetDataSize() == source.GetDataSize());
-        LargeMemCopy(target.GetData(), source.GetData(), source.GetDataSize());
+
+        // LargeMemCopy requires data size to be multiple of AVX register size
+        if (source.GetDataSize() % sizeof(math::Vector8) == 0)
+        {
+            LargeMemCopy(target.GetData(), source.GetData(), source.GetDataSize());
+        }
+        else
+        {
+            memcpy(target.GetData(), source.GetData(), source.GetDataSize());
+        }
     }
     else
     {
@@ -878,17 +889,21 @@ bool Bitmap::Scale(const math::Vector4& factor)
 }
 
 // performs 1D box blur in linear time
+template<typename T>
 RT_FORCE_NOINLINE
-static void BoxBlur_Internal(Vector4* __restrict targetLine, const Vector4* __restrict srcLine, const uint32 radius, const uint32 width)
+static void BoxBlur_Internal(T* __restrict targetLine, const T* __restrict srcLine, uint32 radius, const uint32 width)
 {
+    // the box can't be wider than the line
+    radius = Min(radius, (width - 1) / 2);
+
     const float factor = 1.0f / (float)(2 * radius + 1);
 
-    const Vector4* __restrict srcLineBegin = srcLine;
-    const Vector4* __restrict srcLineEnd = srcLine;
+    const T* __restrict srcLineBegin = srcLine;
+    const T* __restrict srcLineEnd = srcLine;
 
-    const Vector4 firstValue = srcLine[0];
-    const Vector4 lastValue = srcLine[width - 1];
-    Vector4 val = firstValue * static_cast<float>(radius + 1);
+    const T firstValue = srcLine[0];
+    const T lastValue = srcLine[width - 1];
+    T val = firstValue * static_cast<float>(radius + 1);
 
     for (uint32 j = 0; j < radius; j++)
     {
@@ -914,7 +929,7 @@ static void BoxBlur_Internal(Vector4* __restrict targetLine, const Vector4* __re
     }
 }
 
-bool Bitmap::GaussianBlur(const float sigma, const uint32 n)
+bool Bitmap::GaussianBlur(const float sigma, const uint32 n, ThreadPool* threadPool, DynArray<Vector8>* scratchBuffer)
 {
     if (mFormat != Format::R32G32B32_Float)
     {
@@ -922,12 +937,9 @@ bool Bitmap::GaussianBlur(const float sigma, const uint32 n)
         return false;
     }
 
-    // TODO get rid of this
-    const uint32 MaxLineSize = 4096;
-    if (mWidth > MaxLineSize || mHeight > MaxLineSize)
+    if (mWidth == 0 || mHeight == 0 || n == 0)
     {
-        RT_LOG_ERROR("GaussianBlur: Image too big");
-        return false;
+        return true;
     }
 
     // based on http://blog.ivank.net/fastest-gaussian-blur.html
@@ -943,73 +955,152 @@ bool Bitmap::GaussianBlur(const float sigma, const uint32 n)
     const float mIdeal = (12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f);
     const float m = roundf(mIdeal);
 
-    const uint32 numColumns = 4; // RT_CACHE_LINE_SIZE / sizeof(Float3);
-
-    Vector4 tempLineA[numColumns][MaxLineSize];
-    Vector4 tempLineB[numColumns][MaxLineSize];
+    // Each SIMD-8 line holds two rows (horizontal pass) or two columns (vertical pass) of pixels.
+    // A single task blurs 'numLines' such lines, each worker thread has its own scratch buffers.
+    const uint32 numLines = 4;
+    const uint32 pixelsPerTask = 2 * numLines;
+    const uint32 maxLineSize = Max(mWidth, mHeight);
+    const uint32 numThreads = threadPool ? threadPool->GetNumThreads() : 1;
+    const size_t scratchSizePerThread = 2 * numLines * static_cast<size_t>(maxLineSize);
 
-    Vector4* sourceLinePtr = nullptr;
-    Vector4* targetLinePtr = nullptr;
+    DynArray<Vector8> localScratch;
+    DynArray<Vector8>& scratch = scratchBuffer ? *scratchBuffer : localScratch;
+    const uint32 scratchSize = static_cast<uint32>(numThreads * scratchSizePerThread);
+    if (scratch.Size() < scratchSize && !scratch.Resize_SkipConstructor(scratchSize))
+    {
+        RT_LOG_ERROR("GaussianBlur: Failed to allocate scratch buffer");
+        return false;
+    }
 
-    // horizontal blur
-    for (uint32 y = 0; y < mHeight; ++y)
+    // blur lines in place, returns pointer to the blurred lines
+    const auto blurLines = [&](Vector8* lines, const uint32 lineSize) -> Vector8*
     {
-        Float3* rowPtr = &GetPixelRef<Float3>(0, y);
+        Vector8* tempLines = lines + numLines * maxLineSize;
 
-        for (uint32 x = 0; x < mWidth; ++x)
+        for (uint32 i = 0; i < n; ++i)
         {
-            tempLineB[0][x] = Vector4((float*)(rowPtr + x));
+            const uint32 radius = i < m ? wl : wu;
+            for (uint32 j = 0; j < numLines; ++j)
+            {
+                BoxBlur_Internal(tempLines + j * maxLineSize, lines + j * maxLineSize, radius, lineSize);
+            }
+            std::swap(lines, tempLines);
         }
 
-        sourceLinePtr = tempLineB[0];
-        targetLinePtr = tempLineA[0];
+        return lines;
+    };
 
-        for (uint32 i = 0; i < n; ++i)
+    const auto runTasks = [threadPool](const ParallelTask& task, uint32 numTasks)
+    {
+        if (threadPool)
         {
-            const uint32 radius = i < m ? wl : wu;
-            BoxBlur_Internal(targetLinePtr, sourceLinePtr, radius, mWidth);
-            std::swap(sourceLinePtr, targetLinePtr);
+            threadPool->RunParallelTask(task, numTasks);
         }
-
-        for (uint32 x = 0; x < mWidth; ++x)
+        else
         {
-            *(rowPtr + x) = targetLinePtr[x].ToFloat3();
+            for (uint32 i = 0; i < numTasks; ++i)
+            {
+                task(i, 0);
+            }
         }
-    }
+    };
 
-    // vertical blur
-    for (uint32 x = 0; x < mWidth; x += numColumns)
+    // horizontal blur
+    const auto horizontalBlurTask = [&](uint32 taskID, uint32 threadID)
     {
-        for (uint32 y = 0; y < mHeight; ++y)
+        Vector8* lines = scratch.Data() + threadID * scratchSizePerThread;
+
+        const uint32 minY = taskID * pixelsPerTask;
+        const uint32 maxY = Min(minY + pixelsPerTask, mHeight);
+
+        for (uint32 j = 0; j < numLines; ++j)
+        {
+            const uint32 yA = Min(minY + 2 * j, maxY - 1);
+            const uint32 yB = Min(yA + 1, maxY - 1);
+            const Float3* rowA = &GetPixelRef<Float3>(0, yA);
+            const Float3* rowB = &GetPixelRef<Float3>(0, yB);
+
+            Vector8* line = lines + j * maxLineSize;
+            for (uint32 x = 0; x < mWidth; ++x)
+            {
+                line[x] = Vector8(Vector4_Load_Float3_Unsafe(rowA[x]), Vector4_Load_Float3_Unsafe(rowB[x]));
+            }
+        }
+
+        const Vector8* blurredLines = blurLines(lines, mWidth);
+
+        for (uint32 j = 0; j < numLines; ++j)
         {
-            for (uint32 i = 0; i < numColumns; ++i)
+            const uint32 yA = minY + 2 * j;
+            const Vector8* line = blurredLines + j * maxLineSize;
+
+            if (yA < maxY)
+            {
+                Float3* rowA = &GetPixelRef<Float3>(0, yA);
+                for (uint32 x = 0; x < mWidth; ++x)
+                {
+                    rowA[x] = line[x].Low().ToFloat3();
+                }
+            }
+
+            if (yA + 1 < maxY)
             {
-                tempLineA[i][y] = Vector4(GetPixelRef<Float3>(x + i, y));
+                Float3* rowB = &GetPixelRef<Float3>(0, yA + 1);
+                for (uint32 x = 0; x < mWidth; ++x)
+                {
+                    rowB[x] = line[x].High().ToFloat3();
+                }
             }
         }
+    };
 
-        for (uint32 i = 0; i < numColumns; ++i)
+    runTasks(horizontalBlurTask, (mHeight + pixelsPerTask - 1) / pixelsPerTask);
+
+    // vertical blur
+    const auto verticalBlurTask = [&](uint32 taskID, uint32 threadID)
+    {
+        Vector8* lines = scratch.Data() + threadID * scratchSizePerThread;
+
+        const uint32 minX = taskID * pixelsPerTask;
+        const uint32 maxX = Min(minX + pixelsPerTask, mWidth);
+
+        for (uint32 y = 0; y < mHeight; ++y)
         {
-            sourceLinePtr = tempLineA[i];
-            targetLinePtr = tempLineB[i];
+            const Float3* row = &GetPixelRef<Float3>(0, y);
 
-            for (uint32 j = 0; j < n; ++j)
+            for (uint32 j = 0; j < numLines; ++j)
             {
-                const uint32 radius = j < m ? wl : wu;
-                BoxBlur_Internal(targetLinePtr, sourceLinePtr, radius, mHeight);
-                std::swap(sourceLinePtr, targetLinePtr);
+                const uint32 xA = Min(minX + 2 * j, maxX - 1);
+                const uint32 xB = Min(xA + 1, maxX - 1);
+                lines[j * maxLineSize + y] = Vector8(Vector4_Load_Float3_Unsafe(row[xA]), Vector4_Load_Float3_Unsafe(row[xB]));
             }
         }
 
+        const Vector8* blurredLines = blurLines(lines, mHeight);
 
         for (uint32 y = 0; y < mHeight; ++y)
         {
-            for (uint32 i = 0; i < numColumns; ++i)
+            Float3* row = &GetPixelRef<Float3>(0, y);
+
+            for (uint32 j = 0; j < numLines; ++j)
             {
-                GetPixelRef<Float3>(x + i, y) = tempLineA[i][y].ToFloat3();
+                const uint32 xA = minX + 2 * j;
+                const Vector8 value = blurredLines[j * maxLineSize + y];
+
+                if (xA < maxX)
+                {
+                    row[xA] = value.Low().ToFloat3();
+                }
+
+                if (xA + 1 < maxX)
+                {
+                    row[xA + 1] = value.High().ToFloat3();
+                }
             }
         }
-    }
+    };
+
+    runTasks(verticalBlurTask, (mWidth + pixelsPerTask - 1) / pixelsPerTask);
 
     return true;
 }
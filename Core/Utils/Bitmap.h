@@ -1,10 +1,14 @@
 #pragma once
 
 #include "../Math/VectorInt4.h"
+#include "../Math/Vector8.h"
 #include "../Utils/Memory.h"
+#include "../Containers/DynArray.h"
 
 namespace rt {
 
+class ThreadPool;
+
 /**
  * Class representing 2D bitmap.
  */
@@ -131,8 +135,12 @@ public:
 
     // scale pixels by a given value
     RAYLIB_API bool Scale(const math::Vector4& factor);
-    
-    bool GaussianBlur(const float sigma, const uint32 n);
+
+    // apply gaussian blur (approximated with 'n' box blur passes)
+    // NOTE: must be R32G32B32_Float format
+    // NOTE: rows and columns are processed in parallel if a thread pool is provided
+    // NOTE: 'scratchBuffer' can be provided to reuse the temporary memory across calls (it only grows)
+    RAYLIB_API bool GaussianBlur(const float sigma, const uint32 n, ThreadPool* threadPool = nullptr, DynArray<math::Vector8>* scratchBuffer = nullptr);
 
 private:
 
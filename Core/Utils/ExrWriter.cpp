@@ -0,0 +1,331 @@
+#include "PCH.h"
+#include "ExrWriter.h"
+#include "Logger.h"
+
+namespace rt {
+
+using namespace math;
+
+namespace {
+
+// Note: EXR stores the channels in alphabetical order
+const char* const ExrChannelNames[] = { "B", "G", "R" };
+const uint32 ExrNumChannels = 3;
+const int32 ExrPixelTypeFloat = 2;
+
+bool WriteExrAttribute(FILE* file, const char* name, const char* type, const void* data, uint32 size)
+{
+    bool success = true;
+    success &= fwrite(name, strlen(name) + 1, 1, file) == 1;
+    success &= fwrite(type, strlen(type) + 1, 1, file) == 1;
+    success &= fwrite(&size, sizeof(size), 1, file) == 1;
+    success &= fwrite(data, size, 1, file) == 1;
+    return success;
+}
+
+bool WriteExrHeader(FILE* file, uint32 width, uint32 height)
+{
+    bool success = true;
+
+    const uint8 magic[] = { 0x76, 0x2F, 0x31, 0x01 };
+    const uint32 version = 2; // single-part scanline image
+    success &= fwrite(magic, sizeof(magic), 1, file) == 1;
+    success &= fwrite(&version, sizeof(version), 1, file) == 1;
+
+    // channels list: name, pixel type, pLinear + reserved bytes, x and y sampling
+    {
+        uint8 channels[ExrNumChannels * 18 + 1];
+        uint8* ptr = channels;
+        for (uint32 i = 0; i < ExrNumChannels; ++i)
+        {
+            const int32 channelDesc[4] = { ExrPixelTypeFloat, 0, 1, 1 };
+            *ptr++ = static_cast<uint8>(ExrChannelNames[i][0]);
+            *ptr++ = 0;
+            memcpy(ptr, channelDesc, sizeof(channelDesc));
+            ptr += sizeof(channelDesc);
+        }
+        *ptr++ = 0;
+        success &= WriteExrAttribute(file, "channels", "chlist", channels, static_cast<uint32>(ptr - channels));
+    }
+
+    const uint8 compression = 0; // NO_COMPRESSION
+    const int32 window[4] = { 0, 0, static_cast<int32>(width) - 1, static_cast<int32>(height) - 1 };
+    const uint8 lineOrder = 0; // INCREASING_Y
+    const float pixelAspectRatio = 1.0f;
+    const float screenWindowCenter[2] = { 0.0f, 0.0f };
+    const float screenWindowWidth = 1.0f;
+
+    success &= WriteExrAttribute(file, "compression", "compression", &compression, sizeof(compression));
+    success &= WriteExrAttribute(file, "dataWindow", "box2i", window, sizeof(window));
+    success &= WriteExrAttribute(file, "displayWindow", "box2i", window, sizeof(window));
+    success &= WriteExrAttribute(file, "lineOrder", "lineOrder", &lineOrder, sizeof(lineOrder));
+    success &= WriteExrAttribute(file, "pixelAspectRatio", "float", &pixelAspectRatio, sizeof(pixelAspectRatio));
+    success &= WriteExrAttribute(file, "screenWindowCenter", "v2f", screenWindowCenter, sizeof(screenWindowCenter));
+    success &= WriteExrAttribute(file, "screenWindowWidth", "float", &screenWindowWidth, sizeof(screenWindowWidth));
+
+    // end of header
+    const uint8 terminator = 0;
+    success &= fwrite(&terminator, sizeof(terminator), 1, file) == 1;
+
+    return success;
+}
+
+} // namespace
+
+ExrWriter::ExrWriter()
+    : mFile(nullptr)
+    , mWidth(0)
+    , mHeight(0)
+    , mNumWrittenLines(0)
+{
+}
+
+ExrWriter::~ExrWriter()
+{
+    if (mFile)
+    {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+bool ExrWriter::Open(const char* path, uint32 width, uint32 height)
+{
+    RT_ASSERT(!mFile, "EXR writer is already open");
+
+    if (width == 0 || height == 0)
+    {
+        RT_LOG_ERROR("ExrWriter: Invalid image size %ux%u", width, height);
+        return false;
+    }
+
+    if (!mLineBuffer.Resize(width * ExrNumChannels))
+    {
+        return false;
+    }
+
+    mFile = fopen(path, "wb");
+    if (!mFile)
+    {
+        RT_LOG_ERROR("ExrWriter: Failed to open file '%s'", path);
+        return false;
+    }
+
+    mPath = path;
+    mWidth = width;
+    mHeight = height;
+    mNumWrittenLines = 0;
+
+    bool success = WriteExrHeader(mFile, width, height);
+
+    // lines are not compressed, so the offsets of all the lines are known upfront
+    const uint64 lineChunkSize = 2 * sizeof(int32) + sizeof(float) * ExrNumChannels * static_cast<uint64>(width);
+    const uint64 firstLineOffset = static_cast<uint64>(ftell(mFile)) + sizeof(uint64) * static_cast<uint64>(height);
+    for (uint32 y = 0; y < height && success; ++y)
+    {
+        const uint64 offset = firstLineOffset + lineChunkSize * y;
+        success &= fwrite(&offset, sizeof(offset), 1, mFile) == 1;
+    }
+
+    if (!success)
+    {
+        RT_LOG_ERROR("ExrWriter: Failed to write header of '%s'", path);
+        fclose(mFile);
+        mFile = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool ExrWriter::WriteLine(const Float3* pixels)
+{
+    RT_ASSERT(mFile, "EXR writer is not open");
+    RT_ASSERT(mNumWrittenLines < mHeight, "All the lines were already written");
+
+    // convert RGB triplets to separate B, G and R lines
+    float* blueLine = mLineBuffer.Data();
+    float* greenLine = blueLine + mWidth;
+    float* redLine = greenLine + mWidth;
+    for (uint32 x = 0; x < mWidth; ++x)
+    {
+        blueLine[x] = pixels[x].z;
+        greenLine[x] = pixels[x].y;
+        redLine[x] = pixels[x].x;
+    }
+
+    const int32 chunkHeader[2] =
+    {
+        static_cast<int32>(mNumWrittenLines),
+        static_cast<int32>(sizeof(float) * mLineBuffer.Size()),
+    };
+
+    bool success = true;
+    success &= fwrite(chunkHeader, sizeof(chunkHeader), 1, mFile) == 1;
+    success &= fwrite(mLineBuffer.Data(), sizeof(float) * mLineBuffer.Size(), 1, mFile) == 1;
+
+    if (!success)
+    {
+        RT_LOG_ERROR("ExrWriter: Failed to write line %u of '%s'", mNumWrittenLines, mPath.c_str());
+        return false;
+    }
+
+    mNumWrittenLines++;
+    return true;
+}
+
+bool ExrWriter::Close()
+{
+    if (!mFile)
+    {
+        return false;
+    }
+
+    const bool success = (fclose(mFile) == 0) && (mNumWrittenLines == mHeight);
+    mFile = nullptr;
+
+    if (!success)
+    {
+        RT_LOG_ERROR("ExrWriter: Failed to write '%s' (%u of %u lines written)", mPath.c_str(), mNumWrittenLines, mHeight);
+        return false;
+    }
+
+    RT_LOG_INFO("Image file '%s' written successfully", mPath.c_str());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+AsyncExrWriter::AsyncExrWriter()
+    : mNumQueuedLines(0)
+    , mNumPendingBytes(0)
+    , mFinish(false)
+    , mFailed(false)
+{
+}
+
+AsyncExrWriter::~AsyncExrWriter()
+{
+    if (mThread.joinable())
+    {
+        Close();
+    }
+}
+
+bool AsyncExrWriter::Open(const char* path, uint32 width, uint32 height)
+{
+    RT_ASSERT(!mThread.joinable(), "EXR writer is already open");
+
+    if (!mWriter.Open(path, width, height))
+    {
+        return false;
+    }
+
+    mNumQueuedLines = 0;
+    mNumPendingBytes = 0;
+    mFinish = false;
+    mFailed = false;
+    mThread = std::thread(&AsyncExrWriter::WriterThreadCallback, this);
+
+    return true;
+}
+
+bool AsyncExrWriter::PushLines(DynArray<Float3>&& pixels)
+{
+    const uint32 width = mWriter.GetWidth();
+    RT_ASSERT(pixels.Size() % width == 0, "Only whole lines can be written");
+
+    const uint32 numLines = pixels.Size() / width;
+    if (numLines == 0)
+    {
+        return true;
+    }
+
+    if (mNumQueuedLines + numLines > mWriter.GetHeight())
+    {
+        RT_LOG_ERROR("AsyncExrWriter: Too many lines queued");
+        return false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (mFailed)
+        {
+            return false;
+        }
+
+        mNumPendingBytes += sizeof(Float3) * pixels.Size();
+        mQueue.push_back(std::move(pixels));
+    }
+    mQueueCV.notify_one();
+
+    mNumQueuedLines += numLines;
+    return true;
+}
+
+size_t AsyncExrWriter::GetNumPendingBytes() const
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    return mNumPendingBytes;
+}
+
+bool AsyncExrWriter::Close()
+{
+    if (!mThread.joinable())
+    {
+        return false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mFinish = true;
+    }
+    mQueueCV.notify_one();
+    mThread.join();
+
+    // Note: all the queued lines are written at this point
+    const bool success = mWriter.Close() && !mFailed;
+    mQueue.clear();
+    return success;
+}
+
+void AsyncExrWriter::WriterThreadCallback()
+{
+    const uint32 width = mWriter.GetWidth();
+
+    for (;;)
+    {
+        DynArray<Float3> pixels;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mQueueCV.wait(lock, [this] { return mFinish || !mQueue.empty(); });
+
+            if (mQueue.empty())
+            {
+                // finish requested and nothing left to write
+                return;
+            }
+
+            pixels = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+
+        bool success = true;
+        for (uint32 offset = 0; offset < pixels.Size() && success; offset += width)
+        {
+            success = mWriter.WriteLine(pixels.Data() + offset);
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mNumPendingBytes -= sizeof(Float3) * pixels.Size();
+        if (!success)
+        {
+            mFailed = true;
+            mQueue.clear();
+            mNumPendingBytes = 0;
+            return;
+        }
+    }
+}
+
+} // namespace rt
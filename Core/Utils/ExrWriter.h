@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../RayLib.h"
+#include "../Containers/DynArray.h"
+#include "../Math/Float3.h"
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace rt {
+
+/**
+ * Streaming writer of scanline OpenEXR images (RGB, 32-bit float, uncompressed).
+ * Lines are written one by one in top-to-bottom order, so the whole image never needs to be kept in memory.
+ */
+class RAYLIB_API ExrWriter
+{
+public:
+    ExrWriter();
+    ~ExrWriter();
+
+    ExrWriter(const ExrWriter&) = delete;
+    ExrWriter& operator = (const ExrWriter&) = delete;
+
+    // create the file and write the header and the line offsets table
+    bool Open(const char* path, uint32 width, uint32 height);
+
+    // write next line of the image (array of 'width' pixels)
+    bool WriteLine(const math::Float3* pixels);
+
+    // finish writing, fails if not all the lines were written
+    bool Close();
+
+    RT_FORCE_INLINE bool IsOpen() const { return mFile != nullptr; }
+    RT_FORCE_INLINE uint32 GetWidth() const { return mWidth; }
+    RT_FORCE_INLINE uint32 GetHeight() const { return mHeight; }
+    RT_FORCE_INLINE uint32 GetNumWrittenLines() const { return mNumWrittenLines; }
+
+private:
+    FILE* mFile;
+    std::string mPath;
+    uint32 mWidth;
+    uint32 mHeight;
+    uint32 mNumWrittenLines;
+    DynArray<float> mLineBuffer; // line in the file layout (channels stored one after another)
+};
+
+/**
+ * Writes lines of an EXR image on a background thread.
+ * The lines are queued in blocks, so the producer only pays for filling the blocks.
+ */
+class RAYLIB_API AsyncExrWriter
+{
+public:
+    AsyncExrWriter();
+    ~AsyncExrWriter();
+
+    AsyncExrWriter(const AsyncExrWriter&) = delete;
+    AsyncExrWriter& operator = (const AsyncExrWriter&) = delete;
+
+    bool Open(const char* path, uint32 width, uint32 height);
+
+    // queue block of consecutive lines (whole lines only)
+    bool PushLines(DynArray<math::Float3>&& pixels);
+
+    // wait until all the queued lines are written and close the file
+    bool Close();
+
+    RT_FORCE_INLINE bool IsOpen() const { return mWriter.IsOpen(); }
+    RT_FORCE_INLINE uint32 GetWidth() const { return mWriter.GetWidth(); }
+    RT_FORCE_INLINE uint32 GetHeight() const { return mWriter.GetHeight(); }
+
+    // number of lines passed to PushLines so far
+    RT_FORCE_INLINE uint32 GetNumQueuedLines() const { return mNumQueuedLines; }
+
+    // size of queued blocks which were not written yet
+    size_t GetNumPendingBytes() const;
+
+private:
+    void WriterThreadCallback();
+
+    ExrWriter mWriter;
+    uint32 mNumQueuedLines;
+
+    std::thread mThread;
+    mutable std::mutex mLock;
+    std::condition_variable mQueueCV;
+    std::deque<DynArray<math::Float3>> mQueue;
+    size_t mNumPendingBytes;
+    bool mFinish;
+    bool mFailed;
+};
+
+} // namespace rt
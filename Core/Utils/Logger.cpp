@@ -1,6 +1,7 @@
 #include "PCH.h"
 #include "Logger.h"
 
+#include <atomic>
 #include <iostream>
 
 #ifdef WIN32
@@ -15,6 +16,12 @@
 namespace rt {
 
 static std::mutex gLogMutex;
+static std::atomic<bool> gLogToStandardError(false);
+
+void SetLogToStandardError(bool enabled)
+{
+    gLogToStandardError.store(enabled, std::memory_order_relaxed);
+}
 
 void LogGeneric(LogType type, const char* str, ...)
 {
@@ -62,7 +69,8 @@ void LogGeneric(LogType type, const char* str, ...)
     {
         std::lock_guard<std::mutex> lock(gLogMutex);
 
-        std::cout << logTypeStr << buffer << std::endl;
+        std::ostream& stream = gLogToStandardError.load(std::memory_order_relaxed) ? std::cerr : std::cout;
+        stream << logTypeStr << buffer << std::endl;
 #ifdef WIN32
         OutputDebugStringA(logTypeStr);
         OutputDebugStringA(buffer);
@@ -15,6 +15,9 @@ enum class LogType
 
 void RAYLIB_API LogGeneric(LogType type, const char* str, ...);
 
+// redirect all the log messages to the standard error stream (e.g. when standard output is used for results)
+void RAYLIB_API SetLogToStandardError(bool enabled);
+
 } // namespace rt
 
 
@@ -0,0 +1,148 @@
+#include "PCH.h"
+#include "MappedFile.h"
+#include "Logger.h"
+
+#if defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__LINUX__) | defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // defined(WIN32)
+
+namespace rt {
+
+MappedFile::MappedFile()
+    : mData(nullptr)
+    , mSize(0)
+#if defined(WIN32)
+    , mFileHandle(INVALID_HANDLE_VALUE)
+    , mMappingHandle(NULL)
+#endif // defined(WIN32)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(WIN32)
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    mFileHandle = ::CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mFileHandle == INVALID_HANDLE_VALUE)
+    {
+        RT_LOG_ERROR("Failed to open file '%s' for mapping, error code: %u", filePath.c_str(), ::GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(mFileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        RT_LOG_ERROR("Failed to map file '%s': invalid file size", filePath.c_str());
+        Close();
+        return false;
+    }
+
+    mMappingHandle = ::CreateFileMappingA(mFileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mMappingHandle == NULL)
+    {
+        RT_LOG_ERROR("CreateFileMapping failed for file '%s', error code: %u", filePath.c_str(), ::GetLastError());
+        Close();
+        return false;
+    }
+
+    mData = ::MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!mData)
+    {
+        RT_LOG_ERROR("MapViewOfFile failed for file '%s', error code: %u", filePath.c_str(), ::GetLastError());
+        Close();
+        return false;
+    }
+
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData)
+    {
+        ::UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+
+    if (mMappingHandle != NULL)
+    {
+        ::CloseHandle(mMappingHandle);
+        mMappingHandle = NULL;
+    }
+
+    if (mFileHandle != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(mFileHandle);
+        mFileHandle = INVALID_HANDLE_VALUE;
+    }
+
+    mSize = 0;
+}
+
+#elif defined(__LINUX__) | defined(__linux__)
+
+bool MappedFile::Open(const std::string& filePath)
+{
+    Close();
+
+    const int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        RT_LOG_ERROR("Failed to open file '%s' for mapping, error code: %i", filePath.c_str(), errno);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        RT_LOG_ERROR("Failed to map file '%s': invalid file size", filePath.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(fileStat.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        RT_LOG_ERROR("mmap failed for file '%s', error code: %i", filePath.c_str(), errno);
+        return false;
+    }
+
+    mData = data;
+    mSize = size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData)
+    {
+        ::munmap(const_cast<void*>(mData), mSize);
+        mData = nullptr;
+    }
+
+    mSize = 0;
+}
+
+#endif // defined(WIN32)
+
+} // namespace rt
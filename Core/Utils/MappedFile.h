@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../RayLib.h"
+
+#include <string>
+
+namespace rt {
+
+/**
+ * Read-only memory mapped file.
+ */
+class RAYLIB_API MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    // map whole file into memory
+    bool Open(const std::string& filePath);
+
+    // unmap the file
+    void Close();
+
+    RT_FORCE_INLINE bool IsOpen() const { return mData != nullptr; }
+    RT_FORCE_INLINE const void* GetData() const { return mData; }
+    RT_FORCE_INLINE size_t GetSize() const { return mSize; }
+
+private:
+    const void* mData;
+    size_t mSize;
+
+#if defined(WIN32)
+    void* mFileHandle;
+    void* mMappingHandle;
+#endif // defined(WIN32)
+};
+
+using MappedFilePtr = std::shared_ptr<MappedFile>;
+
+} // namespace rt
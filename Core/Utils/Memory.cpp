@@ -5,10 +5,21 @@
 
 #include <stdlib.h>
 #include <malloc.h>
+#include <atomic>
+
+#if defined(WIN32)
 #include <Windows.h>
+#elif defined(__LINUX__) | defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // defined(WIN32)
 
 namespace rt {
 
+// large pages are used for big enough allocations (if supported by the system)
+// Note: can be toggled while other threads are allocating
+static std::atomic<bool> gLargePagesEnabled(true);
+
 #if defined(WIN32)
 
 static bool TogglePrivilege(TCHAR* pszPrivilege, BOOL bEnable)
@@ -72,15 +83,97 @@ static void EnableLargePagesSupport()
     }
 }
 
-#else
+#elif defined(__LINUX__) | defined(__linux__)
+
+namespace {
+
+static constexpr size_t HugePageSize = 2u * 1024u * 1024u;
+
+// stored right before the data returned by SystemAllocator::Allocate
+struct SystemAllocationHeader
+{
+    void* mappingStart;
+    size_t mappingSize;
+};
+
+// read first line of a system file (empty string on failure)
+std::string ReadSystemFileLine(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        return std::string();
+    }
+
+    char buffer[256] = { 0 };
+    if (!fgets(buffer, sizeof(buffer), file))
+    {
+        buffer[0] = '\0';
+    }
+    fclose(file);
+
+    std::string line(buffer);
+    if (!line.empty() && line.back() == '\n')
+    {
+        line.pop_back();
+    }
+    return line;
+}
+
+void* MapPages(size_t size, int flags)
+{
+    void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return ptr != MAP_FAILED ? ptr : nullptr;
+}
+
+// map region aligned to huge page size and ask the kernel to back it with transparent huge pages
+void* MapTransparentHugePages(size_t size, bool& outAdvised)
+{
+    // over-allocate, so the mapping can be trimmed to huge page boundaries
+    const size_t paddedSize = size + HugePageSize;
+    char* ptr = static_cast<char*>(MapPages(paddedSize, 0));
+    if (!ptr)
+    {
+        return nullptr;
+    }
+
+    char* alignedPtr = reinterpret_cast<char*>(math::RoundUp(reinterpret_cast<uintptr_t>(ptr), static_cast<uintptr_t>(HugePageSize)));
+    const size_t headSize = static_cast<size_t>(alignedPtr - ptr);
+    const size_t tailSize = paddedSize - headSize - size;
+
+    if (headSize > 0)
+    {
+        ::munmap(ptr, headSize);
+    }
+    if (tailSize > 0)
+    {
+        ::munmap(alignedPtr + size, tailSize);
+    }
+
+    // may fail if transparent huge pages are disabled, the memory is still usable then
+    outAdvised = ::madvise(alignedPtr, size, MADV_HUGEPAGE) == 0;
+    return alignedPtr;
+}
+
+} // namespace
 
 static void EnableLargePagesSupport()
 {
-    // TODO
+    const std::string transparentHugePagesMode = ReadSystemFileLine("/sys/kernel/mm/transparent_hugepage/enabled");
+    const std::string numHugePages = ReadSystemFileLine("/proc/sys/vm/nr_hugepages");
+
+    RT_LOG_INFO("Large page support: transparent huge pages mode: '%s', reserved huge pages: %s",
+                !transparentHugePagesMode.empty() ? transparentHugePagesMode.c_str() : "unknown",
+                !numHugePages.empty() ? numHugePages.c_str() : "unknown");
 }
 
 #endif // WIN32
 
+void SystemAllocator::SetLargePagesEnabled(bool enabled)
+{
+    gLargePagesEnabled.store(enabled, std::memory_order_relaxed);
+}
+
 void InitMemory(const MemoryInitOptions& options)
 {
     if (options.useLargePages)
@@ -129,7 +222,7 @@ void* SystemAllocator::Allocate(size_t size, size_t alignment)
 
     if (size < 64u * 1024u)
     {
-        RT_LOG_WARNING("SystemAllocator: Allocating less than 64KB is not optimal (requested %zu bytes)", size);
+        RT_LOG_DEBUG("SystemAllocator: Allocating less than 64KB is not optimal (requested %zu bytes)", size);
     }
 
     RT_UNUSED(alignment);
@@ -137,7 +230,7 @@ void* SystemAllocator::Allocate(size_t size, size_t alignment)
     // try large pages first
     const size_t largePageMinNumpages = 4;
     const size_t minLargePageSize = largePageMinNumpages * ::GetLargePageMinimum();
-    if (size >= minLargePageSize)
+    if (gLargePagesEnabled.load(std::memory_order_relaxed) && size >= minLargePageSize)
     {
         const size_t roundedSize = math::RoundUp(size, minLargePageSize);
         ptr = ::VirtualAlloc(NULL, roundedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
@@ -162,11 +255,66 @@ void* SystemAllocator::Allocate(size_t size, size_t alignment)
 
 #elif defined(__LINUX__) | defined(__linux__)
 
-    // TODO
-    DefaultAllocator::Allocate(size, alignment);
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    RT_ASSERT(alignment <= pageSize, "SystemAllocator: Alignment can't exceed page size");
+
+    if (size < 64u * 1024u)
+    {
+        RT_LOG_DEBUG("SystemAllocator: Allocating less than 64KB is not optimal (requested %zu bytes)", size);
+    }
+
+    // block layout: [header][data], data is aligned at least to cache line size
+    const size_t dataOffset = math::RoundUp(sizeof(SystemAllocationHeader), std::max<size_t>(alignment, RT_CACHE_LINE_SIZE));
+    const size_t totalSize = size + dataOffset;
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const char* pagesType = nullptr;
+
+    if (gLargePagesEnabled.load(std::memory_order_relaxed) && totalSize >= HugePageSize)
+    {
+        mappingSize = math::RoundUp(totalSize, HugePageSize);
+
+        // try explicit huge pages first (requires reserved pool, see /proc/sys/vm/nr_hugepages)
+        mapping = MapPages(mappingSize, MAP_HUGETLB);
+        if (mapping)
+        {
+            pagesType = "huge pages";
+        }
+        else
+        {
+            bool advised = false;
+            mapping = MapTransparentHugePages(mappingSize, advised);
+            if (mapping)
+            {
+                pagesType = advised ? "transparent huge pages" : "regular pages (transparent huge pages unavailable)";
+            }
+        }
+    }
+
+    if (!mapping)
+    {
+        mappingSize = math::RoundUp(totalSize, pageSize);
+        mapping = MapPages(mappingSize, 0);
+        pagesType = "regular pages";
+    }
+
+    if (!mapping)
+    {
+        RT_LOG_ERROR("SystemAllocator: Failed to allocate %.2f KB, error code: %i", size / 1024.0, errno);
+        return nullptr;
+    }
+
+    RT_LOG_DEBUG("SystemAllocator: Allocated %.2f KB using %s (mapped %.2f KB)", size / 1024.0, pagesType, mappingSize / 1024.0);
+
+    ptr = static_cast<char*>(mapping) + dataOffset;
+
+    SystemAllocationHeader* header = static_cast<SystemAllocationHeader*>(ptr) - 1;
+    header->mappingStart = mapping;
+    header->mappingSize = mappingSize;
+
+#endif // defined(WIN32)
 
-#endif // 
-    
     return ptr;
 }
 
@@ -175,9 +323,14 @@ void SystemAllocator::Free(void* ptr)
 #if defined(WIN32)
     ::VirtualFree(ptr, 0, MEM_RELEASE);
 #elif defined(__LINUX__) | defined(__linux__)
-    // TODO
-    DefaultAllocator::Free(ptr);
-#endif // 
+    if (!ptr)
+    {
+        return;
+    }
+
+    const SystemAllocationHeader* header = static_cast<const SystemAllocationHeader*>(ptr) - 1;
+    ::munmap(header->mappingStart, header->mappingSize);
+#endif // defined(WIN32)
 }
 
 } // namespace rt
\ No newline at end of file
@@ -21,11 +21,16 @@ public:
     RAYLIB_API static void Free(void* ptr);
 };
 
+// Allocates memory directly from the OS (page granularity), intended for big buffers.
+// Large (huge) pages are used for big allocations when available.
 class SystemAllocator
 {
 public:
     RAYLIB_API static void* Allocate(size_t size, size_t alignment = 1);
     RAYLIB_API static void Free(void* ptr);
+
+    // enable/disable large pages for subsequent allocations (enabled by default)
+    RAYLIB_API static void SetLargePagesEnabled(bool enabled);
 };
 
 // Override this class to align children objects.
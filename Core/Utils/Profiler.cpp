@@ -1,19 +1,185 @@
 #include "PCH.h"
 #include "Profiler.h"
-#include "Timer.h"
 #include "Logger.h"
 
 #include <string>
-#include <map>
 
 namespace rt {
 
+struct ProfilerEvent
+{
+    const char* name;
+    uint64 startTicks;
+    uint64 endTicks;
+};
+
+// events ring buffer of a single thread
+// Note: written only by the owning thread, the exporter detects overwritten events by comparing counters
+struct ProfilerThreadData
+{
+    static constexpr uint32 MaxEvents = 16384;
+
+    DynArray<ProfilerEvent> events; // allocated when the first event is recorded
+    std::atomic<uint64> numEvents;
+    std::string name;
+    uint32 id = 0;
+    bool retired = false;
+
+    ProfilerThreadData()
+        : numEvents(0)
+    {}
+};
+
+// marks thread's events buffer as reusable when the thread finishes
+struct ProfilerThreadDataHolder
+{
+    ProfilerThreadData* data = nullptr;
+
+    ~ProfilerThreadDataHolder()
+    {
+        if (data)
+        {
+            Profiler& profiler = Profiler::GetInstance();
+            std::lock_guard<std::mutex> lock(profiler.mLock);
+            data->retired = true;
+        }
+    }
+};
+
+static thread_local ProfilerThreadDataHolder gCurrentThreadData;
+
+// escape a string so it can be embedded in a JSON string literal
+static std::string EscapeJsonString(const std::string& str)
+{
+    std::string result;
+    result.reserve(str.size());
+    for (const char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned char>(c));
+            result += buffer;
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+std::atomic<bool> Profiler::sEnabled(true);
+
+Profiler::Profiler()
+    : mFirstEntry(nullptr)
+    , mNextThreadId(0)
+    , mTraceStartTicks(0)
+{
+    mTimer.Start();
+    mStartTicks = GetTicks();
+}
+
+Profiler::~Profiler()
+{
+    for (ProfilerThreadData* threadData : mThreads)
+    {
+        delete threadData;
+    }
+}
+
 Profiler& Profiler::GetInstance()
 {
     static Profiler profiler;
     return profiler;
 }
 
+void Profiler::SetEnabled(bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+double Profiler::GetTickPeriod()
+{
+    // make sure the measurement is long enough to be accurate
+    double elapsedTime = mTimer.Stop();
+    while (elapsedTime < 0.01)
+    {
+        elapsedTime = mTimer.Stop();
+    }
+
+    const uint64 elapsedTicks = GetTicks() - mStartTicks;
+    return elapsedTime / static_cast<double>(elapsedTicks);
+}
+
+ProfilerThreadData& Profiler::GetCurrentThreadData()
+{
+    if (!gCurrentThreadData.data)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+
+        // reuse buffer of a finished thread
+        ProfilerThreadData* threadData = nullptr;
+        for (ProfilerThreadData* data : mThreads)
+        {
+            if (data->retired)
+            {
+                threadData = data;
+                threadData->numEvents = 0;
+                threadData->name.clear();
+                threadData->retired = false;
+                break;
+            }
+        }
+
+        if (!threadData)
+        {
+            threadData = new ProfilerThreadData;
+            mThreads.PushBack(threadData);
+        }
+
+        threadData->id = mNextThreadId++;
+        gCurrentThreadData.data = threadData;
+    }
+
+    return *gCurrentThreadData.data;
+}
+
+void Profiler::SetCurrentThreadName(const char* name)
+{
+    ProfilerThreadData& threadData = GetCurrentThreadData();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    threadData.name = name;
+}
+
+void Profiler::RecordEvent(const ScopedEntry& entry, uint64 startTicks, uint64 endTicks)
+{
+    ProfilerThreadData& threadData = GetCurrentThreadData();
+
+    if (threadData.events.Empty())
+    {
+        if (!threadData.events.Resize(ProfilerThreadData::MaxEvents))
+        {
+            return;
+        }
+    }
+
+    const uint64 index = threadData.numEvents.load(std::memory_order_relaxed);
+
+    ProfilerEvent& event = threadData.events[static_cast<uint32>(index % ProfilerThreadData::MaxEvents)];
+    event.name = entry.name;
+    event.startTicks = startTicks;
+    event.endTicks = endTicks;
+
+    threadData.numEvents.store(index + 1, std::memory_order_release);
+}
+
 void Profiler::RegisterEntry(ScopedEntry& entry)
 {
     std::lock_guard<std::mutex> lock(mLock);
@@ -21,43 +187,181 @@ void Profiler::RegisterEntry(ScopedEntry& entry)
     mFirstEntry = &entry;
 }
 
+void Profiler::UnregisterEntry(ScopedEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (ScopedEntry** entryPtr = &mFirstEntry; *entryPtr != nullptr; entryPtr = &(*entryPtr)->nextEntry)
+    {
+        if (*entryPtr == &entry)
+        {
+            *entryPtr = entry.nextEntry;
+            break;
+        }
+    }
+
+    const ScopedEntryData data = entry.GetData();
+    if (data.count > 0)
+    {
+        mRetiredEntries[entry.name] += data;
+    }
+}
+
 void Profiler::Collect(DynArray<ProfilerResult>& outResult)
 {
     std::map<const char*, ScopedEntryData> entriesMap;
     {
         std::lock_guard<std::mutex> lock(mLock);
+
+        entriesMap = mRetiredEntries;
+
         for (ScopedEntry* entry = mFirstEntry; entry != nullptr; entry = entry->nextEntry)
         {
-            entriesMap[entry->name] += entry->data;
+            entriesMap[entry->name] += entry->GetData();
         }
     }
 
+    const double tickPeriod = GetTickPeriod();
+
     for (const auto& iter : entriesMap)
     {
+        const ScopedEntryData& data = iter.second;
+        if (data.count == 0)
+        {
+            continue;
+        }
+
         ProfilerResult result;
         result.scopeName = iter.first;
-        result.avgTime = iter.second.accumulatedTicks * gTimerPeriod / iter.second.count;
-        result.minTime = iter.second.minTick * gTimerPeriod;
-        result.count = iter.second.count;
+        result.avgTime = static_cast<double>(data.accumulatedTicks) * tickPeriod / static_cast<double>(data.count);
+        result.minTime = static_cast<double>(data.minTicks) * tickPeriod;
+        result.maxTime = static_cast<double>(data.maxTicks) * tickPeriod;
+        result.count = data.count;
         outResult.PushBack(result);
-        //RT_LOG_INFO("Profiler: %s count=%llu, avg=%.3f us, min=%.3fus, ", iter.first, data.count, avgTime, minTime);
     }
 }
 
 void Profiler::ResetAll()
 {
     std::lock_guard<std::mutex> lock(mLock);
+
     for (ScopedEntry* entry = mFirstEntry; entry != nullptr; entry = entry->nextEntry)
     {
-        entry->data = ScopedEntryData();
+        entry->RequestReset();
+    }
+
+    mRetiredEntries.clear();
+
+    mTraceStartTicks = GetTicks();
+}
+
+bool Profiler::ExportTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        RT_LOG_ERROR("Failed to open trace file '%s'", path);
+        return false;
+    }
+
+    const double tickPeriod = GetTickPeriod();
+    const uint64 traceStartTicks = mTraceStartTicks;
+
+    // copy of a thread's events (they may be overwritten while exporting)
+    DynArray<ProfilerEvent> events(ProfilerThreadData::MaxEvents);
+
+    uint32 numExportedEvents = 0;
+    fprintf(file, "{\"traceEvents\":[\n");
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+
+        bool firstEvent = true;
+        for (const ProfilerThreadData* threadData : mThreads)
+        {
+            const uint64 numEvents = threadData->numEvents.load(std::memory_order_acquire);
+            const uint64 firstIndex = numEvents > ProfilerThreadData::MaxEvents ? numEvents - ProfilerThreadData::MaxEvents : 0;
+            for (uint64 i = firstIndex; i < numEvents; ++i)
+            {
+                events[static_cast<uint32>(i - firstIndex)] = threadData->events[static_cast<uint32>(i % ProfilerThreadData::MaxEvents)];
+            }
+
+            // skip events that were overwritten by the owning thread in the meantime
+            const uint64 numEventsAfterCopy = threadData->numEvents.load(std::memory_order_acquire);
+            const uint64 firstValidIndex = numEventsAfterCopy >= ProfilerThreadData::MaxEvents ? numEventsAfterCopy + 1 - ProfilerThreadData::MaxEvents : 0;
+
+            if (!threadData->name.empty())
+            {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        firstEvent ? "" : ",\n", threadData->id, EscapeJsonString(threadData->name).c_str());
+                firstEvent = false;
+            }
+
+            for (uint64 i = math::Max(firstIndex, firstValidIndex); i < numEvents; ++i)
+            {
+                const ProfilerEvent& event = events[static_cast<uint32>(i - firstIndex)];
+                if (event.startTicks < traceStartTicks)
+                {
+                    continue;
+                }
+
+                // timestamps are in microseconds
+                const double timestamp = static_cast<double>(event.startTicks - mStartTicks) * tickPeriod * 1.0e+6;
+                const double duration = static_cast<double>(event.endTicks - event.startTicks) * tickPeriod * 1.0e+6;
+
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        firstEvent ? "" : ",\n", event.name, threadData->id, timestamp, duration);
+                firstEvent = false;
+                numExportedEvents++;
+            }
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    const bool success = ferror(file) == 0;
+    fclose(file);
+
+    if (!success)
+    {
+        RT_LOG_ERROR("Failed to write trace file '%s'", path);
+        return false;
     }
+
+    RT_LOG_INFO("Profiler trace with %u events written to '%s'", numExportedEvents, path);
+    return true;
 }
 
 ScopedEntry::ScopedEntry(const char* name)
     : name(name)
+    , mMinTicks(UINT64_MAX)
+    , mMaxTicks(0)
+    , mAccumulatedTicks(0)
+    , mCount(0)
+    , mResetRequested(false)
 {
     Profiler::GetInstance().RegisterEntry(*this);
 }
 
+ScopedEntry::~ScopedEntry()
+{
+    Profiler::GetInstance().UnregisterEntry(*this);
+}
+
+const ScopedEntryData ScopedEntry::GetData() const
+{
+    ScopedEntryData data;
+    if (!mResetRequested.load(std::memory_order_relaxed))
+    {
+        data.minTicks = mMinTicks.load(std::memory_order_relaxed);
+        data.maxTicks = mMaxTicks.load(std::memory_order_relaxed);
+        data.accumulatedTicks = mAccumulatedTicks.load(std::memory_order_relaxed);
+        data.count = mCount.load(std::memory_order_relaxed);
+    }
+    return data;
+}
+
+void ScopedEntry::RequestReset()
+{
+    mResetRequested.store(true, std::memory_order_relaxed);
+}
 
 } // namespace rt
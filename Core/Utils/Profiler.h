@@ -3,100 +3,203 @@
 #include "../RayLib.h"
 #include "../Containers/DynArray.h"
 #include "../Math/Math.h"
+#include "Timer.h"
 
+#include <atomic>
 #include <mutex>
+#include <map>
 
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-#include <Windows.h>
+#if defined(WIN32)
+#include <intrin.h>
+#elif defined(__LINUX__) | defined(__linux__)
+#include <x86intrin.h>
+#endif // defined(WIN32)
 
 namespace rt {
 
 class ScopedEntry;
+struct ProfilerThreadData;
 
 struct ProfilerResult
 {
     const char* scopeName = nullptr;
     double avgTime = 0.0;
     double minTime = 0.0;
+    double maxTime = 0.0;
     uint64 count = 0;
 };
 
+struct ScopedEntryData
+{
+    uint64 minTicks = UINT64_MAX;
+    uint64 maxTicks = 0;
+    uint64 accumulatedTicks = 0;
+    uint64 count = 0;
+
+    ScopedEntryData& operator += (const ScopedEntryData& other)
+    {
+        minTicks = math::Min(minTicks, other.minTicks);
+        maxTicks = math::Max(maxTicks, other.maxTicks);
+        accumulatedTicks += other.accumulatedTicks;
+        count += other.count;
+        return *this;
+    }
+};
+
+// Collects timings of scopes marked with RT_SCOPED_TIMER.
+// Every thread aggregates the timings in its own entries and records the scopes in its own events ring buffer,
+// so the timers don't need any locks. The entries are only written by the owning thread (see ScopedEntry).
 class RAYLIB_API Profiler
 {
 public:
     static Profiler& GetInstance();
+
+    // read CPU time stamp counter
+    static RT_FORCE_INLINE uint64 GetTicks()
+    {
+        return __rdtsc();
+    }
+
+    // when disabled, the scoped timers don't read the time stamp counter nor record any events
+    static RT_FORCE_INLINE bool IsEnabled()
+    {
+        return sEnabled.load(std::memory_order_relaxed);
+    }
+
+    static void SetEnabled(bool enabled);
+
+    // name of the calling thread in the exported trace
+    void SetCurrentThreadName(const char* name);
+
     void RegisterEntry(ScopedEntry& entry);
+    void UnregisterEntry(ScopedEntry& entry);
+
+    // store finished scope in calling thread's events buffer
+    void RecordEvent(const ScopedEntry& entry, uint64 startTicks, uint64 endTicks);
+
+    // aggregate timings from all the threads
     void Collect(DynArray<ProfilerResult>& outResult);
+
+    // reset timings and drop recorded events
     void ResetAll();
 
+    // write recently recorded events in Chrome trace event format (chrome://tracing)
+    bool ExportTrace(const char* path);
+
+    // get duration of a single tick (in seconds)
+    double GetTickPeriod();
+
 private:
-    Profiler() = default;
+    Profiler();
+    ~Profiler();
+
+    ProfilerThreadData& GetCurrentThreadData();
+
+    static std::atomic<bool> sEnabled;
 
     std::mutex mLock;
     ScopedEntry* mFirstEntry;
-};
 
-struct ScopedEntryData
-{
-    uint64 minTick = UINT64_MAX;
-    uint64 accumulatedTicks = 0;
-    uint64 count = 0;
+    // timings of entries owned by finished threads
+    std::map<const char*, ScopedEntryData> mRetiredEntries;
 
-    ScopedEntryData& operator += (const ScopedEntryData& other)
-    {
-        minTick = math::Min(minTick, other.accumulatedTicks);
-        accumulatedTicks += other.accumulatedTicks;
-        count += other.count;
-        return *this;
-    }
+    DynArray<ProfilerThreadData*> mThreads;
+    uint32 mNextThreadId;
+
+    // time stamp counter frequency is measured against the system timer since the profiler creation
+    Timer mTimer;
+    uint64 mStartTicks;
+
+    // events recorded before this point are not exported
+    std::atomic<uint64> mTraceStartTicks;
+
+    friend struct ProfilerThreadDataHolder;
 };
 
+// timings of a scope aggregated by a single thread
+// Note: the counters are written only by the owning thread, other threads can read them at any time (relaxed atomics)
+// and request a reset, which is applied by the owning thread when the next sample is added
 class RAYLIB_API ScopedEntry
 {
 public:
     RT_FORCE_NOINLINE ScopedEntry(const char* name);
+    ~ScopedEntry();
+
+    RT_FORCE_INLINE void AddSample(const uint64 ticks)
+    {
+        if (mResetRequested.load(std::memory_order_relaxed))
+        {
+            mResetRequested.store(false, std::memory_order_relaxed);
+            mMinTicks.store(UINT64_MAX, std::memory_order_relaxed);
+            mMaxTicks.store(0, std::memory_order_relaxed);
+            mAccumulatedTicks.store(0, std::memory_order_relaxed);
+            mCount.store(0, std::memory_order_relaxed);
+        }
+
+        mMinTicks.store(math::Min(mMinTicks.load(std::memory_order_relaxed), ticks), std::memory_order_relaxed);
+        mMaxTicks.store(math::Max(mMaxTicks.load(std::memory_order_relaxed), ticks), std::memory_order_relaxed);
+        mAccumulatedTicks.store(mAccumulatedTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+        mCount.store(mCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // snapshot of the counters (safe to call from any thread)
+    const ScopedEntryData GetData() const;
+
+    // clear the counters (safe to call from any thread)
+    void RequestReset();
 
     const char* name;
     ScopedEntry* nextEntry = nullptr;
-    ScopedEntryData data;
+
+private:
+    std::atomic<uint64> mMinTicks;
+    std::atomic<uint64> mMaxTicks;
+    std::atomic<uint64> mAccumulatedTicks;
+    std::atomic<uint64> mCount;
+    std::atomic<bool> mResetRequested;
 };
 
 
-class RAYLIB_API ScopedTimer
+// measures time spent in a scope
+// Note: trace events are recorded only if 'RecordEvents' is set - per-ray scopes would overflow the events buffers quickly
+template<bool RecordEvents>
+class ScopedTimer
 {
 public:
     RT_FORCE_INLINE ScopedTimer(ScopedEntry& entry)
         : mEntry(entry)
+        , mStartTicks(Profiler::IsEnabled() ? Profiler::GetTicks() : 0)
     {
-        QueryPerformanceCounter(&mStart);
     }
 
     RT_FORCE_INLINE ~ScopedTimer()
     {
-        LARGE_INTEGER stop;
-        QueryPerformanceCounter(&stop);
-        const uint64 ticks = stop.QuadPart - mStart.QuadPart;
-
-        if (ticks > 0)
+        if (mStartTicks)
         {
-            mEntry.data.minTick = math::Min(mEntry.data.minTick, ticks);
-        }
+            const uint64 endTicks = Profiler::GetTicks();
+            mEntry.AddSample(endTicks - mStartTicks);
 
-        mEntry.data.accumulatedTicks += ticks;
-        mEntry.data.count++;
+            if (RecordEvents)
+            {
+                Profiler::GetInstance().RecordEvent(mEntry, mStartTicks, endTicks);
+            }
+        }
     }
 
-    void ReportAndReset();
-
 private:
-    LARGE_INTEGER mStart;
     ScopedEntry& mEntry;
+    const uint64 mStartTicks;
 };
 
 } // namespace rt
 
 
+// aggregate scope timings only
 #define RT_SCOPED_TIMER(name) \
-    thread_local ScopedEntry entry##name(#name); \
-    ScopedTimer scopedTimer(entry##name);
+    thread_local ::rt::ScopedEntry entry##name(#name); \
+    ::rt::ScopedTimer<false> scopedTimer##name(entry##name);
+
+// aggregate scope timings and record the scope in the exported trace
+#define RT_SCOPED_TRACE(name) \
+    thread_local ::rt::ScopedEntry entry##name(#name); \
+    ::rt::ScopedTimer<true> scopedTimer##name(entry##name);
@@ -1,13 +1,108 @@
 #include "PCH.h"
 #include "ThreadPool.h"
+#include "Profiler.h"
 
 
 namespace rt {
 
+// number of failed attempts to find some work before a worker thread goes to sleep
+static const uint32 MaxIdleSpins = 64;
+
+// worker context of the current thread (null for non-worker threads)
+static thread_local void* gCurrentWorker = nullptr;
+
+//////////////////////////////////////////////////////////////////////////
+
+ThreadPool::TaskDeque::TaskDeque()
+    : mTop(0)
+    , mBottom(0)
+{
+}
+
+bool ThreadPool::TaskDeque::Push(const TaskRange& range)
+{
+    const int64 b = mBottom.load(std::memory_order_relaxed);
+    const int64 t = mTop.load(std::memory_order_acquire);
+
+    if (b - t >= (int64)Capacity)
+    {
+        return false;
+    }
+
+    Slot& slot = mSlots[b % Capacity];
+    slot.group.store(range.group, std::memory_order_relaxed);
+    slot.begin.store(range.begin, std::memory_order_relaxed);
+    slot.end.store(range.end, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    mBottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::TaskDeque::Pop(TaskRange& outRange)
+{
+    const int64 b = mBottom.load(std::memory_order_relaxed) - 1;
+    mBottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64 t = mTop.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // queue is empty
+        mBottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const Slot& slot = mSlots[b % Capacity];
+    outRange.group = slot.group.load(std::memory_order_relaxed);
+    outRange.begin = slot.begin.load(std::memory_order_relaxed);
+    outRange.end = slot.end.load(std::memory_order_relaxed);
+
+    if (t == b)
+    {
+        // last element - race against thieves
+        const bool success = mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        mBottom.store(b + 1, std::memory_order_relaxed);
+        return success;
+    }
+
+    return true;
+}
+
+bool ThreadPool::TaskDeque::Steal(TaskRange& outRange)
+{
+    int64 t = mTop.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64 b = mBottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+    {
+        // queue is empty
+        return false;
+    }
+
+    const Slot& slot = mSlots[t % Capacity];
+    TaskRange range;
+    range.group = slot.group.load(std::memory_order_relaxed);
+    range.begin = slot.begin.load(std::memory_order_relaxed);
+    range.end = slot.end.load(std::memory_order_relaxed);
+
+    if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        // lost the race with the owner or other thief
+        return false;
+    }
+
+    outRange = range;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 ThreadPool::ThreadPool()
-    : mNumTasks(0)
-    , mCurrentTask(0)
-    , mTasksLeft(0)
+    : mNumExternalRanges(0)
+    , mNumSleepingThreads(0)
+    , mWakeUpEpoch(0)
     , mFinishThreads(true)
 {
     StartWorkerThreads(std::thread::hardware_concurrency());
@@ -20,31 +115,45 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::StartWorkerThreads(uint32 num)
 {
-    const uint32 maxThreads = 256;
+    if (num == 0)
+    {
+        num = std::thread::hardware_concurrency();
+    }
 
-    if (num > maxThreads)
+    if (num > MaxThreads)
     {
-        num = maxThreads;
+        num = MaxThreads;
     }
 
     RT_ASSERT(mFinishThreads == true);
     mFinishThreads = false;
 
+    // all the worker contexts must exist before any thread starts stealing
+    for (uint32 i = 0; i < num; ++i)
+    {
+        WorkerContextPtr worker(new WorkerContext);
+        worker->pool = this;
+        worker->id = i;
+        worker->randomState = 0x9E3779B9u * (i + 1u);
+        mWorkers.PushBack(std::move(worker));
+    }
+
     for (uint32 i = 0; i < num; ++i)
     {
-        mThreads.EmplaceBack(&ThreadPool::ThreadCallback, this, i);
+        mThreads.EmplaceBack(&ThreadPool::ThreadCallback, this, mWorkers[i].get());
     }
 }
 
 void ThreadPool::StopWorkerThreads()
 {
     RT_ASSERT(mFinishThreads == false);
-    mFinishThreads = true;
 
     {
         Lock lock(mMutex);
-        mNewTaskCV.notify_all();
+        mFinishThreads = true;
+        mWakeUpEpoch++;
     }
+    mNewTaskCV.notify_all();
 
     for (auto& thread : mThreads)
     {
@@ -52,67 +161,255 @@ void ThreadPool::StopWorkerThreads()
     }
 
     mThreads.Clear();
+    mWorkers.Clear();
 }
 
-void ThreadPool::ThreadCallback(uint32 threadID)
+void ThreadPool::SetNumThreads(const uint32 numThreads)
 {
-    for (;;)
+    if (numThreads != GetNumThreads())
     {
-        uint32 taskID;
+        StopWorkerThreads();
+        StartWorkerThreads(numThreads);
+    }
+}
 
-        {
-            Lock lock(mMutex);
-            while (!mFinishThreads && (mNumTasks == 0))
-            {
-                mNewTaskCV.wait(lock);
-            }
+void ThreadPool::SubmitExternal(const TaskRange& range)
+{
+    {
+        Lock lock(mMutex);
+        mExternalRanges.PushBack(range);
+        mNumExternalRanges++;
+        mWakeUpEpoch++;
+    }
+    mNewTaskCV.notify_all();
+}
 
-            if (mFinishThreads)
-            {
-                break;
-            }
+bool ThreadPool::PopExternal(TaskRange& outRange)
+{
+    Lock lock(mMutex);
+
+    if (mExternalRanges.Empty())
+    {
+        return false;
+    }
+
+    outRange = mExternalRanges.Back();
+    mExternalRanges.PopBack();
+    mNumExternalRanges--;
+    return true;
+}
 
-            taskID = mCurrentTask++;
+void ThreadPool::NotifyWorkers(bool all)
+{
+    {
+        Lock lock(mMutex);
+        mWakeUpEpoch++;
+    }
 
-            // last task
-            if (mCurrentTask >= mNumTasks)
+    if (all)
+    {
+        mNewTaskCV.notify_all();
+    }
+    else
+    {
+        mNewTaskCV.notify_one();
+    }
+}
+
+bool ThreadPool::FindWork(WorkerContext& worker, TaskRange& outRange)
+{
+    if (worker.queue.Pop(outRange))
+    {
+        return true;
+    }
+
+    if (mNumExternalRanges.load(std::memory_order_relaxed) > 0)
+    {
+        if (PopExternal(outRange))
+        {
+            return true;
+        }
+    }
+
+    const uint32 numWorkers = mWorkers.Size();
+    if (numWorkers > 1)
+    {
+        // xorshift32
+        uint32 x = worker.randomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        worker.randomState = x;
+
+        const uint32 firstVictim = x % numWorkers;
+        for (uint32 i = 0; i < numWorkers; ++i)
+        {
+            const uint32 victim = (firstVictim + i) % numWorkers;
+            if (victim != worker.id && mWorkers[victim]->queue.Steal(outRange))
             {
-                mNumTasks = 0;
+                return true;
             }
         }
+    }
+
+    return false;
+}
 
-        mTask(taskID, threadID);
+void ThreadPool::ExecuteRange(WorkerContext& worker, TaskRange range)
+{
+    TaskGroup* group = range.group;
 
-        if (--mTasksLeft == 0)
+    // split the range in halves, so other threads can steal the upper parts
+    bool rangesPushed = false;
+    while (range.end - range.begin > 1)
+    {
+        const uint32 mid = range.begin + (range.end - range.begin) / 2;
+        if (!worker.queue.Push({ group, mid, range.end }))
         {
-            mTileFinishedCV.notify_all();
+            break;
         }
+
+        range.end = mid;
+        rangesPushed = true;
+    }
+
+    // Note: pairs with the fence in ThreadCallback() - either this thread sees the sleeping worker,
+    // or the worker sees the pushed ranges when checking for work the last time before sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (rangesPushed && mNumSleepingThreads.load(std::memory_order_seq_cst) > 0)
+    {
+        NotifyWorkers(false);
+    }
+
+    for (uint32 i = range.begin; i < range.end; ++i)
+    {
+        (*group->task)(i, worker.id);
+    }
+
+    // Note: the group must not be accessed after the counter reaches zero
+    const uint32 count = range.end - range.begin;
+    if (group->numTasksLeft.fetch_sub(count, std::memory_order_acq_rel) == count)
+    {
+        Lock lock(mMutex);
+        mTaskFinishedCV.notify_all();
     }
 }
 
-void ThreadPool::SetNumThreads(const uint32 numThreads)
+void ThreadPool::ThreadCallback(WorkerContext* worker)
 {
-    if (numThreads != GetNumThreads())
+    gCurrentWorker = worker;
+
+    char threadName[32];
+    snprintf(threadName, sizeof(threadName), "Worker %u", worker->id);
+    Profiler::GetInstance().SetCurrentThreadName(threadName);
+
+    uint32 numIdleSpins = 0;
+
+    for (;;)
     {
-        StopWorkerThreads();
-        StartWorkerThreads(numThreads);
+        TaskRange range;
+        if (FindWork(*worker, range))
+        {
+            ExecuteRange(*worker, range);
+            numIdleSpins = 0;
+            continue;
+        }
+
+        if (++numIdleSpins < MaxIdleSpins)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // nothing to do - go to sleep
+        uint64 epoch;
+        {
+            Lock lock(mMutex);
+            epoch = mWakeUpEpoch;
+        }
+
+        // announce sleeping before the last check, so a producer can't miss this worker
+        mNumSleepingThreads.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (FindWork(*worker, range))
+        {
+            mNumSleepingThreads.fetch_sub(1, std::memory_order_seq_cst);
+            ExecuteRange(*worker, range);
+            numIdleSpins = 0;
+            continue;
+        }
+
+        {
+            Lock lock(mMutex);
+            mNewTaskCV.wait(lock, [this, epoch]
+            {
+                return mFinishThreads || mWakeUpEpoch != epoch || mNumExternalRanges > 0;
+            });
+            mNumSleepingThreads.fetch_sub(1, std::memory_order_seq_cst);
+
+            if (mFinishThreads)
+            {
+                break;
+            }
+        }
+
+        numIdleSpins = 0;
     }
+
+    gCurrentWorker = nullptr;
 }
 
 void ThreadPool::RunParallelTask(const ParallelTask& task, uint32 num)
 {
-    if (num > 0u)
+    if (num == 0u)
     {
-        Lock lock(mMutex);
+        return;
+    }
 
-        mTask = task;
-        mCurrentTask = 0;
-        mNumTasks = num;
-        mTasksLeft = num;
+    TaskGroup group;
+    group.task = &task;
+    group.numTasksLeft = num;
 
-        mNewTaskCV.notify_all();
+    WorkerContext* currentWorker = static_cast<WorkerContext*>(gCurrentWorker);
+    if (currentWorker && currentWorker->pool == this)
+    {
+        // nested call - participate in the work instead of blocking the worker thread
+        ExecuteRange(*currentWorker, { &group, 0, num });
 
-        mTileFinishedCV.wait(lock);
+        uint32 numIdleSpins = 0;
+        while (group.numTasksLeft.load(std::memory_order_acquire) > 0)
+        {
+            TaskRange range;
+            if (FindWork(*currentWorker, range))
+            {
+                ExecuteRange(*currentWorker, range);
+                numIdleSpins = 0;
+            }
+            else if (++numIdleSpins < MaxIdleSpins)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                // remaining tasks are being processed by other threads - wait for them
+                Lock lock(mMutex);
+                mTaskFinishedCV.wait(lock, [&group]
+                {
+                    return group.numTasksLeft.load(std::memory_order_acquire) == 0;
+                });
+            }
+        }
+    }
+    else
+    {
+        SubmitExternal({ &group, 0, num });
+
+        Lock lock(mMutex);
+        mTaskFinishedCV.wait(lock, [&group]
+        {
+            return group.numTasksLeft.load(std::memory_order_acquire) == 0;
+        });
     }
 }
 
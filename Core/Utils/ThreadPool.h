@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../Common.h"
+#include "../RayLib.h"
 #include "../Containers/DynArray.h"
 
 #include <functional>
@@ -13,7 +13,13 @@ namespace rt {
 
 using ParallelTask = std::function<void(uint32 taskID, uint32 threadID)>;
 
-class ThreadPool
+// Work-stealing thread pool.
+// Each worker thread owns a lock-free deque of task ranges. A range is split recursively
+// into halves (the upper half is pushed to the owner's deque), so idle workers can steal
+// big chunks of work without any locking on the hot path.
+// RunParallelTask() can be called from inside of a running task (nested parallelism),
+// in such case the calling worker participates in the work instead of blocking.
+class RAYLIB_API ThreadPool
 {
 public:
     struct TaskCoords
@@ -22,39 +28,115 @@ public:
         uint32 y;
     };
 
+    static constexpr uint32 MaxThreads = 256;
+
     ThreadPool();
     ~ThreadPool();
 
     void SetNumThreads(const uint32 numThreads);
 
+    // Run 'num' tasks in parallel and wait for completion.
+    // Note: the task callback receives worker thread ID, which is always lower than GetNumThreads()
     void RunParallelTask(const ParallelTask& task, uint32 num);
 
     RT_FORCE_INLINE uint32 GetNumThreads() const
     {
-        return mThreads.Size();
+        return mWorkers.Size();
     }
 
 private:
 
+    // state shared by all the tasks spawned by a single RunParallelTask() call
+    struct TaskGroup
+    {
+        const ParallelTask* task;
+        std::atomic<uint32> numTasksLeft;
+    };
+
+    // range of task IDs to process: [begin, end)
+    struct TaskRange
+    {
+        TaskGroup* group = nullptr;
+        uint32 begin = 0;
+        uint32 end = 0;
+    };
+
+    // fixed-size Chase-Lev deque
+    // the owner pushes and pops at the bottom, other threads steal from the top
+    class TaskDeque
+    {
+    public:
+        static constexpr uint32 Capacity = 1024;
+
+        TaskDeque();
+
+        // owner thread only, returns false if the queue is full
+        bool Push(const TaskRange& range);
+
+        // owner thread only
+        bool Pop(TaskRange& outRange);
+
+        // any thread
+        bool Steal(TaskRange& outRange);
+
+    private:
+        // every field is accessed atomically, because a thief may read a slot that is being overwritten
+        // (in such case the following CAS on 'mTop' fails and the value is discarded)
+        struct Slot
+        {
+            std::atomic<TaskGroup*> group;
+            std::atomic<uint32> begin;
+            std::atomic<uint32> end;
+        };
+
+        RT_ALIGN(RT_CACHE_LINE_SIZE) std::atomic<int64> mTop;
+        RT_ALIGN(RT_CACHE_LINE_SIZE) std::atomic<int64> mBottom;
+        RT_ALIGN(RT_CACHE_LINE_SIZE) Slot mSlots[Capacity];
+    };
+
+    struct RT_ALIGN(RT_CACHE_LINE_SIZE) WorkerContext : public Aligned<RT_CACHE_LINE_SIZE>
+    {
+        TaskDeque queue;
+        ThreadPool* pool = nullptr;
+        uint32 id = 0;
+        uint32 randomState = 0;
+    };
+
+    using WorkerContextPtr = std::unique_ptr<WorkerContext>;
+    using Lock = std::unique_lock<std::mutex>;
+
     void StartWorkerThreads(uint32 num);
     void StopWorkerThreads();
 
-    using Lock = std::unique_lock<std::mutex>;
+    void ThreadCallback(WorkerContext* worker);
+
+    // try to get some work: own queue first, then global queue, then steal from other workers
+    bool FindWork(WorkerContext& worker, TaskRange& outRange);
+
+    // process task range (splitting it for other threads)
+    void ExecuteRange(WorkerContext& worker, TaskRange range);
+
+    // push a range to the global queue (used by non-worker threads)
+    void SubmitExternal(const TaskRange& range);
+    bool PopExternal(TaskRange& outRange);
+
+    // wake up sleeping workers
+    void NotifyWorkers(bool all);
 
     DynArray<std::thread> mThreads;
-    std::condition_variable mNewTaskCV;
-    std::condition_variable mTileFinishedCV;
-    std::mutex mMutex;
+    DynArray<WorkerContextPtr> mWorkers;
 
-    ParallelTask mTask;
-    uint32 mNumTasks;
-    uint32 mCurrentTask;
+    // used only for sleeping/waking up threads and for submitting work from non-worker threads
+    std::mutex mMutex;
+    std::condition_variable mNewTaskCV;
+    std::condition_variable mTaskFinishedCV;
 
-    std::atomic<uint32> mTasksLeft;
+    DynArray<TaskRange> mExternalRanges;
+    std::atomic<uint32> mNumExternalRanges;
+    std::atomic<uint32> mNumSleepingThreads;
+    uint64 mWakeUpEpoch;
 
     bool mFinishThreads;
-
-    void ThreadCallback(uint32 id);
 };
 
 } // namespace rt
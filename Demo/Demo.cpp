@@ -159,7 +159,7 @@ void DemoWindow::SwitchScene(const std::string& sceneName)
 
     if (!sceneName.empty())
     {
-        if (helpers::LoadScene(sceneName, *mScene, mCamera))
+        if (helpers::LoadScene(sceneName, gOptions.dataPath, *mScene, mCamera, gOptions.meshCachePath))
         {
             mSceneFileName = sceneName;
 
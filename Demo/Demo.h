@@ -14,6 +14,7 @@ struct Options
     uint32 windowWidth = 1280;
     uint32 windowHeight = 720;
     std::string dataPath;
+    std::string meshCachePath; // disabled if empty
 
     uint32 numThreads = 0;
 
@@ -71,21 +71,30 @@ void DemoWindow::RenderUI_Stats()
     ImGui::Text("Delta time"); ImGui::NextColumn();
     ImGui::Text("%.2f ms", 1000.0 * mDeltaTime); ImGui::NextColumn();
 
-#ifdef RT_ENABLE_INTERSECTION_COUNTERS
     const RayTracingCounters& counters = mViewport->GetCounters();
+    const RayTracingStats& stats = mViewport->GetStats();
     ImGui::Separator();
     {
         ImGui::Text("Rays"); ImGui::NextColumn();
-        ImGui::Text("%.3fM", (float)counters.numRays / 1.0e+6f); ImGui::NextColumn();
+        ImGui::Text("%.3fM (%.2fM/s)", (float)counters.numRays / 1.0e+6f, stats.raysPerSecond / 1.0e+6); ImGui::NextColumn();
 
         ImGui::Text("Primary rays"); ImGui::NextColumn();
-        ImGui::Text("%.3fM", (float)counters.numPrimaryRays / 1.0e+6f); ImGui::NextColumn();
+        ImGui::Text("%.3fM (%.2fM/s)", (float)counters.numPrimaryRays / 1.0e+6f, stats.primaryRaysPerSecond / 1.0e+6); ImGui::NextColumn();
 
         ImGui::Text("Shadow rays"); ImGui::NextColumn();
-        ImGui::Text("%.3fM", (float)counters.numShadowRays / 1.0e+6f); ImGui::NextColumn();
+        ImGui::Text("%.3fM (%.2fM/s)", (float)counters.numShadowRays / 1.0e+6f, stats.shadowRaysPerSecond / 1.0e+6); ImGui::NextColumn();
 
         ImGui::Text("Shadow rays (hit)"); ImGui::NextColumn();
         ImGui::Text("%.3fM", (float)counters.numShadowRaysHit / 1.0e+6f); ImGui::NextColumn();
+    }
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    if (mRenderingParams.enableIntersectionCounters)
+    {
+        ImGui::Separator();
+
+        ImGui::Text("Traversed rays"); ImGui::NextColumn();
+        ImGui::Text("%.3fM (%.2fM/s)", (float)counters.numTraversedRays / 1.0e+6f, stats.traversedRaysPerSecond / 1.0e+6); ImGui::NextColumn();
 
         ImGui::Text("Ray-box tests (total)"); ImGui::NextColumn();
         ImGui::Text("%.3fM", (float)counters.numRayBoxTests / 1.0e+6f); ImGui::NextColumn();
@@ -98,6 +107,18 @@ void DemoWindow::RenderUI_Stats()
 
         ImGui::Text("Ray-tri tests (passed)"); ImGui::NextColumn();
         ImGui::Text("%.3fM", (float)counters.numPassedRayTriangleTests / 1.0e+6f); ImGui::NextColumn();
+
+        ImGui::Text("Nodes per ray"); ImGui::NextColumn();
+        ImGui::Text("%.2f", stats.nodesPerRay); ImGui::NextColumn();
+
+        ImGui::Text("Leaf tests per ray"); ImGui::NextColumn();
+        ImGui::Text("%.2f", stats.leafTestsPerRay); ImGui::NextColumn();
+
+        if (counters.numPacketLanes > 0)
+        {
+            ImGui::Text("Packet utilization"); ImGui::NextColumn();
+            ImGui::Text("%.2f%%", 100.0 * stats.packetUtilization); ImGui::NextColumn();
+        }
     }
 #endif // RT_ENABLE_INTERSECTION_COUNTERS
 
@@ -132,20 +153,34 @@ void DemoWindow::RenderUI_Profiler()
 {
     static const char* selectedScope = nullptr;
 
+    bool enabled = Profiler::IsEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+    {
+        Profiler::SetEnabled(enabled);
+    }
+
+    ImGui::SameLine();
     if (ImGui::Button("Reset"))
     {
         Profiler::GetInstance().ResetAll();
     }
 
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace"))
+    {
+        Profiler::GetInstance().ExportTrace("trace.json");
+    }
+
     DynArray<ProfilerResult> profilerResults;
     Profiler::GetInstance().Collect(profilerResults);
 
-    ImGui::Columns(4);
+    ImGui::Columns(5);
 
     ImGui::Text("Scope"); ImGui::NextColumn();
     ImGui::Text("Count"); ImGui::NextColumn();
     ImGui::Text("Avg. time"); ImGui::NextColumn();
     ImGui::Text("Min time"); ImGui::NextColumn();
+    ImGui::Text("Max time"); ImGui::NextColumn();
 
     ImGui::Separator();
 
@@ -161,6 +196,7 @@ void DemoWindow::RenderUI_Profiler()
         ImGui::Text("%llu", result.count); ImGui::NextColumn();
         ImGuiPrintTime(result.avgTime); ImGui::NextColumn();
         ImGuiPrintTime(result.minTime); ImGui::NextColumn();
+        ImGuiPrintTime(result.maxTime); ImGui::NextColumn();
     }
 
     ImGui::Columns(1);
@@ -392,9 +428,7 @@ bool DemoWindow::RenderUI_Settings()
 
         if (ImGui::Button("HDR screenshot"))
         {
-            // TODO this is incorrect
-            const float colorScale = 1.0f / (float)mViewport->GetProgress().passesFinished;
-            mViewport->GetSumBuffer().SaveEXR("screenshot.exr", colorScale);
+            mViewport->SaveHdrImage("screenshot.exr");
         }
     }
 
@@ -497,13 +531,16 @@ bool DemoWindow::RenderUI_Settings_Rendering()
     const char* traversalModeItems[] = { "Single", "Packet" };
     resetFrame |= ImGui::Combo("Traversal mode", &traversalModeIndex, traversalModeItems, IM_ARRAYSIZE(traversalModeItems));
 
-    const char* lightSamplingStrategyItems[] = { "Single", "All" };
+    const char* lightSamplingStrategyItems[] = { "Single", "All", "Light BVH" };
     resetFrame |= ImGui::Combo("Light sampling strategy", &lightSamplingStrategyIndex, lightSamplingStrategyItems, IM_ARRAYSIZE(lightSamplingStrategyItems));
 
     ImGui::SliderInt("Tile size", (int*)&tileSize, 2, 256);
 
     resetFrame |= ImGui::SliderInt("Max ray depth", (int*)&mRenderingParams.maxRayDepth, 0, 200);
     resetFrame |= ImGui::Checkbox("Visualize time per pixel", &mRenderingParams.visualizeTimePerPixel);
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    ImGui::Checkbox("Intersection counters", &mRenderingParams.enableIntersectionCounters);
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
     resetFrame |= ImGui::SliderInt("Russian roulette depth", (int*)&mRenderingParams.minRussianRouletteDepth, 1, 64);
     resetFrame |= ImGui::SliderFloat("Antialiasing spread", &mRenderingParams.antiAliasingSpread, 0.0f, 3.0f);
     resetFrame |= ImGui::SliderFloat("Motion blur strength", &mRenderingParams.motionBlurStrength, 0.0f, 1.0f);
@@ -13,6 +13,7 @@ bool ParseOptions(int argc, char** argv, Options& outOptions)
         ("renderer", "Renderer name", cxxopts::value<std::string>())
         ("p,packet-tracing", "Use ray packet tracing by default", cxxopts::value<bool>())
         ("data", "Data path", cxxopts::value<std::string>())
+        ("mesh-cache", "Directory for meshes BVH cache files (disabled by default)", cxxopts::value<std::string>())
         ;
 
     try
@@ -28,6 +29,9 @@ bool ParseOptions(int argc, char** argv, Options& outOptions)
         if (result.count("data"))
             outOptions.dataPath = result["data"].as<std::string>();
 
+        if (result.count("mesh-cache"))
+            outOptions.meshCachePath = result["mesh-cache"].as<std::string>();
+
         if (result.count("scene"))
             outOptions.sceneName = result["scene"].as<std::string>();
 
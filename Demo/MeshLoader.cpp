@@ -376,10 +376,12 @@ public:
         }
     }
 
-    MeshShapePtr BuildMesh()
+    MeshShapePtr BuildMesh(ThreadPool* threadPool, const std::string& cacheDirectory)
     {
         MeshDesc meshDesc;
         meshDesc.path = mFilePath;
+        meshDesc.threadPool = threadPool;
+        meshDesc.cacheDirectory = cacheDirectory;
         meshDesc.vertexBufferDesc.numTriangles = static_cast<uint32>(mVertexIndices.size() / 3);
         meshDesc.vertexBufferDesc.numVertices = static_cast<uint32>(mVertexPositions.size());
         meshDesc.vertexBufferDesc.numMaterials = static_cast<uint32>(mMaterialPointers.size());
@@ -414,7 +416,7 @@ private:
     std::unordered_map<tinyobj::index_t, uint32, TriangleIndicesHash, TriangleIndicesComparator> mUniqueIndices;
 };
 
-rt::MeshShapePtr LoadMesh(const std::string& filePath, MaterialsMap& outMaterials, const float scale)
+rt::MeshShapePtr LoadMesh(const std::string& filePath, MaterialsMap& outMaterials, const float scale, rt::ThreadPool* threadPool, const std::string& cacheDirectory)
 {
     MeshLoader loader;
     if (!loader.LoadMesh(filePath, outMaterials, scale))
@@ -422,7 +424,7 @@ rt::MeshShapePtr LoadMesh(const std::string& filePath, MaterialsMap& outMaterial
         return nullptr;
     }
 
-    return loader.BuildMesh();
+    return loader.BuildMesh(threadPool, cacheDirectory);
 }
 
 } // namespace helpers
\ No newline at end of file
@@ -14,7 +14,8 @@ using MaterialsMap = std::map<std::string, rt::MaterialPtr>;
 
 rt::BitmapPtr LoadBitmapObject(const std::string& baseDir, const std::string& path);
 rt::TexturePtr LoadTexture(const std::string& baseDir, const std::string& path);
-rt::MeshShapePtr LoadMesh(const std::string& filePath, MaterialsMap& outMaterials, const float scale = 1.0f);
+// Note: mesh cache files are written to (and read from) 'cacheDirectory', caching is disabled if it's empty
+rt::MeshShapePtr LoadMesh(const std::string& filePath, MaterialsMap& outMaterials, const float scale = 1.0f, rt::ThreadPool* threadPool = nullptr, const std::string& cacheDirectory = std::string());
 rt::MaterialPtr CreateDefaultMaterial(MaterialsMap& outMaterials);
 
 } // namespace helpers
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <float.h>
+#include <limits>
 #include <unordered_map>
 
 #include "../External/cxxopts.hpp"
@@ -1,8 +1,9 @@
 #include "PCH.h"
-#include "Demo.h"
+#include "SceneLoader.h"
 #include "MeshLoader.h"
 
 #include "../Core/Utils/Logger.h"
+#include "../Core/Utils/ThreadPool.h"
 #include "../Core/Scene/Light/PointLight.h"
 #include "../Core/Scene/Light/AreaLight.h"
 #include "../Core/Scene/Light/BackgroundLight.h"
@@ -215,7 +216,7 @@ static bool TryParseTransform(const rapidjson::Value& parentValue, const char* n
     return true;
 }
 
-static bool TryParseTextureName(const rapidjson::Value& value, const char* name, const TexturesMap& textures, TexturePtr& outValue)
+static bool TryParseTextureName(const rapidjson::Value& value, const char* name, const TexturesMap& textures, const std::string& dataPath, TexturePtr& outValue)
 {
     if (!value.HasMember(name))
     {
@@ -237,7 +238,7 @@ static bool TryParseTextureName(const rapidjson::Value& value, const char* name,
         return true;
     }
 
-    outValue = helpers::LoadTexture(gOptions.dataPath, textureName);
+    outValue = helpers::LoadTexture(dataPath, textureName);
     return true;
 }
 
@@ -266,7 +267,7 @@ static bool TryParseMaterialName(const MaterialsMap& materials, const rapidjson:
     return true;
 }
 
-static TexturePtr ParseTexture(const rapidjson::Value& value, const TexturesMap& textures, std::string& outName)
+static TexturePtr ParseTexture(const rapidjson::Value& value, const TexturesMap& textures, const std::string& dataPath, std::string& outName)
 {
     if (!value.IsObject())
     {
@@ -316,7 +317,7 @@ static TexturePtr ParseTexture(const rapidjson::Value& value, const TexturesMap&
             return nullptr;
         }
 
-        BitmapPtr bitmap = LoadBitmapObject(gOptions.dataPath, path);
+        BitmapPtr bitmap = LoadBitmapObject(dataPath, path);
         if (!bitmap || bitmap->GetWidth() == 0 || bitmap->GetHeight() == 0)
         {
             return nullptr;
@@ -350,9 +351,9 @@ static TexturePtr ParseTexture(const rapidjson::Value& value, const TexturesMap&
     {
         TexturePtr texA, texB, texWeight;
 
-        if (!TryParseTextureName(value, "textureA", textures, texA)) return nullptr;
-        if (!TryParseTextureName(value, "textureB", textures, texB)) return nullptr;
-        if (!TryParseTextureName(value, "weight", textures, texWeight)) return nullptr;
+        if (!TryParseTextureName(value, "textureA", textures, dataPath, texA)) return nullptr;
+        if (!TryParseTextureName(value, "textureB", textures, dataPath, texB)) return nullptr;
+        if (!TryParseTextureName(value, "weight", textures, dataPath, texWeight)) return nullptr;
 
         return std::shared_ptr<ITexture>(new MixTexture(texA, texB, texWeight));
     }
@@ -361,7 +362,7 @@ static TexturePtr ParseTexture(const rapidjson::Value& value, const TexturesMap&
     return nullptr;
 }
 
-static MaterialPtr ParseMaterial(const rapidjson::Value& value, const TexturesMap& textures)
+static MaterialPtr ParseMaterial(const rapidjson::Value& value, const TexturesMap& textures, const std::string& dataPath)
 {
     if (!value.IsObject())
     {
@@ -399,12 +400,12 @@ static MaterialPtr ParseMaterial(const rapidjson::Value& value, const TexturesMa
     if (!TryParseFloat(value, "roughness", true, material->roughness.baseValue)) return nullptr;
     if (!TryParseFloat(value, "metalness", true, material->metalness.baseValue)) return nullptr;
 
-    if (!TryParseTextureName(value, "baseColorTexture", textures, material->baseColor.texture)) return nullptr;
-    if (!TryParseTextureName(value, "emissionTexture", textures, material->emission.texture)) return nullptr;
-    if (!TryParseTextureName(value, "roughnessTexture", textures, material->roughness.texture)) return nullptr;
-    if (!TryParseTextureName(value, "metalnessTexture", textures, material->metalness.texture)) return nullptr;
-    if (!TryParseTextureName(value, "normalMap", textures, material->normalMap)) return nullptr;
-    if (!TryParseTextureName(value, "maskMap", textures, material->maskMap)) return nullptr;
+    if (!TryParseTextureName(value, "baseColorTexture", textures, dataPath, material->baseColor.texture)) return nullptr;
+    if (!TryParseTextureName(value, "emissionTexture", textures, dataPath, material->emission.texture)) return nullptr;
+    if (!TryParseTextureName(value, "roughnessTexture", textures, dataPath, material->roughness.texture)) return nullptr;
+    if (!TryParseTextureName(value, "metalnessTexture", textures, dataPath, material->metalness.texture)) return nullptr;
+    if (!TryParseTextureName(value, "normalMap", textures, dataPath, material->normalMap)) return nullptr;
+    if (!TryParseTextureName(value, "maskMap", textures, dataPath, material->maskMap)) return nullptr;
 
     if (!TryParseFloat(value, "normalMapStrength", true, material->normalMapStrength)) return nullptr;
     if (!TryParseFloat(value, "IoR", true, material->IoR)) return nullptr;
@@ -415,14 +416,14 @@ static MaterialPtr ParseMaterial(const rapidjson::Value& value, const TexturesMa
     return material;
 }
 
-static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, MaterialsMap& materials = MaterialsMap())
+static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, MaterialsMap& materials, ThreadPool& threadPool, const std::string& dataPath, const std::string& meshCacheDirectory)
 {
     ShapePtr shape;
 
     if (!value.HasMember("type"))
     {
         RT_LOG_ERROR("Object is missing 'type' field");
-        return false;
+        return nullptr;
     }
 
     // parse type
@@ -432,7 +433,7 @@ static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, Material
         float radius = 1.0f;
         if (!TryParseFloat(value, "radius", false, radius))
         {
-            return false;
+            return nullptr;
         }
 
         shape = std::make_unique<SphereShape>(radius);
@@ -442,7 +443,7 @@ static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, Material
         Vector4 size;
         if (!TryParseVector3(value, "size", false, size))
         {
-            return false;
+            return nullptr;
         }
 
         shape = std::make_unique<BoxShape>(size);
@@ -452,12 +453,12 @@ static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, Material
         Vector4 size(FLT_MAX);
         if (!TryParseVector2(value, "size", false, size))
         {
-            return false;
+            return nullptr;
         }
         Vector4 textureScale(1.0f);
         if (!TryParseVector2(value, "textureScale", true, textureScale))
         {
-            return false;
+            return nullptr;
         }
 
         shape = std::make_unique<RectShape>(size.ToFloat2(), textureScale.ToFloat2());
@@ -472,23 +473,23 @@ static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, Material
         if (!value.HasMember("path"))
         {
             RT_LOG_ERROR("Missing 'path' property");
-            return false;
+            return nullptr;
         }
 
         if (!value["path"].IsString())
         {
             RT_LOG_ERROR("Mesh path must be a string");
-            return false;
+            return nullptr;
         }
 
         float scale = 1.0f;
         if (!TryParseFloat(value, "scale", true, scale))
         {
-            return false;
+            return nullptr;
         }
 
-        const std::string path = gOptions.dataPath + value["path"].GetString();
-        shape = helpers::LoadMesh(path, materials, scale);
+        const std::string path = dataPath + value["path"].GetString();
+        shape = helpers::LoadMesh(path, materials, scale, &threadPool, meshCacheDirectory);
     }
     else
     {
@@ -498,7 +499,7 @@ static ShapePtr ParseShape(const rapidjson::Value& value, Scene& scene, Material
     return shape;
 }
 
-static bool ParseLight(const rapidjson::Value& value, Scene& scene, const TexturesMap& textures)
+static bool ParseLight(const rapidjson::Value& value, Scene& scene, const TexturesMap& textures, ThreadPool& threadPool, const std::string& dataPath, const std::string& meshCacheDirectory)
 {
     if (!value.IsObject())
     {
@@ -530,10 +531,11 @@ static bool ParseLight(const rapidjson::Value& value, Scene& scene, const Textur
             return false;
         }
 
-        ShapePtr shape = ParseShape(value["shape"], scene);
+        MaterialsMap materials;
+        ShapePtr shape = ParseShape(value["shape"], scene, materials, threadPool, dataPath, meshCacheDirectory);
         auto areaLight = std::make_unique<AreaLight>(std::move(shape), lightColor);
 
-        if (!TryParseTextureName(value, "texture", textures, areaLight->mTexture))
+        if (!TryParseTextureName(value, "texture", textures, dataPath, areaLight->mTexture))
             return false;
 
         if (areaLight->mTexture && !areaLight->mTexture->IsSamplable())
@@ -579,9 +581,20 @@ static bool ParseLight(const rapidjson::Value& value, Scene& scene, const Textur
     {
         auto backgroundLight = std::make_unique<BackgroundLight>(lightColor);
 
-        if (!TryParseTextureName(value, "texture", textures, backgroundLight->mTexture))
+        if (!TryParseTextureName(value, "texture", textures, dataPath, backgroundLight->mTexture))
             return false;
 
+        bool useAliasTables = false;
+        if (!TryParseBool(value, "aliasTables", true, useAliasTables))
+            return false;
+
+        // build environment map importance map in parallel
+        // Note: if the importance map can't be built (e.g. completely black texture), the light falls back to uniform sampling
+        if (backgroundLight->mTexture)
+        {
+            backgroundLight->MakeSamplable(useAliasTables, &threadPool);
+        }
+
         light = std::move(backgroundLight);
     }
     else if (typeStr == "sphere") // TODO merge with "area"
@@ -617,7 +630,7 @@ static bool ParseLight(const rapidjson::Value& value, Scene& scene, const Textur
     return true;
 }
 
-static bool ParseObject(const rapidjson::Value& value, Scene& scene, MaterialsMap& materials)
+static bool ParseObject(const rapidjson::Value& value, Scene& scene, MaterialsMap& materials, ThreadPool& threadPool, const std::string& dataPath, const std::string& meshCacheDirectory)
 {
     if (!value.IsObject())
     {
@@ -625,7 +638,7 @@ static bool ParseObject(const rapidjson::Value& value, Scene& scene, MaterialsMa
         return false;
     }
 
-    ShapePtr shape = ParseShape(value, scene, materials);
+    ShapePtr shape = ParseShape(value, scene, materials, threadPool, dataPath, meshCacheDirectory);
     if (!shape)
     {
         return false;
@@ -649,7 +662,7 @@ static bool ParseObject(const rapidjson::Value& value, Scene& scene, MaterialsMa
     return true;
 }
 
-static bool ParseCamera(const rapidjson::Value& value, const TexturesMap& textures, rt::Camera& camera)
+static bool ParseCamera(const rapidjson::Value& value, const TexturesMap& textures, const std::string& dataPath, rt::Camera& camera)
 {
     if (!value.IsObject())
     {
@@ -677,7 +690,7 @@ static bool ParseCamera(const rapidjson::Value& value, const TexturesMap& textur
     if (!TryParseFloat(value, "focalPlaneDistance", true, camera.mDOF.focalPlaneDistance))
         return false;
 
-    if (!TryParseTextureName(value, "bokehTexture", textures, camera.mDOF.bokehTexture))
+    if (!TryParseTextureName(value, "bokehTexture", textures, dataPath, camera.mDOF.bokehTexture))
         return false;
 
     if (camera.mDOF.bokehTexture)
@@ -689,7 +702,7 @@ static bool ParseCamera(const rapidjson::Value& value, const TexturesMap& textur
     return true;
 }
 
-bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
+bool LoadScene(const std::string& path, const std::string& dataPath, Scene& scene, rt::Camera& camera, const std::string& meshCacheDirectory)
 {
     FILE* fp = fopen(path.c_str(), "rb");
     if (!fp)
@@ -714,6 +727,9 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
     MaterialsMap materialsMap;
     TexturesMap texturesMap;
 
+    // shared by all the meshes BVH builds and textures importance maps
+    ThreadPool threadPool;
+
     if (d.HasMember("textures"))
     {
         const rapidjson::Value& texturesArray = d["textures"];
@@ -722,7 +738,7 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
             for (rapidjson::SizeType i = 0; i < texturesArray.Size(); i++)
             {
                 std::string name;
-                const TexturePtr texture = ParseTexture(texturesArray[i], texturesMap, name);
+                const TexturePtr texture = ParseTexture(texturesArray[i], texturesMap, dataPath, name);
                 if (!texture)
                     return false;
 
@@ -750,7 +766,7 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
         {
             for (rapidjson::SizeType i = 0; i < materialsArray.Size(); i++)
             {
-                const MaterialPtr material = ParseMaterial(materialsArray[i], texturesMap);
+                const MaterialPtr material = ParseMaterial(materialsArray[i], texturesMap, dataPath);
                 if (!material)
                     return false;
 
@@ -778,7 +794,7 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
         {
             for (rapidjson::SizeType i = 0; i < objectsArray.Size(); i++)
             {
-                if (!ParseObject(objectsArray[i], scene, materialsMap))
+                if (!ParseObject(objectsArray[i], scene, materialsMap, threadPool, dataPath, meshCacheDirectory))
                     return false;
             }
         }
@@ -796,7 +812,7 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
         {
             for (rapidjson::SizeType i = 0; i < lightsArray.Size(); i++)
             {
-                if (!ParseLight(lightsArray[i], scene, texturesMap))
+                if (!ParseLight(lightsArray[i], scene, texturesMap, threadPool, dataPath, meshCacheDirectory))
                     return false;
             }
         }
@@ -810,7 +826,7 @@ bool LoadScene(const std::string& path, Scene& scene, rt::Camera& camera)
     if (d.HasMember("camera"))
     {
         const rapidjson::Value& cameraObject = d["camera"];
-        if (!ParseCamera(cameraObject, texturesMap, camera))
+        if (!ParseCamera(cameraObject, texturesMap, dataPath, camera))
         {
             return false;
         }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Camera.h"
 
 namespace helpers {
 
-bool LoadScene(const std::string& path, rt::Scene& scene, rt::Camera& camera);
+// load scene description (JSON) file
+// Note: textures and meshes paths are relative to the data path
+// Note: meshes BVH cache files are kept in 'meshCacheDirectory', caching is disabled if it's empty
+bool LoadScene(const std::string& path, const std::string& dataPath, rt::Scene& scene, rt::Camera& camera, const std::string& meshCacheDirectory = std::string());
 
 } // namespace helpers
\ No newline at end of file
@@ -0,0 +1,488 @@
+#include "PCH.h"
+#include "../Demo/SceneLoader.h"
+
+#include "../Core/Utils/Logger.h"
+#include "../Core/Utils/Timer.h"
+#include "../Core/Utils/Bitmap.h"
+#include "../Core/Scene/Camera.h"
+#include "../Core/Rendering/Viewport.h"
+#include "../Core/Rendering/Renderer.h"
+
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace rt;
+
+namespace {
+
+struct Options
+{
+    std::string sceneName;
+    std::string dataPath = "../Data/";
+    std::string outputPath;
+    std::string statsPath;
+    std::string checkpointPath;
+    std::string resumePath;
+    std::string meshCachePath; // disabled if empty
+    std::string rendererName = "Path Tracer";
+    uint32 width = 1280;
+    uint32 height = 720;
+    uint32 numThreads = 0;
+    uint32 tileSize = 32;
+    uint32 samplesPerPass = 1;
+    bool enablePacketTracing = false;
+    bool enableAdaptiveRendering = false;
+    bool enableIntersectionCounters = false;
+
+    // periodic outputs (zero means disabled)
+    double checkpointInterval = 0.0;
+    double previewInterval = 0.0;
+
+    // stop conditions (zero means unlimited)
+    uint32 targetSamples = 0;
+    double timeLimit = 0.0;
+    float errorThreshold = 0.0f;
+};
+
+bool HasExtension(const std::string& path, const char* extension)
+{
+    const size_t extensionLength = strlen(extension);
+    if (path.size() < extensionLength)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < extensionLength; ++i)
+    {
+        if (tolower(path[path.size() - extensionLength + i]) != extension[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options& outOptions)
+{
+    cxxopts::Options options("RenderCli", "Headless batch renderer");
+    options.add_options()
+        ("s,scene", "Scene file", cxxopts::value<std::string>())
+        ("data", "Data path", cxxopts::value<std::string>())
+        ("o,output", "Output image (.exr or .bmp)", cxxopts::value<std::string>())
+        ("stats", "Output statistics JSON file (printed to the standard output by default)", cxxopts::value<std::string>())
+        ("checkpoint", "Save rendering checkpoint file when finished", cxxopts::value<std::string>())
+        ("checkpoint-interval", "Also save the checkpoint every given number of seconds", cxxopts::value<double>())
+        ("resume", "Continue rendering from a checkpoint file", cxxopts::value<std::string>())
+        ("mesh-cache", "Directory for meshes BVH cache files (disabled by default)", cxxopts::value<std::string>())
+        ("preview-interval", "Write the output EXR image in the background every given number of seconds", cxxopts::value<double>())
+        ("w,width", "Image width", cxxopts::value<uint32>())
+        ("h,height", "Image height", cxxopts::value<uint32>())
+        ("renderer", "Renderer name", cxxopts::value<std::string>())
+        ("t,threads", "Number of rendering threads (0 - use all cores)", cxxopts::value<uint32>())
+        ("tile-size", "Rendering tile size", cxxopts::value<uint32>())
+        ("p,packet-tracing", "Use ray packet tracing", cxxopts::value<bool>())
+        ("samples-per-pass", "Number of samples per pixel rendered in a single pass", cxxopts::value<uint32>())
+        ("adaptive", "Enable adaptive rendering", cxxopts::value<bool>())
+        ("counters", "Collect ray-box and ray-triangle intersection counters", cxxopts::value<bool>())
+        ("spp", "Stop after reaching given number of samples per pixel", cxxopts::value<uint32>())
+        ("time", "Stop after given number of seconds", cxxopts::value<double>())
+        ("error", "Stop when average image error drops below given value", cxxopts::value<float>())
+        ;
+
+    try
+    {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("scene"))
+        {
+            RT_LOG_ERROR("Missing scene file. Usage:\n%s", options.help().c_str());
+            return false;
+        }
+        outOptions.sceneName = result["scene"].as<std::string>();
+
+        if (result.count("data"))
+            outOptions.dataPath = result["data"].as<std::string>();
+
+        if (result.count("output"))
+            outOptions.outputPath = result["output"].as<std::string>();
+
+        if (result.count("stats"))
+            outOptions.statsPath = result["stats"].as<std::string>();
+
+        if (result.count("checkpoint"))
+            outOptions.checkpointPath = result["checkpoint"].as<std::string>();
+
+        if (result.count("checkpoint-interval"))
+            outOptions.checkpointInterval = result["checkpoint-interval"].as<double>();
+
+        if (result.count("resume"))
+            outOptions.resumePath = result["resume"].as<std::string>();
+
+        if (result.count("mesh-cache"))
+            outOptions.meshCachePath = result["mesh-cache"].as<std::string>();
+
+        if (result.count("preview-interval"))
+            outOptions.previewInterval = result["preview-interval"].as<double>();
+
+        if (result.count("w"))
+            outOptions.width = result["w"].as<uint32>();
+
+        if (result.count("h"))
+            outOptions.height = result["h"].as<uint32>();
+
+        if (result.count("renderer"))
+            outOptions.rendererName = result["renderer"].as<std::string>();
+
+        if (result.count("threads"))
+            outOptions.numThreads = result["threads"].as<uint32>();
+
+        if (result.count("tile-size"))
+            outOptions.tileSize = result["tile-size"].as<uint32>();
+
+        if (result.count("samples-per-pass"))
+            outOptions.samplesPerPass = result["samples-per-pass"].as<uint32>();
+
+        if (result.count("spp"))
+            outOptions.targetSamples = result["spp"].as<uint32>();
+
+        if (result.count("time"))
+            outOptions.timeLimit = result["time"].as<double>();
+
+        if (result.count("error"))
+            outOptions.errorThreshold = result["error"].as<float>();
+
+        outOptions.enablePacketTracing = result["p"].count() > 0;
+        outOptions.enableAdaptiveRendering = result["adaptive"].count() > 0;
+        outOptions.enableIntersectionCounters = result["counters"].count() > 0;
+    }
+    catch (cxxopts::OptionParseException& e)
+    {
+        RT_LOG_ERROR("Failed to parse commandline: %s", e.what());
+        return false;
+    }
+
+    if (outOptions.width == 0 || outOptions.height == 0)
+    {
+        RT_LOG_ERROR("Invalid image size: %ux%u", outOptions.width, outOptions.height);
+        return false;
+    }
+
+    if (outOptions.tileSize == 0 || outOptions.tileSize > UINT16_MAX)
+    {
+        RT_LOG_ERROR("Invalid tile size: %u", outOptions.tileSize);
+        return false;
+    }
+
+    if (outOptions.previewInterval > 0.0 && !HasExtension(outOptions.outputPath, ".exr"))
+    {
+        RT_LOG_ERROR("Preview output requires EXR output image");
+        return false;
+    }
+
+    // render something sensible when no stop condition was given
+    if (outOptions.targetSamples == 0 && outOptions.timeLimit <= 0.0 && outOptions.errorThreshold <= 0.0f)
+    {
+        outOptions.targetSamples = 16;
+    }
+
+    return true;
+}
+
+bool SaveImage(Viewport& viewport, const std::string& path)
+{
+    if (HasExtension(path, ".exr"))
+    {
+        return viewport.SaveHdrImage(path.c_str());
+    }
+
+    if (HasExtension(path, ".bmp"))
+    {
+        return viewport.GetFrontBuffer().SaveBMP(path.c_str(), true);
+    }
+
+    RT_LOG_ERROR("Unsupported output image format: '%s'", path.c_str());
+    return false;
+}
+
+void WriteStats(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const Options& options, const Viewport& viewport,
+                const RayTracingCounters& counters, uint32 numSamples, double renderingTime)
+{
+    writer.StartObject();
+
+    writer.Key("scene");
+    writer.String(options.sceneName.c_str());
+    writer.Key("renderer");
+    writer.String(options.rendererName.c_str());
+    writer.Key("width");
+    writer.Uint(viewport.GetWidth());
+    writer.Key("height");
+    writer.Uint(viewport.GetHeight());
+    writer.Key("traversalMode");
+    writer.String(options.enablePacketTracing ? "packet" : "single");
+
+    writer.Key("passes");
+    writer.Uint(viewport.GetProgress().passesFinished);
+    writer.Key("samplesPerPixel");
+    writer.Uint(numSamples);
+    writer.Key("time");
+    writer.Double(renderingTime);
+    writer.Key("averageError");
+    writer.Double(viewport.GetProgress().averageError);
+    writer.Key("converged");
+    writer.Double(viewport.GetProgress().converged);
+
+    const RayTracingStats stats = counters.ComputeStats(renderingTime);
+    writer.Key("raysPerSecond");
+    writer.Double(stats.raysPerSecond);
+    writer.Key("primaryRaysPerSecond");
+    writer.Double(stats.primaryRaysPerSecond);
+    writer.Key("shadowRaysPerSecond");
+    writer.Double(stats.shadowRaysPerSecond);
+
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+    if (options.enableIntersectionCounters)
+    {
+        writer.Key("traversedRaysPerSecond");
+        writer.Double(stats.traversedRaysPerSecond);
+        writer.Key("nodesPerRay");
+        writer.Double(stats.nodesPerRay);
+        writer.Key("rayBoxTestsPerRay");
+        writer.Double(stats.rayBoxTestsPerRay);
+        writer.Key("leafTestsPerRay");
+        writer.Double(stats.leafTestsPerRay);
+        if (options.enablePacketTracing)
+        {
+            writer.Key("packetUtilization");
+            writer.Double(stats.packetUtilization);
+        }
+    }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+
+    writer.Key("counters");
+    writer.StartObject();
+    {
+        writer.Key("numRays");
+        writer.Uint64(counters.numRays);
+        writer.Key("numPrimaryRays");
+        writer.Uint64(counters.numPrimaryRays);
+        writer.Key("numShadowRays");
+        writer.Uint64(counters.numShadowRays);
+        writer.Key("numShadowRaysHit");
+        writer.Uint64(counters.numShadowRaysHit);
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        if (options.enableIntersectionCounters)
+        {
+            writer.Key("numTraversedRays");
+            writer.Uint64(counters.numTraversedRays);
+            writer.Key("numRayBoxTests");
+            writer.Uint64(counters.numRayBoxTests);
+            writer.Key("numPassedRayBoxTests");
+            writer.Uint64(counters.numPassedRayBoxTests);
+            writer.Key("numRayTriangleTests");
+            writer.Uint64(counters.numRayTriangleTests);
+            writer.Key("numPassedRayTriangleTests");
+            writer.Uint64(counters.numPassedRayTriangleTests);
+            writer.Key("numVisitedNodes");
+            writer.Uint64(counters.numVisitedNodes);
+            writer.Key("numPacketLanes");
+            writer.Uint64(counters.numPacketLanes);
+            writer.Key("numActivePacketLanes");
+            writer.Uint64(counters.numActivePacketLanes);
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+    }
+    writer.EndObject();
+
+    writer.EndObject();
+}
+
+int Run(const Options& options)
+{
+    Scene scene;
+    Camera camera;
+    if (!helpers::LoadScene(options.sceneName, options.dataPath, scene, camera, options.meshCachePath))
+    {
+        RT_LOG_ERROR("Failed to load scene: '%s'", options.sceneName.c_str());
+        return 2;
+    }
+    scene.BuildBVH();
+
+    camera.SetPerspective(static_cast<float>(options.width) / static_cast<float>(options.height), camera.mFieldOfView);
+
+    const RendererPtr renderer = CreateRenderer(options.rendererName, scene);
+    if (!renderer)
+    {
+        RT_LOG_ERROR("Unknown renderer: '%s'", options.rendererName.c_str());
+        return 2;
+    }
+
+    RenderingParams params;
+    params.numThreads = options.numThreads;
+    params.tileSize = static_cast<uint16>(options.tileSize);
+    params.samplesPerPixel = math::Max(1u, options.samplesPerPass);
+    params.traversalMode = options.enablePacketTracing ? TraversalMode::Packet : TraversalMode::Single;
+    params.adaptiveSettings.enable = options.enableAdaptiveRendering;
+    params.enableIntersectionCounters = options.enableIntersectionCounters;
+    if (options.errorThreshold > 0.0f)
+    {
+        params.adaptiveSettings.convergenceTreshold = options.errorThreshold;
+    }
+
+    Viewport viewport;
+    if (!viewport.Resize(options.width, options.height) || !viewport.SetRenderingParams(params) || !viewport.SetRenderer(renderer))
+    {
+        return 3;
+    }
+    viewport.Reset();
+
+    if (!options.resumePath.empty() && !viewport.LoadCheckpoint(options.resumePath.c_str()))
+    {
+        RT_LOG_ERROR("Failed to load checkpoint: '%s'", options.resumePath.c_str());
+        return 3;
+    }
+
+    RT_LOG_INFO("Rendering '%s' (%ux%u) with '%s'...", options.sceneName.c_str(), options.width, options.height, options.rendererName.c_str());
+
+    // viewport counters are reset every pass
+    RayTracingCounters counters;
+    counters.Reset();
+
+    // Note: samples from the resumed checkpoint count towards the target
+    // (the checkpoint could be rendered with different number of samples per pass, or adaptively)
+    uint32 numSamples = 0;
+    for (const uint32 pixelSamples : viewport.GetSamplesPerPixel())
+    {
+        numSamples = math::Max(numSamples, pixelSamples);
+    }
+    double renderingTime = 0.0;
+    double lastCheckpointTime = 0.0;
+    double lastPreviewTime = 0.0;
+
+    Timer timer;
+    timer.Start();
+    for (;;)
+    {
+        if (!viewport.Render(camera))
+        {
+            return 3;
+        }
+
+        numSamples += params.samplesPerPixel;
+        counters.Append(viewport.GetCounters());
+        renderingTime = timer.Stop();
+
+        const RenderingProgress& progress = viewport.GetProgress();
+
+        if (options.checkpointInterval > 0.0 && !options.checkpointPath.empty() && renderingTime - lastCheckpointTime >= options.checkpointInterval)
+        {
+            viewport.SaveCheckpoint(options.checkpointPath.c_str());
+            lastCheckpointTime = renderingTime;
+        }
+
+        // the image is captured in blocks after the following passes, so skip if previous preview is still being written
+        if (options.previewInterval > 0.0 && !viewport.IsHdrImageExportInProgress() && renderingTime - lastPreviewTime >= options.previewInterval)
+        {
+            viewport.BeginHdrImageExport(options.outputPath.c_str());
+            lastPreviewTime = renderingTime;
+        }
+
+        if (options.targetSamples > 0 && numSamples >= options.targetSamples)
+        {
+            break;
+        }
+
+        if (options.timeLimit > 0.0 && renderingTime >= options.timeLimit)
+        {
+            break;
+        }
+
+        if (options.errorThreshold > 0.0f)
+        {
+            // adaptive rendering stops tracing converged blocks on its own
+            if (options.enableAdaptiveRendering && progress.passesFinished > params.adaptiveSettings.numInitialPasses && progress.activePixels == 0)
+            {
+                break;
+            }
+
+            // the error is estimated every second pass
+            if (!options.enableAdaptiveRendering && progress.passesFinished >= 2 && progress.averageError <= options.errorThreshold)
+            {
+                break;
+            }
+        }
+    }
+
+    RT_LOG_INFO("Rendering finished: %u samples per pixel in %.3f seconds", numSamples, renderingTime);
+
+    // the final image overwrites the preview
+    if (viewport.IsHdrImageExportInProgress())
+    {
+        viewport.FinishHdrImageExport();
+    }
+
+    if (!options.checkpointPath.empty())
+    {
+        if (!viewport.SaveCheckpoint(options.checkpointPath.c_str()))
+        {
+            RT_LOG_ERROR("Failed to save checkpoint: '%s'", options.checkpointPath.c_str());
+            return 4;
+        }
+    }
+
+    if (!options.outputPath.empty())
+    {
+        if (!SaveImage(viewport, options.outputPath))
+        {
+            RT_LOG_ERROR("Failed to save image: '%s'", options.outputPath.c_str());
+            return 4;
+        }
+    }
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    WriteStats(writer, options, viewport, counters, numSamples, renderingTime);
+
+    if (options.statsPath.empty())
+    {
+        std::cout << buffer.GetString() << std::endl;
+    }
+    else
+    {
+        std::ofstream file(options.statsPath);
+        file << buffer.GetString() << std::endl;
+        if (!file.good())
+        {
+            RT_LOG_ERROR("Failed to write statistics file: '%s'", options.statsPath.c_str());
+            return 4;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    // standard output is reserved for the statistics JSON
+    rt::SetLogToStandardError(true);
+
+    rt::math::SetFlushDenormalsToZero();
+    rt::InitMemory();
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    const int result = Run(options);
+
+    RT_ASSERT(rt::math::GetFlushDenormalsToZero(), "Something disabled flushing denormal float to zero");
+
+    return result;
+}
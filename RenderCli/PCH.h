@@ -0,0 +1,30 @@
+#pragma once
+
+#if defined(_DEBUG) && defined(WIN32)
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#endif // _DEBUG
+
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+#elif defined(__linux__) | defined(__LINUX__)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#else
+    #error "Target platform not supported."
+#endif // WIN32
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <inttypes.h>
+#include <stddef.h>
+#include <float.h>
+#include <limits>
+
+#include "../External/cxxopts.hpp"
+#include "../External/rapidjson/rapidjson.h"
@@ -0,0 +1,773 @@
+#include "PCH.h"
+#include "../Core/BVH/BVHBuilder.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Math/Transform.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../Core/Shapes/MeshShape.h"
+#include "../Core/Shapes/Mesh/MeshCache.h"
+#include "../Core/Shapes/Mesh/TriangleSoup.h"
+#include "../Core/Material/Material.h"
+#include "../Core/Textures/ConstTexture.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/Object/SceneObject_Shape.h"
+#include "../Core/Rendering/Context.h"
+#include "../Core/Rendering/RendererContext.h"
+#include "../Core/Traversal/TraversalContext.h"
+
+using namespace rt;
+using namespace rt::math;
+
+namespace {
+
+bool BoxContains(const BVH::Node& parent, const Box& child)
+{
+    const Box parentBox = parent.GetBox();
+    return parentBox.min.x <= child.min.x && parentBox.min.y <= child.min.y && parentBox.min.z <= child.min.z &&
+        parentBox.max.x >= child.max.x && parentBox.max.y >= child.max.y && parentBox.max.z >= child.max.z;
+}
+
+void ValidateBVH(const BVH& bvh, const DynArray<Box>& boxes, const BVHBuilder::Indices& leavesOrder, uint32 maxLeafNodeSize)
+{
+    ASSERT_EQ(boxes.Size(), leavesOrder.Size());
+
+    DynArray<uint32> leafReferences(boxes.Size(), 0u);
+
+    DynArray<uint32> stack;
+    stack.PushBack(0);
+    while (!stack.Empty())
+    {
+        const BVH::Node& node = bvh.GetNodes()[stack.Back()];
+        stack.PopBack();
+
+        if (node.IsLeaf())
+        {
+            ASSERT_LE(node.numLeaves, maxLeafNodeSize);
+            for (uint32 i = 0; i < node.numLeaves; ++i)
+            {
+                const uint32 leafIndex = leavesOrder[node.childIndex + i];
+                ASSERT_LT(leafIndex, boxes.Size());
+                EXPECT_TRUE(BoxContains(node, boxes[leafIndex]));
+                leafReferences[leafIndex]++;
+            }
+        }
+        else
+        {
+            ASSERT_LT(node.childIndex + 1, bvh.GetNumNodes());
+            EXPECT_TRUE(BoxContains(node, bvh.GetNodes()[node.childIndex].GetBox()));
+            EXPECT_TRUE(BoxContains(node, bvh.GetNodes()[node.childIndex + 1].GetBox()));
+            stack.PushBack(node.childIndex);
+            stack.PushBack(node.childIndex + 1);
+        }
+    }
+
+    for (uint32 i = 0; i < boxes.Size(); ++i)
+    {
+        EXPECT_EQ(1u, leafReferences[i]) << "Leaf index: " << i;
+    }
+}
+
+void TestBVHBuilder(const BvhBuildingParams& params)
+{
+    const uint32 numLeaves = 20000;
+
+    Random random;
+
+    DynArray<Box> boxes;
+    for (uint32 i = 0; i < numLeaves; ++i)
+    {
+        // few clusters of boxes, including degenerated ones
+        const Vector4 center = (i % 7 == 0) ? Vector4(1.0f, 2.0f, 3.0f) : random.GetVector4Bipolar() * 100.0f;
+        boxes.PushBack(Box(center, random.GetFloat()));
+    }
+
+    BVH bvh;
+    BVHBuilder::Indices leavesOrder;
+    BVHBuilder builder(bvh);
+    ASSERT_TRUE(builder.Build(boxes.Data(), numLeaves, params, leavesOrder));
+
+    ValidateBVH(bvh, boxes, leavesOrder, params.maxLeafNodeSize);
+}
+
+// build the same random triangle soup for each of the meshes
+// Note: only the BVH settings are taken from 'meshSettings'
+bool CreateRandomMeshes(MeshShape* meshes, const MeshDesc* meshSettings, uint32 numMeshes, uint32 numTriangles)
+{
+    Random random;
+
+    TriangleSoup triangleSoup;
+    if (!triangleSoup.Generate(random, numTriangles, 10.0f))
+    {
+        return false;
+    }
+
+    MeshDesc meshDesc;
+    meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+    for (uint32 i = 0; i < numMeshes; ++i)
+    {
+        meshDesc.bvhFormat = meshSettings[i].bvhFormat;
+        meshDesc.maxLeafSize = meshSettings[i].maxLeafSize;
+        meshDesc.useTriangleBlocks = meshSettings[i].useTriangleBlocks;
+        if (!meshes[i].Initialize(meshDesc))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CreateRandomMeshes(MeshShape* meshes, const BvhFormat* bvhFormats, uint32 numMeshes, uint32 numTriangles)
+{
+    std::vector<MeshDesc> meshSettings(numMeshes);
+    for (uint32 i = 0; i < numMeshes; ++i)
+    {
+        meshSettings[i].bvhFormat = bvhFormats[i];
+    }
+
+    return CreateRandomMeshes(meshes, meshSettings.data(), numMeshes, numTriangles);
+}
+
+} // namespace
+
+
+TEST(BVHTest, Build_FullSweep)
+{
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::FullSweep;
+    TestBVHBuilder(params);
+}
+
+TEST(BVHTest, Build_Binned)
+{
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::Binned;
+    TestBVHBuilder(params);
+}
+
+TEST(BVHTest, Build_Binned_Parallel)
+{
+    ThreadPool threadPool;
+    threadPool.SetNumThreads(4);
+
+    BvhBuildingParams params;
+    params.algorithm = BvhBuildingParams::Algorithm::Binned;
+    params.numBins = 16;
+    params.maxLeafNodeSize = 4;
+    params.threadPool = &threadPool;
+    TestBVHBuilder(params);
+}
+
+TEST(BVHTest, WideBVH_Traversal)
+{
+    const uint32 numTriangles = 5000;
+    const uint32 numRays = 10000;
+
+    const BvhFormat bvhFormats[] = { BvhFormat::Binary, BvhFormat::Wide4, BvhFormat::Wide8, BvhFormat::Quantized };
+    const uint32 numFormats = sizeof(bvhFormats) / sizeof(bvhFormats[0]);
+    MeshShape meshes[numFormats];
+    ASSERT_TRUE(CreateRandomMeshes(meshes, bvhFormats, numFormats, numTriangles));
+
+    const MeshShape& binaryMesh = meshes[0];
+
+    RenderingContext context;
+    Random random;
+
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(random.GetVector4Bipolar() * 15.0f, random.GetVector4Bipolar());
+
+        HitPoint binaryHitPoint;
+        binaryMesh.Traverse({ ray, binaryHitPoint, context }, 0);
+
+        HitPoint binaryShadowHitPoint;
+        const bool binaryOccluded = binaryMesh.Traverse_Shadow({ ray, binaryShadowHitPoint, context });
+
+        for (uint32 j = 1; j < numFormats; ++j)
+        {
+            HitPoint hitPoint;
+            meshes[j].Traverse({ ray, hitPoint, context }, 0);
+
+            EXPECT_EQ(binaryHitPoint.objectId, hitPoint.objectId) << "Format: " << j;
+            if (binaryHitPoint.objectId != RT_INVALID_OBJECT)
+            {
+                EXPECT_EQ(binaryHitPoint.subObjectId, hitPoint.subObjectId) << "Format: " << j;
+                EXPECT_EQ(binaryHitPoint.distance, hitPoint.distance) << "Format: " << j;
+            }
+
+            // shadow rays
+            HitPoint shadowHitPoint;
+            EXPECT_EQ(binaryOccluded, meshes[j].Traverse_Shadow({ ray, shadowHitPoint, context })) << "Format: " << j;
+        }
+    }
+
+    // SIMD-8 rays (traced one by one for non-binary formats)
+    for (uint32 i = 0; i < numRays / 8; ++i)
+    {
+        Vector4 origins[8], dirs[8];
+        for (uint32 k = 0; k < 8; ++k)
+        {
+            origins[k] = random.GetVector4Bipolar() * 15.0f;
+            dirs[k] = random.GetVector4Bipolar().Normalized3();
+        }
+        const Ray_Simd8 ray(
+            Vector3x8(origins[0], origins[1], origins[2], origins[3], origins[4], origins[5], origins[6], origins[7]),
+            Vector3x8(dirs[0], dirs[1], dirs[2], dirs[3], dirs[4], dirs[5], dirs[6], dirs[7]));
+
+        HitPoint_Simd8 binaryHitPoint;
+        binaryMesh.Traverse({ ray, binaryHitPoint, context }, 0);
+
+        HitPoint_Simd8 binaryShadowHitPoint;
+        const uint32 binaryOccluded = binaryMesh.Traverse_Shadow({ ray, binaryShadowHitPoint, context });
+
+        for (uint32 j = 1; j < numFormats; ++j)
+        {
+            HitPoint_Simd8 hitPoint;
+            meshes[j].Traverse({ ray, hitPoint, context }, 0);
+
+            for (uint32 k = 0; k < 8; ++k)
+            {
+                EXPECT_EQ(binaryHitPoint.objectId[k], hitPoint.objectId[k]) << "Format: " << j;
+                if (static_cast<uint32>(binaryHitPoint.objectId[k]) != RT_INVALID_OBJECT)
+                {
+                    EXPECT_EQ(binaryHitPoint.subObjectId[k], hitPoint.subObjectId[k]) << "Format: " << j;
+                    EXPECT_NEAR(binaryHitPoint.distance[k], hitPoint.distance[k], 0.0001f) << "Format: " << j;
+                }
+            }
+
+            HitPoint_Simd8 shadowHitPoint;
+            EXPECT_EQ(binaryOccluded, meshes[j].Traverse_Shadow({ ray, shadowHitPoint, context })) << "Format: " << j;
+        }
+    }
+}
+
+TEST(BVHTest, TriangleBlocks_Traversal)
+{
+    const uint32 numTriangles = 5000;
+    const uint32 numRays = 10000;
+    const uint32 leafSizes[] = { 1, 3, 8, 16 };
+    const uint32 numLeafSizes = sizeof(leafSizes) / sizeof(leafSizes[0]);
+
+    // for each leaf size: triangles intersected one by one and in blocks, also with the wide BVH
+    const uint32 numMeshes = 3 * numLeafSizes;
+    MeshDesc meshSettings[numMeshes];
+    for (uint32 i = 0; i < numLeafSizes; ++i)
+    {
+        meshSettings[3 * i + 0].maxLeafSize = leafSizes[i];
+        meshSettings[3 * i + 1].maxLeafSize = leafSizes[i];
+        meshSettings[3 * i + 1].useTriangleBlocks = true;
+        meshSettings[3 * i + 2].maxLeafSize = leafSizes[i];
+        meshSettings[3 * i + 2].useTriangleBlocks = true;
+        meshSettings[3 * i + 2].bvhFormat = BvhFormat::Wide8;
+    }
+
+    MeshShape meshes[numMeshes];
+    ASSERT_TRUE(CreateRandomMeshes(meshes, meshSettings, numMeshes, numTriangles));
+
+    RenderingContext context;
+    Random random;
+
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(random.GetVector4Bipolar() * 15.0f, random.GetVector4Bipolar());
+
+        for (uint32 j = 0; j < numLeafSizes; ++j)
+        {
+            SCOPED_TRACE("leaf size: " + std::to_string(leafSizes[j]));
+
+            const MeshShape& referenceMesh = meshes[3 * j];
+
+            HitPoint referenceHitPoint;
+            referenceMesh.Traverse({ ray, referenceHitPoint, context }, 0);
+
+            HitPoint referenceShadowHitPoint;
+            const bool referenceOccluded = referenceMesh.Traverse_Shadow({ ray, referenceShadowHitPoint, context });
+
+            // the triangles order is the same, as the BVH is the same
+            for (uint32 k = 1; k < 3; ++k)
+            {
+                HitPoint hitPoint;
+                meshes[3 * j + k].Traverse({ ray, hitPoint, context }, 0);
+
+                EXPECT_EQ(referenceHitPoint.objectId, hitPoint.objectId);
+                if (referenceHitPoint.objectId != RT_INVALID_OBJECT)
+                {
+                    EXPECT_EQ(referenceHitPoint.subObjectId, hitPoint.subObjectId);
+                    EXPECT_NEAR(referenceHitPoint.distance, hitPoint.distance, 1.0e-5f * (1.0f + referenceHitPoint.distance));
+                    EXPECT_NEAR(referenceHitPoint.u, hitPoint.u, 1.0e-4f);
+                    EXPECT_NEAR(referenceHitPoint.v, hitPoint.v, 1.0e-4f);
+                }
+
+                HitPoint shadowHitPoint;
+                EXPECT_EQ(referenceOccluded, meshes[3 * j + k].Traverse_Shadow({ ray, shadowHitPoint, context }));
+            }
+        }
+    }
+}
+
+TEST(BVHTest, AlphaMask_Traversal)
+{
+    // front quad (z = 1) has fully transparent material, back quad (z = 0) covers only x < 0 and is opaque
+    const Float3 positions[] =
+    {
+        { -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f },
+        { -1.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { -1.0f, 1.0f, 0.0f },
+    };
+    const Float2 texCoords[] =
+    {
+        { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f },
+        { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f },
+    };
+    const Float3 normals[8] =
+    {
+        { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f },
+        { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f },
+    };
+    const Float3 tangents[8] =
+    {
+        { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f },
+        { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f },
+    };
+    const uint32 indices[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 };
+    const uint32 materialIndices[] = { 1, 1, 0, 0 };
+
+    MaterialPtr materials[2] = { std::make_shared<Material>(), std::make_shared<Material>() };
+    materials[1]->maskMap = std::make_shared<ConstTexture>(Vector4::Zero());
+
+    const uint32 numMeshes = 4;
+    MeshDesc meshSettings[numMeshes];
+    meshSettings[1].useTriangleBlocks = true;
+    meshSettings[2].bvhFormat = BvhFormat::Wide8;
+    meshSettings[3].bvhFormat = BvhFormat::Quantized;
+
+    MeshShape meshes[numMeshes];
+    for (uint32 i = 0; i < numMeshes; ++i)
+    {
+        meshSettings[i].vertexBufferDesc.numTriangles = 4;
+        meshSettings[i].vertexBufferDesc.numVertices = 8;
+        meshSettings[i].vertexBufferDesc.numMaterials = 2;
+        meshSettings[i].vertexBufferDesc.positions = positions;
+        meshSettings[i].vertexBufferDesc.normals = normals;
+        meshSettings[i].vertexBufferDesc.tangents = tangents;
+        meshSettings[i].vertexBufferDesc.texCoords = texCoords;
+        meshSettings[i].vertexBufferDesc.vertexIndexBuffer = indices;
+        meshSettings[i].vertexBufferDesc.materialIndexBuffer = materialIndices;
+        meshSettings[i].vertexBufferDesc.materials = materials;
+        ASSERT_TRUE(meshes[i].Initialize(meshSettings[i]));
+    }
+
+    RenderingContext context;
+    Random random;
+
+    for (uint32 i = 0; i < 1000; ++i)
+    {
+        // direction is slightly tilted, because axis-aligned rays are not handled by the ray-box test
+        const Vector4 origin = random.GetVector4Bipolar() * Vector4(0.9f, 0.9f, 0.0f, 0.0f) + Vector4(0.0f, 0.0f, 5.0f, 0.0f);
+        const Ray ray(origin, Vector4(0.001f, 0.001f, -1.0f, 0.0f));
+        const bool expectedHit = origin.x + 0.005f < 0.0f;
+
+        for (uint32 j = 0; j < numMeshes; ++j)
+        {
+            SCOPED_TRACE("mesh: " + std::to_string(j));
+
+            HitPoint hitPoint;
+            meshes[j].Traverse({ ray, hitPoint, context }, 0);
+            EXPECT_EQ(expectedHit, hitPoint.objectId != RT_INVALID_OBJECT);
+            if (expectedHit)
+            {
+                EXPECT_NEAR(5.0f, hitPoint.distance, 1.0e-3f);
+            }
+
+            HitPoint shadowHitPoint;
+            EXPECT_EQ(expectedHit, meshes[j].Traverse_Shadow({ ray, shadowHitPoint, context }));
+        }
+    }
+}
+
+TEST(BVHTest, QuantizedBVH_Build)
+{
+    const uint32 numTriangles = 5000;
+
+    const BvhFormat bvhFormats[] = { BvhFormat::Binary, BvhFormat::Quantized };
+    MeshShape meshes[2];
+    ASSERT_TRUE(CreateRandomMeshes(meshes, bvhFormats, 2, numTriangles));
+
+    const BVH& bvh = meshes[0].GetBVH();
+
+    QuantizedBVH quantizedBVH;
+    ASSERT_TRUE(quantizedBVH.Build(bvh));
+    ASSERT_LE(quantizedBVH.GetNumNodes(), bvh.GetNumNodes() / 2);
+
+    // binary BVH should not be kept in memory if quantized one is used
+    EXPECT_EQ(0u, meshes[1].GetBVH().GetNumNodes());
+    EXPECT_EQ(quantizedBVH.GetMemorySize(), meshes[1].GetBvhMemorySize());
+    EXPECT_LE(2 * quantizedBVH.GetMemorySize(), bvh.GetNumNodes() * sizeof(BVH::Node));
+
+    struct StackEntry
+    {
+        uint32 sourceNode;
+        uint32 quantizedNode;
+        Box decodedBox;
+    };
+
+    // walk both trees at once and check if decoded boxes contain the original ones
+    DynArray<StackEntry> stack;
+    stack.PushBack({ 0, 0, quantizedBVH.GetRootBox() });
+    while (!stack.Empty())
+    {
+        const StackEntry entry = stack.Back();
+        stack.PopBack();
+
+        const BVH::Node& sourceNode = bvh.GetNodes()[entry.sourceNode];
+        const QuantizedBVH::Node& node = quantizedBVH.GetNodes()[entry.quantizedNode];
+        const Vector4 scale = node.GetScale();
+
+        for (uint32 i = 0; i < 2; ++i)
+        {
+            const BVH::Node& sourceChild = bvh.GetNodes()[sourceNode.childIndex + i];
+            const Box childBox = node.GetChildBox(i, entry.decodedBox.min, scale);
+
+            const Box sourceBox = sourceChild.GetBox();
+            EXPECT_TRUE((childBox.min <= sourceBox.min).All());
+            EXPECT_TRUE((childBox.max >= sourceBox.max).All());
+
+            // quantized child box should still be tight
+            EXPECT_TRUE(((childBox.max - childBox.min) <= (sourceBox.max - sourceBox.min) + (entry.decodedBox.max - entry.decodedBox.min) * 0.02f).All());
+
+            if (sourceChild.IsLeaf())
+            {
+                EXPECT_EQ(sourceChild.childIndex, node.childIndex[i]);
+                EXPECT_EQ(sourceChild.numLeaves, node.numLeaves[i]);
+            }
+            else
+            {
+                EXPECT_EQ(0u, node.numLeaves[i]);
+                ASSERT_LT(node.childIndex[i], quantizedBVH.GetNumNodes());
+                stack.PushBack({ sourceNode.childIndex + i, node.childIndex[i], childBox });
+            }
+        }
+    }
+}
+
+TEST(BVHTest, MeshCache)
+{
+    const uint32 numTriangles = 5000;
+    const uint32 numRays = 1000;
+
+    Random random;
+
+    TriangleSoup triangleSoup;
+    ASSERT_TRUE(triangleSoup.Generate(random, numTriangles, 10.0f));
+
+    MeshDesc meshDesc;
+    meshDesc.cacheDirectory = ".";
+    meshDesc.vertexBufferDesc = triangleSoup.GetVertexBufferDesc();
+
+    const uint64 hash = MeshCache::CalculateHash(meshDesc.vertexBufferDesc, MeshShape::GetBvhBuildingParams(meshDesc));
+    const std::string cacheFilePath = MeshCache::GetFilePath(meshDesc.cacheDirectory, hash);
+    remove(cacheFilePath.c_str());
+
+    // BVH built with different parameters must not be picked from the cache
+    {
+        BvhBuildingParams otherParams = MeshShape::GetBvhBuildingParams(meshDesc);
+        otherParams.algorithm = BvhBuildingParams::Algorithm::FullSweep;
+        EXPECT_NE(hash, MeshCache::CalculateHash(meshDesc.vertexBufferDesc, otherParams));
+
+        otherParams = MeshShape::GetBvhBuildingParams(meshDesc);
+        otherParams.numBins *= 2;
+        EXPECT_NE(hash, MeshCache::CalculateHash(meshDesc.vertexBufferDesc, otherParams));
+    }
+
+    // the first mesh writes the cache, the second one maps it
+    MeshShape builtMesh, cachedMesh;
+    ASSERT_TRUE(builtMesh.Initialize(meshDesc));
+    {
+        MeshCache cache;
+        ASSERT_TRUE(cache.Load(cacheFilePath, hash));
+        EXPECT_EQ(numTriangles, cache.GetNumTriangles());
+        EXPECT_EQ(builtMesh.GetBVH().GetNumNodes(), cache.GetNumNodes());
+        EXPECT_FALSE(MeshCache().Load(cacheFilePath, hash + 1));
+    }
+
+    // temporary file must be renamed to the cache file
+    FILE* tempFile = fopen((cacheFilePath + ".tmp").c_str(), "rb");
+    EXPECT_EQ(nullptr, tempFile);
+    if (tempFile)
+    {
+        fclose(tempFile);
+    }
+
+    ASSERT_TRUE(cachedMesh.Initialize(meshDesc));
+
+    const BVH& builtBVH = builtMesh.GetBVH();
+    const BVH& cachedBVH = cachedMesh.GetBVH();
+    ASSERT_EQ(builtBVH.GetNumNodes(), cachedBVH.GetNumNodes());
+    EXPECT_EQ(0, memcmp(builtBVH.GetNodes(), cachedBVH.GetNodes(), sizeof(BVH::Node) * builtBVH.GetNumNodes()));
+
+    const Box builtBox = builtMesh.GetBoundingBox();
+    const Box cachedBox = cachedMesh.GetBoundingBox();
+    EXPECT_TRUE((builtBox.min == cachedBox.min).All());
+    EXPECT_TRUE((builtBox.max == cachedBox.max).All());
+
+    RenderingContext context;
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(random.GetVector4Bipolar() * 15.0f, random.GetVector4Bipolar());
+
+        HitPoint builtHitPoint, cachedHitPoint;
+        builtMesh.Traverse({ ray, builtHitPoint, context }, 0);
+        cachedMesh.Traverse({ ray, cachedHitPoint, context }, 0);
+
+        EXPECT_EQ(builtHitPoint.objectId, cachedHitPoint.objectId);
+        if (builtHitPoint.objectId != RT_INVALID_OBJECT)
+        {
+            EXPECT_EQ(builtHitPoint.subObjectId, cachedHitPoint.subObjectId);
+            EXPECT_EQ(builtHitPoint.distance, cachedHitPoint.distance);
+        }
+    }
+
+    // cache file no longer matches the mesh data - it must be rebuilt
+    triangleSoup.positions[0] = Float3(1.0f, 2.0f, 3.0f);
+    MeshShape modifiedMesh;
+    ASSERT_TRUE(modifiedMesh.Initialize(meshDesc));
+    const std::string modifiedCacheFilePath = MeshCache::GetFilePath(meshDesc.cacheDirectory, MeshCache::CalculateHash(meshDesc.vertexBufferDesc, MeshShape::GetBvhBuildingParams(meshDesc)));
+    EXPECT_NE(cacheFilePath, modifiedCacheFilePath);
+
+    EXPECT_EQ(0, remove(cacheFilePath.c_str()));
+    EXPECT_EQ(0, remove(modifiedCacheFilePath.c_str()));
+}
+
+TEST(BVHTest, PacketTraversal)
+{
+    const uint32 numTriangles = 2000;
+    const uint32 numRays = 1001; // not a multiple of ray group size
+
+    const BvhFormat bvhFormat = BvhFormat::Binary;
+    MeshShapePtr mesh = std::make_shared<MeshShape>();
+    ASSERT_TRUE(CreateRandomMeshes(mesh.get(), &bvhFormat, 1, numTriangles));
+
+    // two instances of the mesh, so both scene-level and mesh-level BVHs are traversed
+    Scene scene;
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(mesh);
+        sceneObject->SetTransform(Matrix4::MakeTranslation(Vector4(15.0f * static_cast<float>(i), 0.0f, 0.0f)));
+        scene.AddObject(std::move(sceneObject));
+    }
+    ASSERT_TRUE(scene.BuildBVH());
+
+    RenderingParams params;
+    RenderingContext context;
+    context.params = &params;
+
+    Random random;
+
+    // rays in all the octants, so the packet has partially filled groups
+    DynArray<Ray> rays;
+    DynArray<uint32> rayOffsets;
+    RayPacket& packet = context.rayPacket;
+    packet.Clear();
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(random.GetVector4Bipolar() * 15.0f + Vector4(7.5f, 0.0f, 0.0f), random.GetVector4Bipolar());
+        rays.PushBack(ray);
+        rayOffsets.PushBack(packet.PushRay(ray, Vector4(1.0f), ImageLocationInfo(0, 0)));
+    }
+    ASSERT_EQ(numRays, packet.numRays);
+
+    struct TraversalConfig
+    {
+        float reorderingThreshold;
+        uint32 simdThreshold;
+        uint32 singleRayThreshold;
+    };
+
+    // pure packet traversal, ray reordering and (aggressive) SIMD-8 and single-ray fallbacks
+    const TraversalConfig configs[] =
+    {
+        { 0.0f, 0, 0 },
+        { 0.5f, 0, 0 },
+        { 1.0f, 0, 0 },
+        { 0.0f, 1, 1 },
+        { 0.0f, 1000, 0 },
+        { 0.0f, 0, 1000 },
+        { 0.5f, 4, 4 },
+    };
+
+    for (const TraversalConfig& config : configs)
+    {
+        params.packetReorderingThreshold = config.reorderingThreshold;
+        params.simdTraversalThreshold = config.simdThreshold;
+        params.singleRayTraversalThreshold = config.singleRayThreshold;
+        scene.Traverse(PacketTraversalContext{ packet, context });
+
+        for (uint32 i = 0; i < numRays; ++i)
+        {
+            HitPoint hitPoint;
+            scene.Traverse({ rays[i], hitPoint, context });
+
+            const HitPoint& packetHitPoint = context.hitPoints[rayOffsets[i]];
+            EXPECT_EQ(hitPoint.objectId, packetHitPoint.objectId) << "Ray index: " << i << ", config: " << (&config - configs);
+            if (hitPoint.objectId != RT_INVALID_OBJECT && hitPoint.objectId == packetHitPoint.objectId)
+            {
+                EXPECT_EQ(hitPoint.subObjectId, packetHitPoint.subObjectId) << "Ray index: " << i << ", config: " << (&config - configs);
+                EXPECT_NEAR(hitPoint.distance, packetHitPoint.distance, 0.001f) << "Ray index: " << i << ", config: " << (&config - configs);
+            }
+        }
+    }
+}
+
+TEST(BVHTest, ShadowTraversal)
+{
+    const uint32 numTriangles = 2000;
+    const uint32 numRays = 1001; // not a multiple of ray group size
+    const uint32 numInstances = 8;
+
+    const BvhFormat bvhFormat = BvhFormat::Binary;
+    MeshShapePtr mesh = std::make_shared<MeshShape>();
+    ASSERT_TRUE(CreateRandomMeshes(mesh.get(), &bvhFormat, 1, numTriangles));
+
+    Random random;
+
+    // rotated instances, so local-space rays have different octants than world-space rays
+    Scene scene;
+    for (uint32 i = 0; i < numInstances; ++i)
+    {
+        const Vector4 position = random.GetVector4Bipolar() * 15.0f;
+        const Quaternion rotation = Quaternion::FromEulerAngles((random.GetVector4() * (2.0f * RT_PI)).ToFloat3());
+
+        ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(mesh);
+        sceneObject->SetTransform(Transform(position, rotation).ToMatrix4());
+        scene.AddObject(std::move(sceneObject));
+    }
+    ASSERT_TRUE(scene.BuildBVH());
+
+    RenderingParams params;
+    RenderingContext context;
+    context.params = &params;
+
+    // random shadow rays of random length, some of them are not occluded
+    DynArray<Ray> rays;
+    DynArray<float> maxDistances;
+    DynArray<uint32> rayOffsets;
+    DynArray<bool> expectedOcclusion;
+    RayPacket& packet = context.rayPacket;
+    packet.Clear();
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(random.GetVector4Bipolar() * 20.0f, random.GetVector4Bipolar());
+        const float maxDistance = 40.0f * random.GetFloat();
+        rays.PushBack(ray);
+        maxDistances.PushBack(maxDistance);
+        rayOffsets.PushBack(packet.PushRay(ray, Vector4(1.0f), ImageLocationInfo(0, 0), maxDistance));
+
+        HitPoint hitPoint;
+        hitPoint.distance = maxDistance;
+        expectedOcclusion.PushBack(scene.Traverse_Shadow({ ray, hitPoint, context }));
+    }
+
+    // SIMD-8 traversal, the last group has inactive lanes
+    for (uint32 i = 0; i < numRays; i += RayPacket::RaysPerGroup)
+    {
+        Ray groupRays[RayPacket::RaysPerGroup];
+        HitPoint_Simd8 hitPoint;
+        for (uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+        {
+            const uint32 rayIndex = Min(i + lane, numRays - 1);
+            groupRays[lane] = rays[rayIndex];
+            hitPoint.distance[lane] = i + lane < numRays ? maxDistances[rayIndex] : 0.0f;
+        }
+
+        const Ray_Simd8 simdRay(groupRays[0], groupRays[1], groupRays[2], groupRays[3], groupRays[4], groupRays[5], groupRays[6], groupRays[7]);
+        const uint32 occludedRaysMask = scene.Traverse_Shadow(SimdTraversalContext{ simdRay, hitPoint, context });
+
+        for (uint32 lane = 0; lane < RayPacket::RaysPerGroup; ++lane)
+        {
+            const bool occluded = ((occludedRaysMask >> lane) & 1u) != 0;
+            if (i + lane < numRays)
+            {
+                EXPECT_EQ(expectedOcclusion[i + lane], occluded) << "Ray index: " << (i + lane);
+            }
+            else
+            {
+                EXPECT_FALSE(occluded);
+            }
+        }
+    }
+
+    // pure packet traversal, ray reordering and (aggressive) SIMD-8 fallback
+    struct TraversalConfig
+    {
+        float reorderingThreshold;
+        uint32 simdThreshold;
+    };
+
+    const TraversalConfig configs[] =
+    {
+        { 0.0f, 0 },
+        { 0.5f, 0 },
+        { 1.0f, 0 },
+        { 0.0f, 1000 },
+        { 0.5f, 4 },
+    };
+
+    for (const TraversalConfig& config : configs)
+    {
+        params.packetReorderingThreshold = config.reorderingThreshold;
+        params.simdTraversalThreshold = config.simdThreshold;
+
+        // packet traversal modifies rays max distances
+        packet.Clear();
+        for (uint32 i = 0; i < numRays; ++i)
+        {
+            packet.PushRay(rays[i], Vector4(1.0f), ImageLocationInfo(0, 0), maxDistances[i]);
+        }
+
+        scene.Traverse_Shadow(PacketTraversalContext{ packet, context });
+
+        for (uint32 i = 0; i < numRays; ++i)
+        {
+            const uint32 rayOffset = rayOffsets[i];
+            const bool occluded = ((context.occludedRays[rayOffset / RayPacket::RaysPerGroup] >> (rayOffset % RayPacket::RaysPerGroup)) & 1u) != 0;
+            EXPECT_EQ(expectedOcclusion[i], occluded) << "Ray index: " << i << ", config: " << (&config - configs);
+        }
+    }
+}
+
+TEST(BVHTest, RayPacket_OctantGroups)
+{
+    const uint32 numRays = 100;
+
+    Random random;
+    RayPacket packet;
+
+    for (uint32 i = 0; i < numRays; ++i)
+    {
+        const Ray ray(Vector4::Zero(), random.GetVector4Bipolar());
+        const uint32 rayOffset = packet.PushRay(ray, Vector4(1.0f), ImageLocationInfo(i, 0));
+        EXPECT_EQ(i, packet.imageLocations[rayOffset].x);
+    }
+
+    uint32 numValidRays = 0;
+    for (uint32 i = 0; i < packet.GetNumGroups(); ++i)
+    {
+        const RayGroup& group = packet.groups[i];
+        for (uint32 j = 0; j < RayPacket::RaysPerGroup; ++j)
+        {
+            if (group.rayOffsets[j] == RayPacket::InvalidRayOffset)
+            {
+                continue;
+            }
+
+            // all rays in a group must be in the same octant
+            const Ray ray = Ray::BuildUnsafe(Vector4(group.rays[0].origin.x[j], group.rays[0].origin.y[j], group.rays[0].origin.z[j]),
+                                             Vector4(group.rays[0].dir.x[j], group.rays[0].dir.y[j], group.rays[0].dir.z[j]));
+            EXPECT_EQ(packet.groupOctants[i], RayPacket::GetRayOctant(ray));
+            EXPECT_EQ(static_cast<int32>(RayPacket::RaysPerGroup * i + j), group.rayOffsets[j]);
+            numValidRays++;
+        }
+    }
+
+    EXPECT_EQ(numRays, numValidRays);
+    EXPECT_LE(packet.GetNumGroups(), numRays / RayPacket::RaysPerGroup + RayPacket::NumOctants);
+}
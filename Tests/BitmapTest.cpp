@@ -1,7 +1,10 @@
 #include "PCH.h"
 #include "../Core/Utils/Bitmap.h"
+#include "../Core/Utils/ExrWriter.h"
 #include "../Core/Math/Half.h"
 #include "../Core/Math/Packed.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Utils/ThreadPool.h"
 
 using namespace rt;
 using namespace rt::math;
@@ -492,3 +495,176 @@ TEST(BitmapTest, Format_R16G16B16A16_Half)
     Validate_GetPixel(bitmap, expected, 0.001f);
     Validate_GetPixelBlock(bitmap, expected, 0.001f);
 }
+
+TEST(BitmapTest, GaussianBlur)
+{
+    // the image is wider than the old 4096 pixels limit and its size is not a multiple of the SIMD width
+    const uint32 width = 5003;
+    const uint32 height = 37;
+
+    Bitmap bitmap;
+    ASSERT_TRUE(bitmap.Init({ width, height, Bitmap::Format::R32G32B32_Float }));
+
+    Random random;
+    Vector4 sum = Vector4::Zero();
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            const Vector4 value = random.GetVector4();
+            bitmap.GetPixelRef<Float3>(x, y) = value.ToFloat3();
+            sum += Vector4(value.ToFloat3());
+        }
+    }
+
+    Bitmap reference;
+    ASSERT_TRUE(reference.Init({ width, height, Bitmap::Format::R32G32B32_Float }));
+    ASSERT_TRUE(Bitmap::Copy(reference, bitmap));
+
+    ThreadPool threadPool;
+
+    // scratch buffer is reused after blurring a smaller image, so it's too small and contains stale data
+    DynArray<Vector8> scratchBuffer;
+    {
+        Bitmap smallBitmap;
+        ASSERT_TRUE(smallBitmap.Init({ 16, 16, Bitmap::Format::R32G32B32_Float }));
+        smallBitmap.Clear();
+        ASSERT_TRUE(smallBitmap.GaussianBlur(2.0f, 4, &threadPool, &scratchBuffer));
+    }
+
+    ASSERT_TRUE(bitmap.GaussianBlur(20.0f, 4, &threadPool, &scratchBuffer));
+    ASSERT_TRUE(reference.GaussianBlur(20.0f, 4));
+
+    Vector4 blurredSum = Vector4::Zero();
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            // multithreaded blur must give exactly the same results
+            const Vector4 value(bitmap.GetPixelRef<Float3>(x, y));
+            CompareVector(Vector4(reference.GetPixelRef<Float3>(x, y)), value);
+            blurredSum += value;
+        }
+    }
+
+    // blurring must (approximately) preserve the image energy
+    const Vector4 numPixels(static_cast<float>(width * height));
+    CompareVector(sum / numPixels, blurredSum / numPixels, 0.01f);
+}
+
+TEST(BitmapTest, GaussianBlur_SmallImage)
+{
+    // blur radius is much bigger than the image
+    Bitmap bitmap;
+    ASSERT_TRUE(bitmap.Init({ 3, 2, Bitmap::Format::R32G32B32_Float }));
+    for (uint32 y = 0; y < 2; ++y)
+    {
+        for (uint32 x = 0; x < 3; ++x)
+        {
+            bitmap.GetPixelRef<Float3>(x, y) = Float3(1.0f, 2.0f, 3.0f);
+        }
+    }
+
+    ASSERT_TRUE(bitmap.GaussianBlur(100.0f, 8));
+
+    for (uint32 y = 0; y < 2; ++y)
+    {
+        for (uint32 x = 0; x < 3; ++x)
+        {
+            CompareVector(Vector4(1.0f, 2.0f, 3.0f), Vector4(bitmap.GetPixelRef<Float3>(x, y)), 0.0001f);
+        }
+    }
+}
+
+TEST(BitmapTest, ExrWriter)
+{
+    const char* path = "exr_writer_test.exr";
+    const uint32 width = 37;
+    const uint32 height = 11;
+
+    const auto pixelValue = [](uint32 x, uint32 y)
+    {
+        return Float3(static_cast<float>(x), static_cast<float>(y) * 0.5f, static_cast<float>(x + y) * 0.25f);
+    };
+
+    {
+        DynArray<Float3> line;
+        ASSERT_TRUE(line.Resize(width));
+
+        ExrWriter writer;
+        ASSERT_TRUE(writer.Open(path, width, height));
+        for (uint32 y = 0; y < height; ++y)
+        {
+            for (uint32 x = 0; x < width; ++x)
+            {
+                line[x] = pixelValue(x, y);
+            }
+            ASSERT_TRUE(writer.WriteLine(line.Data()));
+        }
+        ASSERT_TRUE(writer.Close());
+    }
+
+    Bitmap bitmap;
+    ASSERT_TRUE(bitmap.Load(path));
+    remove(path);
+
+    ASSERT_EQ(width, bitmap.GetWidth());
+    ASSERT_EQ(height, bitmap.GetHeight());
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            const Vector4 expected(pixelValue(x, y));
+            const Vector4 value = bitmap.GetPixel(x, y);
+            EXPECT_EQ(expected.x, value.x);
+            EXPECT_EQ(expected.y, value.y);
+            EXPECT_EQ(expected.z, value.z);
+        }
+    }
+}
+
+TEST(BitmapTest, ExrWriter_Async)
+{
+    const char* path = "exr_writer_async_test.exr";
+    const uint32 width = 16;
+    const uint32 height = 20;
+    const uint32 linesPerBlock = 3;
+
+    AsyncExrWriter writer;
+    ASSERT_TRUE(writer.Open(path, width, height));
+
+    for (uint32 firstLine = 0; firstLine < height; firstLine += linesPerBlock)
+    {
+        const uint32 numLines = Min(linesPerBlock, height - firstLine);
+
+        DynArray<Float3> pixels;
+        ASSERT_TRUE(pixels.Resize(width * numLines));
+        for (uint32 i = 0; i < pixels.Size(); ++i)
+        {
+            pixels[i] = Float3(static_cast<float>(firstLine + i / width));
+        }
+
+        ASSERT_TRUE(writer.PushLines(std::move(pixels)));
+    }
+
+    EXPECT_EQ(height, writer.GetNumQueuedLines());
+    ASSERT_TRUE(writer.Close());
+    EXPECT_EQ(0u, writer.GetNumPendingBytes());
+
+    Bitmap bitmap;
+    ASSERT_TRUE(bitmap.Load(path));
+    remove(path);
+
+    ASSERT_EQ(width, bitmap.GetWidth());
+    ASSERT_EQ(height, bitmap.GetHeight());
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            const Vector4 value = bitmap.GetPixel(x, y);
+            EXPECT_EQ(static_cast<float>(y), value.x);
+            EXPECT_EQ(static_cast<float>(y), value.y);
+            EXPECT_EQ(static_cast<float>(y), value.z);
+        }
+    }
+}
@@ -159,6 +159,27 @@ TEST(DynArray, Resize_ReduceSize)
     EXPECT_EQ(2, array[1]);
 }
 
+TEST(DynArray, ShrinkToFit)
+{
+    DynArray<int32> array;
+    ASSERT_TRUE(array.Reserve(100));
+    array.PushBack(1);
+    array.PushBack(2);
+    array.PushBack(3);
+    EXPECT_LE(100u, array.GetCapacity());
+
+    ASSERT_TRUE(array.ShrinkToFit());
+    EXPECT_EQ(3u, array.GetCapacity());
+    ASSERT_EQ(3u, array.Size());
+    EXPECT_EQ(1, array[0]);
+    EXPECT_EQ(2, array[1]);
+    EXPECT_EQ(3, array[2]);
+
+    array.Clear();
+    ASSERT_TRUE(array.ShrinkToFit());
+    EXPECT_EQ(0u, array.GetCapacity());
+}
+
 TEST(DynArray, Resize_CustomElement)
 {
     DynArray<int32> array;
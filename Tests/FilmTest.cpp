@@ -0,0 +1,182 @@
+#include "PCH.h"
+#include "../Core/Rendering/Film.h"
+#include "../Core/Utils/Bitmap.h"
+#include "../Core/Utils/ThreadPool.h"
+#include "../Core/Math/Random.h"
+
+using namespace rt;
+using namespace rt::math;
+
+namespace {
+
+bool InitFilmBitmap(Bitmap& bitmap, uint32 width, uint32 height)
+{
+    Bitmap::InitData initData;
+    initData.linearSpace = true;
+    initData.width = width;
+    initData.height = height;
+    initData.format = Bitmap::Format::R32G32B32_Float;
+    return bitmap.Init(initData);
+}
+
+} // namespace
+
+TEST(FilmTest, MergeSplats_NoEnergyLoss)
+{
+    const uint32 width = 123;
+    const uint32 height = 71;
+    const uint32 numThreads = 64;
+    const uint32 numTasks = 256;
+    const uint32 numSplatsPerTask = 1000;
+
+    Bitmap sum;
+    ASSERT_TRUE(InitFilmBitmap(sum, width, height));
+    sum.Clear();
+
+    ThreadPool threadPool;
+    threadPool.SetNumThreads(numThreads);
+    ASSERT_EQ(numThreads, threadPool.GetNumThreads());
+
+    DynArray<FilmSplatQueue> queues;
+    ASSERT_TRUE(queues.Resize(numTasks));
+
+    const auto taskCallback = [&](uint32 taskID, uint32)
+    {
+        Film film(sum, nullptr, &queues[taskID]);
+        Random random;
+        for (uint32 i = 0; i < numSplatsPerTask; ++i)
+        {
+            // keep away from the film borders, so the jittered splats can't fall outside
+            const Vector4 pos = Vector4(0.05f) + random.GetVector4() * 0.9f;
+            film.AccumulateColor(pos, Vector4(1.0f, 2.0f, 4.0f), random);
+        }
+    };
+    threadPool.RunParallelTask(taskCallback, numTasks);
+
+    Film film(sum);
+    film.MergeSplats(queues, threadPool);
+
+    for (const FilmSplatQueue& queue : queues)
+    {
+        EXPECT_TRUE(queue.Empty());
+    }
+
+    // integer colors, so the sum is exact
+    Vector4 energy = Vector4::Zero();
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            energy += Vector4(sum.GetPixelRef<Float3>(x, y));
+        }
+    }
+
+    const float numSplats = static_cast<float>(numTasks * numSplatsPerTask);
+    EXPECT_EQ(numSplats, energy.x);
+    EXPECT_EQ(2.0f * numSplats, energy.y);
+    EXPECT_EQ(4.0f * numSplats, energy.z);
+}
+
+TEST(FilmTest, MergeSplats_Deterministic)
+{
+    const uint32 width = 67;
+    const uint32 height = 45;
+    const uint32 numTasks = 100;
+    const uint32 numSplatsPerTask = 500;
+
+    struct TestSplat
+    {
+        uint32 x;
+        uint32 y;
+        Vector4 color;
+    };
+
+    // splats are generated upfront, so every run pushes exactly the same data
+    Random random;
+    DynArray<DynArray<TestSplat>> taskSplats;
+    ASSERT_TRUE(taskSplats.Resize(numTasks));
+    for (DynArray<TestSplat>& splats : taskSplats)
+    {
+        for (uint32 i = 0; i < numSplatsPerTask; ++i)
+        {
+            splats.PushBack({ random.GetInt() % width, random.GetInt() % height, random.GetVector4() });
+        }
+    }
+
+    // reference: splatting sequentially in tasks order
+    Bitmap reference;
+    ASSERT_TRUE(InitFilmBitmap(reference, width, height));
+    reference.Clear();
+    {
+        Film film(reference);
+        for (const DynArray<TestSplat>& splats : taskSplats)
+        {
+            for (const TestSplat& splat : splats)
+            {
+                film.AccumulateColor(splat.x, splat.y, splat.color);
+            }
+        }
+    }
+
+    for (const uint32 numThreads : { 1u, 7u, 64u })
+    {
+        ThreadPool threadPool;
+        threadPool.SetNumThreads(numThreads);
+
+        Bitmap sum;
+        ASSERT_TRUE(InitFilmBitmap(sum, width, height));
+        sum.Clear();
+
+        DynArray<FilmSplatQueue> queues;
+        ASSERT_TRUE(queues.Resize(numTasks));
+
+        const auto taskCallback = [&](uint32 taskID, uint32)
+        {
+            for (const TestSplat& splat : taskSplats[taskID])
+            {
+                queues[taskID].Push(splat.x, splat.y, splat.color);
+            }
+        };
+        threadPool.RunParallelTask(taskCallback, numTasks);
+
+        Film film(sum);
+        film.MergeSplats(queues, threadPool);
+
+        EXPECT_EQ(0, memcmp(reference.GetData(), sum.GetData(), sum.GetDataSize())) << "Num threads: " << numThreads;
+    }
+}
+
+TEST(FilmTest, SplatQueue_SortByStripe)
+{
+    FilmSplatQueue queue;
+    EXPECT_TRUE(queue.Empty());
+
+    const uint32 height = 10;
+    for (uint32 i = 0; i < 100; ++i)
+    {
+        queue.Push(i, (i * 7u) % height, Vector4(static_cast<float>(i)));
+    }
+    ASSERT_EQ(100u, queue.Size());
+
+    const uint32 numStripes = 3;
+    queue.SortByStripe(numStripes, height);
+
+    uint32 numSplats = 0;
+    for (uint32 stripe = 0; stripe < numStripes; ++stripe)
+    {
+        uint32 prevX = 0;
+        for (const FilmSplatQueue::Splat& splat : queue.GetStripe(stripe))
+        {
+            EXPECT_EQ(stripe, splat.y * numStripes / height);
+
+            // push order must be preserved within a stripe
+            EXPECT_LE(prevX, splat.x);
+            prevX = splat.x;
+            numSplats++;
+        }
+    }
+    EXPECT_EQ(100u, numSplats);
+
+    queue.Clear();
+    EXPECT_TRUE(queue.Empty());
+}
@@ -0,0 +1,156 @@
+#include "PCH.h"
+#include "../Core/Scene/Scene.h"
+#include "../Core/Scene/LightBVH.h"
+#include "../Core/Scene/Light/PointLight.h"
+#include "../Core/Scene/Light/SpotLight.h"
+#include "../Core/Scene/Light/AreaLight.h"
+#include "../Core/Scene/Light/BackgroundLight.h"
+#include "../Core/Scene/Object/SceneObject_Light.h"
+#include "../Core/Shapes/RectShape.h"
+#include "../Core/Math/Random.h"
+#include "../Core/Math/Transform.h"
+
+using namespace rt;
+using namespace math;
+
+namespace {
+
+void CreateRandomLights(Scene& scene, Random& random, uint32 numLights, bool pointLightsOnly)
+{
+    for (uint32 i = 0; i < numLights; ++i)
+    {
+        const Vector4 color = random.GetVector4() * 10.0f;
+
+        LightPtr light;
+        switch (pointLightsOnly ? 0 : i % 3)
+        {
+        case 0: light = std::make_unique<PointLight>(color); break;
+        case 1: light = std::make_unique<SpotLight>(color, DegToRad(30.0f)); break;
+        case 2: light = std::make_unique<AreaLight>(std::make_shared<RectShape>(Float2(0.5f)), color); break;
+        }
+
+        auto lightObject = std::make_unique<LightSceneObject>(std::move(light));
+        const Quaternion rotation = Quaternion::FromEulerAngles((random.GetVector4() * RT_2PI).ToFloat3());
+        lightObject->SetTransform(Transform(random.GetVector4Bipolar() * 20.0f, rotation).ToMatrix4());
+        scene.AddObject(std::move(lightObject));
+    }
+}
+
+} // namespace
+
+TEST(LightBVHTest, Empty)
+{
+    LightBVH lightBVH;
+    ASSERT_TRUE(lightBVH.Build({}));
+    EXPECT_EQ(0u, lightBVH.GetNumNodes());
+
+    float pdf = 1.0f;
+    EXPECT_EQ(nullptr, lightBVH.Sample(Vector4::Zero(), VECTOR_Z, 0.5f, pdf));
+    EXPECT_EQ(0.0f, pdf);
+
+    pdf = 1.0f;
+    EXPECT_EQ(nullptr, lightBVH.SampleEmission(0.5f, pdf));
+    EXPECT_EQ(0.0f, pdf);
+}
+
+TEST(LightBVHTest, PdfConsistency)
+{
+    const uint32 numLights = 100;
+    const uint32 numQueries = 1000;
+
+    Random random;
+
+    Scene scene;
+    CreateRandomLights(scene, random, numLights, false);
+    scene.AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(Vector4(0.5f))));
+    ASSERT_TRUE(scene.BuildBVH());
+
+    const LightBVH& lightBVH = scene.GetLightBVH();
+    const auto& lights = scene.GetLights();
+    ASSERT_EQ(numLights + 1, lights.Size());
+    EXPECT_EQ(2 * numLights - 1, lightBVH.GetNumNodes());
+
+    // emission pick probabilities
+    {
+        float pdfSum = 0.0f;
+        for (const LightSceneObject* light : lights)
+        {
+            const float pdf = lightBVH.PdfEmission(light);
+            EXPECT_GE(pdf, 0.0f);
+            pdfSum += pdf;
+        }
+        EXPECT_NEAR(1.0f, pdfSum, 0.001f);
+
+        for (uint32 i = 0; i < numQueries; ++i)
+        {
+            float pdf = 0.0f;
+            const LightSceneObject* light = lightBVH.SampleEmission(random.GetFloat(), pdf);
+            ASSERT_NE(nullptr, light);
+            EXPECT_GT(pdf, 0.0f);
+            EXPECT_NEAR(lightBVH.PdfEmission(light), pdf, pdf * 0.001f);
+        }
+    }
+
+    // shading point dependent pick probabilities
+    // Note: spot and area lights can't illuminate all the points, so the light may not be picked at all
+    for (uint32 i = 0; i < numQueries; ++i)
+    {
+        const Vector4 position = random.GetVector4Bipolar() * 30.0f;
+        const Vector4 normal = (i % 4 == 0) ? Vector4::Zero() : random.GetVector4Bipolar().Normalized3();
+
+        float pdfSum = 0.0f;
+        for (const LightSceneObject* light : lights)
+        {
+            const float pdf = lightBVH.Pdf(position, normal, light);
+            EXPECT_GE(pdf, 0.0f);
+            pdfSum += pdf;
+        }
+        EXPECT_LE(pdfSum, 1.001f);
+
+        float pdf = 0.0f;
+        const LightSceneObject* light = lightBVH.Sample(position, normal, random.GetFloat(), pdf);
+        if (light)
+        {
+            EXPECT_GT(pdf, 0.0f);
+            EXPECT_NEAR(lightBVH.Pdf(position, normal, light), pdf, pdf * 0.001f);
+        }
+        else
+        {
+            EXPECT_EQ(0.0f, pdf);
+        }
+    }
+}
+
+TEST(LightBVHTest, PdfConsistency_PointLights)
+{
+    const uint32 numLights = 100;
+    const uint32 numQueries = 1000;
+
+    Random random;
+
+    Scene scene;
+    CreateRandomLights(scene, random, numLights, true);
+    ASSERT_TRUE(scene.BuildBVH());
+
+    const LightBVH& lightBVH = scene.GetLightBVH();
+    const auto& lights = scene.GetLights();
+
+    // point lights illuminate any point, so the pick probabilities must sum up to one
+    for (uint32 i = 0; i < numQueries; ++i)
+    {
+        const Vector4 position = random.GetVector4Bipolar() * 30.0f;
+        const Vector4 normal = (i % 4 == 0) ? Vector4::Zero() : random.GetVector4Bipolar().Normalized3();
+
+        float pdfSum = 0.0f;
+        for (const LightSceneObject* light : lights)
+        {
+            pdfSum += lightBVH.Pdf(position, normal, light);
+        }
+        EXPECT_NEAR(1.0f, pdfSum, 0.001f);
+
+        float pdf = 0.0f;
+        const LightSceneObject* light = lightBVH.Sample(position, normal, random.GetFloat(), pdf);
+        ASSERT_NE(nullptr, light);
+        EXPECT_NEAR(lightBVH.Pdf(position, normal, light), pdf, pdf * 0.001f);
+    }
+}
@@ -0,0 +1,28 @@
+#include "PCH.h"
+#include "../Core/Utils/Logger.h"
+
+#include <string>
+
+using namespace rt;
+
+
+TEST(UtilsTest, Logger_StandardError)
+{
+    // log must not be mixed with results written to the standard output (e.g. RenderCli statistics)
+    SetLogToStandardError(true);
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    RT_LOG_INFO("Logger test message %u", 42u);
+    const std::string stdoutString = testing::internal::GetCapturedStdout();
+    const std::string stderrString = testing::internal::GetCapturedStderr();
+    SetLogToStandardError(false);
+
+    EXPECT_TRUE(stdoutString.empty());
+    EXPECT_NE(std::string::npos, stderrString.find("[INFO] Logger test message 42"));
+
+    testing::internal::CaptureStdout();
+    RT_LOG_INFO("Logger test message %u", 43u);
+    const std::string defaultStdoutString = testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(std::string::npos, defaultStdoutString.find("[INFO] Logger test message 43"));
+}
@@ -2,6 +2,8 @@
 #include "../Core/Math/Distribution.h"
 #include "../Core/Math/Random.h"
 #include "../Core/Math/SamplingHelpers.h"
+#include "../Core/Containers/DynArray.h"
+#include "../Core/Utils/ThreadPool.h"
 
 #include "../Core/Utils/Bitmap.h"
 #include "../Core/Textures/BitmapTexture.h"
@@ -59,3 +61,210 @@ TEST(MathTest, Distribution_MultipleValues)
         EXPECT_LT(Abs(expected - counters[i]), 200);
     }
 }
+
+TEST(MathTest, Distribution_AliasTable)
+{
+    const uint32 pdfSize = 6;
+    const uint32 numIterations = 10000;
+
+    const float p[] = { 0.1f, 0.0f, 0.3f, 0.1f, 0.5f, 0.0f };
+    Distribution distr;
+    ASSERT_TRUE(distr.Initialize(p, pdfSize, true));
+
+    Random random;
+
+    int32 counters[pdfSize] = { 0,0,0,0 };
+
+    for (uint32 i = 0; i < numIterations; ++i)
+    {
+        float pdf = 0.0f;
+        uint32 sample = distr.SampleDiscrete(random.GetFloat(), pdf);
+        ASSERT_LT(sample, pdfSize);
+        EXPECT_NEAR(p[sample] * pdfSize, pdf, 0.0001f);
+
+        counters[sample]++;
+    }
+
+    for (uint32 i = 0; i < pdfSize; ++i)
+    {
+        int32 expected = (int32)(numIterations * p[i]);
+
+        EXPECT_LT(Abs(expected - counters[i]), 200);
+    }
+}
+
+TEST(MathTest, Distribution_Continuous)
+{
+    const uint32 pdfSize = 6;
+    const uint32 numIterations = 10000;
+
+    const float p[] = { 0.0f, 0.2f, 0.3f, 0.0f, 0.5f, 0.0f };
+
+    for (const bool useAliasTable : { false, true })
+    {
+        SCOPED_TRACE(useAliasTable ? "Alias table" : "Binary search");
+
+        Distribution distr;
+        ASSERT_TRUE(distr.Initialize(p, pdfSize, useAliasTable));
+
+        Random random;
+
+        for (uint32 i = 0; i < numIterations; ++i)
+        {
+            float pdf = 0.0f;
+            uint32 offset = 0;
+            const float value = distr.SampleContinuous(random.GetFloat(), pdf, offset);
+            ASSERT_LT(offset, pdfSize);
+            EXPECT_GT(p[offset], 0.0f);
+            EXPECT_NEAR(p[offset] * pdfSize, pdf, 0.0001f);
+
+            // sampled value must lie within the sampled bucket
+            EXPECT_GE(value, static_cast<float>(offset) / pdfSize);
+            EXPECT_LE(value, static_cast<float>(offset + 1) / pdfSize);
+        }
+    }
+}
+
+TEST(MathTest, Distribution2D)
+{
+    const uint32 width = 37;
+    const uint32 height = 23;
+    const uint32 numIterations = 100000;
+
+    Random random;
+
+    // random function with some empty rows and columns
+    DynArray<float> values;
+    values.Resize(width * height);
+    float sum = 0.0f;
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            const bool isEmpty = (y % 5 == 1) || (x % 7 == 3);
+            const float value = isEmpty ? 0.0f : random.GetFloat();
+            values[width * y + x] = value;
+            sum += value;
+        }
+    }
+
+    ThreadPool threadPool;
+
+    for (const bool useAliasTables : { false, true })
+    {
+        SCOPED_TRACE(useAliasTables ? "Alias tables" : "Binary search");
+
+        Distribution2D distr;
+        ASSERT_TRUE(distr.Initialize(values.Data(), width, height, useAliasTables, &threadPool));
+
+        DynArray<uint32> counters;
+        counters.Resize(width * height, 0);
+
+        for (uint32 i = 0; i < numIterations; ++i)
+        {
+            float pdf = 0.0f;
+            const Float2 coords = distr.Sample(random.GetFloat2(), pdf);
+            ASSERT_GE(coords.x, 0.0f);
+            ASSERT_GE(coords.y, 0.0f);
+            ASSERT_LT(coords.x, 1.0f);
+            ASSERT_LT(coords.y, 1.0f);
+
+            const uint32 x = static_cast<uint32>(coords.x * width);
+            const uint32 y = static_cast<uint32>(coords.y * height);
+            const float expectedPdf = values[width * y + x] * (width * height) / sum;
+            EXPECT_NEAR(expectedPdf, pdf, expectedPdf * 0.001f);
+            EXPECT_NEAR(pdf, distr.Pdf(coords), pdf * 0.001f);
+
+            counters[width * y + x]++;
+        }
+
+        for (uint32 i = 0; i < width * height; ++i)
+        {
+            const float expected = numIterations * values[i] / sum;
+            EXPECT_LT(Abs(expected - static_cast<float>(counters[i])), 5.0f * sqrtf(expected) + 1.0f);
+        }
+    }
+}
+
+TEST(MathTest, BitmapTexture_LatLongSampling)
+{
+    const uint32 width = 64;
+    const uint32 height = 32;
+    const uint32 numIterations = 1000000;
+
+    // dim environment map with a bright spot
+    DynArray<Float3> pixels;
+    pixels.Resize(width * height, Float3(0.1f, 0.2f, 0.3f));
+    pixels[width * 10 + 20] = Float3(1000.0f);
+
+    auto bitmap = std::make_shared<Bitmap>();
+    ASSERT_TRUE(bitmap->Init({ width, height, Bitmap::Format::R32G32B32_Float, pixels.Data() }));
+
+    BitmapTexture texture(bitmap);
+
+    TextureSamplingDesc desc;
+    desc.latLongMapping = true;
+    desc.coverFilteredTexels = true;
+    ASSERT_TRUE(texture.MakeSamplable(desc));
+    ASSERT_TRUE(texture.IsSamplable());
+
+    Random random;
+
+    // Monte Carlo estimate of the texture area
+    float area = 0.0f;
+    uint32 numSamplesInSpot = 0;
+
+    for (uint32 i = 0; i < numIterations; ++i)
+    {
+        Vector4 coords;
+        float pdf = 0.0f;
+        texture.Sample(random.GetFloat2(), coords, &pdf);
+        ASSERT_GT(pdf, 0.0f);
+        EXPECT_NEAR(pdf, texture.Pdf(coords), pdf * 0.001f);
+
+        area += 1.0f / pdf;
+
+        // cells around the bright texel
+        const uint32 x = static_cast<uint32>(coords.x * width);
+        const uint32 y = static_cast<uint32>(coords.y * height);
+        if (x >= 19 && x <= 20 && y >= 9 && y <= 10)
+        {
+            numSamplesInSpot++;
+        }
+    }
+
+    EXPECT_NEAR(1.0f, area / numIterations, 0.02f);
+    EXPECT_GT(numSamplesInSpot, numIterations / 2);
+}
+
+TEST(MathTest, BitmapTexture_MaskSampling)
+{
+    const uint32 width = 16;
+    const uint32 height = 8;
+    const uint32 numIterations = 10000;
+
+    // single-texel mask (e.g. bokeh shape)
+    DynArray<Float3> pixels;
+    pixels.Resize(width * height, Float3(0.0f));
+    pixels[width * 3 + 5] = Float3(1.0f);
+
+    auto bitmap = std::make_shared<Bitmap>();
+    ASSERT_TRUE(bitmap->Init({ width, height, Bitmap::Format::R32G32B32_Float, pixels.Data() }));
+
+    BitmapTexture texture(bitmap);
+    ASSERT_TRUE(texture.MakeSamplable(TextureSamplingDesc()));
+
+    Random random;
+
+    // by default texels are not dilated, so samples never fall outside of the mask
+    for (uint32 i = 0; i < numIterations; ++i)
+    {
+        Vector4 coords;
+        float pdf = 0.0f;
+        texture.Sample(random.GetFloat2(), coords, &pdf);
+
+        EXPECT_EQ(5u, static_cast<uint32>(coords.x * width));
+        EXPECT_EQ(3u, static_cast<uint32>(coords.y * height));
+        EXPECT_NEAR(static_cast<float>(width * height), pdf, 0.01f);
+    }
+}
@@ -111,6 +111,13 @@ TEST(MathTest, FastExp_4)
     TestTranscendental("FastExp_4", range, func, expf, 1.0f, 2.0e-2f);
 }
 
+TEST(MathTest, FastExp_8)
+{
+    const auto func = [](float x) { return math::FastExp(math::Vector8(x))[0]; };
+    const TestRange range(-40.0f, 5.0f, 0.01f, TestRange::StepType::Increment);
+    TestTranscendental("FastExp_8", range, func, expf, 1.0f, 2.0e-2f);
+}
+
 TEST(MathTest, Log)
 {
     const TestRange range(0.0001f, 1.0e+30f, 1.5f, TestRange::StepType::Multiply);
@@ -131,4 +138,11 @@ TEST(MathTest, FastLog_4)
     TestTranscendental("FastLog_4", range, func, logf, 1.0f, 1.0e-4f);
 }
 
+TEST(MathTest, FastLog_8)
+{
+    const auto func = [](float x) { return math::FastLog(math::Vector8(x))[0]; };
+    TestRange range(0.0001f, 1.0e+30f, 1.5f, TestRange::StepType::Multiply);
+    TestTranscendental("FastLog_8", range, func, logf, 1.0f, 1.0e-4f);
+}
+
 // TODO atan2
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "PCH.h"
+#include "../Core/Utils/Profiler.h"
+#include "../Core/Utils/ThreadPool.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace rt;
+
+namespace {
+
+const ProfilerResult* FindResult(const DynArray<ProfilerResult>& results, const char* scopeName)
+{
+    for (const ProfilerResult& result : results)
+    {
+        if (strcmp(result.scopeName, scopeName) == 0)
+        {
+            return &result;
+        }
+    }
+    return nullptr;
+}
+
+uint32 CountOccurrences(const std::string& str, const std::string& pattern)
+{
+    uint32 count = 0;
+    for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + pattern.size()))
+    {
+        count++;
+    }
+    return count;
+}
+
+std::string ReadFile(const char* path)
+{
+    std::ifstream file(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+}
+
+RT_FORCE_NOINLINE void TimedFunction(uint32 numIterations)
+{
+    RT_SCOPED_TIMER(ProfilerTest_Timer);
+
+    volatile uint32 sum = 0;
+    for (uint32 i = 0; i < numIterations; ++i)
+    {
+        sum += i;
+    }
+}
+
+RT_FORCE_NOINLINE void TracedFunction()
+{
+    RT_SCOPED_TRACE(ProfilerTest_Trace);
+}
+
+} // namespace
+
+
+TEST(UtilsTest, Profiler_AggregateAcrossThreads)
+{
+    const uint32 numTasks = 1000;
+
+    Profiler::GetInstance().ResetAll();
+
+    ThreadPool pool;
+    pool.SetNumThreads(4);
+    pool.RunParallelTask([](uint32 taskID, uint32) { TimedFunction(100 * (taskID % 10 + 1)); }, numTasks);
+
+    DynArray<ProfilerResult> results;
+    Profiler::GetInstance().Collect(results);
+
+    const ProfilerResult* result = FindResult(results, "ProfilerTest_Timer");
+    ASSERT_NE(nullptr, result);
+    EXPECT_EQ(numTasks, result->count);
+    EXPECT_GT(result->minTime, 0.0);
+    EXPECT_LE(result->minTime, result->avgTime);
+    EXPECT_LE(result->avgTime, result->maxTime);
+}
+
+TEST(UtilsTest, Profiler_CollectAndResetWhileSampling)
+{
+    const uint32 numTasks = 1000;
+
+    std::atomic<bool> finished(false);
+    std::thread collector([&finished]()
+    {
+        DynArray<ProfilerResult> results;
+        while (!finished.load(std::memory_order_relaxed))
+        {
+            Profiler::GetInstance().Collect(results);
+            for (const ProfilerResult& result : results)
+            {
+                if (result.count > 0)
+                {
+                    EXPECT_LE(result.minTime, result.maxTime);
+                }
+            }
+            Profiler::GetInstance().ResetAll();
+        }
+    });
+
+    ThreadPool pool;
+    pool.SetNumThreads(4);
+    pool.RunParallelTask([](uint32, uint32) { TimedFunction(100); }, numTasks);
+
+    finished = true;
+    collector.join();
+
+    // a reset requested by another thread must not lose samples recorded afterwards
+    Profiler::GetInstance().ResetAll();
+    pool.RunParallelTask([](uint32, uint32) { TimedFunction(100); }, numTasks);
+
+    DynArray<ProfilerResult> results;
+    Profiler::GetInstance().Collect(results);
+
+    const ProfilerResult* result = FindResult(results, "ProfilerTest_Timer");
+    ASSERT_NE(nullptr, result);
+    EXPECT_EQ(numTasks, result->count);
+}
+
+TEST(UtilsTest, Profiler_Disabled)
+{
+    Profiler::GetInstance().ResetAll();
+
+    TimedFunction(10);
+
+    Profiler::SetEnabled(false);
+    TimedFunction(10);
+    Profiler::SetEnabled(true);
+
+    DynArray<ProfilerResult> results;
+    Profiler::GetInstance().Collect(results);
+
+    const ProfilerResult* result = FindResult(results, "ProfilerTest_Timer");
+    ASSERT_NE(nullptr, result);
+    EXPECT_EQ(1u, result->count);
+}
+
+TEST(UtilsTest, Profiler_ExportTrace)
+{
+    const char* path = "profiler_test_trace.json";
+    const uint32 numEvents = 100;
+
+    Profiler::GetInstance().ResetAll();
+
+    for (uint32 i = 0; i < numEvents; ++i)
+    {
+        TracedFunction();
+    }
+
+    // aggregate-only timers must not appear in the trace
+    TimedFunction(10);
+
+    ASSERT_TRUE(Profiler::GetInstance().ExportTrace(path));
+
+    const std::string trace = ReadFile(path);
+    remove(path);
+
+    EXPECT_EQ(1u, CountOccurrences(trace, "\"traceEvents\""));
+    EXPECT_EQ(numEvents, CountOccurrences(trace, "\"name\":\"ProfilerTest_Trace\",\"ph\":\"X\""));
+    EXPECT_EQ(0u, CountOccurrences(trace, "ProfilerTest_Timer"));
+}
+
+TEST(UtilsTest, Profiler_ExportTrace_EscapeThreadName)
+{
+    const char* path = "profiler_test_trace.json";
+
+    Profiler::GetInstance().ResetAll();
+
+    std::thread thread([]()
+    {
+        Profiler::GetInstance().SetCurrentThreadName("Thread \"quoted\" \\ name\n");
+        TracedFunction();
+    });
+    thread.join();
+
+    ASSERT_TRUE(Profiler::GetInstance().ExportTrace(path));
+
+    const std::string trace = ReadFile(path);
+    remove(path);
+
+    EXPECT_EQ(1u, CountOccurrences(trace, "\"args\":{\"name\":\"Thread \\\"quoted\\\" \\\\ name\\u000a\"}"));
+}
+
+TEST(UtilsTest, Profiler_ExportTrace_Overflow)
+{
+    const char* path = "profiler_test_trace.json";
+    const uint32 maxEvents = 16384;
+
+    Profiler::GetInstance().ResetAll();
+
+    // only the most recent events are kept
+    for (uint32 i = 0; i < maxEvents + 1000; ++i)
+    {
+        TracedFunction();
+    }
+
+    ASSERT_TRUE(Profiler::GetInstance().ExportTrace(path));
+
+    const std::string trace = ReadFile(path);
+    remove(path);
+
+    // the oldest event in the buffer may be skipped, because it could be overwritten during the export
+    const uint32 numExportedEvents = CountOccurrences(trace, "\"name\":\"ProfilerTest_Trace\",\"ph\":\"X\"");
+    EXPECT_GE(numExportedEvents, maxEvents - 1);
+    EXPECT_LE(numExportedEvents, maxEvents);
+}
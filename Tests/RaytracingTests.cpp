@@ -5,11 +5,18 @@
 #include "../Core/Material/Material.h"
 #include "../Core/Rendering/Viewport.h"
 #include "../Core/Rendering/PathTracer.h"
+#include "../Core/Rendering/VertexConnectionAndMerging.h"
 #include "../Core/Scene/Light/BackgroundLight.h"
+#include "../Core/Scene/Light/PointLight.h"
+#include "../Core/Scene/Light/SpotLight.h"
+#include "../Core/Scene/Light/AreaLight.h"
 #include "../Core/Scene/Object/SceneObject_Shape.h"
 #include "../Core/Scene/Object/SceneObject_Light.h"
 #include "../Core/Shapes/SphereShape.h"
 #include "../Core/Shapes/MeshShape.h"
+#include "../Core/Shapes/RectShape.h"
+#include "../Core/Textures/BitmapTexture.h"
+#include "../Core/Traversal/Intersection.h"
 
 using namespace rt;
 using namespace math;
@@ -365,6 +372,495 @@ TEST_F(RenderingTest, FurnaceTest_Diffuse)
     }
 }
 
+TEST_F(RenderingTest, FurnaceTest_Diffuse_Packet)
+{
+    const Vector4 materialColor(0.4f, 0.6f, 0.8f);
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = materialColor;
+    material->Compile();
+
+    const Vector4 lightColor(1.0f, 2.0f, 3.0f);
+    auto backgroundLight = std::make_unique<BackgroundLight>(lightColor);
+    auto lightObject = std::make_unique<LightSceneObject>(std::move(backgroundLight));
+    mScene->AddObject(std::move(lightObject));
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    RenderingParams params;
+    params.traversalMode = TraversalMode::Packet;
+    mViewport->SetRenderingParams(params);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    // wavefront path tracing
+    RendererPtr renderer = CreateRenderer("Path Tracer", *mScene);
+    mViewport->SetRenderer(renderer);
+    mViewport->Reset();
+
+    uint32 numPasses = 100;
+
+    for (uint32 i = 0; i < numPasses; ++i)
+    {
+        mViewport->Render(camera);
+    }
+
+    Bitmap bitmap = mViewport->GetSumBuffer();
+    bitmap.Scale(Vector4(1.0f / numPasses));
+
+    ValidateBitmap(bitmap, lightColor * materialColor, 0.05f);
+
+    bitmap.SaveEXR((g_ouputFilePrefix + "FurnaceTest_Diffuse_Packet.exr").c_str());
+}
+
+TEST_F(RenderingTest, FurnaceTest_Diffuse_VCM_MultipleSamplesPerPass)
+{
+    const Vector4 materialColor(0.4f, 0.6f, 0.8f);
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = materialColor;
+    material->Compile();
+
+    const Vector4 lightColor(1.0f, 2.0f, 3.0f);
+    auto backgroundLight = std::make_unique<BackgroundLight>(lightColor);
+    auto lightObject = std::make_unique<LightSceneObject>(std::move(backgroundLight));
+    mScene->AddObject(std::move(lightObject));
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    const uint32 samplesPerPixel = 4;
+    const uint32 numPasses = 50;
+
+    RenderingParams params;
+    params.samplesPerPixel = samplesPerPixel;
+    mViewport->SetRenderingParams(params);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    RendererPtr renderer = CreateRenderer("VCM", *mScene);
+    mViewport->SetRenderer(renderer);
+    mViewport->Reset();
+
+    for (uint32 i = 0; i < numPasses; ++i)
+    {
+        mViewport->Render(camera);
+    }
+
+    Bitmap bitmap = mViewport->GetSumBuffer();
+    bitmap.Scale(Vector4(1.0f / (numPasses * samplesPerPixel)));
+
+    ValidateBitmap(bitmap, lightColor * materialColor, 0.05f);
+
+    bitmap.SaveEXR((g_ouputFilePrefix + "FurnaceTest_Diffuse_VCM_MultipleSamplesPerPass.exr").c_str());
+}
+
+TEST_F(RenderingTest, VCM_MultipleSamplesPerPass_Merging)
+{
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = Vector4(0.8f);
+    material->Compile();
+
+    // point light placed right behind the camera, so the sphere is densely covered with photons
+    auto lightObject = std::make_unique<LightSceneObject>(std::make_unique<PointLight>(Vector4(50.0f)));
+    lightObject->SetTransform(Transform(Vector4(0.0f, 0.0f, -4.0f)).ToMatrix4());
+    mScene->AddObject(std::move(lightObject));
+
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::make_unique<SphereShape>(1.0f));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    const uint32 numSamples = 256;
+
+    // Note: big merging radius makes vertex merging the dominant strategy,
+    // so wrong normalization of merged photons can't be hidden by MIS weights
+    float averageBrightness[2];
+    const uint32 samplesPerPixel[2] = { 1, 4 };
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        RenderingParams params;
+        params.samplesPerPixel = samplesPerPixel[i];
+        mViewport->SetRenderingParams(params);
+
+        RendererPtr renderer = CreateRenderer("VCM", *mScene);
+        VertexConnectionAndMerging* vcm = static_cast<VertexConnectionAndMerging*>(renderer.get());
+        vcm->mInitialMergingRadius = 0.2f;
+        vcm->mMinMergingRadius = 0.2f;
+        mViewport->SetRenderer(renderer);
+        mViewport->Reset();
+
+        const uint32 numPasses = numSamples / samplesPerPixel[i];
+        for (uint32 j = 0; j < numPasses; ++j)
+        {
+            mViewport->Render(camera);
+        }
+
+        const Bitmap& sum = mViewport->GetSumBuffer();
+
+        float brightness = 0.0f;
+        for (uint32 y = 0; y < sum.GetHeight(); ++y)
+        {
+            for (uint32 x = 0; x < sum.GetWidth(); ++x)
+            {
+                brightness += sum.GetPixel(x, y).x;
+            }
+        }
+        averageBrightness[i] = brightness / static_cast<float>(numSamples * sum.GetWidth() * sum.GetHeight());
+    }
+
+    ASSERT_GT(averageBrightness[0], 0.0f);
+    EXPECT_NEAR(1.0f, averageBrightness[1] / averageBrightness[0], 0.25f);
+}
+
+TEST_F(RenderingTest, FurnaceTest_Diffuse_AllLights)
+{
+    const Vector4 materialColor(0.4f, 0.6f, 0.8f);
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = materialColor;
+    material->Compile();
+
+    // more lights than a single SIMD group of shadow rays
+    const uint32 numLights = 9;
+    const Vector4 lightColor(1.0f, 2.0f, 3.0f);
+    for (uint32 i = 0; i < numLights; ++i)
+    {
+        auto backgroundLight = std::make_unique<BackgroundLight>(lightColor / static_cast<float>(numLights));
+        mScene->AddObject(std::make_unique<LightSceneObject>(std::move(backgroundLight)));
+    }
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    RenderingParams params;
+    params.lightSamplingStrategy = LightSamplingStrategy::All;
+    mViewport->SetRenderingParams(params);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    // shadow rays of all the lights are traced in SIMD groups
+    RendererPtr renderer = CreateRenderer("Path Tracer MIS", *mScene);
+    mViewport->SetRenderer(renderer);
+    mViewport->Reset();
+
+    uint32 numPasses = 100;
+
+    for (uint32 i = 0; i < numPasses; ++i)
+    {
+        mViewport->Render(camera);
+    }
+
+    Bitmap bitmap = mViewport->GetSumBuffer();
+    bitmap.Scale(Vector4(1.0f / numPasses));
+
+    ValidateBitmap(bitmap, lightColor * materialColor, 0.05f);
+
+    bitmap.SaveEXR((g_ouputFilePrefix + "FurnaceTest_Diffuse_AllLights.exr").c_str());
+}
+
+TEST_F(RenderingTest, FurnaceTest_Diffuse_LightBVH)
+{
+    const Vector4 materialColor(0.4f, 0.6f, 0.8f);
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = materialColor;
+    material->Compile();
+
+    // two background lights (picked uniformly, they are not stored in the light tree)
+    const Vector4 lightColor(1.0f, 2.0f, 3.0f);
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(lightColor * 0.75f)));
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(lightColor * 0.25f)));
+
+    // spot lights facing away from the sphere and the camera, so the light tree is built,
+    // but all of its lights have zero importance and the expected result doesn't change
+    for (const float x : { -2.0f, 2.0f })
+    {
+        auto lightObject = std::make_unique<LightSceneObject>(std::make_unique<SpotLight>(Vector4(10.0f), DegToRad(30.0f)));
+        lightObject->SetTransform(Transform(Vector4(x, 0.0f, 10.0f)).ToMatrix4());
+        mScene->AddObject(std::move(lightObject));
+    }
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    RenderingParams params;
+    params.lightSamplingStrategy = LightSamplingStrategy::LightBVH;
+    mViewport->SetRenderingParams(params);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    uint32 numPasses = 200;
+
+    for (const char* rendererName : { "Path Tracer MIS", "VCM" })
+    {
+        SCOPED_TRACE(rendererName);
+
+        RendererPtr renderer = CreateRenderer(rendererName, *mScene);
+        mViewport->SetRenderer(renderer);
+        mViewport->Reset();
+
+        for (uint32 i = 0; i < numPasses; ++i)
+        {
+            mViewport->Render(camera);
+        }
+
+        Bitmap bitmap = mViewport->GetSumBuffer();
+        bitmap.Scale(Vector4(1.0f / numPasses));
+
+        ValidateBitmap(bitmap, lightColor * materialColor, 0.05f);
+    }
+}
+
+TEST_F(RenderingTest, LightBVH_FiniteLights)
+{
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = Vector4(0.8f);
+    material->Compile();
+
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::make_unique<SphereShape>(1.0f));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    // point lights of different power
+    const Vector4 pointLightPositions[] = { Vector4(-2.0f, 1.0f, -2.0f), Vector4(2.0f, -1.0f, -2.0f), Vector4(0.0f, 0.0f, -20.0f), Vector4(0.0f, 0.0f, 3.0f) };
+    const Vector4 pointLightColors[] = { Vector4(1.0f, 2.0f, 3.0f), Vector4(3.0f, 2.0f, 1.0f), Vector4(100.0f), Vector4(50.0f) };
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        auto lightObject = std::make_unique<LightSceneObject>(std::make_unique<PointLight>(pointLightColors[i]));
+        lightObject->SetTransform(Transform(pointLightPositions[i]).ToMatrix4());
+        mScene->AddObject(std::move(lightObject));
+    }
+
+    // area light above the sphere, facing down
+    {
+        auto lightObject = std::make_unique<LightSceneObject>(std::make_unique<AreaLight>(std::make_shared<RectShape>(Float2(0.5f)), Vector4(2.0f)));
+        lightObject->SetTransform(Transform(Vector4(0.0f, 2.0f, -1.0f), Quaternion::FromAxisAndAngle(VECTOR_X, RT_PI / 2.0f)).ToMatrix4());
+        mScene->AddObject(std::move(lightObject));
+    }
+
+    mScene->BuildBVH();
+    ASSERT_LT(0u, mScene->GetLightBVH().GetNumNodes());
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(40.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    const uint32 numPasses = 200;
+
+    // light BVH only changes the light pick probabilities, so the result must match uniform picking
+    Vector4 averageColor[2];
+    const LightSamplingStrategy strategies[2] = { LightSamplingStrategy::Single, LightSamplingStrategy::LightBVH };
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        RenderingParams params;
+        params.lightSamplingStrategy = strategies[i];
+        mViewport->SetRenderingParams(params);
+
+        RendererPtr renderer = CreateRenderer("Path Tracer MIS", *mScene);
+        mViewport->SetRenderer(renderer);
+        mViewport->Reset();
+
+        for (uint32 j = 0; j < numPasses; ++j)
+        {
+            mViewport->Render(camera);
+        }
+
+        const Bitmap& sum = mViewport->GetSumBuffer();
+
+        averageColor[i] = Vector4::Zero();
+        for (uint32 y = 0; y < sum.GetHeight(); ++y)
+        {
+            for (uint32 x = 0; x < sum.GetWidth(); ++x)
+            {
+                averageColor[i] += sum.GetPixel(x, y);
+            }
+        }
+        averageColor[i] /= static_cast<float>(numPasses * sum.GetWidth() * sum.GetHeight());
+    }
+
+    ASSERT_GT(averageColor[0].x, 0.0f);
+    EXPECT_NEAR(averageColor[0].x, averageColor[1].x, 0.03f * averageColor[0].x);
+    EXPECT_NEAR(averageColor[0].y, averageColor[1].y, 0.03f * averageColor[0].y);
+    EXPECT_NEAR(averageColor[0].z, averageColor[1].z, 0.03f * averageColor[0].z);
+}
+
+TEST(LightTest, BackgroundLight_ImportanceSampling)
+{
+    const uint32 mapWidth = 64;
+    const uint32 mapHeight = 32;
+    const uint32 numSamples = 1000000;
+
+    // dim environment map with a bright spot
+    DynArray<Float3> pixels;
+    pixels.Resize(mapWidth * mapHeight, Float3(0.1f, 0.2f, 0.3f));
+    pixels[mapWidth * 8 + 40] = Float3(1000.0f);
+
+    auto envBitmap = std::make_shared<Bitmap>();
+    ASSERT_TRUE(envBitmap->Init({ mapWidth, mapHeight, Bitmap::Format::R32G32B32_Float, pixels.Data() }));
+
+    BackgroundLight light(Vector4(1.0f));
+    light.mTexture = std::make_shared<BitmapTexture>(envBitmap);
+    ASSERT_TRUE(light.MakeSamplable());
+
+    RenderingContext context;
+    context.wavelength.value = Wavelength::ValueType(0.5f);
+
+    IntersectionData intersection;
+    intersection.frame = Matrix4::Identity();
+
+    Random random;
+
+    float sumInvPdf = 0.0f;
+    uint32 numPdfMismatches = 0;
+
+    for (uint32 i = 0; i < numSamples; ++i)
+    {
+        const ILight::IlluminateParam illuminateParam =
+        {
+            Matrix4::Identity(),
+            Matrix4::Identity(),
+            intersection,
+            context.wavelength,
+            random.GetFloat3(),
+        };
+
+        ILight::IlluminateResult illuminateResult;
+        const RayColor color = light.Illuminate(illuminateParam, illuminateResult);
+        ASSERT_TRUE(color.IsValid());
+
+        // directions exactly at the poles can't be sampled (the sample is rejected)
+        if (illuminateResult.directPdfW == 0.0f)
+        {
+            EXPECT_TRUE(color.AlmostZero());
+            continue;
+        }
+
+        sumInvPdf += 1.0f / illuminateResult.directPdfW;
+
+        // hitting the background in sampled direction must result in the same pdf
+        const Ray ray(Vector4::Zero(), illuminateResult.directionToLight);
+        const ILight::RadianceParam radianceParam = { context, ray };
+
+        float directPdf = 0.0f;
+        float emissionPdf = 0.0f;
+        light.GetRadiance(radianceParam, &directPdf, &emissionPdf);
+
+        // Note: directions near importance map cells boundaries may be mapped to a neighbour cell due to rounding
+        if (Abs(directPdf - illuminateResult.directPdfW) > 0.01f * directPdf ||
+            Abs(emissionPdf - illuminateResult.emissionPdfW) > 0.01f * emissionPdf)
+        {
+            numPdfMismatches++;
+        }
+    }
+
+    // integral of constant function over the sphere
+    EXPECT_NEAR(4.0f * RT_PI, sumInvPdf / numSamples, 0.2f);
+    EXPECT_LT(numPdfMismatches, numSamples / 100);
+}
+
+TEST_F(RenderingTest, FurnaceTest_Diffuse_EnvironmentMap)
+{
+    const Vector4 materialColor(0.4f, 0.6f, 0.8f);
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = materialColor;
+    material->Compile();
+
+    // constant environment map, so the result is known, but the light is importance sampled
+    const uint32 mapWidth = 32;
+    const uint32 mapHeight = 16;
+    DynArray<Float3> pixels;
+    pixels.Resize(mapWidth * mapHeight, Float3(1.0f, 2.0f, 3.0f));
+
+    auto envBitmap = std::make_shared<Bitmap>();
+    ASSERT_TRUE(envBitmap->Init({ mapWidth, mapHeight, Bitmap::Format::R32G32B32_Float, pixels.Data() }));
+
+    const Vector4 lightColor(0.5f, 0.5f, 0.5f);
+    auto backgroundLight = std::make_unique<BackgroundLight>(lightColor);
+    backgroundLight->mTexture = std::make_shared<BitmapTexture>(envBitmap);
+    ASSERT_TRUE(backgroundLight->MakeSamplable(true));
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::move(backgroundLight)));
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    uint32 numPasses = 100;
+
+    for (const char* rendererName : { "Path Tracer MIS", "VCM" })
+    {
+        SCOPED_TRACE(rendererName);
+
+        RendererPtr renderer = CreateRenderer(rendererName, *mScene);
+        mViewport->SetRenderer(renderer);
+        mViewport->Reset();
+
+        for (uint32 i = 0; i < numPasses; ++i)
+        {
+            mViewport->Render(camera);
+        }
+
+        Bitmap bitmap = mViewport->GetSumBuffer();
+        bitmap.Scale(Vector4(1.0f / numPasses));
+
+        ValidateBitmap(bitmap, Vector4(0.5f, 1.0f, 1.5f) * materialColor, 0.05f);
+    }
+}
+
 TEST_F(RenderingTest, FurnaceTest_Emissive)
 {
     const Vector4 emissionColor(3.0f, 2.0f, 1.0f);
@@ -522,4 +1018,425 @@ TEST_F(RenderingTest, FurnaceTest_Dielectric)
     }
 }
 
+TEST_F(RenderingTest, AdaptiveRendering_ConvergedBlocksKeepBrightness)
+{
+    const uint32 width = 40;
+    const uint32 height = 24;
+
+    // uniform background only, so the whole image converges right after the initial passes
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(Vector4(0.2f, 0.3f, 0.4f))));
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    RenderingParams renderingParams;
+    renderingParams.adaptiveSettings.enable = true;
+    renderingParams.adaptiveSettings.numInitialPasses = 2;
+    renderingParams.adaptiveSettings.maxBlockSize = 16;
+
+    PostprocessParams postprocessParams;
+    postprocessParams.ditheringStrength = 0.0f;
+    postprocessParams.bloomFactor = 0.0f;
+
+    mViewport->Resize(width, height);
+    mViewport->SetRenderingParams(renderingParams);
+    mViewport->SetPostprocessParams(postprocessParams);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+    mViewport->Reset();
+
+    for (uint32 i = 0; i < 2; ++i)
+    {
+        ASSERT_TRUE(mViewport->Render(camera));
+    }
+    ASSERT_EQ(0u, mViewport->GetProgress().activePixels);
+
+    const uint32 expectedColor = mViewport->GetFrontBuffer().GetPixelRef<uint32>(0, 0);
+
+    // no pixels are rendered anymore, the image must not get darker
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(mViewport->Render(camera));
+    }
+    mViewport->UpdateFrontBuffer();
+
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            EXPECT_EQ(expectedColor, mViewport->GetFrontBuffer().GetPixelRef<uint32>(x, y)) << "x=" << x << ", y=" << y;
+        }
+    }
+}
+
+TEST_F(RenderingTest, MultipleSamplesPerPass)
+{
+    const uint32 width = 40;
+    const uint32 height = 24;
+    const Vector4 backgroundColor(0.25f, 0.5f, 1.0f);
+
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(backgroundColor)));
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    mViewport->Resize(width, height);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+
+    for (const TraversalMode traversalMode : { TraversalMode::Single, TraversalMode::Packet })
+    {
+        for (const bool depthOfField : { false, true })
+        {
+            camera.mDOF.enable = depthOfField;
+
+            RenderingParams params;
+            params.samplesPerPixel = 5;
+            params.traversalMode = traversalMode;
+            params.tileSize = 8;
+            mViewport->SetRenderingParams(params);
+            mViewport->Reset();
+
+            ASSERT_TRUE(mViewport->Render(camera));
+            ASSERT_TRUE(mViewport->Render(camera));
+            EXPECT_EQ(2u, mViewport->GetProgress().passesFinished);
+
+            // every pixel must receive all the samples
+            for (uint32 y = 0; y < height; ++y)
+            {
+                for (uint32 x = 0; x < width; ++x)
+                {
+                    const Vector4 pixel(mViewport->GetSumBuffer().GetPixelRef<Float3>(x, y));
+                    EXPECT_TRUE(Vector4::AlmostEqual(backgroundColor * 10.0f, pixel)) << "x=" << x << ", y=" << y;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(RenderingTest, IntersectionCounters)
+{
+    const uint32 numPixels = ViewportSize * ViewportSize;
+
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(Vector4(1.0f))));
+
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = Vector4(0.5f);
+    material->Compile();
+
+    for (uint32 i = 0; i < 4; ++i)
+    {
+        ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::make_unique<SphereShape>(0.2f));
+        sceneObject->SetDefaultMaterial(material);
+        sceneObject->SetTransform(Matrix4::MakeTranslation(Vector4(0.5f * static_cast<float>(i) - 0.75f, 0.0f, 0.0f)));
+        mScene->AddObject(std::move(sceneObject));
+    }
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(60.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+
+    for (const TraversalMode traversalMode : { TraversalMode::Single, TraversalMode::Packet })
+    {
+        RenderingParams params;
+        params.traversalMode = traversalMode;
+
+        // counters are not collected by default
+        mViewport->SetRenderingParams(params);
+        mViewport->Reset();
+        ASSERT_TRUE(mViewport->Render(camera));
+        EXPECT_EQ(numPixels, mViewport->GetCounters().numPrimaryRays);
+        EXPECT_GT(mViewport->GetStats().primaryRaysPerSecond, 0.0);
+#ifdef RT_ENABLE_INTERSECTION_COUNTERS
+        EXPECT_EQ(0u, mViewport->GetCounters().numTraversedRays);
+        EXPECT_EQ(0u, mViewport->GetCounters().numRayBoxTests);
+
+        params.enableIntersectionCounters = true;
+        mViewport->SetRenderingParams(params);
+        mViewport->Reset();
+        ASSERT_TRUE(mViewport->Render(camera));
+
+        const RayTracingCounters& counters = mViewport->GetCounters();
+        const RayTracingStats& stats = mViewport->GetStats();
+        EXPECT_GE(counters.numTraversedRays, numPixels);
+        EXPECT_GT(counters.numRayBoxTests, 0u);
+        EXPECT_LE(counters.numPassedRayBoxTests, counters.numRayBoxTests);
+        EXPECT_GT(stats.nodesPerRay, 0.0);
+        EXPECT_GT(stats.traversedRaysPerSecond, 0.0);
+
+        if (traversalMode == TraversalMode::Packet)
+        {
+            EXPECT_GT(stats.packetUtilization, 0.0);
+            EXPECT_LE(stats.packetUtilization, 1.0);
+        }
+        else
+        {
+            EXPECT_EQ(0u, counters.numPacketLanes);
+        }
+#endif // RT_ENABLE_INTERSECTION_COUNTERS
+    }
+}
+
+TEST_F(RenderingTest, PostProcess_Simd)
+{
+    // width is not a multiple of 8, so the per-pixel path is also used at the end of each row
+    const uint32 width = 37;
+    const uint32 height = 21;
+
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = Vector4(0.4f, 0.6f, 0.8f);
+    material->Compile();
+
+    ShapePtr shape = std::make_unique<SphereShape>(1.0f);
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::move(shape));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(Vector4(1.0f, 2.0f, 3.0f))));
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    mViewport->Resize(width, height);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+    mViewport->Reset();
+    mViewport->Render(camera);
+
+    PostprocessParams params;
+    params.ditheringStrength = 0.0f;
+    params.bloomFactor = 0.2f;
+
+    DynArray<uint32> referencePixels;
+    params.useSimd = false;
+    mViewport->SetPostprocessParams(params);
+    mViewport->UpdateFrontBuffer();
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            referencePixels.PushBack(mViewport->GetFrontBuffer().GetPixelRef<uint32>(x, y));
+        }
+    }
+
+    params.useSimd = true;
+    mViewport->SetPostprocessParams(params);
+    mViewport->UpdateFrontBuffer();
+    for (uint32 y = 0; y < height; ++y)
+    {
+        for (uint32 x = 0; x < width; ++x)
+        {
+            const uint32 expected = referencePixels[y * width + x];
+            const uint32 actual = mViewport->GetFrontBuffer().GetPixelRef<uint32>(x, y);
+
+            // allow off-by-one differences due to floating point precision of the SIMD tone mapping
+            for (uint32 channel = 0; channel < 3; ++channel)
+            {
+                const int32 expectedValue = (expected >> (8 * channel)) & 0xFF;
+                const int32 actualValue = (actual >> (8 * channel)) & 0xFF;
+                EXPECT_NEAR(expectedValue, actualValue, 1) << "x=" << x << ", y=" << y << ", channel=" << channel;
+            }
+        }
+    }
+}
+
+TEST_F(RenderingTest, HdrImageExport)
+{
+    const char* path = "hdr_image_export_test.exr";
+    const uint32 width = 40;
+    const uint32 height = 24;
+    const Vector4 backgroundColor(0.25f, 0.5f, 1.0f);
+
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(backgroundColor)));
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    mViewport->Resize(width, height);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+    ASSERT_TRUE(mViewport->Render(camera));
+
+    // synchronous export
+    {
+        ASSERT_TRUE(mViewport->SaveHdrImage(path));
+
+        Bitmap image;
+        ASSERT_TRUE(image.Load(path));
+        remove(path);
+        ASSERT_EQ(width, image.GetWidth());
+        ASSERT_EQ(height, image.GetHeight());
+        ValidateBitmap(image, backgroundColor, 0.001f);
+    }
+
+    // background export, interleaved with rendering
+    {
+        ASSERT_TRUE(mViewport->BeginHdrImageExport(path));
+        EXPECT_FALSE(mViewport->BeginHdrImageExport(path));
+        ASSERT_TRUE(mViewport->Render(camera));
+        if (mViewport->IsHdrImageExportInProgress())
+        {
+            ASSERT_TRUE(mViewport->FinishHdrImageExport());
+        }
+        EXPECT_FALSE(mViewport->IsHdrImageExportInProgress());
+
+        Bitmap image;
+        ASSERT_TRUE(image.Load(path));
+        remove(path);
+        ASSERT_EQ(width, image.GetWidth());
+        ASSERT_EQ(height, image.GetHeight());
+        ValidateBitmap(image, backgroundColor, 0.001f);
+    }
+}
+
+TEST_F(RenderingTest, Checkpoint)
+{
+    const char* path = "checkpoint_test.bin";
+    const uint32 width = 40;
+    const uint32 height = 24;
+    const Vector4 backgroundColor(0.25f, 0.5f, 1.0f);
+
+    mScene->AddObject(std::make_unique<LightSceneObject>(std::make_unique<BackgroundLight>(backgroundColor)));
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(static_cast<float>(width) / static_cast<float>(height), DegToRad(60.0f));
+
+    mViewport->Resize(width, height);
+    mViewport->SetRenderer(CreateRenderer("Path Tracer", *mScene));
+    ASSERT_TRUE(mViewport->Render(camera));
+    ASSERT_TRUE(mViewport->Render(camera));
+    ASSERT_TRUE(mViewport->Render(camera));
+    ASSERT_TRUE(mViewport->SaveCheckpoint(path));
+
+    // the checkpoint is written to a temporary file, then renamed
+    FILE* tempFile = fopen((std::string(path) + ".tmp").c_str(), "rb");
+    EXPECT_EQ(nullptr, tempFile);
+    if (tempFile)
+    {
+        fclose(tempFile);
+    }
+
+    Viewport resumedViewport;
+    resumedViewport.SetRenderer(CreateRenderer("Path Tracer", *mScene));
+    ASSERT_TRUE(resumedViewport.LoadCheckpoint(path));
+    remove(path);
+
+    ASSERT_EQ(width, resumedViewport.GetWidth());
+    ASSERT_EQ(height, resumedViewport.GetHeight());
+    EXPECT_EQ(3u, resumedViewport.GetProgress().passesFinished);
+
+    const Bitmap& sum = mViewport->GetSumBuffer();
+    const Bitmap& resumedSum = resumedViewport.GetSumBuffer();
+    ASSERT_EQ(sum.GetDataSize(), resumedSum.GetDataSize());
+    EXPECT_EQ(0, memcmp(sum.GetData(), resumedSum.GetData(), sum.GetDataSize()));
+
+    // continue accumulation on top of the restored samples
+    ASSERT_TRUE(resumedViewport.Render(camera));
+    EXPECT_EQ(4u, resumedViewport.GetProgress().passesFinished);
+
+    Bitmap image;
+    ASSERT_TRUE(resumedViewport.GetHdrImage(image));
+    ValidateBitmap(image, backgroundColor, 0.001f);
+
+    // invalid files are rejected
+    EXPECT_FALSE(resumedViewport.LoadCheckpoint("nonexisting_checkpoint.bin"));
+
+    // number of blocks doesn't match the viewport
+    ASSERT_TRUE(mViewport->SaveCheckpoint(path));
+    {
+        FILE* file = fopen(path, "r+b");
+        ASSERT_NE(nullptr, file);
+
+        // Note: number of blocks is the fifth field of the header
+        const uint32 numBlocks = width * height + 1;
+        EXPECT_EQ(0, fseek(file, 4 * sizeof(uint32), SEEK_SET));
+        EXPECT_EQ(1u, fwrite(&numBlocks, sizeof(numBlocks), 1, file));
+        fclose(file);
+    }
+    EXPECT_FALSE(resumedViewport.LoadCheckpoint(path));
+    remove(path);
+}
+
+TEST_F(RenderingTest, Checkpoint_VCM)
+{
+    const char* path = "checkpoint_vcm_test.bin";
+    const uint32 numPasses = 16;
+
+    MaterialPtr material = std::make_unique<Material>();
+    material->SetBsdf("diffuse");
+    material->baseColor = Vector4(0.8f);
+    material->Compile();
+
+    auto lightObject = std::make_unique<LightSceneObject>(std::make_unique<PointLight>(Vector4(50.0f)));
+    lightObject->SetTransform(Transform(Vector4(0.0f, 0.0f, -4.0f)).ToMatrix4());
+    mScene->AddObject(std::move(lightObject));
+
+    ShapeSceneObjectPtr sceneObject = std::make_unique<ShapeSceneObject>(std::make_unique<SphereShape>(1.0f));
+    sceneObject->SetDefaultMaterial(material);
+    mScene->AddObject(std::move(sceneObject));
+
+    mScene->BuildBVH();
+
+    Camera camera;
+    camera.SetPerspective(1.0f, DegToRad(10.0f));
+    camera.SetTransform(Transform(Vector4(0.0f, 0.0f, -3.0f)));
+
+    const auto createRenderer = [this]()
+    {
+        RendererPtr renderer = CreateRenderer("VCM", *mScene);
+        VertexConnectionAndMerging* vcm = static_cast<VertexConnectionAndMerging*>(renderer.get());
+        vcm->mInitialMergingRadius = 0.2f;
+        vcm->mMinMergingRadius = 0.2f;
+        return renderer;
+    };
+
+    const auto calculateAverageBrightness = [](const Bitmap& sum)
+    {
+        float brightness = 0.0f;
+        for (uint32 y = 0; y < sum.GetHeight(); ++y)
+        {
+            for (uint32 x = 0; x < sum.GetWidth(); ++x)
+            {
+                const Vector4 value = sum.GetPixel(x, y);
+                EXPECT_TRUE(value.IsValid()) << "x=" << x << ", y=" << y;
+                brightness += value.x;
+            }
+        }
+        return brightness / static_cast<float>(sum.GetWidth() * sum.GetHeight());
+    };
+
+    mViewport->Resize(ViewportSize, ViewportSize);
+    mViewport->SetRenderer(createRenderer());
+    for (uint32 i = 0; i < numPasses; ++i)
+    {
+        ASSERT_TRUE(mViewport->Render(camera));
+    }
+    ASSERT_TRUE(mViewport->SaveCheckpoint(path));
+
+    // the resumed renderer has no photons from the previous pass, so it must not try to merge with them
+    Viewport resumedViewport;
+    resumedViewport.SetRenderer(createRenderer());
+    ASSERT_TRUE(resumedViewport.LoadCheckpoint(path));
+    remove(path);
+
+    for (uint32 i = 0; i < numPasses; ++i)
+    {
+        ASSERT_TRUE(mViewport->Render(camera));
+        ASSERT_TRUE(resumedViewport.Render(camera));
+    }
+
+    const float averageBrightness = calculateAverageBrightness(mViewport->GetSumBuffer());
+    const float resumedAverageBrightness = calculateAverageBrightness(resumedViewport.GetSumBuffer());
+
+    ASSERT_GT(averageBrightness, 0.0f);
+    EXPECT_NEAR(1.0f, resumedAverageBrightness / averageBrightness, 0.1f);
+}
+
 // TODO
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "PCH.h"
+#include "../Core/Utils/ThreadPool.h"
+
+#include <atomic>
+
+using namespace rt;
+
+
+TEST(UtilsTest, ThreadPool_AllTasksExecutedOnce)
+{
+    ThreadPool pool;
+    pool.SetNumThreads(8);
+    ASSERT_EQ(8u, pool.GetNumThreads());
+
+    for (const uint32 numTasks : { 1u, 2u, 7u, 100u, 10000u })
+    {
+        DynArray<std::atomic<uint32>> counters(numTasks);
+        for (auto& counter : counters)
+        {
+            counter = 0;
+        }
+
+        std::atomic<bool> invalidThreadID(false);
+        const auto taskCallback = [&](uint32 taskID, uint32 threadID)
+        {
+            counters[taskID]++;
+            if (threadID >= pool.GetNumThreads())
+            {
+                invalidThreadID = true;
+            }
+        };
+
+        pool.RunParallelTask(taskCallback, numTasks);
+
+        EXPECT_FALSE(invalidThreadID);
+        for (uint32 i = 0; i < numTasks; ++i)
+        {
+            EXPECT_EQ(1u, counters[i].load()) << "Task ID: " << i;
+        }
+    }
+}
+
+TEST(UtilsTest, ThreadPool_ChangeNumThreads)
+{
+    ThreadPool pool;
+
+    for (const uint32 numThreads : { 1u, 3u, 16u, 2u })
+    {
+        pool.SetNumThreads(numThreads);
+        ASSERT_EQ(numThreads, pool.GetNumThreads());
+
+        std::atomic<uint32> sum(0);
+        pool.RunParallelTask([&sum](uint32 taskID, uint32) { sum += taskID; }, 1000);
+        EXPECT_EQ(1000u * 999u / 2u, sum.load());
+    }
+}
+
+TEST(UtilsTest, ThreadPool_NestedTasks)
+{
+    const uint32 numOuterTasks = 64;
+    const uint32 numInnerTasks = 256;
+
+    ThreadPool pool;
+    pool.SetNumThreads(4);
+
+    std::atomic<uint32> counter(0);
+    const auto outerTask = [&](uint32, uint32)
+    {
+        pool.RunParallelTask([&counter](uint32, uint32) { counter++; }, numInnerTasks);
+    };
+
+    pool.RunParallelTask(outerTask, numOuterTasks);
+
+    EXPECT_EQ(numOuterTasks * numInnerTasks, counter.load());
+}